@@ -6,5 +6,5 @@
 @ stdcall DeviceIoControl() kernel32.DeviceIoControl
 @ stdcall GetOverlappedResult() kernel32.GetOverlappedResult
 @ stdcall GetQueuedCompletionStatus() kernel32.GetQueuedCompletionStatus
-@ stub GetQueuedCompletionStatusEx
+@ stdcall GetQueuedCompletionStatusEx() kernel32_vista.GetQueuedCompletionStatusEx
 @ stdcall PostQueuedCompletionStatus() kernel32.PostQueuedCompletionStatus
@@ -9,5 +9,5 @@
 @ stdcall GetOverlappedResult() kernel32.GetOverlappedResult
 @ stub GetOverlappedResultEx
 @ stdcall GetQueuedCompletionStatus() kernel32.GetQueuedCompletionStatus
-@ stub GetQueuedCompletionStatusEx
+@ stdcall GetQueuedCompletionStatusEx() kernel32_vista.GetQueuedCompletionStatusEx
 @ stdcall PostQueuedCompletionStatus() kernel32.PostQueuedCompletionStatus
@@ -1,45 +1,45 @@
 
 # This file is autogenerated by update.py
 
-@ stub CallbackMayRunLong
-@ stub CancelThreadpoolIo
+@ stdcall CallbackMayRunLong() kernel32_vista.CallbackMayRunLong
+@ stdcall CancelThreadpoolIo() kernel32_vista.CancelThreadpoolIo
 @ stdcall ChangeTimerQueueTimer() kernel32.ChangeTimerQueueTimer
-@ stub CloseThreadpool
-@ stub CloseThreadpoolCleanupGroup
-@ stub CloseThreadpoolCleanupGroupMembers
-@ stub CloseThreadpoolIo
-@ stub CloseThreadpoolTimer
-@ stub CloseThreadpoolWait
-@ stub CloseThreadpoolWork
-@ stub CreateThreadpool
-@ stub CreateThreadpoolCleanupGroup
-@ stub CreateThreadpoolIo
-@ stub CreateThreadpoolTimer
-@ stub CreateThreadpoolWait
-@ stub CreateThreadpoolWork
+@ stdcall CloseThreadpool() kernel32_vista.CloseThreadpool
+@ stdcall CloseThreadpoolCleanupGroup() kernel32_vista.CloseThreadpoolCleanupGroup
+@ stdcall CloseThreadpoolCleanupGroupMembers() kernel32_vista.CloseThreadpoolCleanupGroupMembers
+@ stdcall CloseThreadpoolIo() kernel32_vista.CloseThreadpoolIo
+@ stdcall CloseThreadpoolTimer() kernel32_vista.CloseThreadpoolTimer
+@ stdcall CloseThreadpoolWait() kernel32_vista.CloseThreadpoolWait
+@ stdcall CloseThreadpoolWork() kernel32_vista.CloseThreadpoolWork
+@ stdcall CreateThreadpool() kernel32_vista.CreateThreadpool
+@ stdcall CreateThreadpoolCleanupGroup() kernel32_vista.CreateThreadpoolCleanupGroup
+@ stdcall CreateThreadpoolIo() kernel32_vista.CreateThreadpoolIo
+@ stdcall CreateThreadpoolTimer() kernel32_vista.CreateThreadpoolTimer
+@ stdcall CreateThreadpoolWait() kernel32_vista.CreateThreadpoolWait
+@ stdcall CreateThreadpoolWork() kernel32_vista.CreateThreadpoolWork
 @ stdcall CreateTimerQueue() kernel32.CreateTimerQueue
 @ stdcall CreateTimerQueueTimer() kernel32.CreateTimerQueueTimer
 @ stdcall DeleteTimerQueueEx() kernel32.DeleteTimerQueueEx
 @ stdcall DeleteTimerQueueTimer() kernel32.DeleteTimerQueueTimer
-@ stub DisassociateCurrentThreadFromCallback
-@ stub FreeLibraryWhenCallbackReturns
-@ stub IsThreadpoolTimerSet
-@ stub LeaveCriticalSectionWhenCallbackReturns
+@ stdcall DisassociateCurrentThreadFromCallback() kernel32_vista.DisassociateCurrentThreadFromCallback
+@ stdcall FreeLibraryWhenCallbackReturns() kernel32_vista.FreeLibraryWhenCallbackReturns
+@ stdcall IsThreadpoolTimerSet() kernel32_vista.IsThreadpoolTimerSet
+@ stdcall LeaveCriticalSectionWhenCallbackReturns() kernel32_vista.LeaveCriticalSectionWhenCallbackReturns
 @ stub QueryThreadpoolStackInformation
 @ stdcall RegisterWaitForSingleObjectEx() kernel32.RegisterWaitForSingleObjectEx
-@ stub ReleaseMutexWhenCallbackReturns
-@ stub ReleaseSemaphoreWhenCallbackReturns
-@ stub SetEventWhenCallbackReturns
+@ stdcall ReleaseMutexWhenCallbackReturns() kernel32_vista.ReleaseMutexWhenCallbackReturns
+@ stdcall ReleaseSemaphoreWhenCallbackReturns() kernel32_vista.ReleaseSemaphoreWhenCallbackReturns
+@ stdcall SetEventWhenCallbackReturns() kernel32_vista.SetEventWhenCallbackReturns
 @ stub SetThreadpoolStackInformation
-@ stub SetThreadpoolThreadMaximum
-@ stub SetThreadpoolThreadMinimum
-@ stub SetThreadpoolTimer
-@ stub SetThreadpoolWait
-@ stub StartThreadpoolIo
-@ stub SubmitThreadpoolWork
-@ stub TrySubmitThreadpoolCallback
+@ stdcall SetThreadpoolThreadMaximum() kernel32_vista.SetThreadpoolThreadMaximum
+@ stdcall SetThreadpoolThreadMinimum() kernel32_vista.SetThreadpoolThreadMinimum
+@ stdcall SetThreadpoolTimer() kernel32_vista.SetThreadpoolTimer
+@ stdcall SetThreadpoolWait() kernel32_vista.SetThreadpoolWait
+@ stdcall StartThreadpoolIo() kernel32_vista.StartThreadpoolIo
+@ stdcall SubmitThreadpoolWork() kernel32_vista.SubmitThreadpoolWork
+@ stdcall TrySubmitThreadpoolCallback() kernel32_vista.TrySubmitThreadpoolCallback
 @ stdcall UnregisterWaitEx() kernel32.UnregisterWaitEx
-@ stub WaitForThreadpoolIoCallbacks
-@ stub WaitForThreadpoolTimerCallbacks
-@ stub WaitForThreadpoolWaitCallbacks
-@ stub WaitForThreadpoolWorkCallbacks
+@ stdcall WaitForThreadpoolIoCallbacks() kernel32_vista.WaitForThreadpoolIoCallbacks
+@ stdcall WaitForThreadpoolTimerCallbacks() kernel32_vista.WaitForThreadpoolTimerCallbacks
+@ stdcall WaitForThreadpoolWaitCallbacks() kernel32_vista.WaitForThreadpoolWaitCallbacks
+@ stdcall WaitForThreadpoolWorkCallbacks() kernel32_vista.WaitForThreadpoolWorkCallbacks
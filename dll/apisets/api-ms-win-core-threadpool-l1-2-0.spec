@@ -1,40 +1,40 @@
 
 # This file is autogenerated by update.py
 
-@ stub CallbackMayRunLong
-@ stub CancelThreadpoolIo
-@ stub CloseThreadpool
-@ stub CloseThreadpoolCleanupGroup
-@ stub CloseThreadpoolCleanupGroupMembers
-@ stub CloseThreadpoolIo
-@ stub CloseThreadpoolTimer
-@ stub CloseThreadpoolWait
-@ stub CloseThreadpoolWork
-@ stub CreateThreadpool
-@ stub CreateThreadpoolCleanupGroup
-@ stub CreateThreadpoolIo
-@ stub CreateThreadpoolTimer
-@ stub CreateThreadpoolWait
-@ stub CreateThreadpoolWork
-@ stub DisassociateCurrentThreadFromCallback
-@ stub FreeLibraryWhenCallbackReturns
-@ stub IsThreadpoolTimerSet
-@ stub LeaveCriticalSectionWhenCallbackReturns
+@ stdcall CallbackMayRunLong() kernel32_vista.CallbackMayRunLong
+@ stdcall CancelThreadpoolIo() kernel32_vista.CancelThreadpoolIo
+@ stdcall CloseThreadpool() kernel32_vista.CloseThreadpool
+@ stdcall CloseThreadpoolCleanupGroup() kernel32_vista.CloseThreadpoolCleanupGroup
+@ stdcall CloseThreadpoolCleanupGroupMembers() kernel32_vista.CloseThreadpoolCleanupGroupMembers
+@ stdcall CloseThreadpoolIo() kernel32_vista.CloseThreadpoolIo
+@ stdcall CloseThreadpoolTimer() kernel32_vista.CloseThreadpoolTimer
+@ stdcall CloseThreadpoolWait() kernel32_vista.CloseThreadpoolWait
+@ stdcall CloseThreadpoolWork() kernel32_vista.CloseThreadpoolWork
+@ stdcall CreateThreadpool() kernel32_vista.CreateThreadpool
+@ stdcall CreateThreadpoolCleanupGroup() kernel32_vista.CreateThreadpoolCleanupGroup
+@ stdcall CreateThreadpoolIo() kernel32_vista.CreateThreadpoolIo
+@ stdcall CreateThreadpoolTimer() kernel32_vista.CreateThreadpoolTimer
+@ stdcall CreateThreadpoolWait() kernel32_vista.CreateThreadpoolWait
+@ stdcall CreateThreadpoolWork() kernel32_vista.CreateThreadpoolWork
+@ stdcall DisassociateCurrentThreadFromCallback() kernel32_vista.DisassociateCurrentThreadFromCallback
+@ stdcall FreeLibraryWhenCallbackReturns() kernel32_vista.FreeLibraryWhenCallbackReturns
+@ stdcall IsThreadpoolTimerSet() kernel32_vista.IsThreadpoolTimerSet
+@ stdcall LeaveCriticalSectionWhenCallbackReturns() kernel32_vista.LeaveCriticalSectionWhenCallbackReturns
 @ stub QueryThreadpoolStackInformation
-@ stub ReleaseMutexWhenCallbackReturns
-@ stub ReleaseSemaphoreWhenCallbackReturns
-@ stub SetEventWhenCallbackReturns
+@ stdcall ReleaseMutexWhenCallbackReturns() kernel32_vista.ReleaseMutexWhenCallbackReturns
+@ stdcall ReleaseSemaphoreWhenCallbackReturns() kernel32_vista.ReleaseSemaphoreWhenCallbackReturns
+@ stdcall SetEventWhenCallbackReturns() kernel32_vista.SetEventWhenCallbackReturns
 @ stub SetThreadpoolStackInformation
-@ stub SetThreadpoolThreadMaximum
-@ stub SetThreadpoolThreadMinimum
-@ stub SetThreadpoolTimer
+@ stdcall SetThreadpoolThreadMaximum() kernel32_vista.SetThreadpoolThreadMaximum
+@ stdcall SetThreadpoolThreadMinimum() kernel32_vista.SetThreadpoolThreadMinimum
+@ stdcall SetThreadpoolTimer() kernel32_vista.SetThreadpoolTimer
 @ stub SetThreadpoolTimerEx
-@ stub SetThreadpoolWait
+@ stdcall SetThreadpoolWait() kernel32_vista.SetThreadpoolWait
 @ stub SetThreadpoolWaitEx
-@ stub StartThreadpoolIo
-@ stub SubmitThreadpoolWork
-@ stub TrySubmitThreadpoolCallback
-@ stub WaitForThreadpoolIoCallbacks
-@ stub WaitForThreadpoolTimerCallbacks
-@ stub WaitForThreadpoolWaitCallbacks
-@ stub WaitForThreadpoolWorkCallbacks
+@ stdcall StartThreadpoolIo() kernel32_vista.StartThreadpoolIo
+@ stdcall SubmitThreadpoolWork() kernel32_vista.SubmitThreadpoolWork
+@ stdcall TrySubmitThreadpoolCallback() kernel32_vista.TrySubmitThreadpoolCallback
+@ stdcall WaitForThreadpoolIoCallbacks() kernel32_vista.WaitForThreadpoolIoCallbacks
+@ stdcall WaitForThreadpoolTimerCallbacks() kernel32_vista.WaitForThreadpoolTimerCallbacks
+@ stdcall WaitForThreadpoolWaitCallbacks() kernel32_vista.WaitForThreadpoolWaitCallbacks
+@ stdcall WaitForThreadpoolWorkCallbacks() kernel32_vista.WaitForThreadpoolWorkCallbacks
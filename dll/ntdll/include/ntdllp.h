@@ -8,8 +8,11 @@
 
 #pragma once
 
-#define LDR_HASH_TABLE_ENTRIES 32
-#define LDR_GET_HASH_ENTRY(x) (RtlUpcaseUnicodeChar((x)) & (LDR_HASH_TABLE_ENTRIES - 1))
+#define LDR_HASH_TABLE_ENTRIES 128
+
+/* Export name tables with fewer names are binary searched, without a hash */
+#define LDRP_EXPORT_HASH_MIN_NAMES 64
+#define LDRP_EXPORT_HASH_MODULES   64
 
 /* LdrpUpdateLoadCount2 flags */
 #define LDRP_UPDATE_REFCOUNT   0x01
@@ -29,6 +32,16 @@ typedef struct _LDRP_TLS_DATA
     IMAGE_TLS_DIRECTORY TlsDirectory;
 } LDRP_TLS_DATA, *PLDRP_TLS_DATA;
 
+typedef struct _LDRP_EXPORT_HASH
+{
+    struct _LDRP_EXPORT_HASH *Next;
+    PVOID DllBase;
+    PIMAGE_EXPORT_DIRECTORY ExportDirectory;
+    ULONG BucketMask;
+    PULONG Buckets;
+    PULONG NextName;
+} LDRP_EXPORT_HASH, *PLDRP_EXPORT_HASH;
+
 /* Global data */
 extern RTL_CRITICAL_SECTION LdrpLoaderLock;
 extern BOOLEAN LdrpInLdrInit;
@@ -84,6 +97,9 @@ NTSTATUS NTAPI
 LdrpWalkImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                          IN PLDR_DATA_TABLE_ENTRY LdrEntry);
 
+VOID NTAPI
+LdrpFreeExportHash(IN PVOID DllBase);
+
 
 /* ldrutils.c */
 NTSTATUS NTAPI
@@ -99,6 +115,9 @@ LdrpAllocateDataTableEntry(IN PVOID BaseAddress);
 VOID NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry);
 
+ULONG NTAPI
+LdrpHashUnicodeString(IN PUNICODE_STRING NameString);
+
 NTSTATUS NTAPI
 LdrpLoadDll(IN BOOLEAN Redirected,
             IN PWSTR DllPath OPTIONAL,
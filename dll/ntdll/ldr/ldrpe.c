@@ -17,6 +17,7 @@
 
 PLDR_MANIFEST_PROBER_ROUTINE LdrpManifestProberRoutine;
 ULONG LdrpNormalSnap;
+PLDRP_EXPORT_HASH LdrpExportHashTable[LDRP_EXPORT_HASH_MODULES];
 
 /* FUNCTIONS *****************************************************************/
 
@@ -408,9 +409,6 @@ LdrpHandleOneNewFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                         &LdrEntry->BaseDllName,
                         ForwarderName);
             }
-
-            /* Remember it's valid */
-            Stale = FALSE;
         }
 
         /* Move to the next one */
@@ -530,7 +528,7 @@ LdrpHandleOneOldFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
 {
     LPSTR ImportName;
     NTSTATUS Status;
-    BOOLEAN AlreadyLoaded = FALSE;
+    BOOLEAN AlreadyLoaded = FALSE, Bound;
     PLDR_DATA_TABLE_ENTRY DllLdrEntry;
     PIMAGE_THUNK_DATA FirstThunk;
     PPEB Peb = NtCurrentPeb();
@@ -582,7 +580,6 @@ LdrpHandleOneOldFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
     }
 
     /* Check if it wasn't already loaded */
-    ++LdrpNormalSnap;
     if (!AlreadyLoaded)
     {
         /* Add the DLL to our list */
@@ -590,8 +587,31 @@ LdrpHandleOneOldFormatImportDescriptor(IN LPWSTR DllPath OPTIONAL,
                        &DllLdrEntry->InInitializationOrderLinks);
     }
 
-    /* Now snap the IAT Entry */
-    Status = LdrpSnapIAT(DllLdrEntry, LdrEntry, *ImportEntry, FALSE);
+    /*
+     * An old style binding is only valid if it was made against this very
+     * DLL at its preferred base, and we need the original thunks to snap
+     * the forwarders. A time stamp of -1 would mean new style binding.
+     */
+    Bound = ((*ImportEntry)->TimeDateStamp != 0) &&
+            ((*ImportEntry)->TimeDateStamp != 0xFFFFFFFF) &&
+            ((*ImportEntry)->OriginalFirstThunk != 0) &&
+            ((*ImportEntry)->TimeDateStamp == DllLdrEntry->TimeDateStamp) &&
+            !(DllLdrEntry->Flags & LDRP_IMAGE_NOT_AT_BASE);
+    if (!Bound)
+    {
+        /* Show debug message */
+        if (ShowSnaps && (*ImportEntry)->TimeDateStamp)
+        {
+            DPRINT1("LDR: %wZ has stale binding to %s\n",
+                    &LdrEntry->BaseDllName,
+                    ImportName);
+        }
+
+        ++LdrpNormalSnap;
+    }
+
+    /* Now snap the IAT Entry, only the forwarders if the binding is valid */
+    Status = LdrpSnapIAT(DllLdrEntry, LdrEntry, *ImportEntry, Bound);
     if (!NT_SUCCESS(Status))
     {
         /* Fail */
@@ -676,6 +696,137 @@ LdrpNameToOrdinal(IN LPSTR ImportName,
     return OrdinalTable[Next];
 }
 
+static
+ULONG
+LdrpHashExportName(IN PCSTR Name)
+{
+    ULONG Hash = 0;
+
+    while (*Name) Hash = Hash * 65599 + (UCHAR)*Name++;
+    return Hash;
+}
+
+/* Loader lock must be held */
+static
+PLDRP_EXPORT_HASH
+LdrpGetExportHash(IN PVOID ExportBase,
+                  IN PIMAGE_EXPORT_DIRECTORY ExportEntry,
+                  IN PULONG NameTable)
+{
+    PLDRP_EXPORT_HASH ExportHash;
+    ULONG Index, BucketCount, Bucket, i;
+
+    /* DLLs are mapped on 64K boundaries */
+    Index = ((ULONG_PTR)ExportBase >> 16) & (LDRP_EXPORT_HASH_MODULES - 1);
+
+    /* Check if it was already built */
+    for (ExportHash = LdrpExportHashTable[Index]; ExportHash; ExportHash = ExportHash->Next)
+    {
+        if ((ExportHash->DllBase == ExportBase) &&
+            (ExportHash->ExportDirectory == ExportEntry))
+        {
+            return ExportHash;
+        }
+    }
+
+    /* Names can only lead to 64K ordinals */
+    if (ExportEntry->NumberOfNames > 0x10000) return NULL;
+
+    /* Use about one bucket per name */
+    BucketCount = 1;
+    while (BucketCount < ExportEntry->NumberOfNames) BucketCount <<= 1;
+
+    ExportHash = RtlAllocateHeap(RtlGetProcessHeap(),
+                                 0,
+                                 sizeof(LDRP_EXPORT_HASH) +
+                                 (BucketCount + ExportEntry->NumberOfNames) * sizeof(ULONG));
+    if (!ExportHash) return NULL;
+
+    ExportHash->DllBase = ExportBase;
+    ExportHash->ExportDirectory = ExportEntry;
+    ExportHash->BucketMask = BucketCount - 1;
+    ExportHash->Buckets = (PULONG)(ExportHash + 1);
+    ExportHash->NextName = ExportHash->Buckets + BucketCount;
+    RtlZeroMemory(ExportHash->Buckets, BucketCount * sizeof(ULONG));
+
+    /* Chain the names, bucket entries are name indexes plus one */
+    for (i = ExportEntry->NumberOfNames; i-- > 0;)
+    {
+        Bucket = LdrpHashExportName((PCHAR)((ULONG_PTR)ExportBase + NameTable[i])) &
+                 ExportHash->BucketMask;
+        ExportHash->NextName[i] = ExportHash->Buckets[Bucket];
+        ExportHash->Buckets[Bucket] = i + 1;
+    }
+
+    /* Insert it */
+    ExportHash->Next = LdrpExportHashTable[Index];
+    LdrpExportHashTable[Index] = ExportHash;
+    return ExportHash;
+}
+
+static
+USHORT
+LdrpLookupExportName(IN LPSTR ImportName,
+                     IN PVOID ExportBase,
+                     IN PIMAGE_EXPORT_DIRECTORY ExportEntry,
+                     IN PULONG NameTable,
+                     IN PUSHORT OrdinalTable)
+{
+    PLDRP_EXPORT_HASH ExportHash = NULL;
+    ULONG Name;
+
+    /* Big export tables get a hash the first time the hint doesn't do */
+    if (ExportEntry->NumberOfNames >= LDRP_EXPORT_HASH_MIN_NAMES)
+    {
+        ExportHash = LdrpGetExportHash(ExportBase, ExportEntry, NameTable);
+    }
+
+    /* Fall back to the binary search if there isn't any */
+    if (!ExportHash)
+    {
+        return LdrpNameToOrdinal(ImportName,
+                                 ExportEntry->NumberOfNames,
+                                 ExportBase,
+                                 NameTable,
+                                 OrdinalTable);
+    }
+
+    /* Walk the chain of the bucket */
+    Name = ExportHash->Buckets[LdrpHashExportName(ImportName) & ExportHash->BucketMask];
+    while (Name)
+    {
+        if (!strcmp(ImportName, (PCHAR)((ULONG_PTR)ExportBase + NameTable[Name - 1])))
+        {
+            return OrdinalTable[Name - 1];
+        }
+        Name = ExportHash->NextName[Name - 1];
+    }
+
+    /* Not found */
+    return -1;
+}
+
+VOID
+NTAPI
+LdrpFreeExportHash(IN PVOID DllBase)
+{
+    PLDRP_EXPORT_HASH *Link, ExportHash;
+
+    Link = &LdrpExportHashTable[((ULONG_PTR)DllBase >> 16) & (LDRP_EXPORT_HASH_MODULES - 1)];
+    while ((ExportHash = *Link))
+    {
+        if (ExportHash->DllBase == DllBase)
+        {
+            *Link = ExportHash->Next;
+            RtlFreeHeap(RtlGetProcessHeap(), 0, ExportHash);
+        }
+        else
+        {
+            Link = &ExportHash->Next;
+        }
+    }
+}
+
 NTSTATUS
 NTAPI
 LdrpWalkImportDescriptor(IN LPWSTR DllPath OPTIONAL,
@@ -1025,11 +1176,11 @@ LdrpSnapThunk(IN PVOID ExportBase,
         else
         {
             /* Well bummer, hint didn't work, do it the long way */
-            Ordinal = LdrpNameToOrdinal(ImportName,
-                                        ExportEntry->NumberOfNames,
-                                        ExportBase,
-                                        NameTable,
-                                        OrdinalTable);
+            Ordinal = LdrpLookupExportName(ImportName,
+                                           ExportBase,
+                                           ExportEntry,
+                                           NameTable,
+                                           OrdinalTable);
         }
     }
 
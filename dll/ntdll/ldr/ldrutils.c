@@ -1571,6 +1571,26 @@ LdrpAllocateDataTableEntry(IN PVOID BaseAddress)
     return LdrEntry;
 }
 
+ULONG
+NTAPI
+LdrpHashUnicodeString(IN PUNICODE_STRING NameString)
+{
+    ULONG Result = 0;
+    ULONG i;
+
+    /*
+     * Hash the whole name, many DLLs share their first character. Upcase it
+     * like RtlEqualUnicodeString does, so that names comparing equal get the
+     * same hash.
+     */
+    for (i = 0; i < NameString->Length / sizeof(WCHAR); i++)
+    {
+        Result = Result * 65599 + RtlUpcaseUnicodeChar(NameString->Buffer[i]);
+    }
+
+    return Result & (LDR_HASH_TABLE_ENTRIES - 1);
+}
+
 VOID
 NTAPI
 LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
@@ -1579,7 +1599,7 @@ LdrpInsertMemoryTableEntry(IN PLDR_DATA_TABLE_ENTRY LdrEntry)
     ULONG i;
 
     /* Insert into hash table */
-    i = LDR_GET_HASH_ENTRY(LdrEntry->BaseDllName.Buffer[0]);
+    i = LdrpHashUnicodeString(&LdrEntry->BaseDllName);
     InsertTailList(&LdrpHashTable[i], &LdrEntry->HashLinks);
 
     /* Insert into other lists */
@@ -1606,6 +1626,9 @@ LdrpFinalizeAndDeallocateDataTableEntry(IN PLDR_DATA_TABLE_ENTRY Entry)
     /* Release the full dll name string */
     if (Entry->FullDllName.Buffer) LdrpFreeUnicodeString(&Entry->FullDllName);
 
+    /* The export name hash is stale once the DLL is gone */
+    LdrpFreeExportHash(Entry->DllBase);
+
     /* Finally free the entry's memory */
     RtlFreeHeap(RtlGetProcessHeap(), 0, Entry);
 }
@@ -2005,7 +2028,7 @@ lookinhash:
         /* FIXME: if we get redirected dll it means that we also get a full path so we need to find its filename for the hash lookup */
 
         /* Get hash index */
-        HashIndex = LDR_GET_HASH_ENTRY(DllName->Buffer[0]);
+        HashIndex = LdrpHashUnicodeString(DllName);
 
         /* Traverse that list */
         ListHead = &LdrpHashTable[HashIndex];
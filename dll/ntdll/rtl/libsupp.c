@@ -55,6 +55,14 @@ RtlpGetMode(VOID)
    return UserMode;
 }
 
+ULONG
+NTAPI
+RtlpGetAffinityHint(VOID)
+{
+    /* Thread IDs are multiples of 4, drop the low bits */
+    return HandleToUlong(NtCurrentTeb()->ClientId.UniqueThread) >> 2;
+}
+
 /*
  * @implemented
  */
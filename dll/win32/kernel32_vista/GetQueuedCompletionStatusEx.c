@@ -0,0 +1,63 @@
+
+#include "k32_vista.h"
+
+#include <ndk/rtlfuncs.h>
+#include <ndk/iofuncs.h>
+
+/* The entries are filled in by the native API directly */
+C_ASSERT(sizeof(OVERLAPPED_ENTRY) == sizeof(FILE_IO_COMPLETION_INFORMATION));
+C_ASSERT(FIELD_OFFSET(OVERLAPPED_ENTRY, lpCompletionKey) == FIELD_OFFSET(FILE_IO_COMPLETION_INFORMATION, KeyContext));
+C_ASSERT(FIELD_OFFSET(OVERLAPPED_ENTRY, lpOverlapped) == FIELD_OFFSET(FILE_IO_COMPLETION_INFORMATION, ApcContext));
+C_ASSERT(FIELD_OFFSET(OVERLAPPED_ENTRY, Internal) == FIELD_OFFSET(FILE_IO_COMPLETION_INFORMATION, IoStatusBlock.Status));
+C_ASSERT(FIELD_OFFSET(OVERLAPPED_ENTRY, dwNumberOfBytesTransferred) == FIELD_OFFSET(FILE_IO_COMPLETION_INFORMATION, IoStatusBlock.Information));
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+GetQueuedCompletionStatusEx(IN HANDLE CompletionPort,
+                            OUT LPOVERLAPPED_ENTRY lpCompletionPortEntries,
+                            IN ULONG ulCount,
+                            OUT PULONG ulNumEntriesRemoved,
+                            IN DWORD dwMilliseconds,
+                            IN BOOL fAlertable)
+{
+    NTSTATUS Status;
+    LARGE_INTEGER Time;
+    PLARGE_INTEGER TimePtr = NULL;
+    ULONG Removed = 0;
+
+    /* Convert the timeout */
+    if (dwMilliseconds != INFINITE)
+    {
+        Time.QuadPart = (ULONGLONG)dwMilliseconds * -10000;
+        TimePtr = &Time;
+    }
+
+    /* Get as many packets as we can in one go */
+    Status = NtRemoveIoCompletionEx(CompletionPort,
+                                    (PFILE_IO_COMPLETION_INFORMATION)lpCompletionPortEntries,
+                                    ulCount,
+                                    &Removed,
+                                    TimePtr,
+                                    fAlertable ? TRUE : FALSE);
+    if (!(NT_SUCCESS(Status)) || (Status == STATUS_TIMEOUT) || (Status == STATUS_USER_APC))
+    {
+        *ulNumEntriesRemoved = 0;
+
+        /* Timeouts and APCs are set directly since there's no conversion */
+        if (Status == STATUS_TIMEOUT)
+            SetLastError(WAIT_TIMEOUT);
+        else if (Status == STATUS_USER_APC)
+            SetLastError(WAIT_IO_COMPLETION);
+        else
+            SetLastError(RtlNtStatusToDosError(Status));
+
+        return FALSE;
+    }
+
+    /* Unlike GetQueuedCompletionStatus, failed I/O is reported in the entries only */
+    *ulNumEntriesRemoved = Removed;
+    return TRUE;
+}
@@ -1,6 +1,7 @@
 
 @ stdcall InitOnceExecuteOnce(ptr ptr ptr ptr)
 @ stdcall GetFileInformationByHandleEx(long long ptr long)
+@ stdcall GetQueuedCompletionStatusEx(ptr ptr long ptr long long)
 @ stdcall -ret64 GetTickCount64()
 
 @ stdcall InitializeSRWLock(ptr)
@@ -16,3 +17,37 @@
 @ stdcall WakeConditionVariable(ptr)
 
 @ stdcall InitializeCriticalSectionEx(ptr long long)
+
+@ stdcall CreateThreadpool(ptr)
+@ stdcall CloseThreadpool(ptr)
+@ stdcall SetThreadpoolThreadMaximum(ptr long)
+@ stdcall SetThreadpoolThreadMinimum(ptr long)
+@ stdcall CreateThreadpoolCleanupGroup()
+@ stdcall CloseThreadpoolCleanupGroup(ptr)
+@ stdcall CloseThreadpoolCleanupGroupMembers(ptr long ptr)
+@ stdcall CreateThreadpoolWork(ptr ptr ptr)
+@ stdcall SubmitThreadpoolWork(ptr)
+@ stdcall WaitForThreadpoolWorkCallbacks(ptr long)
+@ stdcall CloseThreadpoolWork(ptr)
+@ stdcall TrySubmitThreadpoolCallback(ptr ptr ptr)
+@ stdcall CreateThreadpoolTimer(ptr ptr ptr)
+@ stdcall SetThreadpoolTimer(ptr ptr long long)
+@ stdcall IsThreadpoolTimerSet(ptr)
+@ stdcall WaitForThreadpoolTimerCallbacks(ptr long)
+@ stdcall CloseThreadpoolTimer(ptr)
+@ stdcall CreateThreadpoolWait(ptr ptr ptr)
+@ stdcall SetThreadpoolWait(ptr ptr ptr)
+@ stdcall WaitForThreadpoolWaitCallbacks(ptr long)
+@ stdcall CloseThreadpoolWait(ptr)
+@ stdcall CreateThreadpoolIo(ptr ptr ptr ptr)
+@ stdcall StartThreadpoolIo(ptr)
+@ stdcall CancelThreadpoolIo(ptr)
+@ stdcall WaitForThreadpoolIoCallbacks(ptr long)
+@ stdcall CloseThreadpoolIo(ptr)
+@ stdcall CallbackMayRunLong(ptr)
+@ stdcall DisassociateCurrentThreadFromCallback(ptr)
+@ stdcall FreeLibraryWhenCallbackReturns(ptr ptr)
+@ stdcall LeaveCriticalSectionWhenCallbackReturns(ptr ptr)
+@ stdcall ReleaseMutexWhenCallbackReturns(ptr ptr)
+@ stdcall ReleaseSemaphoreWhenCallbackReturns(ptr ptr long)
+@ stdcall SetEventWhenCallbackReturns(ptr ptr)
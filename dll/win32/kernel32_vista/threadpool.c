@@ -0,0 +1,509 @@
+
+#include "k32_vista.h"
+
+#include <ndk/iofuncs.h>
+
+/* POOLS *********************************************************************/
+
+/*
+ * @implemented
+ */
+PTP_POOL
+WINAPI
+CreateThreadpool(IN PVOID Reserved)
+{
+    PTP_POOL Pool;
+    NTSTATUS Status;
+
+    Status = TpAllocPool(&Pool, Reserved);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    return Pool;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpool(IN OUT PTP_POOL Pool)
+{
+    TpReleasePool(Pool);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SetThreadpoolThreadMaximum(IN OUT PTP_POOL Pool,
+                           IN DWORD cthrdMost)
+{
+    TpSetPoolMaxThreads(Pool, cthrdMost);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+SetThreadpoolThreadMinimum(IN OUT PTP_POOL Pool,
+                           IN DWORD cthrdMic)
+{
+    NTSTATUS Status;
+
+    Status = TpSetPoolMinThreads(Pool, cthrdMic);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* CLEANUP GROUPS ************************************************************/
+
+/*
+ * @implemented
+ */
+PTP_CLEANUP_GROUP
+WINAPI
+CreateThreadpoolCleanupGroup(VOID)
+{
+    PTP_CLEANUP_GROUP CleanupGroup;
+    NTSTATUS Status;
+
+    Status = TpAllocCleanupGroup(&CleanupGroup);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    return CleanupGroup;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolCleanupGroup(IN OUT PTP_CLEANUP_GROUP CleanupGroup)
+{
+    TpReleaseCleanupGroup(CleanupGroup);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolCleanupGroupMembers(IN OUT PTP_CLEANUP_GROUP CleanupGroup,
+                                   IN BOOL fCancelPendingCallbacks,
+                                   IN OUT PVOID pvCleanupContext OPTIONAL)
+{
+    TpReleaseCleanupGroupMembers(CleanupGroup, fCancelPendingCallbacks != FALSE, pvCleanupContext);
+}
+
+/* WORK **********************************************************************/
+
+/*
+ * @implemented
+ */
+PTP_WORK
+WINAPI
+CreateThreadpoolWork(IN PTP_WORK_CALLBACK pfnwk,
+                     IN OUT PVOID pv OPTIONAL,
+                     IN PTP_CALLBACK_ENVIRON pcbe OPTIONAL)
+{
+    PTP_WORK Work;
+    NTSTATUS Status;
+
+    Status = TpAllocWork(&Work, pfnwk, pv, pcbe);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    return Work;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SubmitThreadpoolWork(IN OUT PTP_WORK Work)
+{
+    TpPostWork(Work);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WaitForThreadpoolWorkCallbacks(IN OUT PTP_WORK Work,
+                               IN BOOL fCancelPendingCallbacks)
+{
+    TpWaitForWork(Work, fCancelPendingCallbacks != FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolWork(IN OUT PTP_WORK Work)
+{
+    TpReleaseWork(Work);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+TrySubmitThreadpoolCallback(IN PTP_SIMPLE_CALLBACK pfns,
+                            IN OUT PVOID pv OPTIONAL,
+                            IN PTP_CALLBACK_ENVIRON pcbe OPTIONAL)
+{
+    NTSTATUS Status;
+
+    Status = TpSimpleTryPost(pfns, pv, pcbe);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/* TIMERS ********************************************************************/
+
+/*
+ * @implemented
+ */
+PTP_TIMER
+WINAPI
+CreateThreadpoolTimer(IN PTP_TIMER_CALLBACK pfnti,
+                      IN OUT PVOID pv OPTIONAL,
+                      IN PTP_CALLBACK_ENVIRON pcbe OPTIONAL)
+{
+    PTP_TIMER Timer;
+    NTSTATUS Status;
+
+    Status = TpAllocTimer(&Timer, pfnti, pv, pcbe);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    return Timer;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SetThreadpoolTimer(IN OUT PTP_TIMER Timer,
+                   IN PFILETIME pftDueTime OPTIONAL,
+                   IN DWORD msPeriod,
+                   IN DWORD msWindowLength OPTIONAL)
+{
+    LARGE_INTEGER DueTime;
+
+    if (pftDueTime)
+    {
+        DueTime.LowPart = pftDueTime->dwLowDateTime;
+        DueTime.HighPart = pftDueTime->dwHighDateTime;
+    }
+
+    TpSetTimer(Timer, pftDueTime ? &DueTime : NULL, msPeriod, msWindowLength);
+}
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+IsThreadpoolTimerSet(IN OUT PTP_TIMER Timer)
+{
+    return TpIsTimerSet(Timer);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WaitForThreadpoolTimerCallbacks(IN OUT PTP_TIMER Timer,
+                                IN BOOL fCancelPendingCallbacks)
+{
+    TpWaitForTimer(Timer, fCancelPendingCallbacks != FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolTimer(IN OUT PTP_TIMER Timer)
+{
+    TpReleaseTimer(Timer);
+}
+
+/* WAITS *********************************************************************/
+
+/*
+ * @implemented
+ */
+PTP_WAIT
+WINAPI
+CreateThreadpoolWait(IN PTP_WAIT_CALLBACK pfnwa,
+                     IN OUT PVOID pv OPTIONAL,
+                     IN PTP_CALLBACK_ENVIRON pcbe OPTIONAL)
+{
+    PTP_WAIT Wait;
+    NTSTATUS Status;
+
+    Status = TpAllocWait(&Wait, pfnwa, pv, pcbe);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    return Wait;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SetThreadpoolWait(IN OUT PTP_WAIT Wait,
+                  IN HANDLE h OPTIONAL,
+                  IN PFILETIME pftTimeout OPTIONAL)
+{
+    LARGE_INTEGER Timeout;
+
+    if (pftTimeout)
+    {
+        Timeout.LowPart = pftTimeout->dwLowDateTime;
+        Timeout.HighPart = pftTimeout->dwHighDateTime;
+    }
+
+    TpSetWait(Wait, h, pftTimeout ? &Timeout : NULL);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WaitForThreadpoolWaitCallbacks(IN OUT PTP_WAIT Wait,
+                               IN BOOL fCancelPendingCallbacks)
+{
+    TpWaitForWait(Wait, fCancelPendingCallbacks != FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolWait(IN OUT PTP_WAIT Wait)
+{
+    TpReleaseWait(Wait);
+}
+
+/* I/O ***********************************************************************/
+
+/* ntdll leaves us the first pointer of the object, that's where the Win32 callback goes */
+static
+VOID
+NTAPI
+BasepTpIoCallback(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                  IN OUT PVOID Context OPTIONAL,
+                  IN PVOID ApcContext,
+                  IN PIO_STATUS_BLOCK IoStatusBlock,
+                  IN PTP_IO Io)
+{
+    PTP_WIN32_IO_CALLBACK Callback = *(PTP_WIN32_IO_CALLBACK*)Io;
+
+    Callback(Instance,
+             Context,
+             ApcContext,
+             RtlNtStatusToDosError(IoStatusBlock->Status),
+             IoStatusBlock->Information,
+             Io);
+}
+
+/*
+ * @implemented
+ */
+PTP_IO
+WINAPI
+CreateThreadpoolIo(IN HANDLE fl,
+                   IN PTP_WIN32_IO_CALLBACK pfnio,
+                   IN OUT PVOID pv OPTIONAL,
+                   IN PTP_CALLBACK_ENVIRON pcbe OPTIONAL)
+{
+    PTP_IO Io;
+    NTSTATUS Status;
+
+    if (!pfnio)
+    {
+        SetLastError(ERROR_INVALID_PARAMETER);
+        return NULL;
+    }
+
+    Status = TpAllocIoCompletion(&Io, fl, BasepTpIoCallback, pv, pcbe);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return NULL;
+    }
+
+    /* Nothing can complete before the caller started an operation */
+    *(PTP_WIN32_IO_CALLBACK*)Io = pfnio;
+    return Io;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+StartThreadpoolIo(IN OUT PTP_IO pio)
+{
+    TpStartAsyncIoOperation(pio);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CancelThreadpoolIo(IN OUT PTP_IO pio)
+{
+    TpCancelAsyncIoOperation(pio);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+WaitForThreadpoolIoCallbacks(IN OUT PTP_IO pio,
+                             IN BOOL fCancelPendingCallbacks)
+{
+    TpWaitForIoCompletion(pio, fCancelPendingCallbacks != FALSE);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+CloseThreadpoolIo(IN OUT PTP_IO pio)
+{
+    TpReleaseIoCompletion(pio);
+}
+
+/* CALLBACK INSTANCES ********************************************************/
+
+/*
+ * @implemented
+ */
+BOOL
+WINAPI
+CallbackMayRunLong(IN OUT PTP_CALLBACK_INSTANCE pci)
+{
+    NTSTATUS Status;
+
+    Status = TpCallbackMayRunLong(pci);
+    if (!NT_SUCCESS(Status))
+    {
+        SetLastError(RtlNtStatusToDosError(Status));
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+DisassociateCurrentThreadFromCallback(IN OUT PTP_CALLBACK_INSTANCE pci)
+{
+    TpDisassociateCallback(pci);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+FreeLibraryWhenCallbackReturns(IN OUT PTP_CALLBACK_INSTANCE pci,
+                               IN HMODULE mod)
+{
+    TpCallbackUnloadDllOnCompletion(pci, mod);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+LeaveCriticalSectionWhenCallbackReturns(IN OUT PTP_CALLBACK_INSTANCE pci,
+                                        IN OUT PCRITICAL_SECTION pcs)
+{
+    TpCallbackLeaveCriticalSectionOnCompletion(pci, pcs);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+ReleaseMutexWhenCallbackReturns(IN OUT PTP_CALLBACK_INSTANCE pci,
+                                IN HANDLE mut)
+{
+    TpCallbackReleaseMutexOnCompletion(pci, mut);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+ReleaseSemaphoreWhenCallbackReturns(IN OUT PTP_CALLBACK_INSTANCE pci,
+                                    IN HANDLE sem,
+                                    IN DWORD crel)
+{
+    TpCallbackReleaseSemaphoreOnCompletion(pci, sem, crel);
+}
+
+/*
+ * @implemented
+ */
+VOID
+WINAPI
+SetEventWhenCallbackReturns(IN OUT PTP_CALLBACK_INSTANCE pci,
+                            IN HANDLE evt)
+{
+    TpCallbackSetEventOnCompletion(pci, evt);
+}
@@ -0,0 +1,1598 @@
+/*
+ * COPYRIGHT:         See COPYING in the top level directory
+ * PROJECT:           ReactOS system libraries
+ * PURPOSE:           Thread pool (Tp*) routines
+ * PROGRAMMER:        ReactOS Team
+ *
+ * NOTES:             Every pool owns an I/O completion port. Work, timer
+ *                    and wait callbacks are queued to it as completion
+ *                    packets keyed by their object, I/O objects bind their
+ *                    file to it, so the kernel takes care of throttling the
+ *                    number of running callbacks to the number of processors.
+ *
+ *                    Workers are added when packets are queued and no worker
+ *                    is idle, up to one per processor plus one per callback
+ *                    that may run long. Beyond that, a pool whose workers
+ *                    made no progress for a while gets another one. Workers
+ *                    idle for too long exit again.
+ *
+ *                    Timers and waits are armed on waiter threads which
+ *                    handle up to MAXIMUM_WAIT_OBJECTS - 1 handles each and
+ *                    queue the callbacks when they fire.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl_vista.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* INTERNAL TYPES ***********************************************************/
+
+/* Workers idle for that long exit, if the pool doesn't need them */
+#define TPP_IDLE_TIMEOUT            (20 * 1000 * 10000LL)
+
+/* Interval at which pools with queued callbacks are checked for progress */
+#define TPP_STARVATION_INTERVAL     100
+
+#define TPP_DEFAULT_MAX_THREADS     512
+
+typedef enum _TPP_OBJECT_TYPE
+{
+    TppWork,
+    TppSimple,
+    TppTimer,
+    TppWait,
+    TppIo,
+    TppMonitor
+} TPP_OBJECT_TYPE;
+
+struct _TPP_WAITER;
+
+/* What TP_WORK, TP_TIMER, TP_WAIT and TP_IO point to */
+typedef struct _TPP_OBJECT
+{
+    /* Belongs to kernel32, which keeps the Win32 I/O callback there */
+    PVOID Reserved;
+
+    TPP_OBJECT_TYPE Type;
+    LONG RefCount;
+    PTP_POOL Pool;
+    PVOID Callback;
+    PVOID Context;
+
+    /* From the callback environment */
+    PTP_CLEANUP_GROUP CleanupGroup;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK CancelCallback;
+    PTP_SIMPLE_CALLBACK FinalizationCallback;
+    PVOID RaceDll;
+    BOOLEAN LongFunction;
+
+    /* Protected by the lock of the cleanup group */
+    LIST_ENTRY GroupLink;
+    BOOLEAN InGroup;
+
+    /* Callbacks queued and not started yet, changed under the pool lock or interlocked */
+    LONG Pending;
+
+    /* Protected by the pool lock */
+    ULONG Skip;
+    ULONG Running;
+
+    /* Timers and waits, protected by the waiter lock */
+    LIST_ENTRY WaitLink;
+    struct _TPP_WAITER *Waiter;
+    HANDLE Handle;
+    ULONGLONG DueTime;
+    ULONG Period;
+    ULONG Generation;
+} TPP_OBJECT, *PTPP_OBJECT;
+
+struct _TP_POOL
+{
+    LONG RefCount;
+    HANDLE CompletionPort;
+    ULONG MaxThreads;
+    ULONG MinThreads;
+
+    /* Protects the thread counts and the callback counts of the objects */
+    RTL_CRITICAL_SECTION Lock;
+    RTL_CONDITION_VARIABLE CallbacksDone;
+    ULONG Threads;
+    BOOLEAN Shutdown;
+
+    /* Changed interlocked */
+    LONG IdleThreads;
+    LONG LongRunning;
+    LONG Queued;
+    LONG Dequeued;
+
+    /* Only used by the waiter */
+    LONG DequeuedAtCheck;
+    TPP_OBJECT Monitor;
+};
+
+struct _TP_CLEANUP_GROUP
+{
+    RTL_CRITICAL_SECTION Lock;
+    LIST_ENTRY Members;
+};
+
+struct _TP_CALLBACK_INSTANCE
+{
+    PTPP_OBJECT Object;
+    BOOLEAN Disassociated;
+    BOOLEAN MayRunLong;
+
+    /* Done when the callback returns */
+    PRTL_CRITICAL_SECTION CriticalSection;
+    HANDLE Mutex;
+    HANDLE Semaphore;
+    ULONG SemaphoreCount;
+    HANDLE Event;
+    PVOID Dll;
+};
+
+typedef struct _TPP_WAITER
+{
+    LIST_ENTRY Link;
+    LIST_ENTRY Items;
+    ULONG HandleCount;
+    HANDLE UpdateEvent;
+} TPP_WAITER, *PTPP_WAITER;
+
+/* GLOBALS ******************************************************************/
+
+static PTP_POOL TppDefaultPool;
+
+/* Protects the waiters and everything armed on them */
+static RTL_CRITICAL_SECTION TppWaiterLock;
+static LIST_ENTRY TppWaiterList;
+
+/* FUNCTIONS *****************************************************************/
+
+static NTSTATUS TppGrowPool(PTP_POOL Pool, BOOLEAN Force);
+static VOID TppDereferenceObject(PTPP_OBJECT Object);
+
+VOID
+RtlpInitializeThreadPool(VOID)
+{
+    RtlInitializeCriticalSection(&TppWaiterLock);
+    InitializeListHead(&TppWaiterList);
+}
+
+static
+ULONGLONG
+TppGetInterruptTime(VOID)
+{
+    ULARGE_INTEGER Time;
+
+    do
+    {
+        Time.HighPart = SharedUserData->InterruptTime.High1Time;
+        Time.LowPart = SharedUserData->InterruptTime.LowPart;
+    } while (Time.HighPart != (ULONG)SharedUserData->InterruptTime.High2Time);
+
+    return Time.QuadPart;
+}
+
+/* Converts an NT timeout to an interrupt time, which doesn't change with the clock */
+static
+ULONGLONG
+TppGetDueTime(IN PLARGE_INTEGER Timeout)
+{
+    ULONGLONG Now = TppGetInterruptTime();
+    LARGE_INTEGER SystemTime;
+
+    if (Timeout->QuadPart <= 0)
+        return Now - Timeout->QuadPart + 1;
+
+    NtQuerySystemTime(&SystemTime);
+    if (Timeout->QuadPart <= SystemTime.QuadPart)
+        return Now + 1;
+
+    return Now + (Timeout->QuadPart - SystemTime.QuadPart);
+}
+
+static
+VOID
+TppFreePool(IN PTP_POOL Pool)
+{
+    NtClose(Pool->CompletionPort);
+    RtlDeleteCriticalSection(&Pool->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+}
+
+static
+VOID
+TppDisarm(IN PTPP_OBJECT Object)
+{
+    BOOLEAN Disarmed = FALSE;
+
+    RtlEnterCriticalSection(&TppWaiterLock);
+    if (Object->Waiter)
+    {
+        RemoveEntryList(&Object->WaitLink);
+        if (Object->Handle) Object->Waiter->HandleCount--;
+        Object->Waiter = NULL;
+        Object->Generation++;
+        Disarmed = TRUE;
+    }
+    RtlLeaveCriticalSection(&TppWaiterLock);
+
+    /* Drop the reference of the waiter */
+    if (Disarmed && Object->Type != TppMonitor)
+        TppDereferenceObject(Object);
+}
+
+static
+VOID
+TppReleasePoolReference(IN PTP_POOL Pool)
+{
+    BOOLEAN Free;
+    ULONG i, Threads;
+
+    if (InterlockedDecrement(&Pool->RefCount) != 0)
+        return;
+
+    TppDisarm(&Pool->Monitor);
+
+    /* Tell the workers to go away, the last one frees the pool */
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->Shutdown = TRUE;
+    Threads = Pool->Threads;
+    Free = (Threads == 0);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    for (i = 0; i < Threads; i++)
+        NtSetIoCompletion(Pool->CompletionPort, NULL, NULL, STATUS_SUCCESS, 0);
+
+    if (Free)
+        TppFreePool(Pool);
+}
+
+static
+NTSTATUS
+TppCreatePool(OUT PTP_POOL *PoolReturn)
+{
+    PTP_POOL Pool;
+    NTSTATUS Status;
+
+    Pool = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Pool));
+    if (!Pool)
+        return STATUS_NO_MEMORY;
+
+    /* Let the port run as many callbacks at once as there are processors */
+    Status = NtCreateIoCompletion(&Pool->CompletionPort, IO_COMPLETION_ALL_ACCESS, NULL, 0);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    Status = RtlInitializeCriticalSection(&Pool->Lock);
+    if (!NT_SUCCESS(Status))
+    {
+        NtClose(Pool->CompletionPort);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Pool);
+        return Status;
+    }
+
+    RtlInitializeConditionVariable(&Pool->CallbacksDone);
+    Pool->RefCount = 1;
+    Pool->MaxThreads = TPP_DEFAULT_MAX_THREADS;
+    Pool->Monitor.Type = TppMonitor;
+    Pool->Monitor.RefCount = 1;
+    Pool->Monitor.Pool = Pool;
+
+    *PoolReturn = Pool;
+    return STATUS_SUCCESS;
+}
+
+static
+PTP_POOL
+TppGetPool(IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PTP_POOL Pool;
+
+    if (CallbackEnviron && CallbackEnviron->Pool)
+        return CallbackEnviron->Pool;
+
+    if (!TppDefaultPool)
+    {
+        if (!NT_SUCCESS(TppCreatePool(&Pool)))
+            return NULL;
+
+        /* Someone else might have been quicker */
+        if (InterlockedCompareExchangePointer((PVOID*)&TppDefaultPool, Pool, NULL) != NULL)
+            TppReleasePoolReference(Pool);
+    }
+
+    return TppDefaultPool;
+}
+
+static
+VOID
+TppCompleteInstance(IN PTP_CALLBACK_INSTANCE Instance)
+{
+    if (Instance->CriticalSection)
+        RtlLeaveCriticalSection(Instance->CriticalSection);
+    if (Instance->Mutex)
+        NtReleaseMutant(Instance->Mutex, NULL);
+    if (Instance->Semaphore)
+        NtReleaseSemaphore(Instance->Semaphore, Instance->SemaphoreCount, NULL);
+    if (Instance->Event)
+        NtSetEvent(Instance->Event, NULL);
+}
+
+static
+VOID
+TppFreeObject(IN PTPP_OBJECT Object)
+{
+    TP_CALLBACK_INSTANCE Instance;
+
+    if (Object->CleanupGroup)
+    {
+        RtlEnterCriticalSection(&Object->CleanupGroup->Lock);
+        if (Object->InGroup)
+        {
+            RemoveEntryList(&Object->GroupLink);
+            Object->InGroup = FALSE;
+        }
+        RtlLeaveCriticalSection(&Object->CleanupGroup->Lock);
+    }
+
+    if (Object->FinalizationCallback)
+    {
+        RtlZeroMemory(&Instance, sizeof(Instance));
+        Instance.Object = Object;
+        Instance.Disassociated = TRUE;
+        Object->FinalizationCallback(&Instance, Object->Context);
+        TppCompleteInstance(&Instance);
+        if (Instance.Dll) LdrUnloadDll(Instance.Dll);
+    }
+
+    if (Object->RaceDll)
+        LdrUnloadDll(Object->RaceDll);
+
+    TppReleasePoolReference(Object->Pool);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+}
+
+static
+VOID
+TppDereferenceObject(IN PTPP_OBJECT Object)
+{
+    if (InterlockedDecrement(&Object->RefCount) == 0)
+        TppFreeObject(Object);
+}
+
+/* Fails if the last reference is gone already and the object is being freed */
+static
+BOOLEAN
+TppReferenceObjectIfAlive(IN PTPP_OBJECT Object)
+{
+    LONG RefCount;
+
+    do
+    {
+        RefCount = Object->RefCount;
+        if (RefCount == 0)
+            return FALSE;
+    } while (InterlockedCompareExchange(&Object->RefCount, RefCount + 1, RefCount) != RefCount);
+
+    return TRUE;
+}
+
+static
+NTSTATUS
+TppAllocObject(OUT PTPP_OBJECT *ObjectReturn,
+               IN TPP_OBJECT_TYPE Type,
+               IN PVOID Callback,
+               IN PVOID Context,
+               IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PTPP_OBJECT Object;
+    PTP_POOL Pool;
+    NTSTATUS Status;
+
+    if (!Callback)
+        return STATUS_INVALID_PARAMETER;
+
+    if (CallbackEnviron && CallbackEnviron->Version != 1 && CallbackEnviron->Version != 3)
+        return STATUS_INVALID_PARAMETER;
+
+    Pool = TppGetPool(CallbackEnviron);
+    if (!Pool)
+        return STATUS_NO_MEMORY;
+
+    Object = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Object));
+    if (!Object)
+        return STATUS_NO_MEMORY;
+
+    Object->Type = Type;
+    Object->RefCount = 1;
+    Object->Pool = Pool;
+    Object->Callback = Callback;
+    Object->Context = Context;
+
+    if (CallbackEnviron)
+    {
+        /* Keep the DLL of the callbacks loaded for as long as we are around */
+        if (CallbackEnviron->RaceDll)
+        {
+            Status = LdrAddRefDll(0, CallbackEnviron->RaceDll);
+            if (!NT_SUCCESS(Status))
+            {
+                RtlFreeHeap(RtlGetProcessHeap(), 0, Object);
+                return Status;
+            }
+            Object->RaceDll = CallbackEnviron->RaceDll;
+        }
+
+        Object->CleanupGroup = CallbackEnviron->CleanupGroup;
+        Object->CancelCallback = CallbackEnviron->CleanupGroupCancelCallback;
+        Object->FinalizationCallback = CallbackEnviron->FinalizationCallback;
+        Object->LongFunction = CallbackEnviron->u.s.LongFunction;
+    }
+
+    InterlockedIncrement(&Pool->RefCount);
+
+    if (Object->CleanupGroup)
+    {
+        RtlEnterCriticalSection(&Object->CleanupGroup->Lock);
+        InsertTailList(&Object->CleanupGroup->Members, &Object->GroupLink);
+        Object->InGroup = TRUE;
+        RtlLeaveCriticalSection(&Object->CleanupGroup->Lock);
+    }
+
+    *ObjectReturn = Object;
+    return STATUS_SUCCESS;
+}
+
+static
+ULONG
+TppGetActiveLimit(IN PTP_POOL Pool)
+{
+    ULONG Limit;
+
+    /* One worker per processor, plus those running long callbacks */
+    Limit = max(NtCurrentPeb()->NumberOfProcessors, Pool->MinThreads);
+    Limit += Pool->LongRunning;
+    return min(Limit, Pool->MaxThreads);
+}
+
+static
+NTSTATUS
+NTAPI
+TppWorkerThread(IN PVOID Parameter);
+
+static
+NTSTATUS
+TppGrowPool(IN PTP_POOL Pool,
+            IN BOOLEAN Force)
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+    HANDLE Thread;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (!Pool->Shutdown &&
+        (Pool->Threads < Pool->MaxThreads) &&
+        (Force ||
+         (Pool->Threads < Pool->MinThreads) ||
+         ((Pool->Queued > Pool->IdleThreads) && (Pool->Threads < TppGetActiveLimit(Pool)))))
+    {
+        /* The new worker counts as idle until it takes a packet */
+        Pool->Threads++;
+        InterlockedIncrement(&Pool->IdleThreads);
+
+        Status = RtlCreateUserThread(NtCurrentProcess(),
+                                     NULL,
+                                     FALSE,
+                                     0,
+                                     0,
+                                     0,
+                                     (PTHREAD_START_ROUTINE)TppWorkerThread,
+                                     Pool,
+                                     &Thread,
+                                     NULL);
+        if (NT_SUCCESS(Status))
+        {
+            NtClose(Thread);
+        }
+        else
+        {
+            DPRINT1("Failed to create a pool worker: 0x%lx\n", Status);
+            InterlockedDecrement(&Pool->IdleThreads);
+            Pool->Threads--;
+        }
+    }
+    else if (Pool->Threads >= Pool->MaxThreads)
+    {
+        Status = STATUS_TOO_MANY_THREADS;
+    }
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    return Status;
+}
+
+static
+VOID
+TppWakeWaiter(IN PTPP_WAITER Waiter)
+{
+    NtSetEvent(Waiter->UpdateEvent, NULL);
+}
+
+static
+NTSTATUS
+NTAPI
+TppWaiterThread(IN PVOID Parameter);
+
+/* Finds room for an item on a waiter, starting a new one if needed. Waiter lock must be held */
+static
+PTPP_WAITER
+TppGetWaiter(IN BOOLEAN NeedHandle)
+{
+    PTPP_WAITER Waiter;
+    PLIST_ENTRY Entry;
+    HANDLE Thread;
+    NTSTATUS Status;
+
+    for (Entry = TppWaiterList.Flink; Entry != &TppWaiterList; Entry = Entry->Flink)
+    {
+        Waiter = CONTAINING_RECORD(Entry, TPP_WAITER, Link);
+        if (!NeedHandle || Waiter->HandleCount < MAXIMUM_WAIT_OBJECTS - 1)
+            return Waiter;
+    }
+
+    Waiter = RtlAllocateHeap(RtlGetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*Waiter));
+    if (!Waiter)
+        return NULL;
+
+    InitializeListHead(&Waiter->Items);
+    Status = NtCreateEvent(&Waiter->UpdateEvent, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Waiter);
+        return NULL;
+    }
+
+    Status = RtlCreateUserThread(NtCurrentProcess(),
+                                 NULL,
+                                 FALSE,
+                                 0,
+                                 0,
+                                 0,
+                                 (PTHREAD_START_ROUTINE)TppWaiterThread,
+                                 Waiter,
+                                 &Thread,
+                                 NULL);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to create a pool waiter: 0x%lx\n", Status);
+        NtClose(Waiter->UpdateEvent);
+        RtlFreeHeap(RtlGetProcessHeap(), 0, Waiter);
+        return NULL;
+    }
+    NtClose(Thread);
+
+    InsertTailList(&TppWaiterList, &Waiter->Link);
+    return Waiter;
+}
+
+/* Arms a timer or a wait, replacing what it was armed with before */
+static
+VOID
+TppArm(IN PTPP_OBJECT Object,
+       IN HANDLE Handle OPTIONAL,
+       IN ULONGLONG DueTime,
+       IN ULONG Period)
+{
+    PTPP_WAITER Waiter;
+
+    TppDisarm(Object);
+
+    RtlEnterCriticalSection(&TppWaiterLock);
+    Waiter = TppGetWaiter(Handle != NULL);
+    if (!Waiter)
+    {
+        RtlLeaveCriticalSection(&TppWaiterLock);
+        DPRINT1("Could not arm %p\n", Object);
+        return;
+    }
+
+    /* The waiter holds a reference while it's armed */
+    if (Object->Type != TppMonitor)
+        InterlockedIncrement(&Object->RefCount);
+
+    Object->Handle = Handle;
+    Object->DueTime = DueTime;
+    Object->Period = Period;
+    Object->Generation++;
+    Object->Waiter = Waiter;
+    InsertTailList(&Waiter->Items, &Object->WaitLink);
+    if (Handle) Waiter->HandleCount++;
+    RtlLeaveCriticalSection(&TppWaiterLock);
+
+    TppWakeWaiter(Waiter);
+}
+
+/* Makes sure someone is going to pick up what was just queued on a pool */
+static
+VOID
+TppEnsureWorker(IN PTP_POOL Pool)
+{
+    if (Pool->Queued <= Pool->IdleThreads)
+        return;
+
+    if (Pool->Threads < TppGetActiveLimit(Pool))
+    {
+        TppGrowPool(Pool, FALSE);
+    }
+    else if (!Pool->Monitor.Waiter)
+    {
+        Pool->DequeuedAtCheck = Pool->Dequeued;
+        TppArm(&Pool->Monitor, NULL,
+               TppGetInterruptTime() + TPP_STARVATION_INTERVAL * 10000ULL,
+               TPP_STARVATION_INTERVAL);
+    }
+}
+
+/* Queues a callback of an object, to be run by a worker of its pool */
+static
+NTSTATUS
+TppPost(IN PTPP_OBJECT Object,
+        IN PVOID ApcContext)
+{
+    PTP_POOL Pool = Object->Pool;
+    NTSTATUS Status;
+
+    /* The packet holds a reference until the callback returned */
+    InterlockedIncrement(&Object->RefCount);
+    InterlockedIncrement(&Object->Pending);
+    InterlockedIncrement(&Pool->Queued);
+
+    Status = NtSetIoCompletion(Pool->CompletionPort, Object, ApcContext, STATUS_SUCCESS, 0);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to queue a callback: 0x%lx\n", Status);
+        InterlockedDecrement(&Pool->Queued);
+
+        RtlEnterCriticalSection(&Pool->Lock);
+        if (InterlockedDecrement(&Object->Pending) == 0 && Object->Running == 0)
+            RtlWakeAllConditionVariable(&Pool->CallbacksDone);
+        RtlLeaveCriticalSection(&Pool->Lock);
+
+        TppDereferenceObject(Object);
+        return Status;
+    }
+
+    TppEnsureWorker(Pool);
+    return STATUS_SUCCESS;
+}
+
+/* Called by a waiter when a pool with queued callbacks is checked. Waiter lock is held */
+static
+BOOLEAN
+TppCheckStarvation(IN PTP_POOL Pool)
+{
+    if (Pool->Queued <= Pool->IdleThreads)
+        return FALSE;
+
+    /* Callbacks are waiting and nobody took one since the last check */
+    if (Pool->Dequeued == Pool->DequeuedAtCheck)
+        TppGrowPool(Pool, TRUE);
+
+    Pool->DequeuedAtCheck = Pool->Dequeued;
+    return TRUE;
+}
+
+/* A timer or wait fired. Waiter lock is held */
+static
+VOID
+TppFire(IN PTPP_OBJECT Object,
+        IN ULONG WaitResult,
+        IN ULONGLONG Now)
+{
+    BOOLEAN Rearm;
+
+    if (Object->Type == TppMonitor)
+        Rearm = TppCheckStarvation(Object->Pool);
+    else
+        Rearm = (Object->Period != 0);
+
+    if (Rearm)
+    {
+        /* Periodic, skip the periods we missed */
+        Object->DueTime += Object->Period * 10000ULL;
+        if (Object->DueTime <= Now)
+            Object->DueTime = Now + Object->Period * 10000ULL;
+    }
+    else
+    {
+        RemoveEntryList(&Object->WaitLink);
+        if (Object->Handle) Object->Waiter->HandleCount--;
+        Object->Waiter = NULL;
+        Object->Generation++;
+    }
+
+    if (Object->Type != TppMonitor)
+    {
+        TppPost(Object, UlongToPtr(WaitResult));
+
+        /* The reference of the waiter goes away, the packet has its own */
+        if (!Rearm)
+            InterlockedDecrement(&Object->RefCount);
+    }
+}
+
+static
+NTSTATUS
+NTAPI
+TppWaiterThread(IN PVOID Parameter)
+{
+    PTPP_WAITER Waiter = Parameter;
+    HANDLE Handles[MAXIMUM_WAIT_OBJECTS];
+    PTPP_OBJECT Objects[MAXIMUM_WAIT_OBJECTS];
+    ULONG Generations[MAXIMUM_WAIT_OBJECTS];
+    OBJECT_BASIC_INFORMATION BasicInfo;
+    PTPP_OBJECT Object;
+    PLIST_ENTRY Entry;
+    LARGE_INTEGER Timeout;
+    ULONGLONG Now, DueTime;
+    NTSTATUS Status;
+    ULONG Count, i;
+
+    Handles[0] = Waiter->UpdateEvent;
+
+    for (;;)
+    {
+        /* Collect the handles and the closest due time */
+        RtlEnterCriticalSection(&TppWaiterLock);
+        Count = 1;
+        DueTime = MAXULONGLONG;
+        for (Entry = Waiter->Items.Flink; Entry != &Waiter->Items; Entry = Entry->Flink)
+        {
+            Object = CONTAINING_RECORD(Entry, TPP_OBJECT, WaitLink);
+            if (Object->Handle)
+            {
+                Handles[Count] = Object->Handle;
+                Objects[Count] = Object;
+                Generations[Count] = Object->Generation;
+                Count++;
+            }
+            if (Object->DueTime && Object->DueTime < DueTime)
+                DueTime = Object->DueTime;
+        }
+        RtlLeaveCriticalSection(&TppWaiterLock);
+
+        Now = TppGetInterruptTime();
+        Timeout.QuadPart = (DueTime > Now) ? -(LONGLONG)(DueTime - Now) : 0;
+        Status = NtWaitForMultipleObjects(Count,
+                                          Handles,
+                                          WaitAny,
+                                          FALSE,
+                                          (DueTime != MAXULONGLONG) ? &Timeout : NULL);
+
+        RtlEnterCriticalSection(&TppWaiterLock);
+        Now = TppGetInterruptTime();
+
+        if (((Status > STATUS_WAIT_0) && (Status < STATUS_WAIT_0 + Count)) ||
+            ((Status > STATUS_ABANDONED_WAIT_0) && (Status < STATUS_ABANDONED_WAIT_0 + Count)))
+        {
+            i = (Status >= STATUS_ABANDONED_WAIT_0) ? Status - STATUS_ABANDONED_WAIT_0 : Status - STATUS_WAIT_0;
+
+            /* Only if it wasn't disarmed or armed again meanwhile. It might be gone, don't touch it before */
+            for (Entry = Waiter->Items.Flink; Entry != &Waiter->Items; Entry = Entry->Flink)
+            {
+                Object = CONTAINING_RECORD(Entry, TPP_OBJECT, WaitLink);
+                if (Object == Objects[i])
+                {
+                    if (Object->Generation == Generations[i])
+                        TppFire(Object, WAIT_OBJECT_0, Now);
+                    break;
+                }
+            }
+        }
+        else if (!NT_SUCCESS(Status))
+        {
+            /* Someone closed a handle we wait on, throw out the waits on bad handles */
+            Entry = Waiter->Items.Flink;
+            while (Entry != &Waiter->Items)
+            {
+                Object = CONTAINING_RECORD(Entry, TPP_OBJECT, WaitLink);
+                Entry = Entry->Flink;
+                if (Object->Handle &&
+                    !NT_SUCCESS(NtQueryObject(Object->Handle,
+                                              ObjectBasicInformation,
+                                              &BasicInfo,
+                                              sizeof(BasicInfo),
+                                              NULL)))
+                {
+                    DPRINT1("Dropping wait on bad handle %p\n", Object->Handle);
+                    RemoveEntryList(&Object->WaitLink);
+                    Waiter->HandleCount--;
+                    Object->Waiter = NULL;
+                    Object->Generation++;
+
+                    /* The caller still holds a reference if it could close the handle */
+                    InterlockedDecrement(&Object->RefCount);
+                }
+            }
+        }
+
+        /* Fire whatever is due */
+        Entry = Waiter->Items.Flink;
+        while (Entry != &Waiter->Items)
+        {
+            Object = CONTAINING_RECORD(Entry, TPP_OBJECT, WaitLink);
+            Entry = Entry->Flink;
+            if (Object->DueTime && Object->DueTime <= Now)
+                TppFire(Object, WAIT_TIMEOUT, Now);
+        }
+        RtlLeaveCriticalSection(&TppWaiterLock);
+    }
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+TppRunCallback(IN PTP_POOL Pool,
+               IN PTPP_OBJECT Object,
+               IN PVOID ApcContext,
+               IN PIO_STATUS_BLOCK IoStatusBlock)
+{
+    TP_CALLBACK_INSTANCE Instance;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (Object->Skip)
+    {
+        /* Canceled while it was queued */
+        Object->Skip--;
+        RtlLeaveCriticalSection(&Pool->Lock);
+        TppDereferenceObject(Object);
+        return;
+    }
+    InterlockedDecrement(&Object->Pending);
+    Object->Running++;
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    RtlZeroMemory(&Instance, sizeof(Instance));
+    Instance.Object = Object;
+    if (Object->LongFunction)
+    {
+        Instance.MayRunLong = TRUE;
+        InterlockedIncrement(&Pool->LongRunning);
+    }
+
+    switch (Object->Type)
+    {
+        case TppWork:
+            ((PTP_WORK_CALLBACK)Object->Callback)(&Instance, Object->Context, (PTP_WORK)Object);
+            break;
+
+        case TppSimple:
+            ((PTP_SIMPLE_CALLBACK)Object->Callback)(&Instance, Object->Context);
+            break;
+
+        case TppTimer:
+            ((PTP_TIMER_CALLBACK)Object->Callback)(&Instance, Object->Context, (PTP_TIMER)Object);
+            break;
+
+        case TppWait:
+            ((PTP_WAIT_CALLBACK)Object->Callback)(&Instance,
+                                                  Object->Context,
+                                                  (PTP_WAIT)Object,
+                                                  PtrToUlong(ApcContext));
+            break;
+
+        case TppIo:
+            ((PTP_IO_CALLBACK)Object->Callback)(&Instance,
+                                                Object->Context,
+                                                ApcContext,
+                                                IoStatusBlock,
+                                                (PTP_IO)Object);
+            break;
+
+        default:
+            ASSERT(FALSE);
+            break;
+    }
+
+    if (Instance.MayRunLong)
+        InterlockedDecrement(&Pool->LongRunning);
+
+    TppCompleteInstance(&Instance);
+
+    if (!Instance.Disassociated)
+    {
+        RtlEnterCriticalSection(&Pool->Lock);
+        if (--Object->Running == 0 && Object->Pending == 0)
+            RtlWakeAllConditionVariable(&Pool->CallbacksDone);
+        RtlLeaveCriticalSection(&Pool->Lock);
+    }
+
+    TppDereferenceObject(Object);
+
+    if (Instance.Dll)
+        LdrUnloadDll(Instance.Dll);
+}
+
+static
+NTSTATUS
+NTAPI
+TppWorkerThread(IN PVOID Parameter)
+{
+    PTP_POOL Pool = Parameter;
+    LARGE_INTEGER Timeout;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PVOID Key, ApcContext;
+    NTSTATUS Status;
+    BOOLEAN Free = FALSE;
+
+    /* We were counted as idle when we got created */
+    for (;;)
+    {
+        Timeout.QuadPart = -TPP_IDLE_TIMEOUT;
+        Status = NtRemoveIoCompletion(Pool->CompletionPort,
+                                      &Key,
+                                      &ApcContext,
+                                      &IoStatusBlock,
+                                      &Timeout);
+        if (Status == STATUS_TIMEOUT)
+        {
+            /* Leave if the others can handle what's queued */
+            RtlEnterCriticalSection(&Pool->Lock);
+            if (Pool->Shutdown ||
+                ((Pool->Threads > Pool->MinThreads) && (Pool->Queued < Pool->IdleThreads)))
+            {
+                InterlockedDecrement(&Pool->IdleThreads);
+                Free = (--Pool->Threads == 0) && Pool->Shutdown;
+                RtlLeaveCriticalSection(&Pool->Lock);
+                break;
+            }
+            RtlLeaveCriticalSection(&Pool->Lock);
+            continue;
+        }
+
+        InterlockedDecrement(&Pool->IdleThreads);
+
+        if (!NT_SUCCESS(Status) || !Key)
+        {
+            /* The pool is going away */
+            RtlEnterCriticalSection(&Pool->Lock);
+            Free = (--Pool->Threads == 0) && Pool->Shutdown;
+            RtlLeaveCriticalSection(&Pool->Lock);
+            break;
+        }
+
+        InterlockedDecrement(&Pool->Queued);
+        InterlockedIncrement(&Pool->Dequeued);
+
+        TppRunCallback(Pool, Key, ApcContext, &IoStatusBlock);
+
+        InterlockedIncrement(&Pool->IdleThreads);
+    }
+
+    if (Free)
+        TppFreePool(Pool);
+
+    RtlExitUserThread(STATUS_SUCCESS);
+    return STATUS_SUCCESS;
+}
+
+/* Drops the callbacks which didn't start yet, returns how many there were */
+static
+ULONG
+TppCancelPending(IN PTPP_OBJECT Object)
+{
+    PTP_POOL Pool = Object->Pool;
+    ULONG Canceled;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    Canceled = InterlockedExchange(&Object->Pending, 0);
+    Object->Skip += Canceled;
+    if (Canceled && Object->Running == 0)
+        RtlWakeAllConditionVariable(&Pool->CallbacksDone);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    return Canceled;
+}
+
+static
+VOID
+TppWaitForCallbacks(IN PTPP_OBJECT Object,
+                    IN BOOLEAN CancelPendingCallbacks)
+{
+    PTP_POOL Pool = Object->Pool;
+
+    if (CancelPendingCallbacks)
+        TppCancelPending(Object);
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    while (Object->Pending || Object->Running)
+        RtlSleepConditionVariableCS(&Pool->CallbacksDone, &Pool->Lock, NULL);
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+/* The owner of an object is done with it. Callbacks already queued still run */
+static
+VOID
+TppReleaseObject(IN PTPP_OBJECT Object)
+{
+    if (Object->Type == TppTimer || Object->Type == TppWait)
+        TppDisarm(Object);
+
+    if (Object->CleanupGroup)
+    {
+        RtlEnterCriticalSection(&Object->CleanupGroup->Lock);
+        if (Object->InGroup)
+        {
+            RemoveEntryList(&Object->GroupLink);
+            Object->InGroup = FALSE;
+        }
+        RtlLeaveCriticalSection(&Object->CleanupGroup->Lock);
+    }
+
+    TppDereferenceObject(Object);
+}
+
+/* POOLS *********************************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocPool(OUT PTP_POOL *PoolReturn,
+            IN PVOID Reserved)
+{
+    UNREFERENCED_PARAMETER(Reserved);
+    return TppCreatePool(PoolReturn);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleasePool(IN OUT PTP_POOL Pool)
+{
+    TppReleasePoolReference(Pool);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetPoolMaxThreads(IN OUT PTP_POOL Pool,
+                    IN ULONG MaxThreads)
+{
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->MaxThreads = max(MaxThreads, 1);
+    Pool->MinThreads = min(Pool->MinThreads, Pool->MaxThreads);
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpSetPoolMinThreads(IN OUT PTP_POOL Pool,
+                    IN ULONG MinThreads)
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    Pool->MinThreads = MinThreads;
+    Pool->MaxThreads = max(Pool->MaxThreads, MinThreads);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    /* The minimum is started right away */
+    while (NT_SUCCESS(Status) && Pool->Threads < MinThreads)
+        Status = TppGrowPool(Pool, TRUE);
+
+    return Status;
+}
+
+/* CLEANUP GROUPS ************************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocCleanupGroup(OUT PTP_CLEANUP_GROUP *CleanupGroupReturn)
+{
+    PTP_CLEANUP_GROUP CleanupGroup;
+    NTSTATUS Status;
+
+    CleanupGroup = RtlAllocateHeap(RtlGetProcessHeap(), 0, sizeof(*CleanupGroup));
+    if (!CleanupGroup)
+        return STATUS_NO_MEMORY;
+
+    Status = RtlInitializeCriticalSection(&CleanupGroup->Lock);
+    if (!NT_SUCCESS(Status))
+    {
+        RtlFreeHeap(RtlGetProcessHeap(), 0, CleanupGroup);
+        return Status;
+    }
+    InitializeListHead(&CleanupGroup->Members);
+
+    *CleanupGroupReturn = CleanupGroup;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseCleanupGroup(IN OUT PTP_CLEANUP_GROUP CleanupGroup)
+{
+    ASSERT(IsListEmpty(&CleanupGroup->Members));
+    RtlDeleteCriticalSection(&CleanupGroup->Lock);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, CleanupGroup);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseCleanupGroupMembers(IN OUT PTP_CLEANUP_GROUP CleanupGroup,
+                             IN BOOLEAN CancelPendingCallbacks,
+                             IN OUT PVOID CleanupParameter OPTIONAL)
+{
+    LIST_ENTRY Members;
+    PLIST_ENTRY Entry, NextEntry;
+    PTPP_OBJECT Object;
+
+    /* Take them all out, so that they can't go away while we wait for them */
+    InitializeListHead(&Members);
+    RtlEnterCriticalSection(&CleanupGroup->Lock);
+    for (Entry = CleanupGroup->Members.Flink; Entry != &CleanupGroup->Members; Entry = NextEntry)
+    {
+        NextEntry = Entry->Flink;
+        Object = CONTAINING_RECORD(Entry, TPP_OBJECT, GroupLink);
+
+        /*
+         * A simple callback that just finished may have lost its last reference
+         * and wait for our lock in TppFreeObject. Leave it to it then.
+         */
+        if (!TppReferenceObjectIfAlive(Object))
+            continue;
+
+        RemoveEntryList(Entry);
+        Object->InGroup = FALSE;
+        InsertTailList(&Members, Entry);
+    }
+    RtlLeaveCriticalSection(&CleanupGroup->Lock);
+
+    while (!IsListEmpty(&Members))
+    {
+        Entry = RemoveHeadList(&Members);
+        Object = CONTAINING_RECORD(Entry, TPP_OBJECT, GroupLink);
+
+        if (Object->Type == TppTimer || Object->Type == TppWait)
+            TppDisarm(Object);
+
+        if (CancelPendingCallbacks &&
+            TppCancelPending(Object) &&
+            Object->CancelCallback)
+        {
+            Object->CancelCallback(Object->Context, CleanupParameter);
+        }
+
+        TppWaitForCallbacks(Object, FALSE);
+
+        /* Simple callbacks have no owner, they go away once they ran */
+        if (Object->Type != TppSimple)
+            TppDereferenceObject(Object);
+
+        TppDereferenceObject(Object);
+    }
+}
+
+/* WORK **********************************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpSimpleTryPost(IN PTP_SIMPLE_CALLBACK Callback,
+                IN OUT PVOID Context OPTIONAL,
+                IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    PTPP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocObject(&Object, TppSimple, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    /* Nobody owns it, the packet keeps it alive */
+    Status = TppPost(Object, NULL);
+    TppDereferenceObject(Object);
+    return Status;
+}
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocWork(OUT PTP_WORK *WorkReturn,
+            IN PTP_WORK_CALLBACK Callback,
+            IN OUT PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    return TppAllocObject((PTPP_OBJECT*)WorkReturn, TppWork, Callback, Context, CallbackEnviron);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpPostWork(IN OUT PTP_WORK Work)
+{
+    TppPost((PTPP_OBJECT)Work, NULL);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForWork(IN OUT PTP_WORK Work,
+              IN BOOLEAN CancelPendingCallbacks)
+{
+    TppWaitForCallbacks((PTPP_OBJECT)Work, CancelPendingCallbacks);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseWork(IN OUT PTP_WORK Work)
+{
+    TppReleaseObject((PTPP_OBJECT)Work);
+}
+
+/* TIMERS ********************************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocTimer(OUT PTP_TIMER *Timer,
+             IN PTP_TIMER_CALLBACK Callback,
+             IN OUT PVOID Context OPTIONAL,
+             IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    return TppAllocObject((PTPP_OBJECT*)Timer, TppTimer, Callback, Context, CallbackEnviron);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetTimer(IN OUT PTP_TIMER Timer,
+           IN PLARGE_INTEGER DueTime OPTIONAL,
+           IN ULONG Period,
+           IN ULONG WindowLength OPTIONAL)
+{
+    PTPP_OBJECT Object = (PTPP_OBJECT)Timer;
+
+    /* We don't coalesce, every timer fires on time */
+    UNREFERENCED_PARAMETER(WindowLength);
+
+    if (!DueTime)
+    {
+        /* Stop queuing callbacks, the ones already queued still run */
+        TppDisarm(Object);
+        return;
+    }
+
+    TppArm(Object, NULL, TppGetDueTime(DueTime), Period);
+}
+
+/*
+ * @implemented
+ */
+BOOLEAN
+NTAPI
+TpIsTimerSet(IN PTP_TIMER Timer)
+{
+    return (((PTPP_OBJECT)Timer)->Waiter != NULL);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForTimer(IN OUT PTP_TIMER Timer,
+               IN BOOLEAN CancelPendingCallbacks)
+{
+    TppWaitForCallbacks((PTPP_OBJECT)Timer, CancelPendingCallbacks);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseTimer(IN OUT PTP_TIMER Timer)
+{
+    TppReleaseObject((PTPP_OBJECT)Timer);
+}
+
+/* WAITS *********************************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocWait(OUT PTP_WAIT *WaitReturn,
+            IN PTP_WAIT_CALLBACK Callback,
+            IN OUT PVOID Context OPTIONAL,
+            IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    return TppAllocObject((PTPP_OBJECT*)WaitReturn, TppWait, Callback, Context, CallbackEnviron);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpSetWait(IN OUT PTP_WAIT Wait,
+          IN HANDLE Handle OPTIONAL,
+          IN PLARGE_INTEGER Timeout OPTIONAL)
+{
+    PTPP_OBJECT Object = (PTPP_OBJECT)Wait;
+
+    if (!Handle)
+    {
+        TppDisarm(Object);
+        return;
+    }
+
+    TppArm(Object, Handle, Timeout ? TppGetDueTime(Timeout) : 0, 0);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForWait(IN OUT PTP_WAIT Wait,
+              IN BOOLEAN CancelPendingCallbacks)
+{
+    TppWaitForCallbacks((PTPP_OBJECT)Wait, CancelPendingCallbacks);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseWait(IN OUT PTP_WAIT Wait)
+{
+    TppReleaseObject((PTPP_OBJECT)Wait);
+}
+
+/* I/O ***********************************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpAllocIoCompletion(OUT PTP_IO *IoReturn,
+                    IN HANDLE File,
+                    IN PTP_IO_CALLBACK Callback,
+                    IN OUT PVOID Context OPTIONAL,
+                    IN PTP_CALLBACK_ENVIRON CallbackEnviron OPTIONAL)
+{
+    FILE_COMPLETION_INFORMATION CompletionInfo;
+    IO_STATUS_BLOCK IoStatusBlock;
+    PTPP_OBJECT Object;
+    NTSTATUS Status;
+
+    Status = TppAllocObject(&Object, TppIo, Callback, Context, CallbackEnviron);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    /* Completions of the file go straight to the workers */
+    CompletionInfo.Port = Object->Pool->CompletionPort;
+    CompletionInfo.Key = Object;
+    Status = NtSetInformationFile(File,
+                                  &IoStatusBlock,
+                                  &CompletionInfo,
+                                  sizeof(CompletionInfo),
+                                  FileCompletionInformation);
+    if (!NT_SUCCESS(Status))
+    {
+        TppReleaseObject(Object);
+        return Status;
+    }
+
+    *IoReturn = (PTP_IO)Object;
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpStartAsyncIoOperation(IN OUT PTP_IO Io)
+{
+    PTPP_OBJECT Object = (PTPP_OBJECT)Io;
+
+    /* The completion packet will come from the I/O manager */
+    InterlockedIncrement(&Object->RefCount);
+    InterlockedIncrement(&Object->Pending);
+    InterlockedIncrement(&Object->Pool->Queued);
+
+    /* A pool only used for I/O may have no worker left to take it */
+    TppEnsureWorker(Object->Pool);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCancelAsyncIoOperation(IN OUT PTP_IO Io)
+{
+    PTPP_OBJECT Object = (PTPP_OBJECT)Io;
+    PTP_POOL Pool = Object->Pool;
+
+    /* The operation failed, no packet is coming */
+    InterlockedDecrement(&Pool->Queued);
+
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (InterlockedDecrement(&Object->Pending) == 0 && Object->Running == 0)
+        RtlWakeAllConditionVariable(&Pool->CallbacksDone);
+    RtlLeaveCriticalSection(&Pool->Lock);
+
+    TppDereferenceObject(Object);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpWaitForIoCompletion(IN OUT PTP_IO Io,
+                      IN BOOLEAN CancelPendingCallbacks)
+{
+    TppWaitForCallbacks((PTPP_OBJECT)Io, CancelPendingCallbacks);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpReleaseIoCompletion(IN OUT PTP_IO Io)
+{
+    TppReleaseObject((PTPP_OBJECT)Io);
+}
+
+/* CALLBACK INSTANCES ********************************************************/
+
+/*
+ * @implemented
+ */
+NTSTATUS
+NTAPI
+TpCallbackMayRunLong(IN OUT PTP_CALLBACK_INSTANCE Instance)
+{
+    PTP_POOL Pool = Instance->Object->Pool;
+
+    if (!Instance->MayRunLong)
+    {
+        Instance->MayRunLong = TRUE;
+        InterlockedIncrement(&Pool->LongRunning);
+    }
+
+    /* Make sure the other callbacks don't have to wait for us */
+    if (Pool->Queued >= Pool->IdleThreads)
+        return TppGrowPool(Pool, TRUE);
+
+    return STATUS_SUCCESS;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpDisassociateCallback(IN OUT PTP_CALLBACK_INSTANCE Instance)
+{
+    PTPP_OBJECT Object = Instance->Object;
+    PTP_POOL Pool = Object->Pool;
+
+    if (Instance->Disassociated)
+        return;
+
+    /* Whoever waits for the callbacks of the object doesn't wait for us anymore */
+    Instance->Disassociated = TRUE;
+    RtlEnterCriticalSection(&Pool->Lock);
+    if (--Object->Running == 0 && Object->Pending == 0)
+        RtlWakeAllConditionVariable(&Pool->CallbacksDone);
+    RtlLeaveCriticalSection(&Pool->Lock);
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackLeaveCriticalSectionOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                           IN OUT PRTL_CRITICAL_SECTION CriticalSection)
+{
+    Instance->CriticalSection = CriticalSection;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackReleaseMutexOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                   IN HANDLE Mutex)
+{
+    Instance->Mutex = Mutex;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackReleaseSemaphoreOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                       IN HANDLE Semaphore,
+                                       IN ULONG ReleaseCount)
+{
+    Instance->Semaphore = Semaphore;
+    Instance->SemaphoreCount = ReleaseCount;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackSetEventOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                               IN HANDLE Event)
+{
+    Instance->Event = Event;
+}
+
+/*
+ * @implemented
+ */
+VOID
+NTAPI
+TpCallbackUnloadDllOnCompletion(IN OUT PTP_CALLBACK_INSTANCE Instance,
+                                IN PVOID DllHandle)
+{
+    Instance->Dll = DllHandle;
+}
+
+/* EOF */
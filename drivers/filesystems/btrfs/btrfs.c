@@ -20,13 +20,11 @@
 #endif
 
 #include "btrfs_drv.h"
-#ifndef __REACTOS__
-#ifndef _MSC_VER
+#if !defined(_MSC_VER) && !defined(__REACTOS__)
 #include <cpuid.h>
 #else
 #include <intrin.h>
 #endif
-#endif
 #include <ntddscsi.h>
 #include "btrfs.h"
 #include <ata.h>
@@ -48,6 +46,7 @@
 
 #define INCOMPAT_SUPPORTED (BTRFS_INCOMPAT_FLAGS_MIXED_BACKREF | BTRFS_INCOMPAT_FLAGS_DEFAULT_SUBVOL | BTRFS_INCOMPAT_FLAGS_MIXED_GROUPS | \
                             BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO | BTRFS_INCOMPAT_FLAGS_BIG_METADATA | BTRFS_INCOMPAT_FLAGS_RAID56 | \
+                            BTRFS_INCOMPAT_FLAGS_COMPRESS_ZSTD | \
                             BTRFS_INCOMPAT_FLAGS_EXTENDED_IREF | BTRFS_INCOMPAT_FLAGS_SKINNY_METADATA | BTRFS_INCOMPAT_FLAGS_NO_HOLES)
 #define COMPAT_RO_SUPPORTED (BTRFS_COMPAT_RO_FLAGS_FREE_SPACE_CACHE | BTRFS_COMPAT_RO_FLAGS_FREE_SPACE_CACHE_VALID)
 
@@ -58,9 +57,7 @@ DEFINE_GUID(BtrfsBusInterface, 0x4d414874, 0x6865, 0x6761, 0x6d, 0x65, 0x83, 0x6
 
 PDRIVER_OBJECT drvobj;
 PDEVICE_OBJECT master_devobj;
-#ifndef __REACTOS__
-BOOL have_sse42 = FALSE, have_sse2 = FALSE;
-#endif
+BOOL have_sse42 = FALSE, have_sse2 = FALSE, have_ssse3 = FALSE;
 UINT64 num_reads = 0;
 LIST_ENTRY uid_map_list, gid_map_list;
 LIST_ENTRY VcbList;
@@ -70,6 +67,7 @@ UINT32 mount_compress = 0;
 UINT32 mount_compress_force = 0;
 UINT32 mount_compress_type = 0;
 UINT32 mount_zlib_level = 3;
+UINT32 mount_zstd_level = 3;
 UINT32 mount_flush_interval = 30;
 UINT32 mount_max_inline = 2048;
 UINT32 mount_skip_balance = 0;
@@ -5157,17 +5155,18 @@ static void init_serial(BOOL first_time) {
 }
 #endif
 
-#ifndef __REACTOS__
 static void check_cpu() {
     unsigned int cpuInfo[4];
-#ifndef _MSC_VER
+#if !defined(_MSC_VER) && !defined(__REACTOS__)
     __get_cpuid(1, &cpuInfo[0], &cpuInfo[1], &cpuInfo[2], &cpuInfo[3]);
     have_sse42 = cpuInfo[2] & bit_SSE4_2;
     have_sse2 = cpuInfo[3] & bit_SSE2;
+    have_ssse3 = cpuInfo[2] & bit_SSSE3;
 #else
-   __cpuid(cpuInfo, 1);
+   __cpuid((int*)cpuInfo, 1);
    have_sse42 = cpuInfo[2] & (1 << 20);
    have_sse2 = cpuInfo[3] & (1 << 26);
+   have_ssse3 = cpuInfo[2] & (1 << 9);
 #endif
 
     if (have_sse42)
@@ -5179,8 +5178,12 @@ static void check_cpu() {
         TRACE("SSE2 is supported\n");
     else
         TRACE("SSE2 is not supported\n");
+
+    if (have_ssse3)
+        TRACE("SSSE3 is supported\n");
+    else
+        TRACE("SSSE3 is not supported\n");
 }
-#endif
 
 #ifdef _DEBUG
 static void init_logging() {
@@ -5451,9 +5454,8 @@ NTSTATUS DriverEntry(_In_ PDRIVER_OBJECT DriverObject, _In_ PUNICODE_STRING Regi
 
     TRACE("DriverEntry\n");
 
-#ifndef __REACTOS__
     check_cpu();
-#endif
+    init_crc32c();
 
     if (RtlIsNtDdiVersionAvailable(NTDDI_WIN8)) {
         UNICODE_STRING name;
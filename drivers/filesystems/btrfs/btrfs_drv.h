@@ -84,6 +84,7 @@
 
 #define ALLOC_TAG 0x7442484D //'MHBt'
 #define ALLOC_TAG_ZLIB 0x7A42484D //'MHBz'
+#define ALLOC_TAG_ZSTD 0x6442484D //'MHBd'
 
 #define UID_NOBODY 65534
 #define GID_NOBODY 65534
@@ -234,7 +235,8 @@ typedef struct {
 enum prop_compression_type {
     PropCompression_None,
     PropCompression_Zlib,
-    PropCompression_LZO
+    PropCompression_LZO,
+    PropCompression_ZSTD
 };
 
 typedef struct {
@@ -574,11 +576,22 @@ typedef struct {
     LIST_ENTRY list_entry;
 } sys_chunk;
 
+enum calc_job_type {
+    calc_job_crc32c,
+    calc_job_compress
+};
+
 typedef struct {
+    enum calc_job_type type;
     UINT8* data;
     UINT32* csum;
     UINT32 sectors;
-    LONG pos, done;
+    UINT32 inlen;
+    UINT8 compression;
+    UINT8* out;
+    UINT32 outlen;
+    NTSTATUS Status;
+    LONG pos, done, blocks;
     KEVENT event;
     LONG refcount;
     LIST_ENTRY list_entry;
@@ -606,6 +619,7 @@ typedef struct {
     UINT8 compress_type;
     BOOL readonly;
     UINT32 zlib_level;
+    UINT32 zstd_level;
     UINT32 flush_interval;
     UINT32 max_inline;
     UINT64 subvol_id;
@@ -1117,12 +1131,13 @@ NTSTATUS AddDevice(PDRIVER_OBJECT DriverObject, PDEVICE_OBJECT PhysicalDeviceObj
 #define funcname __func__
 #endif
 
-extern BOOL have_sse2;
+extern BOOL have_sse2, have_ssse3;
 
 extern UINT32 mount_compress;
 extern UINT32 mount_compress_force;
 extern UINT32 mount_compress_type;
 extern UINT32 mount_zlib_level;
+extern UINT32 mount_zstd_level;
 extern UINT32 mount_flush_interval;
 extern UINT32 mount_max_inline;
 extern UINT32 mount_skip_balance;
@@ -1180,6 +1195,7 @@ void _free_fcb(_Requires_exclusive_lock_held_(_Curr_->fcb_lock) _In_ device_exte
 void init_fast_io_dispatch(FAST_IO_DISPATCH** fiod);
 
 // in crc32c.c
+void init_crc32c();
 UINT32 calc_crc32c(_In_ UINT32 seed, _In_reads_bytes_(msglen) UINT8* msg, _In_ ULONG msglen);
 
 typedef struct {
@@ -1479,11 +1495,18 @@ void watch_registry(HANDLE regh);
 // in compress.c
 NTSTATUS zlib_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen);
 NTSTATUS lzo_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen, UINT32 inpageoff);
-NTSTATUS write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end_data, void* data, BOOL* compressed, PIRP Irp, LIST_ENTRY* rollback);
+NTSTATUS zstd_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen);
+NTSTATUS compress_data(device_extension* Vcb, UINT8 compression, UINT8* inbuf, UINT32 inlen, UINT8** outbuf, UINT32* outlen);
+NTSTATUS write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end_data, void* data, UINT8 compression, UINT8* comp_data, UINT32 comp_length,
+                              PIRP Irp, LIST_ENTRY* rollback);
+UINT8 get_compression_type(fcb* fcb);
 
 // in galois.c
 void galois_double(UINT8* data, UINT32 len);
+void galois_double_xor(UINT8* data, UINT8* xor_data, UINT32 len);
+void galois_mul(UINT8* data, UINT8 c, UINT32 len);
 void galois_divpower(UINT8* data, UINT8 div, UINT32 readlen);
+void galois_recover(UINT8* qxy, UINT8* pxy, UINT8* p, UINT8* q, UINT8 a, UINT8 b, UINT32 len);
 UINT8 gpow2(UINT8 e);
 UINT8 gmul(UINT8 a, UINT8 b);
 UINT8 gdiv(UINT8 a, UINT8 b);
@@ -1504,6 +1527,7 @@ void calc_thread(void* context);
 #endif
 
 NTSTATUS add_calc_job(device_extension* Vcb, UINT8* data, UINT32 sectors, UINT32* csum, calc_job** pcj);
+NTSTATUS add_calc_job_comp(device_extension* Vcb, UINT8 compression, UINT8* data, UINT32 inlen, calc_job** pcj);
 void free_calc_job(calc_job* cj);
 
 // in balance.c
@@ -1617,6 +1641,15 @@ static __inline void do_xor(UINT8* buf1, UINT8* buf2, UINT32 len) {
             len -= 16;
         }
     }
+#elif defined(_X86_) || defined(_AMD64_)
+    // unaligned accesses are fine here, so do a register's worth at a time
+    while (len >= sizeof(ULONG_PTR)) {
+        *(ULONG_PTR*)buf1 ^= *(ULONG_PTR*)buf2;
+
+        buf1 += sizeof(ULONG_PTR);
+        buf2 += sizeof(ULONG_PTR);
+        len -= sizeof(ULONG_PTR);
+    }
 #endif
 
     for (j = 0; j < len; j++) {
@@ -63,6 +63,7 @@ typedef struct {
 #define BTRFS_COMPRESSION_ANY   0
 #define BTRFS_COMPRESSION_ZLIB  1
 #define BTRFS_COMPRESSION_LZO   2
+#define BTRFS_COMPRESSION_ZSTD  3
 
 typedef struct {
     UINT64 subvol;
@@ -77,6 +78,7 @@ typedef struct {
     UINT32 inline_length;
     UINT64 disk_size[3];
     UINT8 compression_type;
+    UINT64 disk_size_zstd;
 } btrfs_inode_info;
 
 typedef struct {
@@ -19,29 +19,83 @@
 
 #define SECTOR_BLOCK 16
 
-NTSTATUS add_calc_job(device_extension* Vcb, UINT8* data, UINT32 sectors, UINT32* csum, calc_job** pcj) {
+static void queue_calc_job(device_extension* Vcb, calc_job* cj) {
+    ExAcquireResourceExclusiveLite(&Vcb->calcthreads.lock, TRUE);
+
+    if (cj->type == calc_job_crc32c) {
+        LIST_ENTRY* le = Vcb->calcthreads.job_list.Flink;
+
+        // Someone is usually waiting on a checksum job straight away, whereas compression jobs are queued
+        // ahead of time - put checksums in front of them, so that the two can overlap.
+        while (le != &Vcb->calcthreads.job_list) {
+            calc_job* cj2 = CONTAINING_RECORD(le, calc_job, list_entry);
+
+            if (cj2->type != calc_job_crc32c)
+                break;
+
+            le = le->Flink;
+        }
+
+        InsertTailList(le, &cj->list_entry);
+    } else
+        InsertTailList(&Vcb->calcthreads.job_list, &cj->list_entry);
+
+    ExReleaseResourceLite(&Vcb->calcthreads.lock);
+
+    KeSetEvent(&Vcb->calcthreads.event, 0, FALSE);
+}
+
+static calc_job* alloc_calc_job(enum calc_job_type type, UINT8* data) {
     calc_job* cj;
 
     cj = ExAllocatePoolWithTag(NonPagedPool, sizeof(calc_job), ALLOC_TAG);
     if (!cj) {
         ERR("out of memory\n");
-        return STATUS_INSUFFICIENT_RESOURCES;
+        return NULL;
     }
 
+    RtlZeroMemory(cj, sizeof(calc_job));
+
+    cj->type = type;
     cj->data = data;
-    cj->sectors = sectors;
-    cj->csum = csum;
-    cj->pos = 0;
-    cj->done = 0;
     cj->refcount = 1;
     KeInitializeEvent(&cj->event, NotificationEvent, FALSE);
 
-    ExAcquireResourceExclusiveLite(&Vcb->calcthreads.lock, TRUE);
-    InsertTailList(&Vcb->calcthreads.job_list, &cj->list_entry);
-    ExReleaseResourceLite(&Vcb->calcthreads.lock);
+    return cj;
+}
 
-    KeSetEvent(&Vcb->calcthreads.event, 0, FALSE);
-    KeClearEvent(&Vcb->calcthreads.event);
+NTSTATUS add_calc_job(device_extension* Vcb, UINT8* data, UINT32 sectors, UINT32* csum, calc_job** pcj) {
+    calc_job* cj;
+
+    cj = alloc_calc_job(calc_job_crc32c, data);
+    if (!cj)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    cj->sectors = sectors;
+    cj->csum = csum;
+    cj->blocks = (LONG)((sectors + SECTOR_BLOCK - 1) / SECTOR_BLOCK);
+
+    queue_calc_job(Vcb, cj);
+
+    *pcj = cj;
+
+    return STATUS_SUCCESS;
+}
+
+// The result ends up in cj->Status, cj->out and cj->outlen - see compress_data. The caller
+// has to free cj->out if it's not NULL.
+NTSTATUS add_calc_job_comp(device_extension* Vcb, UINT8 compression, UINT8* data, UINT32 inlen, calc_job** pcj) {
+    calc_job* cj;
+
+    cj = alloc_calc_job(calc_job_compress, data);
+    if (!cj)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    cj->compression = compression;
+    cj->inlen = inlen;
+    cj->blocks = 1;
+
+    queue_calc_job(Vcb, cj);
 
     *pcj = cj;
 
@@ -55,38 +109,30 @@ void free_calc_job(calc_job* cj) {
         ExFreePool(cj);
 }
 
-static BOOL do_calc(device_extension* Vcb, calc_job* cj) {
-    LONG pos, done;
-    UINT32* csum;
-    UINT8* data;
-    ULONG blocksize, i;
-
-    pos = InterlockedIncrement(&cj->pos) - 1;
+static void do_calc(device_extension* Vcb, calc_job* cj, LONG pos) {
+    if (cj->type == calc_job_crc32c) {
+        UINT32* csum;
+        UINT8* data;
+        ULONG blocksize, i;
 
-    if ((UINT32)pos * SECTOR_BLOCK >= cj->sectors)
-        return FALSE;
+        csum = &cj->csum[pos * SECTOR_BLOCK];
+        data = cj->data + (pos * SECTOR_BLOCK * Vcb->superblock.sector_size);
 
-    csum = &cj->csum[pos * SECTOR_BLOCK];
-    data = cj->data + (pos * SECTOR_BLOCK * Vcb->superblock.sector_size);
+        blocksize = min(SECTOR_BLOCK, cj->sectors - (pos * SECTOR_BLOCK));
+        for (i = 0; i < blocksize; i++) {
+            *csum = ~calc_crc32c(0xffffffff, data, Vcb->superblock.sector_size);
+            csum++;
+            data += Vcb->superblock.sector_size;
+        }
+    } else {
+        cj->Status = compress_data(Vcb, cj->compression, cj->data, cj->inlen, &cj->out, &cj->outlen);
 
-    blocksize = min(SECTOR_BLOCK, cj->sectors - (pos * SECTOR_BLOCK));
-    for (i = 0; i < blocksize; i++) {
-        *csum = ~calc_crc32c(0xffffffff, data, Vcb->superblock.sector_size);
-        csum++;
-        data += Vcb->superblock.sector_size;
+        if (!NT_SUCCESS(cj->Status))
+            ERR("compress_data returned %08x\n", cj->Status);
     }
 
-    done = InterlockedIncrement(&cj->done);
-
-    if ((UINT32)done * SECTOR_BLOCK >= cj->sectors) {
-        ExAcquireResourceExclusiveLite(&Vcb->calcthreads.lock, TRUE);
-        RemoveEntryList(&cj->list_entry);
-        ExReleaseResourceLite(&Vcb->calcthreads.lock);
-
+    if (InterlockedIncrement(&cj->done) == cj->blocks)
         KeSetEvent(&cj->event, 0, FALSE);
-    }
-
-    return TRUE;
 }
 
 _Function_class_(KSTART_ROUTINE)
@@ -105,26 +151,35 @@ void calc_thread(void* context) {
 
         while (TRUE) {
             calc_job* cj;
-            BOOL b;
+            LONG pos;
 
             ExAcquireResourceExclusiveLite(&Vcb->calcthreads.lock, TRUE);
 
             if (IsListEmpty(&Vcb->calcthreads.job_list)) {
+                // Cleared while holding the lock, so that we can't miss a job being queued. When
+                // unmounting it has to stay set, so that all the threads see the quit flag.
+                if (!thread->quit)
+                    KeClearEvent(&Vcb->calcthreads.event);
                 ExReleaseResourceLite(&Vcb->calcthreads.lock);
                 break;
             }
 
             cj = CONTAINING_RECORD(Vcb->calcthreads.job_list.Flink, calc_job, list_entry);
-            cj->refcount++;
+            InterlockedIncrement(&cj->refcount);
+
+            // Take the job off the list as soon as its last block has been handed out, rather than
+            // when it's finished, so that the other threads can get on with the next one.
+            pos = cj->pos;
+            cj->pos++;
+
+            if (cj->pos == cj->blocks)
+                RemoveEntryList(&cj->list_entry);
 
             ExReleaseResourceLite(&Vcb->calcthreads.lock);
 
-            b = do_calc(Vcb, cj);
+            do_calc(Vcb, cj, pos);
 
             free_calc_job(cj);
-
-            if (!b)
-                break;
         }
 
         if (thread->quit)
@@ -39,8 +39,15 @@
 #include <zlib.h>
 #endif
 
+#define ZSTD_STATIC_LINKING_ONLY
+
+#include <zstd.h>
+
 #define LINUX_PAGE_SIZE 4096
 
+#define ZSTD_BTRFS_MAX_WINDOWLOG 17
+#define ZSTD_BTRFS_MAX_INPUT (1 << ZSTD_BTRFS_MAX_WINDOWLOG)
+
 typedef struct {
     UINT8* in;
     UINT32 inlen;
@@ -361,151 +368,151 @@ NTSTATUS zlib_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outle
     return STATUS_SUCCESS;
 }
 
-static NTSTATUS zlib_write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end_data, void* data, BOOL* compressed, PIRP Irp, LIST_ENTRY* rollback) {
+static void* zstd_malloc(void* opaque, size_t size) {
+    UNUSED(opaque);
+
+    return ExAllocatePoolWithTag(PagedPool, size, ALLOC_TAG_ZSTD);
+}
+
+static void zstd_free(void* opaque, void* address) {
+    UNUSED(opaque);
+
+    if (address)
+        ExFreePool(address);
+}
+
+static const ZSTD_customMem zstd_mem = { zstd_malloc, zstd_free, NULL };
+
+NTSTATUS zstd_decompress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen) {
     NTSTATUS Status;
-    UINT8 compression;
-    UINT32 comp_length;
-    UINT8* comp_data;
-    UINT32 out_left;
-    LIST_ENTRY* le;
-    chunk* c;
-    z_stream c_stream;
-    int ret;
+    ZSTD_DStream* stream;
+    size_t init_res, read;
+    ZSTD_inBuffer input;
+    ZSTD_outBuffer output;
 
-    comp_data = ExAllocatePoolWithTag(PagedPool, (UINT32)(end_data - start_data), ALLOC_TAG);
-    if (!comp_data) {
-        ERR("out of memory\n");
-        return STATUS_INSUFFICIENT_RESOURCES;
+    stream = ZSTD_createDStream_advanced(zstd_mem);
+
+    if (!stream) {
+        ERR("ZSTD_createDStream failed.\n");
+        return STATUS_INTERNAL_ERROR;
     }
 
-    Status = excise_extents(fcb->Vcb, fcb, start_data, end_data, Irp, rollback);
-    if (!NT_SUCCESS(Status)) {
-        ERR("excise_extents returned %08x\n", Status);
-        ExFreePool(comp_data);
-        return Status;
+    init_res = ZSTD_initDStream(stream);
+
+    if (ZSTD_isError(init_res)) {
+        ERR("ZSTD_initDStream failed: %s\n", ZSTD_getErrorName(init_res));
+        Status = STATUS_INTERNAL_ERROR;
+        goto end;
     }
 
+    input.src = inbuf;
+    input.size = inlen;
+    input.pos = 0;
+
+    output.dst = outbuf;
+    output.size = outlen;
+    output.pos = 0;
+
+    // we may only want the start of the extent, so stop as soon as the output buffer is full
+    do {
+        read = ZSTD_decompressStream(stream, &output, &input);
+
+        if (ZSTD_isError(read)) {
+            ERR("ZSTD_decompressStream failed: %s\n", ZSTD_getErrorName(read));
+            Status = STATUS_INTERNAL_ERROR;
+            goto end;
+        }
+    } while (read != 0 && output.pos < output.size && input.pos < input.size);
+
+    Status = STATUS_SUCCESS;
+
+end:
+    ZSTD_freeDStream(stream);
+
+    return Status;
+}
+
+static NTSTATUS zlib_compress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen, unsigned int level, UINT32* comp_len) {
+    z_stream c_stream;
+    int ret;
+
     c_stream.zalloc = zlib_alloc;
     c_stream.zfree = zlib_free;
     c_stream.opaque = (voidpf)0;
 
-    ret = deflateInit(&c_stream, fcb->Vcb->options.zlib_level);
+    ret = deflateInit(&c_stream, level);
 
     if (ret != Z_OK) {
         ERR("deflateInit returned %08x\n", ret);
-        ExFreePool(comp_data);
         return STATUS_INTERNAL_ERROR;
     }
 
-    c_stream.avail_in = (UINT32)(end_data - start_data);
-    c_stream.next_in = data;
-    c_stream.avail_out = (UINT32)(end_data - start_data);
-    c_stream.next_out = comp_data;
+    c_stream.avail_in = inlen;
+    c_stream.next_in = inbuf;
+    c_stream.avail_out = outlen;
+    c_stream.next_out = outbuf;
 
     do {
         ret = deflate(&c_stream, Z_FINISH);
 
         if (ret == Z_STREAM_ERROR) {
             ERR("deflate returned %x\n", ret);
-            ExFreePool(comp_data);
+            deflateEnd(&c_stream);
             return STATUS_INTERNAL_ERROR;
         }
-    } while (c_stream.avail_in > 0 && c_stream.avail_out > 0);
-
-    out_left = c_stream.avail_out;
+    } while (ret != Z_STREAM_END && c_stream.avail_out > 0);
 
-    ret = deflateEnd(&c_stream);
+    *comp_len = outlen - c_stream.avail_out;
 
-    if (ret != Z_OK) {
-        ERR("deflateEnd returned %08x\n", ret);
-        ExFreePool(comp_data);
-        return STATUS_INTERNAL_ERROR;
-    }
-
-    if (out_left < fcb->Vcb->superblock.sector_size) { // compressed extent would be larger than or same size as uncompressed extent
-        ExFreePool(comp_data);
+    // deflateEnd complains if the stream wasn't finished, which is what happens when the data didn't fit
+    deflateEnd(&c_stream);
 
-        comp_length = (UINT32)(end_data - start_data);
-        comp_data = data;
-        compression = BTRFS_COMPRESSION_NONE;
-
-        *compressed = FALSE;
-    } else {
-        UINT32 cl;
-
-        compression = BTRFS_COMPRESSION_ZLIB;
-        cl = (UINT32)(end_data - start_data - out_left);
-        comp_length = (UINT32)sector_align(cl, fcb->Vcb->superblock.sector_size);
+    return ret == Z_STREAM_END ? STATUS_SUCCESS : STATUS_BUFFER_OVERFLOW;
+}
 
-        RtlZeroMemory(comp_data + cl, comp_length - cl);
+static NTSTATUS zstd_compress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen, UINT32 level, UINT32* comp_len) {
+    ZSTD_CCtx* cctx;
+    size_t init_res, written;
 
-        *compressed = TRUE;
+    if (inlen > ZSTD_BTRFS_MAX_INPUT) {
+        ERR("extent too large for zstd (%x > %x)\n", inlen, ZSTD_BTRFS_MAX_INPUT);
+        return STATUS_INVALID_PARAMETER;
     }
 
-    ExAcquireResourceSharedLite(&fcb->Vcb->chunk_lock, TRUE);
-
-    le = fcb->Vcb->chunks.Flink;
-    while (le != &fcb->Vcb->chunks) {
-        c = CONTAINING_RECORD(le, chunk, list_entry);
-
-        if (!c->readonly && !c->reloc) {
-            ExAcquireResourceExclusiveLite(&c->lock, TRUE);
-
-            if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
-                if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, FALSE, comp_data, Irp, rollback, compression, end_data - start_data, FALSE, 0)) {
-                    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-                    if (compression != BTRFS_COMPRESSION_NONE)
-                        ExFreePool(comp_data);
-
-                    return STATUS_SUCCESS;
-                }
-            }
-
-            ExReleaseResourceLite(&c->lock);
-        }
+    cctx = ZSTD_createCCtx_advanced(zstd_mem);
 
-        le = le->Flink;
+    if (!cctx) {
+        ERR("ZSTD_createCCtx failed.\n");
+        return STATUS_INTERNAL_ERROR;
     }
 
-    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-    ExAcquireResourceExclusiveLite(&fcb->Vcb->chunk_lock, TRUE);
-
-    Status = alloc_chunk(fcb->Vcb, fcb->Vcb->data_flags, &c, FALSE);
-
-    ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-    if (!NT_SUCCESS(Status)) {
-        ERR("alloc_chunk returned %08x\n", Status);
+    // Linux refuses to read frames with a window larger than 128 KB, which is also the largest extent we write
+    init_res = ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
 
-        if (compression != BTRFS_COMPRESSION_NONE)
-            ExFreePool(comp_data);
+    if (!ZSTD_isError(init_res))
+        init_res = ZSTD_CCtx_setParameter(cctx, ZSTD_c_windowLog, ZSTD_BTRFS_MAX_WINDOWLOG);
 
-        return Status;
+    if (ZSTD_isError(init_res)) {
+        ERR("ZSTD_CCtx_setParameter failed: %s\n", ZSTD_getErrorName(init_res));
+        ZSTD_freeCCtx(cctx);
+        return STATUS_INTERNAL_ERROR;
     }
 
-    if (c) {
-        ExAcquireResourceExclusiveLite(&c->lock, TRUE);
+    written = ZSTD_compress2(cctx, outbuf, outlen, inbuf, inlen);
 
-        if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
-            if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, FALSE, comp_data, Irp, rollback, compression, end_data - start_data, FALSE, 0)) {
-                if (compression != BTRFS_COMPRESSION_NONE)
-                    ExFreePool(comp_data);
+    ZSTD_freeCCtx(cctx);
 
-                return STATUS_SUCCESS;
-            }
-        }
+    if (ZSTD_isError(written)) {
+        if (ZSTD_getErrorCode(written) == ZSTD_error_dstSize_tooSmall)
+            return STATUS_BUFFER_OVERFLOW;
 
-        ExReleaseResourceLite(&c->lock);
+        ERR("ZSTD_compress2 failed: %s\n", ZSTD_getErrorName(written));
+        return STATUS_INTERNAL_ERROR;
     }
 
-    WARN("couldn't find any data chunks with %llx bytes free\n", comp_length);
+    *comp_len = (UINT32)written;
 
-    if (compression != BTRFS_COMPRESSION_NONE)
-        ExFreePool(comp_data);
-
-    return STATUS_DISK_FULL;
+    return STATUS_SUCCESS;
 }
 
 static NTSTATUS lzo_do_compress(const UINT8* in, UINT32 in_len, UINT8* out, UINT32* out_len, void* wrkmem) {
@@ -749,63 +756,49 @@ static __inline UINT32 lzo_max_outlen(UINT32 inlen) {
     return inlen + (inlen / 16) + 64 + 3; // formula comes from LZO.FAQ
 }
 
-static NTSTATUS lzo_write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end_data, void* data, BOOL* compressed, PIRP Irp, LIST_ENTRY* rollback) {
-    NTSTATUS Status;
-    UINT8 compression;
-    UINT64 comp_length;
-    ULONG comp_data_len, num_pages, i;
-    UINT8* comp_data;
-    BOOL skip_compression = FALSE;
-    lzo_stream stream;
-    UINT32* out_size;
-    LIST_ENTRY* le;
-    chunk* c;
-
-    num_pages = (ULONG)((sector_align(end_data - start_data, LINUX_PAGE_SIZE)) / LINUX_PAGE_SIZE);
+static __inline UINT32 lzo_buffer_size(UINT32 inlen) {
+    ULONG num_pages = (ULONG)(sector_align(inlen, LINUX_PAGE_SIZE) / LINUX_PAGE_SIZE);
 
     // Four-byte overall header
     // Another four-byte header page
     // Each page has a maximum size of lzo_max_outlen(LINUX_PAGE_SIZE)
     // Plus another four bytes for possible padding
-    comp_data_len = sizeof(UINT32) + ((lzo_max_outlen(LINUX_PAGE_SIZE) + (2 * sizeof(UINT32))) * num_pages);
+    return sizeof(UINT32) + ((lzo_max_outlen(LINUX_PAGE_SIZE) + (2 * sizeof(UINT32))) * num_pages);
+}
 
-    comp_data = ExAllocatePoolWithTag(PagedPool, comp_data_len, ALLOC_TAG);
-    if (!comp_data) {
-        ERR("out of memory\n");
-        return STATUS_INSUFFICIENT_RESOURCES;
-    }
+static NTSTATUS lzo_compress(UINT8* inbuf, UINT32 inlen, UINT8* outbuf, UINT32 outlen, UINT32* comp_len) {
+    NTSTATUS Status;
+    ULONG num_pages, i;
+    lzo_stream stream;
+    UINT32* out_size;
+
+    num_pages = (ULONG)(sector_align(inlen, LINUX_PAGE_SIZE) / LINUX_PAGE_SIZE);
+
+    if (outlen < lzo_buffer_size(inlen))
+        return STATUS_BUFFER_OVERFLOW;
 
     stream.wrkmem = ExAllocatePoolWithTag(PagedPool, LZO1X_MEM_COMPRESS, ALLOC_TAG);
     if (!stream.wrkmem) {
         ERR("out of memory\n");
-        ExFreePool(comp_data);
         return STATUS_INSUFFICIENT_RESOURCES;
     }
 
-    Status = excise_extents(fcb->Vcb, fcb, start_data, end_data, Irp, rollback);
-    if (!NT_SUCCESS(Status)) {
-        ERR("excise_extents returned %08x\n", Status);
-        ExFreePool(comp_data);
-        ExFreePool(stream.wrkmem);
-        return Status;
-    }
-
-    out_size = (UINT32*)comp_data;
+    out_size = (UINT32*)outbuf;
     *out_size = sizeof(UINT32);
 
-    stream.in = data;
-    stream.out = comp_data + (2 * sizeof(UINT32));
+    stream.in = inbuf;
+    stream.out = outbuf + (2 * sizeof(UINT32));
 
     for (i = 0; i < num_pages; i++) {
         UINT32* pagelen = (UINT32*)(stream.out - sizeof(UINT32));
 
-        stream.inlen = (UINT32)min(LINUX_PAGE_SIZE, end_data - start_data - (i * LINUX_PAGE_SIZE));
+        stream.inlen = (UINT32)min(LINUX_PAGE_SIZE, inlen - (i * LINUX_PAGE_SIZE));
 
         Status = lzo1x_1_compress(&stream);
         if (!NT_SUCCESS(Status)) {
             ERR("lzo1x_1_compress returned %08x\n", Status);
-            skip_compression = TRUE;
-            break;
+            ExFreePool(stream.wrkmem);
+            return Status;
         }
 
         *pagelen = stream.outlen;
@@ -823,21 +816,84 @@ static NTSTATUS lzo_write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end
 
     ExFreePool(stream.wrkmem);
 
-    if (skip_compression || *out_size >= end_data - start_data - fcb->Vcb->superblock.sector_size) { // compressed extent would be larger than or same size as uncompressed extent
+    *comp_len = *out_size;
+
+    return STATUS_SUCCESS;
+}
+
+// Called from the calc threads as well as from the writing thread, so this mustn't touch the fcb.
+// If compressing doesn't save at least a sector, *outbuf is set to NULL and the data should be
+// written uncompressed.
+NTSTATUS compress_data(device_extension* Vcb, UINT8 compression, UINT8* inbuf, UINT32 inlen, UINT8** outbuf, UINT32* outlen) {
+    NTSTATUS Status;
+    UINT8* comp_data;
+    UINT32 comp_data_len, cl = 0;
+
+    comp_data_len = compression == BTRFS_COMPRESSION_LZO ? lzo_buffer_size(inlen) : inlen;
+
+    comp_data = ExAllocatePoolWithTag(PagedPool, comp_data_len, ALLOC_TAG);
+    if (!comp_data) {
+        ERR("out of memory\n");
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    switch (compression) {
+        case BTRFS_COMPRESSION_ZLIB:
+            Status = zlib_compress(inbuf, inlen, comp_data, comp_data_len, Vcb->options.zlib_level, &cl);
+            break;
+
+        case BTRFS_COMPRESSION_LZO:
+            Status = lzo_compress(inbuf, inlen, comp_data, comp_data_len, &cl);
+            break;
+
+        case BTRFS_COMPRESSION_ZSTD:
+            Status = zstd_compress(inbuf, inlen, comp_data, comp_data_len, Vcb->options.zstd_level, &cl);
+            break;
+
+        default:
+            ERR("unsupported compression type %x\n", compression);
+            Status = STATUS_NOT_SUPPORTED;
+            break;
+    }
+
+    if (Status == STATUS_BUFFER_OVERFLOW || (NT_SUCCESS(Status) && cl + Vcb->superblock.sector_size > inlen)) { // compressed extent would be larger than or same size as uncompressed extent
         ExFreePool(comp_data);
 
-        comp_length = end_data - start_data;
-        comp_data = data;
-        compression = BTRFS_COMPRESSION_NONE;
+        *outbuf = NULL;
+        *outlen = inlen;
+
+        return STATUS_SUCCESS;
+    } else if (!NT_SUCCESS(Status)) {
+        ExFreePool(comp_data);
+        return Status;
+    }
+
+    *outlen = (UINT32)sector_align(cl, Vcb->superblock.sector_size);
+
+    RtlZeroMemory(comp_data + cl, *outlen - cl);
 
-        *compressed = FALSE;
-    } else {
-        compression = BTRFS_COMPRESSION_LZO;
-        comp_length = sector_align(*out_size, fcb->Vcb->superblock.sector_size);
+    *outbuf = comp_data;
 
-        RtlZeroMemory(comp_data + *out_size, (ULONG)(comp_length - *out_size));
+    return STATUS_SUCCESS;
+}
 
-        *compressed = TRUE;
+// comp_data is the output of compress_data; if it's NULL, the data is written uncompressed
+NTSTATUS write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end_data, void* data, UINT8 compression, UINT8* comp_data, UINT32 comp_length,
+                              PIRP Irp, LIST_ENTRY* rollback) {
+    NTSTATUS Status;
+    LIST_ENTRY* le;
+    chunk* c;
+
+    Status = excise_extents(fcb->Vcb, fcb, start_data, end_data, Irp, rollback);
+    if (!NT_SUCCESS(Status)) {
+        ERR("excise_extents returned %08x\n", Status);
+        return Status;
+    }
+
+    if (!comp_data) {
+        comp_length = (UINT32)(end_data - start_data);
+        comp_data = data;
+        compression = BTRFS_COMPRESSION_NONE;
     }
 
     ExAcquireResourceSharedLite(&fcb->Vcb->chunk_lock, TRUE);
@@ -852,10 +908,6 @@ static NTSTATUS lzo_write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end
             if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
                 if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, FALSE, comp_data, Irp, rollback, compression, end_data - start_data, FALSE, 0)) {
                     ExReleaseResourceLite(&fcb->Vcb->chunk_lock);
-
-                    if (compression != BTRFS_COMPRESSION_NONE)
-                        ExFreePool(comp_data);
-
                     return STATUS_SUCCESS;
                 }
             }
@@ -876,10 +928,6 @@ static NTSTATUS lzo_write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end
 
     if (!NT_SUCCESS(Status)) {
         ERR("alloc_chunk returned %08x\n", Status);
-
-        if (compression != BTRFS_COMPRESSION_NONE)
-            ExFreePool(comp_data);
-
         return Status;
     }
 
@@ -887,32 +935,27 @@ static NTSTATUS lzo_write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end
         ExAcquireResourceExclusiveLite(&c->lock, TRUE);
 
         if (c->chunk_item->type == fcb->Vcb->data_flags && (c->chunk_item->size - c->used) >= comp_length) {
-            if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, FALSE, comp_data, Irp, rollback, compression, end_data - start_data, FALSE, 0)) {
-                if (compression != BTRFS_COMPRESSION_NONE)
-                    ExFreePool(comp_data);
-
+            if (insert_extent_chunk(fcb->Vcb, fcb, c, start_data, comp_length, FALSE, comp_data, Irp, rollback, compression, end_data - start_data, FALSE, 0))
                 return STATUS_SUCCESS;
-            }
         }
 
         ExReleaseResourceLite(&c->lock);
     }
 
-    WARN("couldn't find any data chunks with %llx bytes free\n", comp_length);
-
-    if (compression != BTRFS_COMPRESSION_NONE)
-        ExFreePool(comp_data);
+    WARN("couldn't find any data chunks with %x bytes free\n", comp_length);
 
     return STATUS_DISK_FULL;
 }
 
-NTSTATUS write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end_data, void* data, BOOL* compressed, PIRP Irp, LIST_ENTRY* rollback) {
+UINT8 get_compression_type(fcb* fcb) {
     UINT8 type;
 
     if (fcb->Vcb->options.compress_type != 0 && fcb->prop_compression == PropCompression_None)
         type = fcb->Vcb->options.compress_type;
     else {
-        if (!(fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO) && fcb->prop_compression == PropCompression_LZO) {
+        if (fcb->prop_compression == PropCompression_ZSTD)
+            type = BTRFS_COMPRESSION_ZSTD;
+        else if (!(fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO) && fcb->prop_compression == PropCompression_LZO) {
             fcb->Vcb->superblock.incompat_flags |= BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO;
             type = BTRFS_COMPRESSION_LZO;
         } else if (fcb->Vcb->superblock.incompat_flags & BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO && fcb->prop_compression != PropCompression_Zlib)
@@ -921,9 +964,10 @@ NTSTATUS write_compressed_bit(fcb* fcb, UINT64 start_data, UINT64 end_data, void
             type = BTRFS_COMPRESSION_ZLIB;
     }
 
-    if (type == BTRFS_COMPRESSION_LZO) {
+    if (type == BTRFS_COMPRESSION_LZO)
         fcb->Vcb->superblock.incompat_flags |= BTRFS_INCOMPAT_FLAGS_COMPRESS_LZO;
-        return lzo_write_compressed_bit(fcb, start_data, end_data, data, compressed, Irp, rollback);
-    } else
-        return zlib_write_compressed_bit(fcb, start_data, end_data, data, compressed, Irp, rollback);
+    else if (type == BTRFS_COMPRESSION_ZSTD)
+        fcb->Vcb->superblock.incompat_flags |= BTRFS_INCOMPAT_FLAGS_COMPRESS_ZSTD;
+
+    return type;
 }
@@ -16,11 +16,11 @@
  * along with WinBtrfs.  If not, see <http://www.gnu.org/licenses/>. */
 
 #include <windef.h>
-#ifndef __REACTOS__
-#include <smmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 extern BOOL have_sse42;
-#endif /* __REACTOS__ */
 
 static const UINT32 crctable[] = {
     0x00000000, 0xf26b8303, 0xe13b70f7, 0x1350f3f4, 0xc79a971f, 0x35f1141c, 0x26a1e7e8, 0xd4ca64eb,
@@ -57,75 +57,242 @@ static const UINT32 crctable[] = {
     0x79b737ba, 0x8bdcb4b9, 0x988c474d, 0x6ae7c44e, 0xbe2da0a5, 0x4c4623a6, 0x5f16d052, 0xad7d5351,
 };
 
-#ifndef __REACTOS__
-// HW code taken from https://github.com/rurban/smhasher/blob/master/crc32_hw.c
-#define ALIGN_SIZE      0x08UL
-#define ALIGN_MASK      (ALIGN_SIZE - 1)
-#define CALC_CRC(op, crc, type, buf, len)                               \
-  do {                                                                  \
-    for (; (len) >= sizeof (type); (len) -= sizeof(type), buf += sizeof (type)) { \
-      (crc) = op((crc), *(type *) (buf));                               \
-    }                                                                   \
-  } while(0)
-
-static UINT32 crc32c_hw(const void *input, ULONG len, UINT32 crc) {
-    const char* buf = (const char*)input;
-
-    // Annoyingly, the CRC32 intrinsics don't work properly in modern versions of MSVC -
-    // it compiles _mm_crc32_u8 as if it was _mm_crc32_u32. And because we're apparently
-    // not allowed to use inline asm on amd64, there's no easy way to fix this!
-
-    for (; (len > 0) && ((size_t)buf & ALIGN_MASK); len--, buf++) {
-#ifdef _MSC_VER
+// Tables for the slicing-by-8 software path, crc32c_slice[0] being crctable itself
+static UINT32 crc32c_slice[8][256];
+
+static UINT32 crc32c_sw(_In_ UINT32 crc, _In_reads_bytes_(len) const UINT8* buf, _In_ ULONG len) {
+    UINT32 lo, hi;
+
+    for (; len > 0 && ((ULONG_PTR)buf & 7); len--, buf++) {
         crc = crctable[(crc ^ *buf) & 0xff] ^ (crc >> 8);
-#else
-        crc = _mm_crc32_u8(crc, *buf);
-#endif
     }
 
-#ifdef _AMD64_
+    // Process eight bytes at a time, one table lookup per byte but no dependency between them
+    for (; len >= 8; len -= 8, buf += 8) {
+        lo = *(const UINT32*)buf ^ crc;
+        hi = *(const UINT32*)(buf + 4);
+
+        crc = crc32c_slice[7][lo & 0xff] ^ crc32c_slice[6][(lo >> 8) & 0xff] ^
+              crc32c_slice[5][(lo >> 16) & 0xff] ^ crc32c_slice[4][lo >> 24] ^
+              crc32c_slice[3][hi & 0xff] ^ crc32c_slice[2][(hi >> 8) & 0xff] ^
+              crc32c_slice[1][(hi >> 16) & 0xff] ^ crc32c_slice[0][hi >> 24];
+    }
+
+    for (; len > 0; len--, buf++) {
+        crc = crctable[(crc ^ *buf) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+#if defined(_X86_) || defined(_AMD64_)
+// The SSE4.2 crc32 instruction only works on general purpose registers, so unlike
+// the rest of SSE, it can be used in the kernel without saving the FPU state.
+
 #ifdef _MSC_VER
-#pragma warning(push)
-#pragma warning(disable:4244) // _mm_crc32_u64 wants to return UINT64(!)
-#pragma warning(disable:4242)
+unsigned int _mm_crc32_u32(unsigned int crc, unsigned int v);
+#ifdef _AMD64_
+unsigned __int64 _mm_crc32_u64(unsigned __int64 crc, unsigned __int64 v);
 #endif
-    CALC_CRC(_mm_crc32_u64, crc, UINT64, buf, len);
-#ifdef _MSC_VER
-#pragma warning(pop)
+
+// Annoyingly, the CRC32 intrinsics don't work properly in modern versions of MSVC -
+// it compiles _mm_crc32_u8 as if it was _mm_crc32_u32. And because we're apparently
+// not allowed to use inline asm on amd64, there's no easy way to fix this!
+#define crc32c_u8(crc, v) (crctable[((crc) ^ (v)) & 0xff] ^ ((crc) >> 8))
+#define crc32c_u32(crc, v) _mm_crc32_u32(crc, v)
+#ifdef _AMD64_
+#define crc32c_u64(crc, v) _mm_crc32_u64(crc, v)
+#endif
+#else
+static __inline UINT32 crc32c_u8(UINT32 crc, UINT8 v) {
+    __asm__("crc32b %1, %0" : "+r" (crc) : "rm" (v));
+    return crc;
+}
+
+static __inline UINT32 crc32c_u32(UINT32 crc, UINT32 v) {
+    __asm__("crc32l %1, %0" : "+r" (crc) : "rm" (v));
+    return crc;
+}
+
+#ifdef _AMD64_
+static __inline UINT64 crc32c_u64(UINT64 crc, UINT64 v) {
+    __asm__("crc32q %1, %0" : "+r" (crc) : "rm" (v));
+    return crc;
+}
 #endif
 #endif
-    CALC_CRC(_mm_crc32_u32, crc, UINT32, buf, len);
 
-#ifdef _MSC_VER
-    for (; len > 0; len--, buf++) {
-        crc = crctable[(crc ^ *buf) & 0xff] ^ (crc >> 8);
-    }
+// Process a machine word at a time
+#ifdef _AMD64_
+typedef UINT64 crc32c_word;
+#define crc32c_step(crc, buf) (UINT32)crc32c_u64(crc, *(const UINT64*)(buf))
 #else
-    CALC_CRC(_mm_crc32_u16, crc, UINT16, buf, len);
-    CALC_CRC(_mm_crc32_u8, crc, UINT8, buf, len);
+typedef UINT32 crc32c_word;
+#define crc32c_step(crc, buf) crc32c_u32(crc, *(const UINT32*)(buf))
 #endif
 
+// The crc32 instruction has a latency of three cycles but a throughput of one, so we
+// checksum three adjacent blocks in parallel and combine the results afterwards.
+// Combining means "appending" zeroes to a CRC, which is done with the tables below,
+// built by init_crc32c for these two (power of two) block sizes.
+#define CRC32C_LONG     8192
+#define CRC32C_SHORT    256
+
+static UINT32 crc32c_long[4][256];
+static UINT32 crc32c_short[4][256];
+
+static __inline UINT32 crc32c_shift(UINT32 zeros[][256], UINT32 crc) {
+    return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^ zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+static UINT32 crc32c_hw_serial(_In_ UINT32 crc, _In_reads_bytes_(len) const UINT8* buf, _In_ ULONG len) {
+    for (; len > 0 && ((ULONG_PTR)buf & (sizeof(crc32c_word) - 1)); len--, buf++) {
+        crc = crc32c_u8(crc, *buf);
+    }
+
+    for (; len >= sizeof(crc32c_word); len -= sizeof(crc32c_word), buf += sizeof(crc32c_word)) {
+        crc = crc32c_step(crc, buf);
+    }
+
+    for (; len > 0; len--, buf++) {
+        crc = crc32c_u8(crc, *buf);
+    }
+
     return crc;
 }
-#endif
 
-UINT32 calc_crc32c(_In_ UINT32 seed, _In_reads_bytes_(msglen) UINT8* msg, _In_ ULONG msglen) {
-    UINT32 rem;
-    ULONG i;
+static UINT32 crc32c_hw_blocks(_In_ UINT32 crc, _Inout_ const UINT8** pbuf, _Inout_ ULONG* plen, _In_ ULONG block, _In_ UINT32 zeros[][256]) {
+    const UINT8* buf = *pbuf;
+    const UINT8* end;
+    ULONG len = *plen;
+    UINT32 crc1, crc2;
 
-#ifndef __REACTOS__
-    if (have_sse42) {
-        return crc32c_hw(msg, msglen, seed);
-    } else {
+    while (len >= block * 3) {
+        crc1 = crc2 = 0;
+        end = buf + block;
+
+        do {
+            crc = crc32c_step(crc, buf);
+            crc1 = crc32c_step(crc1, buf + block);
+            crc2 = crc32c_step(crc2, buf + (block * 2));
+            buf += sizeof(crc32c_word);
+        } while (buf < end);
+
+        crc = crc32c_shift(zeros, crc) ^ crc1;
+        crc = crc32c_shift(zeros, crc) ^ crc2;
+
+        buf += block * 2;
+        len -= block * 3;
+    }
+
+    *pbuf = buf;
+    *plen = len;
+
+    return crc;
+}
+
+static UINT32 crc32c_hw(_In_ UINT32 crc, _In_reads_bytes_(len) const UINT8* buf, _In_ ULONG len) {
+    for (; len > 0 && ((ULONG_PTR)buf & (sizeof(crc32c_word) - 1)); len--, buf++) {
+        crc = crc32c_u8(crc, *buf);
+    }
+
+    crc = crc32c_hw_blocks(crc, &buf, &len, CRC32C_LONG, crc32c_long);
+    crc = crc32c_hw_blocks(crc, &buf, &len, CRC32C_SHORT, crc32c_short);
+
+    return crc32c_hw_serial(crc, buf, len);
+}
+
+static UINT32 gf2_matrix_times(const UINT32* mat, UINT32 vec) {
+    UINT32 sum = 0;
+
+    while (vec) {
+        if (vec & 1)
+            sum ^= *mat;
+
+        vec >>= 1;
+        mat++;
+    }
+
+    return sum;
+}
+
+static void gf2_matrix_square(UINT32* square, const UINT32* mat) {
+    unsigned int n;
+
+    for (n = 0; n < 32; n++) {
+        square[n] = gf2_matrix_times(mat, mat[n]);
+    }
+}
+
+// Build the operator appending len zero bytes to a CRC, len being a power of two
+static void crc32c_zeros(UINT32 zeros[][256], ULONG len) {
+    UINT32 even[32], odd[32], row;
+    unsigned int n;
+
+    // Operator for one zero bit
+    odd[0] = crctable[128];
+    row = 1;
+    for (n = 1; n < 32; n++) {
+        odd[n] = row;
+        row <<= 1;
+    }
+
+    // Two, then four zero bits
+    gf2_matrix_square(even, odd);
+    gf2_matrix_square(odd, even);
+
+    // Each square doubles the amount of zeroes, starting at one byte
+    for (;;) {
+        gf2_matrix_square(even, odd);
+        len >>= 1;
+        if (len == 0) {
+            for (n = 0; n < 32; n++) {
+                odd[n] = even[n];
+            }
+            break;
+        }
+
+        gf2_matrix_square(odd, even);
+        len >>= 1;
+        if (len == 0)
+            break;
+    }
+
+    for (n = 0; n < 256; n++) {
+        zeros[0][n] = gf2_matrix_times(odd, n);
+        zeros[1][n] = gf2_matrix_times(odd, n << 8);
+        zeros[2][n] = gf2_matrix_times(odd, n << 16);
+        zeros[3][n] = gf2_matrix_times(odd, n << 24);
+    }
+}
 #endif
-        rem = seed;
 
-        for (i = 0; i < msglen; i++) {
-            rem = crctable[(rem ^ msg[i]) & 0xff] ^ (rem >> 8);
+void init_crc32c() {
+    unsigned int i, j;
+
+    for (i = 0; i < 256; i++) {
+        crc32c_slice[0][i] = crctable[i];
+    }
+
+    for (j = 1; j < 8; j++) {
+        for (i = 0; i < 256; i++) {
+            crc32c_slice[j][i] = (crc32c_slice[j - 1][i] >> 8) ^ crctable[crc32c_slice[j - 1][i] & 0xff];
         }
-#ifndef __REACTOS__
     }
+
+#if defined(_X86_) || defined(_AMD64_)
+    if (have_sse42) {
+        crc32c_zeros(crc32c_long, CRC32C_LONG);
+        crc32c_zeros(crc32c_short, CRC32C_SHORT);
+    }
+#endif
+}
+
+UINT32 calc_crc32c(_In_ UINT32 seed, _In_reads_bytes_(msglen) UINT8* msg, _In_ ULONG msglen) {
+#if defined(_X86_) || defined(_AMD64_)
+    if (have_sse42)
+        return crc32c_hw(seed, msg, msglen);
 #endif
 
-    return rem;
+    return crc32c_sw(seed, msg, msglen);
 }
@@ -1213,6 +1213,7 @@ static NTSTATUS get_inode_info(PFILE_OBJECT FileObject, void* data, ULONG length
     bii->disk_size[0] = 0;
     bii->disk_size[1] = 0;
     bii->disk_size[2] = 0;
+    bii->disk_size_zstd = 0;
 
     if (fcb->type != BTRFS_TYPE_DIRECTORY) {
         LIST_ENTRY* le;
@@ -1235,6 +1236,8 @@ static NTSTATUS get_inode_info(PFILE_OBJECT FileObject, void* data, ULONG length
                             bii->disk_size[1] += ed2->size;
                         } else if (ext->extent_data.compression == BTRFS_COMPRESSION_LZO) {
                             bii->disk_size[2] += ed2->size;
+                        } else if (ext->extent_data.compression == BTRFS_COMPRESSION_ZSTD) {
+                            bii->disk_size_zstd += ed2->size;
                         }
                     }
                 }
@@ -1253,6 +1256,10 @@ static NTSTATUS get_inode_info(PFILE_OBJECT FileObject, void* data, ULONG length
             bii->compression_type = BTRFS_COMPRESSION_LZO;
         break;
 
+        case PropCompression_ZSTD:
+            bii->compression_type = BTRFS_COMPRESSION_ZSTD;
+        break;
+
         default:
             bii->compression_type = BTRFS_COMPRESSION_ANY;
         break;
@@ -1295,7 +1302,7 @@ static NTSTATUS set_inode_info(PFILE_OBJECT FileObject, void* data, ULONG length
         return STATUS_ACCESS_DENIED;
     }
 
-    if (bsii->compression_type_changed && bsii->compression_type > BTRFS_COMPRESSION_LZO)
+    if (bsii->compression_type_changed && bsii->compression_type > BTRFS_COMPRESSION_ZSTD)
         return STATUS_INVALID_PARAMETER;
 
     if (fcb->ads)
@@ -1358,6 +1365,10 @@ static NTSTATUS set_inode_info(PFILE_OBJECT FileObject, void* data, ULONG length
             case BTRFS_COMPRESSION_LZO:
                 fcb->prop_compression = PropCompression_LZO;
             break;
+
+            case BTRFS_COMPRESSION_ZSTD:
+                fcb->prop_compression = PropCompression_ZSTD;
+            break;
         }
 
         fcb->prop_compression_changed = TRUE;
@@ -4313,11 +4324,14 @@ static NTSTATUS fsctl_set_xattr(device_extension* Vcb, PFILE_OBJECT FileObject,
     } else if (bsxa->namelen == strlen(EA_PROP_COMPRESSION) && RtlCompareMemory(bsxa->data, EA_PROP_COMPRESSION, strlen(EA_PROP_COMPRESSION)) == strlen(EA_PROP_COMPRESSION)) {
         const char lzo[] = "lzo";
         const char zlib[] = "zlib";
+        const char zstd[] = "zstd";
 
         if (bsxa->valuelen == strlen(lzo) && RtlCompareMemory(bsxa->data + bsxa->namelen, lzo, bsxa->valuelen) == bsxa->valuelen)
             fcb->prop_compression = PropCompression_LZO;
         else if (bsxa->valuelen == strlen(zlib) && RtlCompareMemory(bsxa->data + bsxa->namelen, zlib, bsxa->valuelen) == bsxa->valuelen)
             fcb->prop_compression = PropCompression_Zlib;
+        else if (bsxa->valuelen == strlen(zstd) && RtlCompareMemory(bsxa->data + bsxa->namelen, zstd, bsxa->valuelen) == bsxa->valuelen)
+            fcb->prop_compression = PropCompression_ZSTD;
         else
             fcb->prop_compression = PropCompression_None;
 
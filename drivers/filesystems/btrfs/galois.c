@@ -15,7 +15,9 @@
  * You should have received a copy of the GNU Lesser General Public Licence
  * along with WinBtrfs.  If not, see <http://www.gnu.org/licenses/>. */
 
-#include "btrfs_drv.h"
+#include <windef.h>
+
+extern BOOL have_ssse3;
 
 static const UINT8 glog[] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1d, 0x3a, 0x74, 0xe8, 0xcd, 0x87, 0x13, 0x26,
                              0x4c, 0x98, 0x2d, 0x5a, 0xb4, 0x75, 0xea, 0xc9, 0x8f, 0x03, 0x06, 0x0c, 0x18, 0x30, 0x60, 0xc0,
@@ -51,21 +53,6 @@ static const UINT8 gilog[] = {0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1a, 0xc6, 0x
                               0xcb, 0x59, 0x5f, 0xb0, 0x9c, 0xa9, 0xa0, 0x51, 0x0b, 0xf5, 0x16, 0xeb, 0x7a, 0x75, 0x2c, 0xd7,
                               0x4f, 0xae, 0xd5, 0xe9, 0xe6, 0xe7, 0xad, 0xe8, 0x74, 0xd6, 0xf4, 0xea, 0xa8, 0x50, 0x58, 0xaf};
 
-// divides the bytes in data by 2^div
-void galois_divpower(UINT8* data, UINT8 div, UINT32 len) {
-    while (len > 0) {
-        if (data[0] != 0) {
-            if (gilog[data[0]] <= div)
-                data[0] = glog[(gilog[data[0]] + (255 - div)) % 255];
-            else
-                data[0] = glog[(gilog[data[0]] - div) % 255];
-        }
-
-        data++;
-        len--;
-    }
-}
-
 UINT8 gpow2(UINT8 e) {
     return glog[e%255];
 }
@@ -94,6 +81,98 @@ UINT8 gdiv(UINT8 a, UINT8 b) {
 // "The mathematics of RAID-6", by H. Peter Anvin.
 // https://www.kernel.org/pub/linux/kernel/people/hpa/raid6.pdf
 
+// Multiplying by a constant c is linear, so c*x = c*(x & 0xf) ^ c*(x & 0xf0). Each half only
+// has 16 possible values, which means the products fit in two 16-byte tables - small enough
+// for a pshufb to do sixteen lookups at once.
+typedef struct {
+    UINT8 lo[16];
+    UINT8 hi[16];
+} galois_mul_table;
+
+static void galois_init_mul_table(galois_mul_table* t, UINT8 c) {
+    unsigned int i;
+
+    for (i = 0; i < 16; i++) {
+        t->lo[i] = gmul(c, (UINT8)i);
+        t->hi[i] = gmul(c, (UINT8)(i << 4));
+    }
+}
+
+static __inline UINT8 galois_mul_byte(const galois_mul_table* t, UINT8 x) {
+    return t->lo[x & 0xf] ^ t->hi[x >> 4];
+}
+
+#if defined(_AMD64_) && defined(__GNUC__)
+// SSE2 is part of x64, and the volatile XMM registers are saved on interrupts, so the kernel can
+// use them freely. This isn't true on x86, where we'd have to save the FPU state first.
+#define GALOIS_SSE
+
+typedef char v16qi __attribute__((vector_size(16)));
+typedef unsigned char v16qu __attribute__((vector_size(16)));
+typedef v16qu v16qu_u __attribute__((aligned(1), may_alias));
+
+static __inline v16qu galois_double_sse2(v16qu v) {
+    v16qu mask = (v16qu)((v16qi)v < (v16qi){0});
+
+    return (v + v) ^ (mask & 0x1d);
+}
+
+static UINT32 galois_double_xor_sse2(UINT8* data, UINT8* xor_data, UINT32 len) {
+    UINT32 done = 0;
+
+    while (len - done >= 16) {
+        v16qu v = galois_double_sse2(*(v16qu_u*)(data + done));
+
+        if (xor_data)
+            v ^= *(v16qu_u*)(xor_data + done);
+
+        *(v16qu_u*)(data + done) = v;
+        done += 16;
+    }
+
+    return done;
+}
+
+__attribute__((target("ssse3")))
+static __inline v16qu galois_mul_ssse3(v16qu tlo, v16qu thi, v16qu v) {
+    v16qu l = v & 0xf;
+    v16qu h = (v >> 4) & 0xf;
+
+    return (v16qu)__builtin_ia32_pshufb128((v16qi)tlo, (v16qi)l) ^ (v16qu)__builtin_ia32_pshufb128((v16qi)thi, (v16qi)h);
+}
+
+__attribute__((target("ssse3")))
+static UINT32 galois_mul_region_ssse3(UINT8* data, const galois_mul_table* t, UINT32 len) {
+    v16qu tlo = *(v16qu_u*)t->lo, thi = *(v16qu_u*)t->hi;
+    UINT32 done = 0;
+
+    while (len - done >= 16) {
+        *(v16qu_u*)(data + done) = galois_mul_ssse3(tlo, thi, *(v16qu_u*)(data + done));
+        done += 16;
+    }
+
+    return done;
+}
+
+__attribute__((target("ssse3")))
+static UINT32 galois_recover_ssse3(UINT8* qxy, UINT8* pxy, const UINT8* p, const UINT8* q, const galois_mul_table* ta,
+                                   const galois_mul_table* tb, UINT32 len) {
+    v16qu talo = *(v16qu_u*)ta->lo, tahi = *(v16qu_u*)ta->hi;
+    v16qu tblo = *(v16qu_u*)tb->lo, tbhi = *(v16qu_u*)tb->hi;
+    UINT32 done = 0;
+
+    while (len - done >= 16) {
+        v16qu pp = *(v16qu_u*)(p + done) ^ *(v16qu_u*)(pxy + done);
+        v16qu qq = *(v16qu_u*)(q + done) ^ *(v16qu_u*)(qxy + done);
+
+        *(v16qu_u*)(qxy + done) = galois_mul_ssse3(talo, tahi, pp) ^ galois_mul_ssse3(tblo, tbhi, qq);
+        done += 16;
+    }
+
+    return done;
+}
+#endif
+
 #ifdef _AMD64_
 __inline static UINT64 galois_double_mask64(UINT64 v) {
     v &= 0x8080808080808080;
@@ -106,26 +185,46 @@ __inline static UINT32 galois_double_mask32(UINT32 v) {
 }
 #endif
 
-void galois_double(UINT8* data, UINT32 len) {
-    // FIXME - SIMD?
+// data = (2 * data) ^ xor_data, or just 2 * data if xor_data is NULL
+static void galois_double_xor_int(UINT8* data, UINT8* xor_data, UINT32 len) {
+#ifdef GALOIS_SSE
+    UINT32 done = galois_double_xor_sse2(data, xor_data, len);
+
+    data += done;
+    if (xor_data)
+        xor_data += done;
+    len -= done;
+#endif
 
 #ifdef _AMD64_
-    while (len > sizeof(UINT64)) {
+    while (len >= sizeof(UINT64)) {
         UINT64 v = *((UINT64*)data), vv;
 
         vv = (v << 1) & 0xfefefefefefefefe;
         vv ^= galois_double_mask64(v) & 0x1d1d1d1d1d1d1d1d;
+
+        if (xor_data) {
+            vv ^= *((UINT64*)xor_data);
+            xor_data += sizeof(UINT64);
+        }
+
         *((UINT64*)data) = vv;
 
         data += sizeof(UINT64);
         len -= sizeof(UINT64);
     }
 #else
-    while (len > sizeof(UINT32)) {
+    while (len >= sizeof(UINT32)) {
         UINT32 v = *((UINT32*)data), vv;
 
         vv = (v << 1) & 0xfefefefe;
         vv ^= galois_double_mask32(v) & 0x1d1d1d1d;
+
+        if (xor_data) {
+            vv ^= *((UINT32*)xor_data);
+            xor_data += sizeof(UINT32);
+        }
+
         *((UINT32*)data) = vv;
 
         data += sizeof(UINT32);
@@ -135,7 +234,80 @@ void galois_double(UINT8* data, UINT32 len) {
 
     while (len > 0) {
         data[0] = (data[0] << 1) ^ ((data[0] & 0x80) ? 0x1d : 0);
+
+        if (xor_data) {
+            data[0] ^= xor_data[0];
+            xor_data++;
+        }
+
         data++;
         len--;
     }
 }
+
+void galois_double(UINT8* data, UINT32 len) {
+    galois_double_xor_int(data, NULL, len);
+}
+
+// One step of Horner's method for the Q syndrome, i.e. Q = 2Q + D
+void galois_double_xor(UINT8* data, UINT8* xor_data, UINT32 len) {
+    galois_double_xor_int(data, xor_data, len);
+}
+
+// multiplies the bytes in data by c
+void galois_mul(UINT8* data, UINT8 c, UINT32 len) {
+    galois_mul_table t;
+
+    galois_init_mul_table(&t, c);
+
+#ifdef GALOIS_SSE
+    if (have_ssse3) {
+        UINT32 done = galois_mul_region_ssse3(data, &t, len);
+
+        data += done;
+        len -= done;
+    }
+#endif
+
+    while (len > 0) {
+        data[0] = galois_mul_byte(&t, data[0]);
+
+        data++;
+        len--;
+    }
+}
+
+// divides the bytes in data by 2^div
+void galois_divpower(UINT8* data, UINT8 div, UINT32 len) {
+    galois_mul(data, gpow2(255 - (div % 255)), len);
+}
+
+// The last step of recovering two data stripes from P and Q: qxy = a(P + Pxy) + b(Q + Qxy)
+void galois_recover(UINT8* qxy, UINT8* pxy, UINT8* p, UINT8* q, UINT8 a, UINT8 b, UINT32 len) {
+    galois_mul_table ta, tb;
+
+    galois_init_mul_table(&ta, a);
+    galois_init_mul_table(&tb, b);
+
+#ifdef GALOIS_SSE
+    if (have_ssse3) {
+        UINT32 done = galois_recover_ssse3(qxy, pxy, p, q, &ta, &tb, len);
+
+        qxy += done;
+        pxy += done;
+        p += done;
+        q += done;
+        len -= done;
+    }
+#endif
+
+    while (len > 0) {
+        *qxy = galois_mul_byte(&ta, *p ^ *pxy) ^ galois_mul_byte(&tb, *q ^ *qxy);
+
+        p++;
+        q++;
+        pxy++;
+        qxy++;
+        len--;
+    }
+}
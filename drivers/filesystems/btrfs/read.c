@@ -874,10 +874,10 @@ void raid6_recover2(UINT8* sectors, UINT16 num_stripes, ULONG sector_size, UINT1
         do {
             stripe--;
 
-            galois_double(out, sector_size);
-
             if (stripe != missing)
-                do_xor(out, sectors + (stripe * sector_size), sector_size);
+                galois_double_xor(out, sectors + (stripe * sector_size), sector_size);
+            else
+                galois_double(out, sector_size);
         } while (stripe > 0);
 
         do_xor(out, sectors + ((num_stripes - 1) * sector_size), sector_size);
@@ -887,7 +887,6 @@ void raid6_recover2(UINT8* sectors, UINT16 num_stripes, ULONG sector_size, UINT1
     } else { // reconstruct from p and q
         UINT16 x, y, stripe;
         UINT8 gyx, gx, denom, a, b, *p, *q, *pxy, *qxy;
-        UINT32 j;
 
         stripe = num_stripes - 3;
 
@@ -910,15 +909,17 @@ void raid6_recover2(UINT8* sectors, UINT16 num_stripes, ULONG sector_size, UINT1
         do {
             stripe--;
 
-            galois_double(qxy, sector_size);
-
             if (stripe != missing1 && stripe != missing2) {
-                do_xor(qxy, sectors + (stripe * sector_size), sector_size);
+                galois_double_xor(qxy, sectors + (stripe * sector_size), sector_size);
                 do_xor(pxy, sectors + (stripe * sector_size), sector_size);
-            } else if (stripe == missing1)
-                x = stripe;
-            else if (stripe == missing2)
-                y = stripe;
+            } else {
+                galois_double(qxy, sector_size);
+
+                if (stripe == missing1)
+                    x = stripe;
+                else
+                    y = stripe;
+            }
         } while (stripe > 0);
 
         gyx = gpow2(y > x ? (y-x) : (255-x+y));
@@ -931,14 +932,7 @@ void raid6_recover2(UINT8* sectors, UINT16 num_stripes, ULONG sector_size, UINT1
         p = sectors + ((num_stripes - 2) * sector_size);
         q = sectors + ((num_stripes - 1) * sector_size);
 
-        for (j = 0; j < sector_size; j++) {
-            *qxy = gmul(a, *p ^ *pxy) ^ gmul(b, *q ^ *qxy);
-
-            p++;
-            q++;
-            pxy++;
-            qxy++;
-        }
+        galois_recover(qxy, pxy, p, q, a, b, sector_size);
 
         do_xor(out + sector_size, out, sector_size);
         do_xor(out + sector_size, sectors + ((num_stripes - 2) * sector_size), sector_size);
@@ -2787,7 +2781,7 @@ NTSTATUS read_file(fcb* fcb, UINT8* data, UINT64 start, UINT64 length, ULONG* pb
                         read = (UINT32)min(min(len, ext->datalen) - off, length);
 
                         RtlCopyMemory(data + bytes_read, &ed->data[off], read);
-                    } else if (ed->compression == BTRFS_COMPRESSION_ZLIB || ed->compression == BTRFS_COMPRESSION_LZO) {
+                    } else if (ed->compression == BTRFS_COMPRESSION_ZLIB || ed->compression == BTRFS_COMPRESSION_LZO || ed->compression == BTRFS_COMPRESSION_ZSTD) {
                         UINT8* decomp;
                         BOOL decomp_alloc;
                         UINT16 inlen = ext->datalen - (UINT16)offsetof(EXTENT_DATA, data[0]);
@@ -2836,6 +2830,13 @@ NTSTATUS read_file(fcb* fcb, UINT8* data, UINT64 start, UINT64 length, ULONG* pb
                                 if (decomp_alloc) ExFreePool(decomp);
                                 goto exit;
                             }
+                        } else if (ed->compression == BTRFS_COMPRESSION_ZSTD) {
+                            Status = zstd_decompress(ed->data, inlen, decomp, (UINT32)(read + off));
+                            if (!NT_SUCCESS(Status)) {
+                                ERR("zstd_decompress returned %08x\n", Status);
+                                if (decomp_alloc) ExFreePool(decomp);
+                                goto exit;
+                            }
                         }
 
                         if (decomp_alloc) {
@@ -3002,6 +3003,18 @@ NTSTATUS read_file(fcb* fcb, UINT8* data, UINT64 start, UINT64 length, ULONG* pb
                                 ERR("lzo_decompress returned %08x\n", Status);
                                 ExFreePool(buf);
 
+                                if (decomp)
+                                    ExFreePool(decomp);
+
+                                goto exit;
+                            }
+                        } else if (ed->compression == BTRFS_COMPRESSION_ZSTD) {
+                            Status = zstd_decompress(buf2, inlen, decomp ? decomp : (data + bytes_read), outlen);
+
+                            if (!NT_SUCCESS(Status)) {
+                                ERR("zstd_decompress returned %08x\n", Status);
+                                ExFreePool(buf);
+
                                 if (decomp)
                                     ExFreePool(decomp);
 
@@ -1994,8 +1994,7 @@ static void scrub_raid6_stripe(device_extension* Vcb, chunk* c, scrub_context_ra
         stripe = parity1 == 0 ? (c->chunk_item->num_stripes - 1) : (parity1 - 1);
 
         while (stripe != parity2) {
-            galois_double(context->parity_scratch2, (UINT32)c->chunk_item->stripe_length);
-            do_xor(context->parity_scratch2, &context->stripes[stripe].buf[num * c->chunk_item->stripe_length], (UINT32)c->chunk_item->stripe_length);
+            galois_double_xor(context->parity_scratch2, &context->stripes[stripe].buf[num * c->chunk_item->stripe_length], (UINT32)c->chunk_item->stripe_length);
 
             stripe = stripe == 0 ? (c->chunk_item->num_stripes - 1) : (stripe - 1);
         }
@@ -2101,12 +2100,12 @@ static void scrub_raid6_stripe(device_extension* Vcb, chunk* c, scrub_context_ra
             if (c->devices[parity2]->devobj) {
                 stripe_num = c->chunk_item->num_stripes - 3;
                 while (stripe != parity2) {
-                    galois_double(scratch, len);
-
                     if (stripe != bad_stripe1)
-                        do_xor(scratch, &context->stripes[stripe].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)], len);
-                    else
+                        galois_double_xor(scratch, &context->stripes[stripe].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)], len);
+                    else {
+                        galois_double(scratch, len);
                         bad_stripe_num = stripe_num;
+                    }
 
                     stripe = stripe == 0 ? (c->chunk_item->num_stripes - 1) : (stripe - 1);
                     stripe_num--;
@@ -2177,11 +2176,9 @@ static void scrub_raid6_stripe(device_extension* Vcb, chunk* c, scrub_context_ra
                                 stripe = stripe == 0 ? (c->chunk_item->num_stripes - 1) : (stripe - 1);
 
                                 while (stripe != parity2) {
-                                    galois_double(&context->stripes[parity2].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)], Vcb->superblock.node_size);
-
-                                    do_xor(&context->stripes[parity2].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)],
-                                        &context->stripes[stripe].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)],
-                                        Vcb->superblock.node_size);
+                                    galois_double_xor(&context->stripes[parity2].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)],
+                                                      &context->stripes[stripe].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)],
+                                                      Vcb->superblock.node_size);
 
                                     stripe = stripe == 0 ? (c->chunk_item->num_stripes - 1) : (stripe - 1);
                                 }
@@ -2281,7 +2278,6 @@ static void scrub_raid6_stripe(device_extension* Vcb, chunk* c, scrub_context_ra
             UINT64 addr;
             UINT32 len = (RtlCheckBit(&context->is_tree, bad_off1) || RtlCheckBit(&context->is_tree, bad_off2)) ? Vcb->superblock.node_size : Vcb->superblock.sector_size;
             UINT8 gyx, gx, denom, a, b, *p, *q, *pxy, *qxy;
-            UINT32 j;
 
             stripe = parity1 == 0 ? (c->chunk_item->num_stripes - 1) : (parity1 - 1);
 
@@ -2308,17 +2304,19 @@ static void scrub_raid6_stripe(device_extension* Vcb, chunk* c, scrub_context_ra
 
             k--;
             do {
-                galois_double(&context->parity_scratch[i * Vcb->superblock.sector_size], len);
-
                 if (stripe != bad_stripe1 && stripe != bad_stripe2) {
-                    do_xor(&context->parity_scratch[i * Vcb->superblock.sector_size],
-                           &context->stripes[stripe].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)], len);
+                    galois_double_xor(&context->parity_scratch[i * Vcb->superblock.sector_size],
+                                      &context->stripes[stripe].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)], len);
                     do_xor(&context->parity_scratch2[i * Vcb->superblock.sector_size],
                            &context->stripes[stripe].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)], len);
-                } else if (stripe == bad_stripe1)
-                    x = k;
-                else if (stripe == bad_stripe2)
-                    y = k;
+                } else {
+                    galois_double(&context->parity_scratch[i * Vcb->superblock.sector_size], len);
+
+                    if (stripe == bad_stripe1)
+                        x = k;
+                    else
+                        y = k;
+                }
 
                 stripe = stripe == 0 ? (c->chunk_item->num_stripes - 1) : (stripe - 1);
                 k--;
@@ -2336,14 +2334,7 @@ static void scrub_raid6_stripe(device_extension* Vcb, chunk* c, scrub_context_ra
             pxy = &context->parity_scratch2[i * Vcb->superblock.sector_size];
             qxy = &context->parity_scratch[i * Vcb->superblock.sector_size];
 
-            for (j = 0; j < len; j++) {
-                *qxy = gmul(a, *p ^ *pxy) ^ gmul(b, *q ^ *qxy);
-
-                p++;
-                q++;
-                pxy++;
-                qxy++;
-            }
+            galois_recover(qxy, pxy, p, q, a, b, len);
 
             do_xor(&context->parity_scratch2[i * Vcb->superblock.sector_size], &context->parity_scratch[i * Vcb->superblock.sector_size], len);
             do_xor(&context->parity_scratch2[i * Vcb->superblock.sector_size], &context->stripes[parity1].buf[(num * c->chunk_item->stripe_length) + (i * Vcb->superblock.sector_size)], len);
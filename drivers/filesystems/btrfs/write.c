@@ -4081,22 +4081,85 @@ nextitem:
     return STATUS_SUCCESS;
 }
 
+// how many extents per calc thread we compress ahead of the one being written
+#define COMPRESS_JOBS_PER_THREAD 2
+
 NTSTATUS write_compressed(fcb* fcb, UINT64 start_data, UINT64 end_data, void* data, PIRP Irp, LIST_ENTRY* rollback) {
     NTSTATUS Status;
-    UINT64 i;
+    UINT8 type;
+    ULONG num_parts, window, queued = 0, collected = 0, i;
+    calc_job** jobs = NULL;
+
+    type = get_compression_type(fcb);
+
+    num_parts = (ULONG)(sector_align(end_data - start_data, COMPRESSED_EXTENT_SIZE) / COMPRESSED_EXTENT_SIZE);
+
+    // Hand the compression of the following extents to the calc threads while we're busy writing out
+    // this one. Not worth it for a single extent, or if there's nobody to share the work with.
+    if (num_parts > 1 && fcb->Vcb->calcthreads.num_threads > 1) {
+        window = min(num_parts, fcb->Vcb->calcthreads.num_threads * COMPRESS_JOBS_PER_THREAD);
+
+        jobs = ExAllocatePoolWithTag(PagedPool, sizeof(calc_job*) * window, ALLOC_TAG);
+        if (!jobs) {
+            ERR("out of memory\n");
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+    } else
+        window = 0;
 
-    for (i = 0; i < sector_align(end_data - start_data, COMPRESSED_EXTENT_SIZE) / COMPRESSED_EXTENT_SIZE; i++) {
+    for (i = 0; i < num_parts; i++) {
         UINT64 s2, e2;
+        UINT8* comp_data;
+        UINT32 comp_length;
         BOOL compressed;
 
         s2 = start_data + (i * COMPRESSED_EXTENT_SIZE);
         e2 = min(s2 + COMPRESSED_EXTENT_SIZE, end_data);
 
-        Status = write_compressed_bit(fcb, s2, e2, (UINT8*)data + (i * COMPRESSED_EXTENT_SIZE), &compressed, Irp, rollback);
+        if (jobs) {
+            calc_job* cj;
+
+            while (queued < num_parts && queued < i + window) {
+                UINT64 s3 = start_data + (queued * COMPRESSED_EXTENT_SIZE);
+                UINT64 e3 = min(s3 + COMPRESSED_EXTENT_SIZE, end_data);
+
+                Status = add_calc_job_comp(fcb->Vcb, type, (UINT8*)data + (queued * COMPRESSED_EXTENT_SIZE), (UINT32)(e3 - s3), &jobs[queued % window]);
+                if (!NT_SUCCESS(Status)) {
+                    ERR("add_calc_job_comp returned %08x\n", Status);
+                    goto end;
+                }
+
+                queued++;
+            }
+
+            cj = jobs[i % window];
+
+            KeWaitForSingleObject(&cj->event, Executive, KernelMode, FALSE, NULL);
+
+            Status = cj->Status;
+            comp_data = cj->out;
+            comp_length = cj->outlen;
+
+            free_calc_job(cj);
+            collected++;
+        } else
+            Status = compress_data(fcb->Vcb, type, (UINT8*)data + (i * COMPRESSED_EXTENT_SIZE), (UINT32)(e2 - s2), &comp_data, &comp_length);
+
+        if (!NT_SUCCESS(Status)) {
+            ERR("compress_data returned %08x\n", Status);
+            goto end;
+        }
+
+        Status = write_compressed_bit(fcb, s2, e2, (UINT8*)data + (i * COMPRESSED_EXTENT_SIZE), type, comp_data, comp_length, Irp, rollback);
+
+        compressed = comp_data ? TRUE : FALSE;
+
+        if (comp_data)
+            ExFreePool(comp_data);
 
         if (!NT_SUCCESS(Status)) {
             ERR("write_compressed_bit returned %08x\n", Status);
-            return Status;
+            goto end;
         }
 
         // If the first 128 KB of a file is incompressible, we set the nocompress flag so we don't
@@ -4112,15 +4175,35 @@ NTSTATUS write_compressed(fcb* fcb, UINT64 start_data, UINT64 end_data, void* da
 
                 if (!NT_SUCCESS(Status)) {
                     ERR("do_write_file returned %08x\n", Status);
-                    return Status;
+                    goto end;
                 }
             }
 
-            return STATUS_SUCCESS;
+            break;
         }
     }
 
-    return STATUS_SUCCESS;
+    Status = STATUS_SUCCESS;
+
+end:
+    if (jobs) {
+        // the calc threads may still be using data, so wait for anything we didn't get round to
+        while (collected < queued) {
+            calc_job* cj = jobs[collected % window];
+
+            KeWaitForSingleObject(&cj->event, Executive, KernelMode, FALSE, NULL);
+
+            if (cj->out)
+                ExFreePool(cj->out);
+
+            free_calc_job(cj);
+            collected++;
+        }
+
+        ExFreePool(jobs);
+    }
+
+    return Status;
 }
 
 NTSTATUS write_file2(device_extension* Vcb, PIRP Irp, LARGE_INTEGER offset, void* buf, ULONG* length, BOOLEAN paging_io, BOOLEAN no_cache,
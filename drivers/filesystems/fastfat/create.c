@@ -116,6 +116,8 @@ FindFile(
     UNICODE_STRING FileToFindUpcase;
     BOOLEAN WildCard;
     BOOLEAN IsFatX = vfatVolumeIsFatX(DeviceExt);
+    PVFAT_DIR_INDEX Index;
+    ULONG DirIndex;
 
     DPRINT("FindFile(Parent %p, FileToFind '%wZ', DirIndex: %u)\n",
            Parent, FileToFindU, DirContext->DirIndex);
@@ -178,6 +180,22 @@ FindFile(
         }
     }
 
+    if (WildCard == FALSE)
+    {
+        /* In a large directory, the name index tells where to start looking, if at all */
+        Index = vfatGetDirIndex(DeviceExt, Parent);
+        if (Index != NULL)
+        {
+            if (!vfatLookupDirIndex(Index, FileToFindU, DirContext->DirIndex, &DirIndex))
+            {
+                ExFreePool(PathNameBuffer);
+                return STATUS_NO_MORE_ENTRIES;
+            }
+            DirContext->DirIndex = DirIndex;
+            First = TRUE;
+        }
+    }
+
     /* FsRtlIsNameInExpression need the searched string to be upcase,
     * even if IgnoreCase is specified */
     Status = RtlUpcaseUnicodeString(&FileToFindUpcase, FileToFindU, TRUE);
@@ -639,6 +639,8 @@ FATAddEntry(
     CcSetDirtyPinnedData(Context, NULL);
     CcUnpinData(Context);
 
+    vfatAddToDirIndex(ParentFcb, &DirContext.LongNameU, &DirContext.ShortNameU, DirContext.DirIndex);
+
     if (MoveContext != NULL)
     {
         /* We're modifying an existing FCB - likely rename/move */
@@ -865,6 +867,8 @@ FATDelEntry(
         }
     }
 
+    vfatRemoveFromDirIndex(pFcb->parentFcb, &pFcb->LongNameU, &pFcb->ShortNameU, pFcb->dirIndex);
+
     /* In case of moving, save properties */
     if (MoveContext != NULL)
     {
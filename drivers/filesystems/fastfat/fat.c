@@ -376,7 +376,8 @@ FAT32FindAndMarkAvailableCluster(
 static
 NTSTATUS
 FAT12CountAvailableClusters(
-    PDEVICE_EXTENSION DeviceExt)
+    PDEVICE_EXTENSION DeviceExt,
+    PRTL_BITMAP Bitmap)
 {
     ULONG Entry;
     PVOID BaseAddress;
@@ -414,6 +415,8 @@ FAT12CountAvailableClusters(
 
         if (Entry == 0)
             ulCount++;
+        else if (Bitmap)
+            RtlSetBit(Bitmap, i - 2);
     }
 
     CcUnpinData(Context);
@@ -430,7 +433,8 @@ FAT12CountAvailableClusters(
 static
 NTSTATUS
 FAT16CountAvailableClusters(
-    PDEVICE_EXTENSION DeviceExt)
+    PDEVICE_EXTENSION DeviceExt,
+    PRTL_BITMAP Bitmap)
 {
     PUSHORT Block;
     PUSHORT BlockEnd;
@@ -465,6 +469,8 @@ FAT16CountAvailableClusters(
         {
             if (*Block == 0)
                 ulCount++;
+            else if (Bitmap)
+                RtlSetBit(Bitmap, i - 2);
             Block++;
             i++;
         }
@@ -485,7 +491,8 @@ FAT16CountAvailableClusters(
 static
 NTSTATUS
 FAT32CountAvailableClusters(
-    PDEVICE_EXTENSION DeviceExt)
+    PDEVICE_EXTENSION DeviceExt,
+    PRTL_BITMAP Bitmap)
 {
     PULONG Block;
     PULONG BlockEnd;
@@ -521,6 +528,8 @@ FAT32CountAvailableClusters(
         {
             if ((*Block & 0x0fffffff) == 0)
                 ulCount++;
+            else if (Bitmap)
+                RtlSetBit(Bitmap, i - 2);
             Block++;
             i++;
         }
@@ -534,6 +543,20 @@ FAT32CountAvailableClusters(
     return STATUS_SUCCESS;
 }
 
+static
+NTSTATUS
+ScanAvailableClusters(
+    PDEVICE_EXTENSION DeviceExt,
+    PRTL_BITMAP Bitmap)
+{
+    if (DeviceExt->FatInfo.FatType == FAT12)
+        return FAT12CountAvailableClusters(DeviceExt, Bitmap);
+    else if (DeviceExt->FatInfo.FatType == FAT16 || DeviceExt->FatInfo.FatType == FATX16)
+        return FAT16CountAvailableClusters(DeviceExt, Bitmap);
+    else
+        return FAT32CountAvailableClusters(DeviceExt, Bitmap);
+}
+
 NTSTATUS
 CountAvailableClusters(
     PDEVICE_EXTENSION DeviceExt,
@@ -543,12 +566,7 @@ CountAvailableClusters(
     ExAcquireResourceExclusiveLite (&DeviceExt->FatResource, TRUE);
     if (!DeviceExt->AvailableClustersValid)
     {
-        if (DeviceExt->FatInfo.FatType == FAT12)
-            Status = FAT12CountAvailableClusters(DeviceExt);
-        else if (DeviceExt->FatInfo.FatType == FAT16 || DeviceExt->FatInfo.FatType == FATX16)
-            Status = FAT16CountAvailableClusters(DeviceExt);
-        else
-            Status = FAT32CountAvailableClusters(DeviceExt);
+        Status = ScanAvailableClusters(DeviceExt, NULL);
     }
     Clusters->QuadPart = DeviceExt->AvailableClusters;
     ExReleaseResourceLite (&DeviceExt->FatResource);
@@ -556,6 +574,111 @@ CountAvailableClusters(
     return Status;
 }
 
+/*
+ * FUNCTION: Builds the in-memory cluster bitmap with a single pass over the
+ *           FAT. Bit n stands for cluster n + 2, like the LCNs reported by
+ *           FSCTL_GET_VOLUME_BITMAP, and is set when the cluster is in use.
+ *           Without the bitmap, the volume keeps working from the FAT alone
+ */
+NTSTATUS
+InitializeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    PULONG Buffer;
+    ULONG Size;
+    NTSTATUS Status;
+
+    Size = ROUND_UP(DeviceExt->FatInfo.NumberOfClusters, 32) / 8;
+    Buffer = ExAllocatePoolWithTag(PagedPool, Size, TAG_VFAT);
+    if (Buffer == NULL)
+    {
+        DPRINT1("No memory for the cluster bitmap (%u bytes)\n", Size);
+        return STATUS_INSUFFICIENT_RESOURCES;
+    }
+
+    ExAcquireResourceExclusiveLite(&DeviceExt->FatResource, TRUE);
+
+    RtlInitializeBitMap(&DeviceExt->ClusterBitmap, Buffer, DeviceExt->FatInfo.NumberOfClusters);
+    RtlClearAllBits(&DeviceExt->ClusterBitmap);
+
+    Status = ScanAvailableClusters(DeviceExt, &DeviceExt->ClusterBitmap);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to build the cluster bitmap (Status %lx)\n", Status);
+        RtlZeroMemory(&DeviceExt->ClusterBitmap, sizeof(RTL_BITMAP));
+        ExFreePoolWithTag(Buffer, TAG_VFAT);
+    }
+
+    ExReleaseResourceLite(&DeviceExt->FatResource);
+
+    return Status;
+}
+
+VOID
+FreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt)
+{
+    if (DeviceExt->ClusterBitmap.Buffer != NULL)
+    {
+        ExFreePoolWithTag(DeviceExt->ClusterBitmap.Buffer, TAG_VFAT);
+        RtlZeroMemory(&DeviceExt->ClusterBitmap, sizeof(RTL_BITMAP));
+    }
+}
+
+/*
+ * FUNCTION: Finds the first available cluster after the last allocated one
+ *           and marks it as end of chain
+ */
+static
+NTSTATUS
+FindAndMarkAvailableCluster(
+    PDEVICE_EXTENSION DeviceExt,
+    PULONG Cluster)
+{
+    ULONG Index;
+    ULONG OldValue;
+    NTSTATUS Status;
+
+    if (DeviceExt->ClusterBitmap.Buffer == NULL)
+        return DeviceExt->FindAndMarkAvailableCluster(DeviceExt, Cluster);
+
+    ASSERT(ExIsResourceAcquiredExclusiveLite(&DeviceExt->FatResource));
+
+    for (;;)
+    {
+        Index = RtlFindClearBits(&DeviceExt->ClusterBitmap, 1, DeviceExt->LastAvailableCluster - 2);
+        if (Index == MAXULONG)
+            return STATUS_DISK_FULL;
+
+        /* Don't trust the bitmap blindly, only take the cluster if the FAT says it's free */
+        Status = DeviceExt->GetNextCluster(DeviceExt, Index + 2, &OldValue);
+        if (!NT_SUCCESS(Status))
+            return Status;
+
+        RtlSetBit(&DeviceExt->ClusterBitmap, Index);
+        DeviceExt->LastAvailableCluster = Index + 2;
+
+        if (OldValue == 0)
+        {
+            Status = DeviceExt->WriteCluster(DeviceExt, Index + 2, 0xffffffff, &OldValue);
+            if (!NT_SUCCESS(Status))
+                return Status;
+
+            break;
+        }
+
+        /* The bitmap was wrong about it, go on */
+        DPRINT1("Cluster 0x%x is in use (0x%x)\n", Index + 2, OldValue);
+    }
+
+    DPRINT("Found available cluster 0x%x\n", Index + 2);
+    *Cluster = Index + 2;
+    if (DeviceExt->AvailableClustersValid)
+        InterlockedDecrement((PLONG)&DeviceExt->AvailableClusters);
+
+    return STATUS_SUCCESS;
+}
+
 
 /*
  * FUNCTION: Writes a cluster to the FAT12 physical and in-memory tables
@@ -706,6 +829,14 @@ WriteCluster(
 
     ExAcquireResourceExclusiveLite (&DeviceExt->FatResource, TRUE);
     Status = DeviceExt->WriteCluster(DeviceExt, ClusterToWrite, NewValue, &OldValue);
+    if (NT_SUCCESS(Status) && DeviceExt->ClusterBitmap.Buffer != NULL &&
+        ClusterToWrite >= 2 && ClusterToWrite - 2 < DeviceExt->ClusterBitmap.SizeOfBitMap)
+    {
+        if (NewValue == 0)
+            RtlClearBit(&DeviceExt->ClusterBitmap, ClusterToWrite - 2);
+        else
+            RtlSetBit(&DeviceExt->ClusterBitmap, ClusterToWrite - 2);
+    }
     if (DeviceExt->AvailableClustersValid)
     {
         if (OldValue && NewValue == 0)
@@ -782,7 +913,7 @@ GetNextClusterExtend(
      */
     if (CurrentCluster == 0)
     {
-        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
+        Status = FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
         if (!NT_SUCCESS(Status))
         {
             ExReleaseResourceLite(&DeviceExt->FatResource);
@@ -801,7 +932,7 @@ GetNextClusterExtend(
         /* We are after last existing cluster, we must add one to file */
         /* Firstly, find the next available open allocation unit and
            mark it as end of file */
-        Status = DeviceExt->FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
+        Status = FindAndMarkAvailableCluster(DeviceExt, &NewCluster);
         if (!NT_SUCCESS(Status))
         {
             ExReleaseResourceLite(&DeviceExt->FatResource);
@@ -270,6 +270,7 @@ vfatDestroyFCB(
     {
         RemoveEntryList(&pFCB->ParentListEntry);
     }
+    vfatFreeDirIndex(pFCB);
     ExFreePool(pFCB->PathNameBuffer);
     ExDeleteResourceLite(&pFCB->PagingIoResource);
     ExDeleteResourceLite(&pFCB->MainResource);
@@ -760,6 +761,330 @@ vfatAttachFCBToFileObject(
     return STATUS_SUCCESS;
 }
 
+static
+ULONG
+vfatDirIndexHash(
+    PUNICODE_STRING NameU)
+{
+    ULONG hash = 2166136261u;
+    USHORT i;
+
+    /* Same case folding as RtlEqualUnicodeString() and FsRtlAreNamesEqual() */
+    for (i = 0; i < NameU->Length / sizeof(WCHAR); i++)
+    {
+        hash = (hash ^ RtlUpcaseUnicodeChar(NameU->Buffer[i])) * 16777619;
+    }
+    return hash;
+}
+
+static
+PVFAT_DIR_INDEX
+vfatAllocateDirIndex(
+    ULONG Size)
+{
+    PVFAT_DIR_INDEX Index;
+    ULONG i;
+
+    Index = ExAllocatePoolWithTag(PagedPool,
+                                  sizeof(VFAT_DIR_INDEX) + Size * (sizeof(ULONG) + sizeof(VFAT_DIR_INDEX_ENTRY)),
+                                  TAG_DIR_INDEX);
+    if (Index == NULL)
+    {
+        return NULL;
+    }
+
+    Index->Size = Size;
+    Index->Used = 0;
+    Index->FreeList = VFAT_DIR_INDEX_NONE;
+    Index->Buckets = (PULONG)(Index + 1);
+    Index->Entries = (PVFAT_DIR_INDEX_ENTRY)(Index->Buckets + Size);
+    for (i = 0; i < Size; i++)
+    {
+        Index->Buckets[i] = VFAT_DIR_INDEX_NONE;
+    }
+    return Index;
+}
+
+static
+VOID
+vfatInsertDirIndexEntry(
+    PVFAT_DIR_INDEX Index,
+    ULONG Hash,
+    ULONG DirIndex)
+{
+    PULONG Bucket = &Index->Buckets[Hash & (Index->Size - 1)];
+    ULONG i;
+
+    if (Index->FreeList != VFAT_DIR_INDEX_NONE)
+    {
+        i = Index->FreeList;
+        Index->FreeList = Index->Entries[i].Next;
+    }
+    else
+    {
+        ASSERT(Index->Used < Index->Size);
+        i = Index->Used++;
+    }
+
+    Index->Entries[i].Hash = Hash;
+    Index->Entries[i].DirIndex = DirIndex;
+    Index->Entries[i].Next = *Bucket;
+    *Bucket = i;
+}
+
+static
+BOOLEAN
+vfatAddDirIndexEntry(
+    PVFAT_DIR_INDEX *pIndex,
+    ULONG Hash,
+    ULONG DirIndex)
+{
+    PVFAT_DIR_INDEX Index = *pIndex;
+    PVFAT_DIR_INDEX NewIndex;
+    ULONG i, j;
+
+    if (Index->FreeList == VFAT_DIR_INDEX_NONE && Index->Used == Index->Size)
+    {
+        /* Full, rehash everything into twice as many buckets */
+        NewIndex = vfatAllocateDirIndex(Index->Size * 2);
+        if (NewIndex == NULL)
+        {
+            return FALSE;
+        }
+        for (i = 0; i < Index->Size; i++)
+        {
+            for (j = Index->Buckets[i]; j != VFAT_DIR_INDEX_NONE; j = Index->Entries[j].Next)
+            {
+                vfatInsertDirIndexEntry(NewIndex, Index->Entries[j].Hash, Index->Entries[j].DirIndex);
+            }
+        }
+        ExFreePoolWithTag(Index, TAG_DIR_INDEX);
+        *pIndex = Index = NewIndex;
+    }
+
+    vfatInsertDirIndexEntry(Index, Hash, DirIndex);
+    return TRUE;
+}
+
+static
+VOID
+vfatRemoveDirIndexEntries(
+    PVFAT_DIR_INDEX Index,
+    ULONG Hash,
+    ULONG DirIndex)
+{
+    PULONG Link = &Index->Buckets[Hash & (Index->Size - 1)];
+    ULONG i;
+
+    while ((i = *Link) != VFAT_DIR_INDEX_NONE)
+    {
+        if (Index->Entries[i].DirIndex == DirIndex)
+        {
+            *Link = Index->Entries[i].Next;
+            Index->Entries[i].Next = Index->FreeList;
+            Index->FreeList = i;
+        }
+        else
+        {
+            Link = &Index->Entries[i].Next;
+        }
+    }
+}
+
+static
+BOOLEAN
+vfatIndexDirEntryNames(
+    PVFAT_DIR_INDEX *pIndex,
+    PUNICODE_STRING LongNameU,
+    PUNICODE_STRING ShortNameU,
+    ULONG DirIndex)
+{
+    if (LongNameU->Length != 0 &&
+        !vfatAddDirIndexEntry(pIndex, vfatDirIndexHash(LongNameU), DirIndex))
+    {
+        return FALSE;
+    }
+    /* Names without a long name entry come back twice */
+    if (ShortNameU->Length != 0 &&
+        !RtlEqualUnicodeString(LongNameU, ShortNameU, TRUE) &&
+        !vfatAddDirIndexEntry(pIndex, vfatDirIndexHash(ShortNameU), DirIndex))
+    {
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Returns the name index of a directory, building it if the directory is
+ * large enough to be worth it. NULL means the directory has to be scanned.
+ */
+PVFAT_DIR_INDEX
+vfatGetDirIndex(
+    PDEVICE_EXTENSION pVCB,
+    PVFATFCB pDirFCB)
+{
+    NTSTATUS status;
+    PVOID Context = NULL;
+    PVOID Page = NULL;
+    BOOLEAN First = TRUE;
+    VFAT_DIRENTRY_CONTEXT DirContext;
+    WCHAR LongNameBuffer[260];
+    WCHAR ShortNameBuffer[13];
+    PVFAT_DIR_INDEX Index;
+
+    ASSERT(ExIsResourceAcquiredExclusive(&pVCB->DirResource));
+
+    /* FATX entries have no short name, the lookups don't handle them */
+    if (pDirFCB->NameIndex != NULL || vfatVolumeIsFatX(pVCB))
+    {
+        return pDirFCB->NameIndex;
+    }
+
+    /* Small directories are scanned faster than they are indexed */
+    if (pDirFCB->RFCB.FileSize.u.LowPart / sizeof(FAT_DIR_ENTRY) < VFAT_DIR_INDEX_THRESHOLD)
+    {
+        return NULL;
+    }
+
+    Index = vfatAllocateDirIndex(VFAT_DIR_INDEX_THRESHOLD * 2);
+    if (Index == NULL)
+    {
+        return NULL;
+    }
+
+    DirContext.DirIndex = 0;
+    DirContext.LongNameU.Buffer = LongNameBuffer;
+    DirContext.LongNameU.Length = 0;
+    DirContext.LongNameU.MaximumLength = sizeof(LongNameBuffer);
+    DirContext.ShortNameU.Buffer = ShortNameBuffer;
+    DirContext.ShortNameU.Length = 0;
+    DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
+
+    while (TRUE)
+    {
+        status = VfatGetNextDirEntry(pVCB, &Context, &Page, pDirFCB, &DirContext, First);
+        First = FALSE;
+        if (status == STATUS_NO_MORE_ENTRIES)
+        {
+            break;
+        }
+        if (!NT_SUCCESS(status))
+        {
+            ExFreePoolWithTag(Index, TAG_DIR_INDEX);
+            return NULL;
+        }
+
+        /* Skip what vfatDirFindFile() and FindFile() skip */
+        if (!ENTRY_VOLUME(FALSE, &DirContext.DirEntry) &&
+            DirContext.LongNameU.Length != 0 &&
+            DirContext.ShortNameU.Length != 0)
+        {
+            if (!vfatIndexDirEntryNames(&Index, &DirContext.LongNameU, &DirContext.ShortNameU, DirContext.DirIndex))
+            {
+                if (Context != NULL)
+                {
+                    CcUnpinData(Context);
+                }
+                ExFreePoolWithTag(Index, TAG_DIR_INDEX);
+                return NULL;
+            }
+        }
+        DirContext.DirIndex++;
+    }
+
+    DPRINT("Indexed %wZ, %u entries\n", &pDirFCB->PathNameU, Index->Used);
+    pDirFCB->NameIndex = Index;
+    return Index;
+}
+
+/*
+ * Finds the lowest directory index not below FromIndex that might hold the
+ * name. The entry itself has to be compared, this only rules out the others.
+ */
+BOOLEAN
+vfatLookupDirIndex(
+    PVFAT_DIR_INDEX Index,
+    PUNICODE_STRING NameU,
+    ULONG FromIndex,
+    PULONG DirIndex)
+{
+    ULONG Hash = vfatDirIndexHash(NameU);
+    BOOLEAN Found = FALSE;
+    ULONG i;
+
+    for (i = Index->Buckets[Hash & (Index->Size - 1)];
+         i != VFAT_DIR_INDEX_NONE;
+         i = Index->Entries[i].Next)
+    {
+        if (Index->Entries[i].Hash == Hash &&
+            Index->Entries[i].DirIndex >= FromIndex &&
+            (!Found || Index->Entries[i].DirIndex < *DirIndex))
+        {
+            *DirIndex = Index->Entries[i].DirIndex;
+            Found = TRUE;
+        }
+    }
+    return Found;
+}
+
+/*
+ * Must be called once a new entry was written to the directory. If the index
+ * can't grow, it's dropped and gets rebuilt by the next lookup.
+ */
+VOID
+vfatAddToDirIndex(
+    PVFATFCB pDirFCB,
+    PUNICODE_STRING LongNameU,
+    PUNICODE_STRING ShortNameU,
+    ULONG DirIndex)
+{
+    if (pDirFCB->NameIndex == NULL)
+    {
+        return;
+    }
+
+    if (!vfatIndexDirEntryNames(&pDirFCB->NameIndex, LongNameU, ShortNameU, DirIndex))
+    {
+        vfatFreeDirIndex(pDirFCB);
+    }
+}
+
+/*
+ * Must be called once an entry was deleted from the directory
+ */
+VOID
+vfatRemoveFromDirIndex(
+    PVFATFCB pDirFCB,
+    PUNICODE_STRING LongNameU,
+    PUNICODE_STRING ShortNameU,
+    ULONG DirIndex)
+{
+    if (pDirFCB->NameIndex == NULL)
+    {
+        return;
+    }
+
+    if (LongNameU->Length != 0)
+    {
+        vfatRemoveDirIndexEntries(pDirFCB->NameIndex, vfatDirIndexHash(LongNameU), DirIndex);
+    }
+    if (ShortNameU->Length != 0)
+    {
+        vfatRemoveDirIndexEntries(pDirFCB->NameIndex, vfatDirIndexHash(ShortNameU), DirIndex);
+    }
+}
+
+VOID
+vfatFreeDirIndex(
+    PVFATFCB pDirFCB)
+{
+    if (pDirFCB->NameIndex != NULL)
+    {
+        ExFreePoolWithTag(pDirFCB->NameIndex, TAG_DIR_INDEX);
+        pDirFCB->NameIndex = NULL;
+    }
+}
+
 NTSTATUS
 vfatDirFindFile(
     PDEVICE_EXTENSION pDeviceExt,
@@ -779,6 +1104,8 @@ vfatDirFindFile(
     BOOLEAN FoundLong = FALSE;
     BOOLEAN FoundShort = FALSE;
     BOOLEAN IsFatX = vfatVolumeIsFatX(pDeviceExt);
+    PVFAT_DIR_INDEX Index;
+    ULONG FromIndex;
 
     ASSERT(pDeviceExt);
     ASSERT(pDirectoryFCB);
@@ -796,6 +1123,42 @@ vfatDirFindFile(
     DirContext.ShortNameU.Length = 0;
     DirContext.ShortNameU.MaximumLength = sizeof(ShortNameBuffer);
 
+    Index = vfatGetDirIndex(pDeviceExt, pDirectoryFCB);
+    if (Index != NULL)
+    {
+        /* Only read the entries the name index points to */
+        FromIndex = 0;
+        while (vfatLookupDirIndex(Index, FileToFindU, FromIndex, &DirContext.DirIndex))
+        {
+            FromIndex = DirContext.DirIndex + 1;
+            Context = NULL;
+            status = VfatGetNextDirEntry(pDeviceExt,
+                &Context,
+                &Page,
+                pDirectoryFCB,
+                &DirContext,
+                TRUE);
+            if (NT_SUCCESS(status) &&
+                DirContext.DirIndex == FromIndex - 1 &&
+                !ENTRY_VOLUME(IsFatX, &DirContext.DirEntry) &&
+                (RtlEqualUnicodeString(FileToFindU, &DirContext.LongNameU, TRUE) ||
+                 RtlEqualUnicodeString(FileToFindU, &DirContext.ShortNameU, TRUE)))
+            {
+                status = vfatMakeFCBFromDirEntry(pDeviceExt,
+                    pDirectoryFCB,
+                    &DirContext,
+                    pFoundFCB);
+                CcUnpinData(Context);
+                return status;
+            }
+            if (Context != NULL)
+            {
+                CcUnpinData(Context);
+            }
+        }
+        return STATUS_OBJECT_NAME_NOT_FOUND;
+    }
+
     while (TRUE)
     {
         status = VfatGetNextDirEntry(pDeviceExt,
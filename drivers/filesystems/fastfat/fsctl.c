@@ -734,6 +734,10 @@ VfatMount(
     DeviceExt->LastAvailableCluster = 2;
     ExInitializeResourceLite(&DeviceExt->FatResource);
 
+    /* Scan the FAT once now, allocations and free space queries then
+       don't need to go through it anymore */
+    InitializeClusterBitmap(DeviceExt);
+
     InitializeListHead(&DeviceExt->FcbListHead);
 
     VolumeFcb = vfatNewFCB(DeviceExt, &VolumeNameU);
@@ -796,6 +800,8 @@ ByeBye:
             ExFreePoolWithTag(DeviceExt->SpareVPB, TAG_VFAT);
         if (DeviceExt && DeviceExt->Statistics)
             ExFreePoolWithTag(DeviceExt->Statistics, TAG_VFAT);
+        if (DeviceExt)
+            FreeClusterBitmap(DeviceExt);
         if (Fcb)
             vfatDestroyFCB(Fcb);
         if (Ccb)
@@ -910,8 +916,88 @@ NTSTATUS
 VfatGetVolumeBitmap(
     PVFAT_IRP_CONTEXT IrpContext)
 {
+    PIO_STACK_LOCATION Stack;
+    PVOLUME_BITMAP_BUFFER BitmapBuffer;
+    PSTARTING_LCN_INPUT_BUFFER StartingLcnBuffer;
+    PDEVICE_EXTENSION DeviceExt;
+    LONGLONG StartingLcn;
+    ULONG TotalClusters;
+    ULONG Length;
+    ULONG ToCopy;
+    NTSTATUS Status = STATUS_SUCCESS;
+
     DPRINT("VfatGetVolumeBitmap (IrpContext %p)\n", IrpContext);
-    return STATUS_INVALID_DEVICE_REQUEST;
+
+    DeviceExt = IrpContext->DeviceExt;
+    Stack = IrpContext->Stack;
+    StartingLcnBuffer = Stack->Parameters.FileSystemControl.Type3InputBuffer;
+    BitmapBuffer = IrpContext->Irp->UserBuffer;
+    Length = Stack->Parameters.FileSystemControl.OutputBufferLength;
+
+    if (Stack->Parameters.FileSystemControl.InputBufferLength < sizeof(STARTING_LCN_INPUT_BUFFER) ||
+        StartingLcnBuffer == NULL)
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    if (BitmapBuffer == NULL || Length < sizeof(VOLUME_BITMAP_BUFFER))
+    {
+        return STATUS_BUFFER_TOO_SMALL;
+    }
+
+    ExAcquireResourceSharedLite(&DeviceExt->FatResource, TRUE);
+
+    if (DeviceExt->ClusterBitmap.Buffer == NULL)
+    {
+        ExReleaseResourceLite(&DeviceExt->FatResource);
+        return STATUS_INVALID_DEVICE_REQUEST;
+    }
+
+    TotalClusters = DeviceExt->FatInfo.NumberOfClusters;
+
+    _SEH2_TRY
+    {
+        if (IrpContext->Irp->RequestorMode != KernelMode)
+        {
+            ProbeForRead(StartingLcnBuffer, sizeof(STARTING_LCN_INPUT_BUFFER), sizeof(UCHAR));
+            ProbeForWrite(BitmapBuffer, Length, sizeof(UCHAR));
+        }
+
+        StartingLcn = StartingLcnBuffer->StartingLcn.QuadPart;
+        if (StartingLcn < 0 || StartingLcn >= TotalClusters)
+        {
+            Status = STATUS_INVALID_PARAMETER;
+        }
+        else
+        {
+            /* The bitmap is indexed by LCN, so this is a plain copy */
+            StartingLcn &= ~7;
+            ToCopy = (TotalClusters - (ULONG)StartingLcn + 7) / 8;
+            Length -= FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer);
+            if (ToCopy > Length)
+            {
+                ToCopy = Length;
+                Status = STATUS_BUFFER_OVERFLOW;
+            }
+
+            BitmapBuffer->StartingLcn.QuadPart = StartingLcn;
+            BitmapBuffer->BitmapSize.QuadPart = TotalClusters - StartingLcn;
+            RtlCopyMemory(BitmapBuffer->Buffer,
+                          (PUCHAR)DeviceExt->ClusterBitmap.Buffer + StartingLcn / 8,
+                          ToCopy);
+
+            IrpContext->Irp->IoStatus.Information = FIELD_OFFSET(VOLUME_BITMAP_BUFFER, Buffer) + ToCopy;
+        }
+    }
+    _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+    {
+        Status = _SEH2_GetExceptionCode();
+    }
+    _SEH2_END;
+
+    ExReleaseResourceLite(&DeviceExt->FatResource);
+
+    return Status;
 }
 
 
@@ -313,6 +313,8 @@ typedef struct DEVICE_EXTENSION
     ULONG LastAvailableCluster;
     ULONG AvailableClusters;
     BOOLEAN AvailableClustersValid;
+    /* Allocated clusters, protected by FatResource */
+    RTL_BITMAP ClusterBitmap;
     ULONG Flags;
     struct _VFATFCB *VolumeFcb;
     PSTATISTICS Statistics;
@@ -403,6 +405,32 @@ typedef struct
 
 extern PVFAT_GLOBAL_DATA VfatGlobalData;
 
+/*
+ * Name index of a large directory: hashes of the long and short names
+ * mapping to the directory index of the short name entry. Hashes collide,
+ * so every hit still has to be checked against the directory entry itself.
+ * Protected by the DirResource of the volume.
+ */
+#define VFAT_DIR_INDEX_THRESHOLD    512
+#define VFAT_DIR_INDEX_NONE         0xffffffff
+
+typedef struct _VFAT_DIR_INDEX_ENTRY
+{
+    ULONG Hash;
+    ULONG DirIndex;
+    ULONG Next;
+} VFAT_DIR_INDEX_ENTRY, *PVFAT_DIR_INDEX_ENTRY;
+
+typedef struct _VFAT_DIR_INDEX
+{
+    /* Number of buckets and of entries, always a power of two */
+    ULONG Size;
+    ULONG Used;
+    ULONG FreeList;
+    PULONG Buckets;
+    PVFAT_DIR_INDEX_ENTRY Entries;
+} VFAT_DIR_INDEX, *PVFAT_DIR_INDEX;
+
 #define FCB_CACHE_INITIALIZED   0x0001
 #define FCB_DELETE_PENDING      0x0002
 #define FCB_IS_FAT              0x0004
@@ -493,6 +521,9 @@ typedef struct _VFATFCB
     FAST_MUTEX LastMutex;
     ULONG LastCluster;
     ULONG LastOffset;
+
+    /* Name index for large directories, built on the first lookup */
+    PVFAT_DIR_INDEX NameIndex;
 } VFATFCB, *PVFATFCB;
 
 #define CCB_DELETE_ON_CLOSE     0x0001
@@ -511,6 +542,7 @@ typedef struct _VFATCCB
 #define TAG_FCB  'BCFV'
 #define TAG_IRP  'PRIV'
 #define TAG_VFAT 'TAFV'
+#define TAG_DIR_INDEX 'XIDV'
 
 #define ENTRIES_PER_SECTOR (BLOCKSIZE / sizeof(FATDirEntry))
 
@@ -867,6 +899,14 @@ WriteCluster(
     ULONG ClusterToWrite,
     ULONG NewValue);
 
+NTSTATUS
+InitializeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt);
+
+VOID
+FreeClusterBitmap(
+    PDEVICE_EXTENSION DeviceExt);
+
 /* fcb.c */
 
 PVFATFCB
@@ -953,6 +993,36 @@ vfatMakeFCBFromDirEntry(
     PVFAT_DIRENTRY_CONTEXT DirContext,
     PVFATFCB *fileFCB);
 
+PVFAT_DIR_INDEX
+vfatGetDirIndex(
+    PDEVICE_EXTENSION pVCB,
+    PVFATFCB pDirFCB);
+
+BOOLEAN
+vfatLookupDirIndex(
+    PVFAT_DIR_INDEX Index,
+    PUNICODE_STRING NameU,
+    ULONG FromIndex,
+    PULONG DirIndex);
+
+VOID
+vfatAddToDirIndex(
+    PVFATFCB pDirFCB,
+    PUNICODE_STRING LongNameU,
+    PUNICODE_STRING ShortNameU,
+    ULONG DirIndex);
+
+VOID
+vfatRemoveFromDirIndex(
+    PVFATFCB pDirFCB,
+    PUNICODE_STRING LongNameU,
+    PUNICODE_STRING ShortNameU,
+    ULONG DirIndex);
+
+VOID
+vfatFreeDirIndex(
+    PVFATFCB pDirFCB);
+
 /* finfo.c */
 
 NTSTATUS
@@ -1438,6 +1438,7 @@ UpdateIndexNode(PDEVICE_EXTENSION DeviceExt,
 
         // Write the buffer to the index allocation
         Status = WriteAttribute(DeviceExt, IndexAllocationContext, NodeOffset, (const PUCHAR)IndexBuffer, IndexBufferSize, &LengthWritten, FileRecord);
+        NtfsInvalidateCachedRecords(DeviceExt, IndexAllocationContext->FileMFTIndex);
         if (!NT_SUCCESS(Status) || LengthWritten != IndexBufferSize)
         {
             DPRINT1("ERROR: Failed to update index allocation!\n");
@@ -119,6 +119,9 @@ NtfsDestroyFCB(PNTFS_FCB Fcb)
 
     ExDeleteResourceLite(&Fcb->MainResource);
 
+    if (Fcb->UnitCache != NULL)
+        NtfsFreeUnitCache(Fcb->UnitCache);
+
     ExFreeToNPagedLookasideList(&NtfsGlobalData->FcbLookasideList, Fcb);
 }
 
@@ -461,6 +461,8 @@ NtfsMountVolume(PDEVICE_OBJECT DeviceObject,
     Vcb->Identifier.Type = NTFS_TYPE_VCB;
     Vcb->Identifier.Size = sizeof(NTFS_TYPE_VCB);
 
+    NtfsInitializeRecordCache(Vcb);
+
     Status = NtfsGetVolumeData(DeviceToMount,
                                Vcb);
     if (!NT_SUCCESS(Status))
@@ -564,6 +566,9 @@ ByeBye:
         if (Ccb)
             ExFreePool(Ccb);
 
+        if (Vcb)
+            NtfsFreeRecordCache(Vcb);
+
         if (NewDeviceObject)
             IoDeleteDevice(NewDeviceObject);
 
@@ -49,6 +49,8 @@ PrepareAttributeContext(PNTFS_ATTR_RECORD AttrRecord)
         return NULL;
     }
 
+    Context->UnitCache = NULL;
+
     // Allocate memory for a copy of the attribute
     Context->pRecord = ExAllocatePoolWithTag(NonPagedPool, AttrRecord->Length, TAG_NTFS);
     if(!Context->pRecord)
@@ -1005,6 +1007,318 @@ SetResidentAttributeDataLength(PDEVICE_EXTENSION Vcb,
     return STATUS_SUCCESS;
 }
 
+/**
+* @name NtfsAllocateUnitCache
+* @implemented
+*
+* Allocates a cache of decompressed compression units. Units themselves are only
+* allocated once they're read.
+*
+* @param UnitSize
+* Size of a compression unit of the stream, in bytes.
+*
+* @return
+* A pointer to the new cache, or NULL if we ran out of memory.
+*/
+PNTFS_UNIT_CACHE
+NtfsAllocateUnitCache(ULONG UnitSize)
+{
+    PNTFS_UNIT_CACHE UnitCache;
+    ULONG i;
+
+    UnitCache = ExAllocatePoolWithTag(NonPagedPool, sizeof(NTFS_UNIT_CACHE), TAG_NTFS);
+    if (UnitCache == NULL)
+        return NULL;
+
+    ExInitializeFastMutex(&UnitCache->Lock);
+    UnitCache->UnitSize = UnitSize;
+    UnitCache->NextVictim = 0;
+    for (i = 0; i < NTFS_UNIT_CACHE_ENTRIES; i++)
+    {
+        UnitCache->UnitVCN[i] = (ULONGLONG)-1;
+        UnitCache->Unit[i] = NULL;
+    }
+
+    return UnitCache;
+}
+
+VOID
+NtfsFreeUnitCache(PNTFS_UNIT_CACHE UnitCache)
+{
+    ULONG i;
+
+    for (i = 0; i < NTFS_UNIT_CACHE_ENTRIES; i++)
+    {
+        if (UnitCache->Unit[i] != NULL)
+            ExFreePoolWithTag(UnitCache->Unit[i], TAG_NTFS);
+    }
+
+    ExFreePoolWithTag(UnitCache, TAG_NTFS);
+}
+
+/**
+* @name ReadAttributeClusters
+* @implemented
+*
+* Reads whole clusters of a non-resident attribute straight from its map control block.
+* Sparse clusters are zeroed without going to the disk.
+*/
+static
+NTSTATUS
+ReadAttributeClusters(PDEVICE_EXTENSION Vcb,
+                      PNTFS_ATTR_CONTEXT Context,
+                      ULONGLONG VCN,
+                      ULONG Clusters,
+                      PUCHAR Buffer)
+{
+    ULONG BytesPerCluster = Vcb->NtfsInfo.BytesPerCluster;
+    LONGLONG LCN, RunLength;
+    ULONG Count;
+    NTSTATUS Status;
+
+    while (Clusters > 0)
+    {
+        if (!FsRtlLookupLargeMcbEntry(&Context->DataRunsMCB, VCN, &LCN, &RunLength, NULL, NULL, NULL))
+        {
+            // Past the last run, the rest is sparse
+            LCN = -1;
+            RunLength = Clusters;
+        }
+
+        Count = (ULONG)min(RunLength, Clusters);
+        if (LCN == -1)
+        {
+            RtlZeroMemory(Buffer, Count * BytesPerCluster);
+        }
+        else
+        {
+            Status = NtfsReadDisk(Vcb->StorageDevice,
+                                  LCN * BytesPerCluster,
+                                  Count * BytesPerCluster,
+                                  Vcb->NtfsInfo.BytesPerSector,
+                                  Buffer,
+                                  FALSE);
+            if (!NT_SUCCESS(Status))
+                return Status;
+        }
+
+        VCN += Count;
+        Clusters -= Count;
+        Buffer += Count * BytesPerCluster;
+    }
+
+    return STATUS_SUCCESS;
+}
+
+/**
+* @name GetUnitAllocatedClusters
+* @implemented
+*
+* Returns how many clusters at the beginning of a compression unit are allocated.
+* None means the unit is sparse, all of them that it's stored uncompressed, and
+* anything else that the allocated clusters hold LZNT1 compressed data.
+*/
+static
+ULONG
+GetUnitAllocatedClusters(PNTFS_ATTR_CONTEXT Context,
+                         ULONGLONG UnitVCN,
+                         ULONG ClustersPerUnit)
+{
+    LONGLONG LCN, RunLength;
+    ULONG Allocated = 0;
+
+    while (Allocated < ClustersPerUnit)
+    {
+        if (!FsRtlLookupLargeMcbEntry(&Context->DataRunsMCB, UnitVCN + Allocated, &LCN, &RunLength, NULL, NULL, NULL) ||
+            LCN == -1)
+        {
+            break;
+        }
+
+        Allocated += (ULONG)min(RunLength, ClustersPerUnit - Allocated);
+    }
+
+    return Allocated;
+}
+
+/**
+* @name ReadCompressionUnit
+* @implemented
+*
+* Reads and, if needed, decompresses a whole compression unit.
+*
+* @param Unit
+* Receives the UnitSize bytes of decompressed data.
+*
+* @param CompressedData
+* Scratch buffer of UnitSize bytes for the compressed data.
+*/
+static
+NTSTATUS
+ReadCompressionUnit(PDEVICE_EXTENSION Vcb,
+                    PNTFS_ATTR_CONTEXT Context,
+                    ULONGLONG UnitVCN,
+                    ULONG Allocated,
+                    ULONG ClustersPerUnit,
+                    PUCHAR Unit,
+                    PUCHAR CompressedData)
+{
+    ULONG UnitSize = ClustersPerUnit * Vcb->NtfsInfo.BytesPerCluster;
+    ULONG FinalSize;
+    NTSTATUS Status;
+
+    // A fully allocated unit wasn't worth compressing
+    if (Allocated == ClustersPerUnit)
+        return ReadAttributeClusters(Vcb, Context, UnitVCN, ClustersPerUnit, Unit);
+
+    Status = ReadAttributeClusters(Vcb, Context, UnitVCN, Allocated, CompressedData);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    Status = RtlDecompressBuffer(COMPRESSION_FORMAT_LZNT1,
+                                 Unit,
+                                 UnitSize,
+                                 CompressedData,
+                                 Allocated * Vcb->NtfsInfo.BytesPerCluster,
+                                 &FinalSize);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("Failed to decompress unit at VCN %I64u: %lx\n", UnitVCN, Status);
+        return STATUS_FILE_CORRUPT_ERROR;
+    }
+
+    // A unit ending with zeroes is stored short
+    if (FinalSize < UnitSize)
+        RtlZeroMemory(Unit + FinalSize, UnitSize - FinalSize);
+
+    return STATUS_SUCCESS;
+}
+
+/**
+* @name ReadCompressedAttribute
+* @implemented
+*
+* ReadAttribute() for LZNT1 compressed attributes. Data is read a compression unit at a
+* time, through the unit cache of the context if it has one. Sparse units are zeroed
+* without going to the disk.
+*
+* @return
+* The number of bytes read, like ReadAttribute().
+*/
+static
+ULONG
+ReadCompressedAttribute(PDEVICE_EXTENSION Vcb,
+                        PNTFS_ATTR_CONTEXT Context,
+                        ULONGLONG Offset,
+                        PCHAR Buffer,
+                        ULONG Length)
+{
+    PNTFS_UNIT_CACHE UnitCache = Context->UnitCache;
+    ULONG ClustersPerUnit = 1 << Context->pRecord->NonResident.CompressionUnit;
+    ULONG UnitSize = ClustersPerUnit * Vcb->NtfsInfo.BytesPerCluster;
+    ULONGLONG AllocatedSize = Context->pRecord->NonResident.AllocatedSize;
+    ULONGLONG UnitVCN;
+    ULONG UnitOffset, ReadLength, Allocated, AlreadyRead = 0, i;
+    PUCHAR Unit = NULL, CompressedData = NULL, Victim;
+    NTSTATUS Status;
+
+    if (Offset >= AllocatedSize)
+        return 0;
+    if (Offset + Length > AllocatedSize)
+        Length = (ULONG)(AllocatedSize - Offset);
+
+    if (UnitCache != NULL && UnitCache->UnitSize != UnitSize)
+        UnitCache = NULL;
+
+    while (Length > 0)
+    {
+        UnitVCN = (Offset / UnitSize) * ClustersPerUnit;
+        UnitOffset = (ULONG)(Offset % UnitSize);
+        ReadLength = min(UnitSize - UnitOffset, Length);
+
+        Allocated = GetUnitAllocatedClusters(Context, UnitVCN, ClustersPerUnit);
+        if (Allocated == 0)
+        {
+            RtlZeroMemory(Buffer, ReadLength);
+        }
+        else
+        {
+            if (UnitCache != NULL)
+            {
+                ExAcquireFastMutex(&UnitCache->Lock);
+
+                for (i = 0; i < NTFS_UNIT_CACHE_ENTRIES; i++)
+                {
+                    if (UnitCache->UnitVCN[i] == UnitVCN)
+                        break;
+                }
+
+                if (i < NTFS_UNIT_CACHE_ENTRIES)
+                {
+                    RtlCopyMemory(Buffer, UnitCache->Unit[i] + UnitOffset, ReadLength);
+                    ExReleaseFastMutex(&UnitCache->Lock);
+                    goto NextUnit;
+                }
+
+                ExReleaseFastMutex(&UnitCache->Lock);
+            }
+
+            // The read completes through an APC, so it can't be done holding the fast mutex
+            if (Unit == NULL)
+                Unit = ExAllocatePoolWithTag(NonPagedPool, UnitSize, TAG_NTFS);
+            if (CompressedData == NULL)
+                CompressedData = ExAllocatePoolWithTag(NonPagedPool, UnitSize, TAG_NTFS);
+            if (Unit == NULL || CompressedData == NULL)
+                break;
+
+            Status = ReadCompressionUnit(Vcb, Context, UnitVCN, Allocated, ClustersPerUnit, Unit, CompressedData);
+            if (!NT_SUCCESS(Status))
+                break;
+
+            RtlCopyMemory(Buffer, Unit + UnitOffset, ReadLength);
+
+            if (UnitCache != NULL)
+            {
+                ExAcquireFastMutex(&UnitCache->Lock);
+
+                // Someone else might have read it meanwhile
+                for (i = 0; i < NTFS_UNIT_CACHE_ENTRIES; i++)
+                {
+                    if (UnitCache->UnitVCN[i] == UnitVCN)
+                        break;
+                }
+
+                if (i == NTFS_UNIT_CACHE_ENTRIES)
+                {
+                    // Swap our buffer with the victim's, the next unit gets read into that one
+                    i = UnitCache->NextVictim;
+                    UnitCache->NextVictim = (i + 1) % NTFS_UNIT_CACHE_ENTRIES;
+                    Victim = UnitCache->Unit[i];
+                    UnitCache->Unit[i] = Unit;
+                    UnitCache->UnitVCN[i] = UnitVCN;
+                    Unit = Victim;
+                }
+
+                ExReleaseFastMutex(&UnitCache->Lock);
+            }
+        }
+
+NextUnit:
+
+        Offset += ReadLength;
+        Buffer += ReadLength;
+        Length -= ReadLength;
+        AlreadyRead += ReadLength;
+    }
+
+    if (Unit != NULL)
+        ExFreePoolWithTag(Unit, TAG_NTFS);
+    if (CompressedData != NULL)
+        ExFreePoolWithTag(CompressedData, TAG_NTFS);
+
+    return AlreadyRead;
+}
+
 ULONG
 ReadAttribute(PDEVICE_EXTENSION Vcb,
               PNTFS_ATTR_CONTEXT Context,
@@ -1045,6 +1359,37 @@ ReadAttribute(PDEVICE_EXTENSION Vcb,
      * Non-resident attribute
      */
 
+    if ((Context->pRecord->Flags & ATTR_IS_COMPRESSED) && Context->pRecord->NonResident.CompressionUnit != 0)
+        return ReadCompressedAttribute(Vcb, Context, Offset, Buffer, Length);
+
+    // Nothing past the initialized size was ever written, don't go to the disk for it
+    if (Offset + Length > (ULONGLONG)Context->pRecord->NonResident.InitializedSize &&
+        Context->pRecord->NonResident.InitializedSize < Context->pRecord->NonResident.AllocatedSize)
+    {
+        ULONGLONG InitializedSize = Context->pRecord->NonResident.InitializedSize;
+        ULONGLONG AllocatedSize = Context->pRecord->NonResident.AllocatedSize;
+        ULONG ZeroLength;
+
+        if (Offset >= AllocatedSize)
+            return 0;
+        if (Offset + Length > AllocatedSize)
+            Length = (ULONG)(AllocatedSize - Offset);
+
+        if (Offset >= InitializedSize)
+        {
+            RtlZeroMemory(Buffer, Length);
+            return Length;
+        }
+
+        ZeroLength = (ULONG)(Offset + Length - InitializedSize);
+        RtlZeroMemory(Buffer + Length - ZeroLength, ZeroLength);
+
+        AlreadyRead = ReadAttribute(Vcb, Context, Offset, Buffer, Length - ZeroLength);
+        if (AlreadyRead != Length - ZeroLength)
+            return AlreadyRead;
+        return Length;
+    }
+
     /*
      * I. Find the corresponding start data run.
      */
@@ -1577,9 +1922,23 @@ ReadFileRecord(PDEVICE_EXTENSION Vcb,
                PFILE_RECORD_HEADER file)
 {
     ULONGLONG BytesRead;
+    PNTFS_CACHED_RECORD CachedRecord;
+    ULONG Generation;
+    NTSTATUS Status;
 
     DPRINT("ReadFileRecord(%p, %I64x, %p)\n", Vcb, index, file);
 
+    /* Callers get their own copy, as they are free to modify it */
+    CachedRecord = NtfsLookupCachedRecord(Vcb, index, NTFS_CACHE_FILE_RECORD);
+    if (CachedRecord != NULL)
+    {
+        RtlCopyMemory(file, CachedRecord->Data, Vcb->NtfsInfo.BytesPerFileRecord);
+        NtfsReleaseCachedRecord(CachedRecord);
+        return STATUS_SUCCESS;
+    }
+
+    Generation = NtfsGetRecordCacheGeneration(Vcb);
+
     BytesRead = ReadAttribute(Vcb, Vcb->MFTContext, index * Vcb->NtfsInfo.BytesPerFileRecord, (PCHAR)file, Vcb->NtfsInfo.BytesPerFileRecord);
     if (BytesRead != Vcb->NtfsInfo.BytesPerFileRecord)
     {
@@ -1589,7 +1948,20 @@ ReadFileRecord(PDEVICE_EXTENSION Vcb,
 
     /* Apply update sequence array fixups. */
     DPRINT("Sequence number: %u\n", file->SequenceNumber);
-    return FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    Status = FixupUpdateSequenceArray(Vcb, &file->Ntfs);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    /* Not being able to cache it isn't an error */
+    CachedRecord = NtfsAllocateCachedRecord(index, NTFS_CACHE_FILE_RECORD, Vcb->NtfsInfo.BytesPerFileRecord);
+    if (CachedRecord != NULL)
+    {
+        RtlCopyMemory(CachedRecord->Data, file, Vcb->NtfsInfo.BytesPerFileRecord);
+        NtfsInsertCachedRecord(Vcb, CachedRecord, Generation);
+        NtfsReleaseCachedRecord(CachedRecord);
+    }
+
+    return STATUS_SUCCESS;
 }
 
 
@@ -1832,6 +2204,7 @@ UpdateIndexEntryFileNameSize(PDEVICE_EXTENSION Vcb,
             }
 
             Status = WriteAttribute(Vcb, IndexAllocationCtx, RecordOffset, (const PUCHAR)IndexRecord, IndexBlockSize, &Written, MftRecord);
+            NtfsInvalidateCachedRecords(Vcb, IndexAllocationCtx->FileMFTIndex);
             if (!NT_SUCCESS(Status))
             {
                 DPRINT1("ERROR Performing write!\n");
@@ -1897,6 +2270,9 @@ UpdateFileRecord(PDEVICE_EXTENSION Vcb,
         DPRINT1("UpdateFileRecord failed: %lu written, %lu expected\n", BytesWritten, Vcb->NtfsInfo.BytesPerFileRecord);
     }
 
+    // whatever made it to the disk, the cached copy can't be trusted anymore
+    NtfsInvalidateCachedRecords(Vcb, MftIndex);
+
     // remove the fixup array (so the file record pointer can still be used)
     FixupUpdateSequenceArray(Vcb, &FileRecord->Ntfs);
 
@@ -2800,6 +3176,9 @@ BrowseSubNodeIndexEntries(PNTFS_VCB Vcb,
     PINDEX_ENTRY_ATTRIBUTE IndexEntry;
     ULONG NodeNumber;
     NTSTATUS Status;
+    PNTFS_CACHED_RECORD CachedRecord;
+    ULONGLONG FileReference;
+    ULONG Generation;
 
     DPRINT("BrowseSubNodeIndexEntries(%p, %p, %lu, %wZ, %p, %p, %I64d, %lu, %lu, %s, %s, %p)\n",
            Vcb,
@@ -2829,37 +3208,54 @@ BrowseSubNodeIndexEntries(PNTFS_VCB Vcb,
     // Clear the bit for this node so it can't be recursively referenced
     RtlClearBits(Bitmap, NodeNumber, 1);
 
-    // Allocate memory for the index record
-    IndexRecord = ExAllocatePoolWithTag(NonPagedPool, IndexBlockSize, TAG_NTFS);
-    if (!IndexRecord)
+    // Index buffers are keyed by the directory's file reference, so a reused file record can't match them
+    FileReference = IndexAllocationContext->FileMFTIndex | ((ULONGLONG)MftRecord->SequenceNumber << 48);
+
+    // Try the record cache first, we only ever read the index record here
+    CachedRecord = NtfsLookupCachedRecord(Vcb, FileReference, VCN);
+    if (CachedRecord == NULL || CachedRecord->Length != IndexBlockSize)
     {
-        DPRINT1("Unable to allocate memory for index record!\n");
-        return STATUS_INSUFFICIENT_RESOURCES;
-    }
+        if (CachedRecord != NULL)
+            NtfsReleaseCachedRecord(CachedRecord);
 
-    // Calculate offset of index record
-    Offset = VCN * Vcb->NtfsInfo.BytesPerCluster;
+        Generation = NtfsGetRecordCacheGeneration(Vcb);
 
-    // Read the index record
-    BytesRead = ReadAttribute(Vcb, IndexAllocationContext, Offset, (PCHAR)IndexRecord, IndexBlockSize);
-    if (BytesRead != IndexBlockSize)
-    {
-        DPRINT1("Unable to read index record!\n");
-        ExFreePoolWithTag(IndexRecord, TAG_NTFS);
-        return STATUS_UNSUCCESSFUL;
-    }
+        // Allocate memory for the index record
+        CachedRecord = NtfsAllocateCachedRecord(FileReference, VCN, IndexBlockSize);
+        if (!CachedRecord)
+        {
+            DPRINT1("Unable to allocate memory for index record!\n");
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
+        IndexRecord = (PINDEX_BUFFER)CachedRecord->Data;
 
-    // Assert that we're dealing with an index record here
-    ASSERT(IndexRecord->Ntfs.Type == NRH_INDX_TYPE);
+        // Calculate offset of index record
+        Offset = VCN * Vcb->NtfsInfo.BytesPerCluster;
 
-    // Apply the fixup array to the index record
-    Status = FixupUpdateSequenceArray(Vcb, &((PFILE_RECORD_HEADER)IndexRecord)->Ntfs);
-    if (!NT_SUCCESS(Status))
-    {
-        ExFreePoolWithTag(IndexRecord, TAG_NTFS);
-        DPRINT1("Failed to apply fixup array!\n");
-        return Status;
+        // Read the index record
+        BytesRead = ReadAttribute(Vcb, IndexAllocationContext, Offset, (PCHAR)IndexRecord, IndexBlockSize);
+        if (BytesRead != IndexBlockSize)
+        {
+            DPRINT1("Unable to read index record!\n");
+            NtfsReleaseCachedRecord(CachedRecord);
+            return STATUS_UNSUCCESSFUL;
+        }
+
+        // Assert that we're dealing with an index record here
+        ASSERT(IndexRecord->Ntfs.Type == NRH_INDX_TYPE);
+
+        // Apply the fixup array to the index record
+        Status = FixupUpdateSequenceArray(Vcb, &((PFILE_RECORD_HEADER)IndexRecord)->Ntfs);
+        if (!NT_SUCCESS(Status))
+        {
+            NtfsReleaseCachedRecord(CachedRecord);
+            DPRINT1("Failed to apply fixup array!\n");
+            return Status;
+        }
+
+        NtfsInsertCachedRecord(Vcb, CachedRecord, Generation);
     }
+    IndexRecord = (PINDEX_BUFFER)CachedRecord->Data;
 
     ASSERT(IndexRecord->Header.AllocatedSize + FIELD_OFFSET(INDEX_BUFFER, Header) == IndexBlockSize);
     FirstEntry = (PINDEX_ENTRY_ATTRIBUTE)((ULONG_PTR)&IndexRecord->Header + IndexRecord->Header.FirstEntryOffset);
@@ -2893,7 +3289,7 @@ BrowseSubNodeIndexEntries(PNTFS_VCB Vcb,
                                                    OutMFTIndex);
                 if (NT_SUCCESS(Status))
                 {
-                    ExFreePoolWithTag(IndexRecord, TAG_NTFS);
+                    NtfsReleaseCachedRecord(CachedRecord);
                     return Status;
                 }
             }
@@ -2911,7 +3307,7 @@ BrowseSubNodeIndexEntries(PNTFS_VCB Vcb,
         {
             *StartEntry = *CurrentEntry;
             *OutMFTIndex = (IndexEntry->Data.Directory.IndexedFile & NTFS_MFT_MASK);
-            ExFreePoolWithTag(IndexRecord, TAG_NTFS);
+            NtfsReleaseCachedRecord(CachedRecord);
             return STATUS_SUCCESS;
         }
 
@@ -2921,7 +3317,7 @@ BrowseSubNodeIndexEntries(PNTFS_VCB Vcb,
         IndexEntry = (PINDEX_ENTRY_ATTRIBUTE)((PCHAR)IndexEntry + IndexEntry->Length);
     }
 
-    ExFreePoolWithTag(IndexRecord, TAG_NTFS);
+    NtfsReleaseCachedRecord(CachedRecord);
 
     return STATUS_OBJECT_PATH_NOT_FOUND;
 }
@@ -20,6 +20,7 @@
 #define TAG_IRP_CTXT 'iftN'
 #define TAG_ATT_CTXT 'aftN'
 #define TAG_FILE_REC 'rftN'
+#define TAG_REC_CACHE 'cftN'
 
 #define ROUND_UP(N, S) ((((N) + (S) - 1) / (S)) * (S))
 #define ROUND_DOWN(N, S) ((N) - ((N) % (S)))
@@ -101,6 +102,33 @@ typedef struct
     ULONG Size;
 } NTFSIDENTIFIER, *PNTFSIDENTIFIER;
 
+/* A fixed-up file record or index buffer kept around by the record cache */
+typedef struct _NTFS_CACHED_RECORD
+{
+    LIST_ENTRY HashLink;
+    LIST_ENTRY LruLink;
+    ULONGLONG FileReference;
+    ULONGLONG VCN;
+    LONG RefCount;
+    ULONG Length;
+    UCHAR Data[ANYSIZE_ARRAY];
+} NTFS_CACHED_RECORD, *PNTFS_CACHED_RECORD;
+
+/* VCN used for the file record itself, index buffers use their real VCN */
+#define NTFS_CACHE_FILE_RECORD      ((ULONGLONG)-1)
+
+#define NTFS_RECORD_CACHE_BUCKETS   64
+#define NTFS_RECORD_CACHE_ENTRIES   256
+
+typedef struct _NTFS_RECORD_CACHE
+{
+    KSPIN_LOCK Lock;
+    LIST_ENTRY HashBuckets[NTFS_RECORD_CACHE_BUCKETS];
+    LIST_ENTRY LruList;
+    ULONG Count;
+    ULONG Generation;
+} NTFS_RECORD_CACHE, *PNTFS_RECORD_CACHE;
+
 typedef struct
 {
     NTFSIDENTIFIER Identifier;
@@ -122,6 +150,7 @@ typedef struct
     NTFS_INFO NtfsInfo;
 
     NPAGED_LOOKASIDE_LIST FileRecLookasideList;
+    NTFS_RECORD_CACHE RecordCache;
 
     ULONG MftDataOffset;
     ULONG Flags;
@@ -305,6 +334,11 @@ typedef struct
     };
 } NTFS_ATTR_RECORD, *PNTFS_ATTR_RECORD;
 
+/* NTFS_ATTR_RECORD.Flags */
+#define ATTR_IS_COMPRESSED  0x0001
+#define ATTR_IS_ENCRYPTED   0x4000
+#define ATTR_IS_SPARSE      0x8000
+
 // The beginning and length of an attribute record are always aligned to an 8-byte boundary,
 // relative to the beginning of the file record.
 #define ATTR_RECORD_ALIGNMENT 8
@@ -481,6 +515,18 @@ typedef struct
     CCHAR PriorityBoost;
 } NTFS_IRP_CONTEXT, *PNTFS_IRP_CONTEXT;
 
+/* Decompressed compression units of a compressed stream, kept per FCB */
+#define NTFS_UNIT_CACHE_ENTRIES 4
+
+typedef struct _NTFS_UNIT_CACHE
+{
+    FAST_MUTEX Lock;
+    ULONG UnitSize;
+    ULONG NextVictim;
+    ULONGLONG UnitVCN[NTFS_UNIT_CACHE_ENTRIES];
+    PUCHAR Unit[NTFS_UNIT_CACHE_ENTRIES];
+} NTFS_UNIT_CACHE, *PNTFS_UNIT_CACHE;
+
 typedef struct _NTFS_ATTR_CONTEXT
 {
     PUCHAR            CacheRun;
@@ -492,6 +538,7 @@ typedef struct _NTFS_ATTR_CONTEXT
     LARGE_MCB           DataRunsMCB;
     ULONGLONG           FileMFTIndex;
     PNTFS_ATTR_RECORD    pRecord;
+    PNTFS_UNIT_CACHE    UnitCache;
 } NTFS_ATTR_CONTEXT, *PNTFS_ATTR_CONTEXT;
 
 #define FCB_CACHE_INITIALIZED   0x0001
@@ -530,6 +577,8 @@ typedef struct _FCB
 
     FILENAME_ATTRIBUTE Entry;
 
+    PNTFS_UNIT_CACHE UnitCache;
+
 } NTFS_FCB, *PNTFS_FCB;
 
 typedef struct _FIND_ATTR_CONTXT
@@ -1019,6 +1068,12 @@ PrepareAttributeContext(PNTFS_ATTR_RECORD AttrRecord);
 VOID
 ReleaseAttributeContext(PNTFS_ATTR_CONTEXT Context);
 
+PNTFS_UNIT_CACHE
+NtfsAllocateUnitCache(ULONG UnitSize);
+
+VOID
+NtfsFreeUnitCache(PNTFS_UNIT_CACHE UnitCache);
+
 ULONG
 ReadAttribute(PDEVICE_EXTENSION Vcb,
               PNTFS_ATTR_CONTEXT Context,
@@ -1197,6 +1252,39 @@ NtfsFindMftRecord(PDEVICE_EXTENSION Vcb,
                   BOOLEAN CaseSensitive,
                   ULONGLONG *OutMFTIndex);
 
+/* reccache.c */
+VOID
+NtfsInitializeRecordCache(PDEVICE_EXTENSION Vcb);
+
+VOID
+NtfsFreeRecordCache(PDEVICE_EXTENSION Vcb);
+
+ULONG
+NtfsGetRecordCacheGeneration(PDEVICE_EXTENSION Vcb);
+
+PNTFS_CACHED_RECORD
+NtfsAllocateCachedRecord(ULONGLONG FileReference,
+                         ULONGLONG VCN,
+                         ULONG Length);
+
+PNTFS_CACHED_RECORD
+NtfsLookupCachedRecord(PDEVICE_EXTENSION Vcb,
+                       ULONGLONG FileReference,
+                       ULONGLONG VCN);
+
+VOID
+NtfsInsertCachedRecord(PDEVICE_EXTENSION Vcb,
+                       PNTFS_CACHED_RECORD Record,
+                       ULONG Generation);
+
+VOID
+NtfsReleaseCachedRecord(PNTFS_CACHED_RECORD Record);
+
+VOID
+NtfsInvalidateCachedRecords(PDEVICE_EXTENSION Vcb,
+                            ULONGLONG MftIndex);
+
+
 /* misc.c */
 
 BOOLEAN
@@ -0,0 +1,307 @@
+/*
+ *  ReactOS kernel
+ *  Copyright (C) 2017 ReactOS Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * COPYRIGHT:        See COPYING in the top level directory
+ * PROJECT:          ReactOS kernel
+ * FILE:             drivers/filesystem/ntfs/reccache.c
+ * PURPOSE:          NTFS filesystem driver
+ * PROGRAMMER:       ReactOS Team
+ */
+
+/*
+ * The record cache keeps fixed-up copies of recently used file records and
+ * $I30 index buffers, so that path lookups don't have to go to the disk and
+ * reapply the update sequence array for every component of every open.
+ *
+ * Entries are keyed by file reference and VCN, file records use
+ * NTFS_CACHE_FILE_RECORD as their VCN. Every entry is reference counted, the
+ * cache holds one reference as long as the entry is hashed, and anyone who
+ * got it from NtfsLookupCachedRecord() holds another one until calling
+ * NtfsReleaseCachedRecord(). This lets an index buffer be browsed without
+ * copying it, even if it gets invalidated or evicted meanwhile.
+ *
+ * Whoever writes a file record or an index buffer must call
+ * NtfsInvalidateCachedRecords() once the write is done. That also bumps the
+ * cache generation: a reader has to fetch the generation before reading from
+ * the disk and NtfsInsertCachedRecord() refuses to insert what it read if a
+ * write completed in the meantime, as it might be stale already.
+ */
+
+/* INCLUDES *****************************************************************/
+
+#include "ntfs.h"
+
+#define NDEBUG
+#include <debug.h>
+
+/* FUNCTIONS ****************************************************************/
+
+static
+ULONG
+NtfsRecordCacheHash(ULONGLONG FileReference,
+                    ULONGLONG VCN)
+{
+    ULONGLONG Key;
+
+    /* Index buffers of the same directory shouldn't pile up in one bucket */
+    Key = (FileReference & NTFS_MFT_MASK) * 0x9E3779B1 + VCN;
+    return (ULONG)(Key ^ (Key >> 32)) % NTFS_RECORD_CACHE_BUCKETS;
+}
+
+/* Unlinks an entry and drops the reference of the cache. Lock must be held */
+static
+VOID
+NtfsRemoveCachedRecord(PNTFS_RECORD_CACHE Cache,
+                       PNTFS_CACHED_RECORD Record)
+{
+    RemoveEntryList(&Record->HashLink);
+    RemoveEntryList(&Record->LruLink);
+    Cache->Count--;
+    NtfsReleaseCachedRecord(Record);
+}
+
+VOID
+NtfsInitializeRecordCache(PDEVICE_EXTENSION Vcb)
+{
+    PNTFS_RECORD_CACHE Cache = &Vcb->RecordCache;
+    ULONG i;
+
+    KeInitializeSpinLock(&Cache->Lock);
+    for (i = 0; i < NTFS_RECORD_CACHE_BUCKETS; i++)
+        InitializeListHead(&Cache->HashBuckets[i]);
+    InitializeListHead(&Cache->LruList);
+    Cache->Count = 0;
+    Cache->Generation = 0;
+}
+
+VOID
+NtfsFreeRecordCache(PDEVICE_EXTENSION Vcb)
+{
+    PNTFS_RECORD_CACHE Cache = &Vcb->RecordCache;
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&Cache->Lock, &OldIrql);
+    while (!IsListEmpty(&Cache->LruList))
+    {
+        NtfsRemoveCachedRecord(Cache, CONTAINING_RECORD(Cache->LruList.Flink, NTFS_CACHED_RECORD, LruLink));
+    }
+    Cache->Generation++;
+    KeReleaseSpinLock(&Cache->Lock, OldIrql);
+}
+
+ULONG
+NtfsGetRecordCacheGeneration(PDEVICE_EXTENSION Vcb)
+{
+    PNTFS_RECORD_CACHE Cache = &Vcb->RecordCache;
+    ULONG Generation;
+    KIRQL OldIrql;
+
+    KeAcquireSpinLock(&Cache->Lock, &OldIrql);
+    Generation = Cache->Generation;
+    KeReleaseSpinLock(&Cache->Lock, OldIrql);
+
+    return Generation;
+}
+
+/**
+* @name NtfsAllocateCachedRecord
+* @implemented
+*
+* Allocates a record cache entry that isn't in the cache yet. The caller owns
+* the only reference and is expected to fill in Data before inserting it.
+*
+* @return
+* A pointer to the new entry, or NULL if we ran out of memory.
+*/
+PNTFS_CACHED_RECORD
+NtfsAllocateCachedRecord(ULONGLONG FileReference,
+                         ULONGLONG VCN,
+                         ULONG Length)
+{
+    PNTFS_CACHED_RECORD Record;
+
+    Record = ExAllocatePoolWithTag(NonPagedPool,
+                                   FIELD_OFFSET(NTFS_CACHED_RECORD, Data) + Length,
+                                   TAG_REC_CACHE);
+    if (Record == NULL)
+        return NULL;
+
+    InitializeListHead(&Record->HashLink);
+    InitializeListHead(&Record->LruLink);
+    Record->FileReference = FileReference;
+    Record->VCN = VCN;
+    Record->RefCount = 1;
+    Record->Length = Length;
+
+    return Record;
+}
+
+/**
+* @name NtfsLookupCachedRecord
+* @implemented
+*
+* Looks up a file record or an index buffer in the record cache.
+*
+* @param FileReference
+* File reference of the file record, or of the directory owning the index buffer.
+* Only the MFT index part is used for file records.
+*
+* @param VCN
+* VCN of the index buffer, or NTFS_CACHE_FILE_RECORD.
+*
+* @return
+* A referenced entry which must be released with NtfsReleaseCachedRecord(), or NULL
+* if it isn't cached.
+*/
+PNTFS_CACHED_RECORD
+NtfsLookupCachedRecord(PDEVICE_EXTENSION Vcb,
+                       ULONGLONG FileReference,
+                       ULONGLONG VCN)
+{
+    PNTFS_RECORD_CACHE Cache = &Vcb->RecordCache;
+    PNTFS_CACHED_RECORD Record;
+    PLIST_ENTRY Bucket, Entry;
+    KIRQL OldIrql;
+
+    Bucket = &Cache->HashBuckets[NtfsRecordCacheHash(FileReference, VCN)];
+
+    KeAcquireSpinLock(&Cache->Lock, &OldIrql);
+    for (Entry = Bucket->Flink; Entry != Bucket; Entry = Entry->Flink)
+    {
+        Record = CONTAINING_RECORD(Entry, NTFS_CACHED_RECORD, HashLink);
+        if (Record->FileReference == FileReference && Record->VCN == VCN)
+        {
+            InterlockedIncrement(&Record->RefCount);
+
+            /* Most recently used */
+            RemoveEntryList(&Record->LruLink);
+            InsertHeadList(&Cache->LruList, &Record->LruLink);
+
+            KeReleaseSpinLock(&Cache->Lock, OldIrql);
+            return Record;
+        }
+    }
+    KeReleaseSpinLock(&Cache->Lock, OldIrql);
+
+    return NULL;
+}
+
+/**
+* @name NtfsInsertCachedRecord
+* @implemented
+*
+* Adds an entry from NtfsAllocateCachedRecord() to the record cache, evicting the
+* least recently used entries if the cache is full. The caller keeps its reference.
+*
+* @param Generation
+* Cache generation the caller got before reading the data from the disk. Nothing is
+* inserted if a file record or index buffer was written since then.
+*/
+VOID
+NtfsInsertCachedRecord(PDEVICE_EXTENSION Vcb,
+                       PNTFS_CACHED_RECORD Record,
+                       ULONG Generation)
+{
+    PNTFS_RECORD_CACHE Cache = &Vcb->RecordCache;
+    PNTFS_CACHED_RECORD Other;
+    PLIST_ENTRY Bucket, Entry;
+    KIRQL OldIrql;
+
+    Bucket = &Cache->HashBuckets[NtfsRecordCacheHash(Record->FileReference, Record->VCN)];
+
+    KeAcquireSpinLock(&Cache->Lock, &OldIrql);
+
+    if (Generation != Cache->Generation)
+    {
+        KeReleaseSpinLock(&Cache->Lock, OldIrql);
+        return;
+    }
+
+    /* Someone might have read it at the same time */
+    for (Entry = Bucket->Flink; Entry != Bucket; Entry = Entry->Flink)
+    {
+        Other = CONTAINING_RECORD(Entry, NTFS_CACHED_RECORD, HashLink);
+        if (Other->FileReference == Record->FileReference && Other->VCN == Record->VCN)
+        {
+            KeReleaseSpinLock(&Cache->Lock, OldIrql);
+            return;
+        }
+    }
+
+    while (Cache->Count >= NTFS_RECORD_CACHE_ENTRIES)
+    {
+        NtfsRemoveCachedRecord(Cache, CONTAINING_RECORD(Cache->LruList.Blink, NTFS_CACHED_RECORD, LruLink));
+    }
+
+    /* Reference for the cache */
+    InterlockedIncrement(&Record->RefCount);
+    InsertHeadList(Bucket, &Record->HashLink);
+    InsertHeadList(&Cache->LruList, &Record->LruLink);
+    Cache->Count++;
+
+    KeReleaseSpinLock(&Cache->Lock, OldIrql);
+}
+
+VOID
+NtfsReleaseCachedRecord(PNTFS_CACHED_RECORD Record)
+{
+    if (InterlockedDecrement(&Record->RefCount) == 0)
+    {
+        ExFreePoolWithTag(Record, TAG_REC_CACHE);
+    }
+}
+
+/**
+* @name NtfsInvalidateCachedRecords
+* @implemented
+*
+* Drops the cached file record of a file along with all of its cached index buffers.
+* Must be called after the file record or one of its index buffers was written.
+*
+* @param MftIndex
+* Index of the file in the master file table. Sequence numbers are ignored.
+*/
+VOID
+NtfsInvalidateCachedRecords(PDEVICE_EXTENSION Vcb,
+                            ULONGLONG MftIndex)
+{
+    PNTFS_RECORD_CACHE Cache = &Vcb->RecordCache;
+    PNTFS_CACHED_RECORD Record;
+    PLIST_ENTRY Entry;
+    KIRQL OldIrql;
+
+    MftIndex &= NTFS_MFT_MASK;
+
+    KeAcquireSpinLock(&Cache->Lock, &OldIrql);
+
+    Cache->Generation++;
+
+    Entry = Cache->LruList.Flink;
+    while (Entry != &Cache->LruList)
+    {
+        Record = CONTAINING_RECORD(Entry, NTFS_CACHED_RECORD, LruLink);
+        Entry = Entry->Flink;
+
+        if ((Record->FileReference & NTFS_MFT_MASK) == MftIndex)
+        {
+            NtfsRemoveCachedRecord(Cache, Record);
+        }
+    }
+
+    KeReleaseSpinLock(&Cache->Lock, OldIrql);
+}
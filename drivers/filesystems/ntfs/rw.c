@@ -72,13 +72,6 @@ NtfsReadFile(PDEVICE_EXTENSION DeviceExt,
 
     Fcb = (PNTFS_FCB)FileObject->FsContext;
 
-    if (NtfsFCBIsCompressed(Fcb))
-    {
-        DPRINT1("Compressed file!\n");
-        UNIMPLEMENTED;
-        return STATUS_NOT_IMPLEMENTED;
-    }
-
     FileRecord = ExAllocateFromNPagedLookasideList(&DeviceExt->FileRecLookasideList);
     if (FileRecord == NULL)
     {
@@ -126,6 +119,27 @@ NtfsReadFile(PDEVICE_EXTENSION DeviceExt,
         return Status;
     }
 
+    // Compressed streams keep their most recently decompressed units around
+    if (DataContext->pRecord->IsNonResident &&
+        (DataContext->pRecord->Flags & ATTR_IS_COMPRESSED) &&
+        DataContext->pRecord->NonResident.CompressionUnit != 0)
+    {
+        if (Fcb->UnitCache == NULL)
+        {
+            PNTFS_UNIT_CACHE UnitCache;
+
+            UnitCache = NtfsAllocateUnitCache(DeviceExt->NtfsInfo.BytesPerCluster << DataContext->pRecord->NonResident.CompressionUnit);
+            if (UnitCache != NULL &&
+                InterlockedCompareExchangePointer((PVOID *)&Fcb->UnitCache, UnitCache, NULL) != NULL)
+            {
+                // Someone else was faster
+                NtfsFreeUnitCache(UnitCache);
+            }
+        }
+
+        DataContext->UnitCache = Fcb->UnitCache;
+    }
+
     StreamSize = AttributeDataLength(DataContext->pRecord);
     if (ReadOffset >= StreamSize)
     {
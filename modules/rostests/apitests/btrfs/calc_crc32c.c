@@ -0,0 +1,129 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for the btrfs driver's CRC32C implementations
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+#include <intrin.h>
+
+/* The implementations are private to the driver, so build its source right here */
+BOOL have_sse42;
+#include "crc32c.c"
+
+typedef UINT32 (*PCRC32C_ROUTINE)(UINT32, const UINT8 *, ULONG);
+
+static UINT8 Buffer[3 * 65536 + 64];
+
+static UINT32 crc32c_table(UINT32 crc, const UINT8 *buf, ULONG len)
+{
+    for (; len > 0; len--, buf++)
+    {
+        crc = crctable[(crc ^ *buf) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static
+VOID
+TestCorrectness(PCSTR Name, PCRC32C_ROUTINE Routine)
+{
+    ULONG Offset, Length;
+    UINT32 Expected, Crc;
+    ULONG Failures = 0;
+
+    /* Well known check value */
+    Crc = Routine(0xffffffff, (const UINT8 *)"123456789", 9) ^ 0xffffffff;
+    ok(Crc == 0xe3069283, "%s: check value is 0x%08x\n", Name, Crc);
+
+    /* Every alignment, and lengths around all the block sizes */
+    for (Offset = 0; Offset < 16; Offset++)
+    {
+        for (Length = 0; Length <= sizeof(Buffer) - 16; Length = (Length < 64) ? Length + 1 : Length * 5 / 4 + 7)
+        {
+            Expected = crc32c_table(0x12345678, Buffer + Offset, Length);
+            Crc = Routine(0x12345678, Buffer + Offset, Length);
+            if (Crc != Expected)
+            {
+                if (Failures++ < 10)
+                    ok(0, "%s: offset %lu length %lu: 0x%08x, expected 0x%08x\n", Name, Offset, Length, Crc, Expected);
+            }
+        }
+    }
+
+    ok(Failures == 0, "%s: %lu mismatches\n", Name, Failures);
+}
+
+static
+VOID
+Benchmark(PCSTR Name, PCRC32C_ROUTINE Routine, ULONG Length)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Iterations, i;
+    UINT32 Crc = 0;
+    double Seconds;
+
+    Iterations = (64 * 1024 * 1024) / Length;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < Iterations; i++)
+    {
+        Crc = Routine(Crc, Buffer, Length);
+    }
+    QueryPerformanceCounter(&End);
+
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    trace("%-16s %6lu bytes: %8.1f MB/s (0x%08x)\n", Name, Length,
+          Seconds > 0 ? (double)Iterations * Length / Seconds / (1024 * 1024) : 0.0, Crc);
+}
+
+START_TEST(calc_crc32c)
+{
+    static const ULONG Lengths[] = { 512, 4096, 16384, 65536 };
+    static const struct
+    {
+        PCSTR Name;
+        PCRC32C_ROUTINE Routine;
+        BOOLEAN NeedsSse42;
+    } Routines[] =
+    {
+        { "table", crc32c_table, FALSE },
+        { "slicing-by-8", crc32c_sw, FALSE },
+#if defined(_X86_) || defined(_AMD64_)
+        { "sse4.2", crc32c_hw_serial, TRUE },
+        { "sse4.2 3-way", crc32c_hw, TRUE },
+#endif
+    };
+    int CpuInfo[4];
+    ULONG i, j;
+
+    for (i = 0; i < sizeof(Buffer); i++)
+    {
+        Buffer[i] = (UINT8)(i * 2654435761U >> 13);
+    }
+
+    __cpuid(CpuInfo, 1);
+    have_sse42 = (CpuInfo[2] & (1 << 20)) != 0;
+    if (!have_sse42)
+        skip("SSE4.2 is not supported, only testing the software paths\n");
+
+    init_crc32c();
+
+    for (i = 0; i < sizeof(Routines) / sizeof(Routines[0]); i++)
+    {
+        if (Routines[i].NeedsSse42 && !have_sse42)
+            continue;
+
+        TestCorrectness(Routines[i].Name, Routines[i].Routine);
+        for (j = 0; j < sizeof(Lengths) / sizeof(Lengths[0]); j++)
+        {
+            Benchmark(Routines[i].Name, Routines[i].Routine, Lengths[j]);
+        }
+    }
+
+    /* And the dispatcher the driver actually calls */
+    TestCorrectness("calc_crc32c", (PCRC32C_ROUTINE)calc_crc32c);
+}
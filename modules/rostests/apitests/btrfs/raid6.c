@@ -0,0 +1,252 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for the btrfs driver's RAID6 Galois field routines
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+#include <intrin.h>
+
+/* The implementations are private to the driver, so build its source right here */
+BOOL have_ssse3;
+#include "galois.c"
+
+#define DATA_STRIPES 6
+#define STRIPE_SIZE 65536
+
+/* Data stripes, then P, then Q, like the driver lays them out */
+static UINT8 Stripes[DATA_STRIPES + 2][STRIPE_SIZE];
+static UINT8 Saved[2][STRIPE_SIZE];
+static UINT8 Scratch[2][STRIPE_SIZE];
+
+static UINT8 ref_mul(UINT8 a, UINT8 b)
+{
+    UINT8 r = 0;
+
+    while (b)
+    {
+        if (b & 1)
+            r ^= a;
+        a = (a << 1) ^ ((a & 0x80) ? 0x1d : 0);
+        b >>= 1;
+    }
+
+    return r;
+}
+
+static VOID XorBuffer(UINT8 *Dest, const UINT8 *Src, ULONG Length)
+{
+    ULONG i;
+
+    for (i = 0; i < Length; i++)
+    {
+        Dest[i] ^= Src[i];
+    }
+}
+
+static
+VOID
+TestCorrectness(VOID)
+{
+    UINT8 Data[80], Expected[80], Xor[80], P[80], Q[80], Pxy[80];
+    ULONG Length, i, Failures = 0;
+    UINT8 c, a, b;
+
+    for (Length = 0; Length <= sizeof(Data); Length++)
+    {
+        for (i = 0; i < Length; i++)
+        {
+            Data[i] = (UINT8)(i * 37 + Length);
+            Xor[i] = (UINT8)(i * 11 + 5);
+            P[i] = (UINT8)(i * 101);
+            Q[i] = (UINT8)(i * 13 + 7);
+            Pxy[i] = (UINT8)(i ^ 0x5a);
+        }
+
+        /* Q = 2Q + D */
+        for (i = 0; i < Length; i++) Expected[i] = ref_mul(Data[i], 2) ^ Xor[i];
+        galois_double_xor(Data, Xor, Length);
+        if (memcmp(Data, Expected, Length)) Failures++;
+
+        c = (UINT8)(Length * 7 + 3);
+        for (i = 0; i < Length; i++) Expected[i] = ref_mul(Data[i], c);
+        galois_mul(Data, c, Length);
+        if (memcmp(Data, Expected, Length)) Failures++;
+
+        /* Dividing by 2^n undoes multiplying by it */
+        memcpy(Expected, Data, Length);
+        galois_mul(Data, gpow2((UINT8)Length), Length);
+        galois_divpower(Data, (UINT8)Length, Length);
+        if (memcmp(Data, Expected, Length)) Failures++;
+
+        a = (UINT8)(Length + 1);
+        b = (UINT8)(Length * 3);
+        for (i = 0; i < Length; i++) Expected[i] = ref_mul(a, P[i] ^ Pxy[i]) ^ ref_mul(b, Q[i] ^ Data[i]);
+        galois_recover(Data, Pxy, P, Q, a, b, Length);
+        if (memcmp(Data, Expected, Length)) Failures++;
+    }
+
+    ok(Failures == 0, "%s: %lu mismatches\n", have_ssse3 ? "ssse3" : "generic", Failures);
+}
+
+static
+VOID
+GenerateParity(VOID)
+{
+    ULONG i;
+
+    memcpy(Stripes[DATA_STRIPES], Stripes[DATA_STRIPES - 1], STRIPE_SIZE);
+    memcpy(Stripes[DATA_STRIPES + 1], Stripes[DATA_STRIPES - 1], STRIPE_SIZE);
+
+    for (i = DATA_STRIPES - 1; i-- > 0;)
+    {
+        XorBuffer(Stripes[DATA_STRIPES], Stripes[i], STRIPE_SIZE);
+        galois_double_xor(Stripes[DATA_STRIPES + 1], Stripes[i], STRIPE_SIZE);
+    }
+}
+
+/* Same steps as raid6_recover2 in the driver, for two missing data stripes */
+static
+VOID
+RecoverTwo(ULONG x, ULONG y)
+{
+    UINT8 *qxy = Scratch[0], *pxy = Scratch[1];
+    UINT8 gyx, gx, denom, a, b;
+    ULONG i;
+
+    memset(qxy, 0, STRIPE_SIZE);
+    memset(pxy, 0, STRIPE_SIZE);
+
+    for (i = DATA_STRIPES; i-- > 0;)
+    {
+        if (i == x || i == y)
+        {
+            galois_double(qxy, STRIPE_SIZE);
+        }
+        else
+        {
+            galois_double_xor(qxy, Stripes[i], STRIPE_SIZE);
+            XorBuffer(pxy, Stripes[i], STRIPE_SIZE);
+        }
+    }
+
+    gyx = gpow2((UINT8)(y - x));
+    gx = gpow2((UINT8)(255 - x));
+    denom = gdiv(1, gyx ^ 1);
+    a = gmul(gyx, denom);
+    b = gmul(gx, denom);
+
+    galois_recover(qxy, pxy, Stripes[DATA_STRIPES], Stripes[DATA_STRIPES + 1], a, b, STRIPE_SIZE);
+
+    XorBuffer(pxy, qxy, STRIPE_SIZE);
+    XorBuffer(pxy, Stripes[DATA_STRIPES], STRIPE_SIZE);
+}
+
+/* One missing data stripe and no P, so it has to come from Q */
+static
+VOID
+RecoverFromQ(ULONG x)
+{
+    UINT8 *out = Scratch[0];
+    ULONG i;
+
+    memset(out, 0, STRIPE_SIZE);
+
+    for (i = DATA_STRIPES; i-- > 0;)
+    {
+        if (i == x)
+            galois_double(out, STRIPE_SIZE);
+        else
+            galois_double_xor(out, Stripes[i], STRIPE_SIZE);
+    }
+
+    XorBuffer(out, Stripes[DATA_STRIPES + 1], STRIPE_SIZE);
+
+    if (x != 0)
+        galois_divpower(out, (UINT8)x, STRIPE_SIZE);
+}
+
+static
+VOID
+TestDegradedRead(VOID)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    ULONG Iterations = 256, i;
+    double Seconds;
+
+    /* Check that reconstruction gives back what was lost */
+    RecoverTwo(1, 4);
+    ok(!memcmp(Scratch[0], Stripes[1], STRIPE_SIZE), "%s: stripe 1 not recovered\n", have_ssse3 ? "ssse3" : "generic");
+    ok(!memcmp(Scratch[1], Stripes[4], STRIPE_SIZE), "%s: stripe 4 not recovered\n", have_ssse3 ? "ssse3" : "generic");
+
+    RecoverFromQ(3);
+    ok(!memcmp(Scratch[0], Stripes[3], STRIPE_SIZE), "%s: stripe 3 not recovered from Q\n", have_ssse3 ? "ssse3" : "generic");
+
+    QueryPerformanceFrequency(&Frequency);
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < Iterations; i++)
+    {
+        RecoverTwo(i % (DATA_STRIPES - 1), DATA_STRIPES - 1);
+    }
+    QueryPerformanceCounter(&End);
+
+    /* Count the data returned to the reader, i.e. the whole stripe row */
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    trace("%-8s two missing: %8.1f MB/s\n", have_ssse3 ? "ssse3" : "generic",
+          Seconds > 0 ? (double)Iterations * DATA_STRIPES * STRIPE_SIZE / Seconds / (1024 * 1024) : 0.0);
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < Iterations; i++)
+    {
+        RecoverFromQ(1 + i % (DATA_STRIPES - 1));
+    }
+    QueryPerformanceCounter(&End);
+
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    trace("%-8s P and one missing: %8.1f MB/s\n", have_ssse3 ? "ssse3" : "generic",
+          Seconds > 0 ? (double)Iterations * DATA_STRIPES * STRIPE_SIZE / Seconds / (1024 * 1024) : 0.0);
+}
+
+START_TEST(raid6)
+{
+    int CpuInfo[4];
+    BOOL HaveSsse3;
+    ULONG i, j;
+
+    for (i = 0; i < DATA_STRIPES; i++)
+    {
+        for (j = 0; j < STRIPE_SIZE; j++)
+        {
+            Stripes[i][j] = (UINT8)((i * STRIPE_SIZE + j) * 2654435761U >> 13);
+        }
+    }
+
+    GenerateParity();
+    memcpy(Saved[0], Stripes[DATA_STRIPES], STRIPE_SIZE);
+    memcpy(Saved[1], Stripes[DATA_STRIPES + 1], STRIPE_SIZE);
+
+    __cpuid(CpuInfo, 1);
+    HaveSsse3 = (CpuInfo[2] & (1 << 9)) != 0;
+
+    /* Always run the generic code, then the SSSE3 one if we can */
+    have_ssse3 = FALSE;
+    TestCorrectness();
+    TestDegradedRead();
+
+    if (!HaveSsse3)
+    {
+        skip("SSSE3 is not supported\n");
+        return;
+    }
+
+    have_ssse3 = TRUE;
+    TestCorrectness();
+
+    GenerateParity();
+    ok(!memcmp(Saved[0], Stripes[DATA_STRIPES], STRIPE_SIZE), "P differs between the generic and SSSE3 code\n");
+    ok(!memcmp(Saved[1], Stripes[DATA_STRIPES + 1], STRIPE_SIZE), "Q differs between the generic and SSSE3 code\n");
+
+    TestDegradedRead();
+}
@@ -0,0 +1,14 @@
+#define __ROS_LONG64__
+
+#define STANDALONE
+#include <apitest.h>
+
+extern void func_calc_crc32c(void);
+extern void func_raid6(void);
+
+const struct test winetest_testlist[] =
+{
+    { "calc_crc32c", func_calc_crc32c },
+    { "raid6", func_raid6 },
+    { 0, 0 }
+};
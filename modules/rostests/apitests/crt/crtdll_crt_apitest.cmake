@@ -428,9 +428,9 @@ list(APPEND SOURCE_CRTDLL
 #    mbtowc.c
 #    memchr.c
 #    memcmp.c
-#    memcpy.c
-#    memmove.c
-#    memset.c
+    memcpy.c
+    memmove.c
+    memset.c
 #    mktime.c
 #    modf.c
 #    perror.c
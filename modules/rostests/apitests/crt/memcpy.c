@@ -0,0 +1,117 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for memcpy
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GUARD_SIZE 64
+#define MAX_SIZE 300
+#define MAX_BENCH_SIZE (16 * 1024 * 1024)
+
+static unsigned char Source[MAX_SIZE + 2 * GUARD_SIZE];
+static unsigned char Dest[MAX_SIZE + 2 * GUARD_SIZE];
+
+static
+void
+Test_memcpy(void)
+{
+    size_t Size, SrcAlign, DstAlign, i;
+    unsigned char *Src, *Dst;
+    void *Result;
+    ULONG Failures = 0;
+
+    for (i = 0; i < sizeof(Source); i++)
+        Source[i] = (unsigned char)(i * 7 + 1);
+
+    for (Size = 0; Size <= MAX_SIZE; Size++)
+    {
+        for (SrcAlign = 0; SrcAlign < 16; SrcAlign++)
+        {
+            for (DstAlign = 0; DstAlign < 16; DstAlign++)
+            {
+                Src = Source + GUARD_SIZE / 2 + SrcAlign;
+                Dst = Dest + GUARD_SIZE / 2 + DstAlign;
+
+                memset(Dest, 0xCC, sizeof(Dest));
+                Result = memcpy(Dst, Src, Size);
+
+                if (Result != Dst || memcmp(Dst, Src, Size) != 0)
+                {
+                    Failures++;
+                    continue;
+                }
+
+                /* Nothing outside the destination may be touched */
+                for (i = 0; i < sizeof(Dest); i++)
+                {
+                    if ((&Dest[i] < Dst || &Dest[i] >= Dst + Size) && Dest[i] != 0xCC)
+                    {
+                        Failures++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    ok(Failures == 0, "%lu mismatches\n", Failures);
+}
+
+static
+void
+Benchmark_memcpy(void)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    unsigned char *Src, *Dst;
+    size_t Size, Iterations, i;
+    double Seconds;
+
+    Src = malloc(MAX_BENCH_SIZE);
+    Dst = malloc(MAX_BENCH_SIZE);
+    if (!Src || !Dst)
+    {
+        skip("Out of memory\n");
+        free(Src);
+        free(Dst);
+        return;
+    }
+
+    memset(Src, 0x5A, MAX_BENCH_SIZE);
+    memset(Dst, 0, MAX_BENCH_SIZE);
+
+    QueryPerformanceFrequency(&Frequency);
+
+    /* Move about 256 MB per size, capped for the tiny ones */
+    for (Size = 1; Size <= MAX_BENCH_SIZE; Size *= 4)
+    {
+        Iterations = min(256 * 1024 * 1024 / Size, 4 * 1024 * 1024);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+        {
+            memcpy(Dst, Src, Size);
+        }
+        QueryPerformanceCounter(&End);
+
+        ok(Dst[Size - 1] == 0x5A, "Wrong data at size %Iu\n", Size);
+
+        Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+        trace("memcpy %8Iu bytes: %10.1f MB/s\n", Size,
+              Seconds > 0 ? (double)Size * Iterations / Seconds / (1024 * 1024) : 0.0);
+    }
+
+    free(Src);
+    free(Dst);
+}
+
+START_TEST(memcpy)
+{
+    Test_memcpy();
+    Benchmark_memcpy();
+}
@@ -0,0 +1,61 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for memmove
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#include <string.h>
+
+#define MAX_SIZE 300
+#define MAX_DISTANCE 80
+
+static unsigned char Buffer[MAX_SIZE + 2 * MAX_DISTANCE + 32];
+static unsigned char Expected[sizeof(Buffer)];
+
+static
+void
+Reference_memmove(unsigned char *Dst, const unsigned char *Src, size_t Size)
+{
+    unsigned char Temp[MAX_SIZE];
+    size_t i;
+
+    for (i = 0; i < Size; i++)
+        Temp[i] = Src[i];
+    for (i = 0; i < Size; i++)
+        Dst[i] = Temp[i];
+}
+
+START_TEST(memmove)
+{
+    size_t Size, SrcOffset, i;
+    ptrdiff_t Distance;
+    size_t DstOffset;
+    void *Result;
+    ULONG Failures = 0;
+
+    /* Overlap in both directions, at every distance and misalignment */
+    for (Size = 0; Size <= MAX_SIZE; Size++)
+    {
+        for (Distance = -MAX_DISTANCE; Distance <= MAX_DISTANCE; Distance++)
+        {
+            for (SrcOffset = MAX_DISTANCE; SrcOffset < MAX_DISTANCE + 16; SrcOffset += 5)
+            {
+                DstOffset = SrcOffset + Distance;
+
+                for (i = 0; i < sizeof(Buffer); i++)
+                    Buffer[i] = Expected[i] = (unsigned char)(i * 13 + Size);
+
+                Reference_memmove(Expected + DstOffset, Expected + SrcOffset, Size);
+                Result = memmove(Buffer + DstOffset, Buffer + SrcOffset, Size);
+
+                if (Result != Buffer + DstOffset || memcmp(Buffer, Expected, sizeof(Buffer)) != 0)
+                    Failures++;
+            }
+        }
+    }
+
+    ok(Failures == 0, "%lu mismatches\n", Failures);
+}
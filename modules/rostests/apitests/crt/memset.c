@@ -0,0 +1,106 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for memset
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <apitest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define GUARD_SIZE 64
+#define MAX_SIZE 300
+#define MAX_BENCH_SIZE (16 * 1024 * 1024)
+
+static unsigned char Buffer[MAX_SIZE + 2 * GUARD_SIZE];
+
+static
+void
+Test_memset(void)
+{
+    size_t Size, Align, i;
+    unsigned char *Dst;
+    void *Result;
+    ULONG Failures = 0;
+
+    for (Size = 0; Size <= MAX_SIZE; Size++)
+    {
+        for (Align = 0; Align < 16; Align++)
+        {
+            Dst = Buffer + GUARD_SIZE / 2 + Align;
+
+            memset(Buffer, 0xCC, sizeof(Buffer));
+
+            /* Only the low byte of the value counts */
+            Result = memset(Dst, 0x1A5 + (int)Size, Size);
+            if (Result != Dst)
+                Failures++;
+
+            for (i = 0; i < sizeof(Buffer); i++)
+            {
+                if (&Buffer[i] >= Dst && &Buffer[i] < Dst + Size)
+                {
+                    if (Buffer[i] != (unsigned char)(0xA5 + Size))
+                    {
+                        Failures++;
+                        break;
+                    }
+                }
+                else if (Buffer[i] != 0xCC)
+                {
+                    Failures++;
+                    break;
+                }
+            }
+        }
+    }
+
+    ok(Failures == 0, "%lu mismatches\n", Failures);
+}
+
+static
+void
+Benchmark_memset(void)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    unsigned char *Dst;
+    size_t Size, Iterations, i;
+    double Seconds;
+
+    Dst = malloc(MAX_BENCH_SIZE);
+    if (!Dst)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    QueryPerformanceFrequency(&Frequency);
+
+    for (Size = 1; Size <= MAX_BENCH_SIZE; Size *= 4)
+    {
+        Iterations = min(256 * 1024 * 1024 / Size, 4 * 1024 * 1024);
+
+        QueryPerformanceCounter(&Start);
+        for (i = 0; i < Iterations; i++)
+        {
+            memset(Dst, (int)i, Size);
+        }
+        QueryPerformanceCounter(&End);
+
+        ok(Dst[Size - 1] == (unsigned char)(Iterations - 1), "Wrong data at size %Iu\n", Size);
+
+        Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+        trace("memset %8Iu bytes: %10.1f MB/s\n", Size,
+              Seconds > 0 ? (double)Size * Iterations / Seconds / (1024 * 1024) : 0.0);
+    }
+
+    free(Dst);
+}
+
+START_TEST(memset)
+{
+    Test_memset();
+    Benchmark_memset();
+}
@@ -1122,11 +1122,11 @@ list(APPEND SOURCE_MSVCRT
 #    mbtowc.c
 #    memchr.c
 #    memcmp.c
-#    memcpy.c
+    memcpy.c
 #    memcpy_s.c memmove_s
-#    memmove.c
+    memmove.c
 #    memmove_s.c
-#    memset.c
+    memset.c
 #    mktime.c
 #    modf.c
 #    perror.c
@@ -75,8 +75,8 @@ list(APPEND SOURCE_NTDLL
 #    memchr.c
 #    memcmp.c
     # memcpy == memmove
-#    memmove.c
-#    memset.c
+    memmove.c
+    memset.c
 #    pow.c
 #    qsort.c
 #    sin.c
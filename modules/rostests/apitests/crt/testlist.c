@@ -17,6 +17,9 @@ extern void func__snwprintf(void);
 extern void func__vsnprintf(void);
 extern void func__vsnwprintf(void);
 extern void func_mbstowcs(void);
+extern void func_memcpy(void);
+extern void func_memmove(void);
+extern void func_memset(void);
 extern void func_sprintf(void);
 extern void func_strcpy(void);
 extern void func_strlen(void);
@@ -35,6 +38,8 @@ const struct test winetest_testlist[] =
     { "_vsnprintf", func__vsnprintf },
     { "_vsnwprintf", func__vsnwprintf },
     { "mbstowcs", func_mbstowcs },
+    { "memmove", func_memmove },
+    { "memset", func_memset },
     { "_snprintf", func__snprintf },
     { "_snwprintf", func__snwprintf },
     { "sprintf", func_sprintf },
@@ -45,6 +50,7 @@ const struct test winetest_testlist[] =
     { "wcstombs", func_wcstombs },
 #if defined(TEST_CRTDLL) || defined(TEST_MSVCRT) || defined(TEST_STATIC_CRT)
     // ...
+    { "memcpy", func_memcpy },
 #endif
 #if defined(TEST_STATIC_CRT) || defined(TEST_MSVCRT)
     // ...
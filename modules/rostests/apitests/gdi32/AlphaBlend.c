@@ -0,0 +1,236 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPL - See COPYING in the top level directory
+ * PURPOSE:         Test for AlphaBlend and benchmark of the 32bpp DIB blits
+ * PROGRAMMERS:     ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define BENCH_WIDTH  1024
+#define BENCH_HEIGHT 768
+#define BENCH_ROUNDS 20
+
+static
+HBITMAP
+CreateDIB32(HDC hdc, LONG Width, LONG Height, PULONG *ppulBits)
+{
+    BITMAPINFO bmi;
+
+    ZeroMemory(&bmi, sizeof(bmi));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = Width;
+    bmi.bmiHeader.biHeight = -Height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    return CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, (PVOID*)ppulBits, NULL, 0);
+}
+
+/* What a single channel should come out as, see DIB_32BPP_AlphaBlend */
+static
+ULONG
+BlendChannel(ULONG Dst, ULONG Src, ULONG ConstAlpha, ULONG Alpha)
+{
+    ULONG Result = (Dst * (255 - Alpha)) / 255 + (Src * ConstAlpha) / 255;
+    return Result > 255 ? 255 : Result;
+}
+
+static
+BOOL
+SameColor(ULONG Pixel1, ULONG Pixel2)
+{
+    ULONG i;
+
+    /* Allow for a different rounding */
+    for (i = 0; i < 32; i += 8)
+    {
+        if (abs((LONG)((Pixel1 >> i) & 0xFF) - (LONG)((Pixel2 >> i) & 0xFF)) > 1)
+            return FALSE;
+    }
+    return TRUE;
+}
+
+static
+void
+Test_AlphaBlend(HDC hdcDst, PULONG pulDst, HDC hdcSrc, PULONG pulSrc)
+{
+    static const ULONG Sources[] = { 0x00000000, 0xFF000000, 0xFFFFFFFF, 0x80402010,
+                                     0x7F7F7F7F, 0x40FF8000, 0xC0102030, 0x01010101 };
+    static const ULONG Dests[] = { 0x00000000, 0xFFFFFFFF, 0x80808080, 0x12345678 };
+    static const BYTE ConstAlphas[] = { 255, 128, 0 };
+    BLENDFUNCTION BlendFunc = { AC_SRC_OVER, 0, 255, AC_SRC_ALPHA };
+    ULONG i, j, k, Expected, Alpha, Source, Channel;
+    BOOL ret;
+
+    for (k = 0; k < ARRAYSIZE(ConstAlphas); k++)
+    {
+        BlendFunc.SourceConstantAlpha = ConstAlphas[k];
+        for (i = 0; i < ARRAYSIZE(Sources); i++)
+        {
+            for (j = 0; j < ARRAYSIZE(Dests); j++)
+            {
+                pulSrc[0] = Sources[i];
+                pulDst[0] = Dests[j];
+                ret = GdiAlphaBlend(hdcDst, 0, 0, 1, 1, hdcSrc, 0, 0, 1, 1, BlendFunc);
+                ok(ret, "GdiAlphaBlend failed\n");
+                GdiFlush();
+
+                Source = Sources[i];
+                Alpha = ((Source >> 24) * ConstAlphas[k]) / 255;
+                Expected = 0;
+                for (Channel = 0; Channel < 32; Channel += 8)
+                {
+                    Expected |= BlendChannel((Dests[j] >> Channel) & 0xFF,
+                                             (Source >> Channel) & 0xFF,
+                                             ConstAlphas[k], Alpha) << Channel;
+                }
+                ok(SameColor(pulDst[0], Expected),
+                   "Src 0x%08lx, Dst 0x%08lx, alpha %u: got 0x%08lx, expected 0x%08lx\n",
+                   Sources[i], Dests[j], ConstAlphas[k], pulDst[0], Expected);
+            }
+        }
+    }
+
+    /* Stretched, every source pixel is opaque */
+    BlendFunc.SourceConstantAlpha = 255;
+    for (i = 0; i < 4; i++)
+        pulSrc[i] = 0xFF000000 | (i * 0x10);
+    ret = GdiAlphaBlend(hdcDst, 0, 0, 8, 1, hdcSrc, 0, 0, 4, 1, BlendFunc);
+    ok(ret, "GdiAlphaBlend failed\n");
+    GdiFlush();
+    for (i = 0; i < 8; i++)
+    {
+        ok(pulDst[i] == (0xFF000000 | ((i / 2) * 0x10)), "Pixel %lu is 0x%08lx\n", i, pulDst[i]);
+    }
+}
+
+static
+void
+Test_StretchBlt(HDC hdcDst, PULONG pulDst, HDC hdcSrc, PULONG pulSrc)
+{
+    ULONG i;
+    BOOL ret;
+
+    for (i = 0; i < 4; i++)
+        pulSrc[i] = 0x00010101 * (i + 1);
+
+    ret = StretchBlt(hdcDst, 0, 0, 8, 1, hdcSrc, 0, 0, 4, 1, SRCCOPY);
+    ok(ret, "StretchBlt failed\n");
+    GdiFlush();
+    for (i = 0; i < 8; i++)
+        ok(pulDst[i] == 0x00010101 * (i / 2 + 1), "Pixel %lu is 0x%08lx\n", i, pulDst[i]);
+
+    ret = StretchBlt(hdcDst, 0, 0, 2, 1, hdcSrc, 0, 0, 4, 1, SRCPAINT);
+    ok(ret, "StretchBlt failed\n");
+    GdiFlush();
+    ok(pulDst[0] == 0x00010101, "Pixel 0 is 0x%08lx\n", pulDst[0]);
+    ok(pulDst[1] == 0x00030303, "Pixel 1 is 0x%08lx\n", pulDst[1]);
+
+    ret = StretchBlt(hdcDst, 0, 0, 2, 1, hdcSrc, 2, 0, 2, 1, SRCAND);
+    ok(ret, "StretchBlt failed\n");
+    GdiFlush();
+    ok(pulDst[0] == 0x00010101, "Pixel 0 is 0x%08lx\n", pulDst[0]);
+    ok(pulDst[1] == 0x00000000, "Pixel 1 is 0x%08lx\n", pulDst[1]);
+}
+
+typedef enum _BENCH_OP
+{
+    BenchSrcCopy,
+    BenchSrcAnd,
+    BenchSrcPaint,
+    BenchPatCopy,
+    BenchAlphaBlend,
+    BenchStretchBlt
+} BENCH_OP;
+
+static
+void
+Benchmark(HDC hdcDst, HDC hdcSrc, BENCH_OP Op, PCSTR Name)
+{
+    BLENDFUNCTION BlendFunc = { AC_SRC_OVER, 0, 192, AC_SRC_ALPHA };
+    LARGE_INTEGER Frequency, Start, End;
+    double Seconds;
+    ULONG i;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCH_ROUNDS; i++)
+    {
+        switch (Op)
+        {
+            case BenchSrcCopy:
+                BitBlt(hdcDst, 0, 0, BENCH_WIDTH, BENCH_HEIGHT, hdcSrc, 0, 0, SRCCOPY);
+                break;
+            case BenchSrcAnd:
+                BitBlt(hdcDst, 0, 0, BENCH_WIDTH, BENCH_HEIGHT, hdcSrc, 0, 0, SRCAND);
+                break;
+            case BenchSrcPaint:
+                BitBlt(hdcDst, 0, 0, BENCH_WIDTH, BENCH_HEIGHT, hdcSrc, 0, 0, SRCPAINT);
+                break;
+            case BenchPatCopy:
+                PatBlt(hdcDst, 0, 0, BENCH_WIDTH, BENCH_HEIGHT, PATCOPY);
+                break;
+            case BenchAlphaBlend:
+                GdiAlphaBlend(hdcDst, 0, 0, BENCH_WIDTH, BENCH_HEIGHT,
+                              hdcSrc, 0, 0, BENCH_WIDTH, BENCH_HEIGHT, BlendFunc);
+                break;
+            case BenchStretchBlt:
+                StretchBlt(hdcDst, 0, 0, BENCH_WIDTH, BENCH_HEIGHT,
+                           hdcSrc, 0, 0, BENCH_WIDTH / 2, BENCH_HEIGHT / 2, SRCCOPY);
+                break;
+        }
+    }
+    GdiFlush();
+    QueryPerformanceCounter(&End);
+
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    trace("%-12s %8.1f Mpixels/s\n", Name,
+          Seconds > 0 ? (double)BENCH_ROUNDS * BENCH_WIDTH * BENCH_HEIGHT / Seconds / 1000000 : 0.0);
+}
+
+START_TEST(AlphaBlend)
+{
+    HBITMAP hbmpDst, hbmpSrc, hbmpDstOld, hbmpSrcOld;
+    PULONG pulDst, pulSrc;
+    HDC hdcDst, hdcSrc;
+    HBRUSH hbr, hbrOld;
+    ULONG i;
+
+    hdcDst = CreateCompatibleDC(NULL);
+    hdcSrc = CreateCompatibleDC(NULL);
+    hbmpDst = CreateDIB32(hdcDst, BENCH_WIDTH, BENCH_HEIGHT, &pulDst);
+    hbmpSrc = CreateDIB32(hdcSrc, BENCH_WIDTH, BENCH_HEIGHT, &pulSrc);
+    if (!hdcDst || !hdcSrc || !hbmpDst || !hbmpSrc)
+    {
+        skip("Failed to create the bitmaps\n");
+        return;
+    }
+    hbmpDstOld = SelectObject(hdcDst, hbmpDst);
+    hbmpSrcOld = SelectObject(hdcSrc, hbmpSrc);
+
+    Test_AlphaBlend(hdcDst, pulDst, hdcSrc, pulSrc);
+    Test_StretchBlt(hdcDst, pulDst, hdcSrc, pulSrc);
+
+    for (i = 0; i < BENCH_WIDTH * BENCH_HEIGHT; i++)
+        pulSrc[i] = (i * 0x9E3779B1) | 0x80000000;
+    hbr = CreateSolidBrush(RGB(0x12, 0x34, 0x56));
+    hbrOld = SelectObject(hdcDst, hbr);
+
+    Benchmark(hdcDst, hdcSrc, BenchSrcCopy, "SRCCOPY");
+    Benchmark(hdcDst, hdcSrc, BenchSrcAnd, "SRCAND");
+    Benchmark(hdcDst, hdcSrc, BenchSrcPaint, "SRCPAINT");
+    Benchmark(hdcDst, hdcSrc, BenchPatCopy, "PATCOPY");
+    Benchmark(hdcDst, hdcSrc, BenchAlphaBlend, "AlphaBlend");
+    Benchmark(hdcDst, hdcSrc, BenchStretchBlt, "StretchBlt");
+
+    SelectObject(hdcDst, hbrOld);
+    DeleteObject(hbr);
+    SelectObject(hdcSrc, hbmpSrcOld);
+    SelectObject(hdcDst, hbmpDstOld);
+    DeleteObject(hbmpSrc);
+    DeleteObject(hbmpDst);
+    DeleteDC(hdcSrc);
+    DeleteDC(hdcDst);
+}
@@ -6,6 +6,7 @@
 extern void func_AddFontMemResourceEx(void);
 extern void func_AddFontResource(void);
 extern void func_AddFontResourceEx(void);
+extern void func_AlphaBlend(void);
 extern void func_BeginPath(void);
 extern void func_CombineRgn(void);
 extern void func_CombineTransform(void);
@@ -80,6 +81,7 @@ const struct test winetest_testlist[] =
     { "AddFontMemResourceEx", func_AddFontMemResourceEx },
     { "AddFontResource", func_AddFontResource },
     { "AddFontResourceEx", func_AddFontResourceEx },
+    { "AlphaBlend", func_AlphaBlend },
     { "BeginPath", func_BeginPath },
     { "CombineRgn", func_CombineRgn },
     { "CombineTransform", func_CombineTransform },
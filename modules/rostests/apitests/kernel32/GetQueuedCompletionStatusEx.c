@@ -0,0 +1,167 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for GetQueuedCompletionStatusEx and completion port dequeue benchmark
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define BENCH_PACKETS   200000
+#define BENCH_BATCH     64
+
+typedef BOOL (WINAPI *PFN_GET_QUEUED_COMPLETION_STATUS_EX)(HANDLE, LPOVERLAPPED_ENTRY, ULONG, PULONG, DWORD, BOOL);
+
+static PFN_GET_QUEUED_COMPLETION_STATUS_EX pGetQueuedCompletionStatusEx;
+
+static
+VOID
+Test_Batch(HANDLE Port)
+{
+    OVERLAPPED_ENTRY Entries[8];
+    ULONG Removed, i;
+    BOOL ret;
+
+    /* Nothing queued */
+    Removed = 0xdeadbeef;
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(Port, Entries, ARRAYSIZE(Entries), &Removed, 0, FALSE);
+    ok(ret == FALSE, "ret = %d\n", ret);
+    ok(GetLastError() == WAIT_TIMEOUT, "GetLastError() = %lu\n", GetLastError());
+    ok(Removed == 0, "Removed = %lu\n", Removed);
+
+    /* More than fits in one call, they must come out in order */
+    for (i = 0; i < 12; i++)
+    {
+        ret = PostQueuedCompletionStatus(Port, i * 100, i + 1, (LPOVERLAPPED)(ULONG_PTR)(i + 0x1000));
+        ok(ret, "PostQueuedCompletionStatus failed with %lu\n", GetLastError());
+    }
+
+    ret = pGetQueuedCompletionStatusEx(Port, Entries, ARRAYSIZE(Entries), &Removed, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed with %lu\n", GetLastError());
+    ok(Removed == 8, "Removed = %lu\n", Removed);
+    for (i = 0; i < Removed && i < ARRAYSIZE(Entries); i++)
+    {
+        ok(Entries[i].lpCompletionKey == i + 1, "Entry %lu: key %Iu\n", i, Entries[i].lpCompletionKey);
+        ok(Entries[i].lpOverlapped == (LPOVERLAPPED)(ULONG_PTR)(i + 0x1000), "Entry %lu: overlapped %p\n", i, Entries[i].lpOverlapped);
+        ok(Entries[i].dwNumberOfBytesTransferred == i * 100, "Entry %lu: %lu bytes\n", i, Entries[i].dwNumberOfBytesTransferred);
+    }
+
+    ret = pGetQueuedCompletionStatusEx(Port, Entries, ARRAYSIZE(Entries), &Removed, 0, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed with %lu\n", GetLastError());
+    ok(Removed == 4, "Removed = %lu\n", Removed);
+    for (i = 0; i < Removed && i < ARRAYSIZE(Entries); i++)
+    {
+        ok(Entries[i].lpCompletionKey == i + 9, "Entry %lu: key %Iu\n", i, Entries[i].lpCompletionKey);
+    }
+
+    /* A single entry works like GetQueuedCompletionStatus */
+    ret = PostQueuedCompletionStatus(Port, 42, 7, NULL);
+    ok(ret, "PostQueuedCompletionStatus failed with %lu\n", GetLastError());
+    ret = pGetQueuedCompletionStatusEx(Port, Entries, 1, &Removed, 1000, FALSE);
+    ok(ret, "GetQueuedCompletionStatusEx failed with %lu\n", GetLastError());
+    ok(Removed == 1, "Removed = %lu\n", Removed);
+    ok(Entries[0].lpCompletionKey == 7, "key %Iu\n", Entries[0].lpCompletionKey);
+    ok(Entries[0].dwNumberOfBytesTransferred == 42, "%lu bytes\n", Entries[0].dwNumberOfBytesTransferred);
+
+    /* No room at all */
+    SetLastError(0xdeadbeef);
+    ret = pGetQueuedCompletionStatusEx(Port, Entries, 0, &Removed, 0, FALSE);
+    ok(ret == FALSE, "ret = %d\n", ret);
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "GetLastError() = %lu\n", GetLastError());
+}
+
+static
+DWORD
+WINAPI
+PostThread(PVOID Parameter)
+{
+    HANDLE Port = Parameter;
+    ULONG i;
+
+    for (i = 0; i < BENCH_PACKETS; i++)
+        PostQueuedCompletionStatus(Port, 0, i, NULL);
+
+    return 0;
+}
+
+static
+VOID
+Benchmark(HANDLE Port, BOOL Batched)
+{
+    OVERLAPPED_ENTRY Entries[BENCH_BATCH];
+    LARGE_INTEGER Frequency, Start, End;
+    LPOVERLAPPED Overlapped;
+    ULONG_PTR Key;
+    DWORD Bytes;
+    ULONG Received = 0, Removed, Calls = 0;
+    HANDLE Thread;
+    double Seconds;
+
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+
+    /* Dequeue while another thread keeps posting, like a server would */
+    Thread = CreateThread(NULL, 0, PostThread, Port, 0, NULL);
+    ok(Thread != NULL, "CreateThread failed with %lu\n", GetLastError());
+    if (!Thread)
+        return;
+
+    while (Received < BENCH_PACKETS)
+    {
+        if (Batched)
+        {
+            if (!pGetQueuedCompletionStatusEx(Port, Entries, ARRAYSIZE(Entries), &Removed, 5000, FALSE))
+                break;
+            Received += Removed;
+        }
+        else
+        {
+            if (!GetQueuedCompletionStatus(Port, &Bytes, &Key, &Overlapped, 5000))
+                break;
+            Received++;
+        }
+        Calls++;
+    }
+
+    QueryPerformanceCounter(&End);
+    WaitForSingleObject(Thread, INFINITE);
+    CloseHandle(Thread);
+
+    ok(Received == BENCH_PACKETS, "Received %lu packets\n", Received);
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    trace("%-27s %8.0f packets/s, %.1f packets per call\n",
+          Batched ? "GetQueuedCompletionStatusEx" : "GetQueuedCompletionStatus",
+          Seconds > 0 ? Received / Seconds : 0.0,
+          Calls ? (double)Received / Calls : 0.0);
+}
+
+START_TEST(GetQueuedCompletionStatusEx)
+{
+    HMODULE hDll;
+    HANDLE Port;
+
+    /* We have it in kernel32_vista, Windows in kernel32 */
+    hDll = LoadLibraryW(L"kernel32_vista.dll");
+    if (hDll)
+        pGetQueuedCompletionStatusEx = (PFN_GET_QUEUED_COMPLETION_STATUS_EX)GetProcAddress(hDll, "GetQueuedCompletionStatusEx");
+    if (!pGetQueuedCompletionStatusEx)
+        pGetQueuedCompletionStatusEx = (PFN_GET_QUEUED_COMPLETION_STATUS_EX)GetProcAddress(GetModuleHandleW(L"kernel32.dll"), "GetQueuedCompletionStatusEx");
+    if (!pGetQueuedCompletionStatusEx)
+    {
+        skip("GetQueuedCompletionStatusEx is not available\n");
+        return;
+    }
+
+    Port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+    ok(Port != NULL, "CreateIoCompletionPort failed with %lu\n", GetLastError());
+    if (!Port)
+        return;
+
+    Test_Batch(Port);
+    Benchmark(Port, FALSE);
+    Benchmark(Port, TRUE);
+
+    CloseHandle(Port);
+    if (hDll) FreeLibrary(hDll);
+}
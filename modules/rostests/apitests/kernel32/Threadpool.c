@@ -0,0 +1,442 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for the thread pool API and work item benchmark
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define WORK_COUNT      100
+#define BENCH_ITEMS     100000
+
+static PTP_WORK (WINAPI *pCreateThreadpoolWork)(PTP_WORK_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (WINAPI *pSubmitThreadpoolWork)(PTP_WORK);
+static VOID (WINAPI *pWaitForThreadpoolWorkCallbacks)(PTP_WORK, BOOL);
+static VOID (WINAPI *pCloseThreadpoolWork)(PTP_WORK);
+static BOOL (WINAPI *pTrySubmitThreadpoolCallback)(PTP_SIMPLE_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static PTP_TIMER (WINAPI *pCreateThreadpoolTimer)(PTP_TIMER_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (WINAPI *pSetThreadpoolTimer)(PTP_TIMER, PFILETIME, DWORD, DWORD);
+static BOOL (WINAPI *pIsThreadpoolTimerSet)(PTP_TIMER);
+static VOID (WINAPI *pWaitForThreadpoolTimerCallbacks)(PTP_TIMER, BOOL);
+static VOID (WINAPI *pCloseThreadpoolTimer)(PTP_TIMER);
+static PTP_WAIT (WINAPI *pCreateThreadpoolWait)(PTP_WAIT_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (WINAPI *pSetThreadpoolWait)(PTP_WAIT, HANDLE, PFILETIME);
+static VOID (WINAPI *pWaitForThreadpoolWaitCallbacks)(PTP_WAIT, BOOL);
+static VOID (WINAPI *pCloseThreadpoolWait)(PTP_WAIT);
+static PTP_CLEANUP_GROUP (WINAPI *pCreateThreadpoolCleanupGroup)(VOID);
+static VOID (WINAPI *pCloseThreadpoolCleanupGroupMembers)(PTP_CLEANUP_GROUP, BOOL, PVOID);
+static VOID (WINAPI *pCloseThreadpoolCleanupGroup)(PTP_CLEANUP_GROUP);
+static VOID (WINAPI *pSetEventWhenCallbackReturns)(PTP_CALLBACK_INSTANCE, HANDLE);
+static PTP_POOL (WINAPI *pCreateThreadpool)(PVOID);
+static VOID (WINAPI *pCloseThreadpool)(PTP_POOL);
+static PTP_IO (WINAPI *pCreateThreadpoolIo)(HANDLE, PTP_WIN32_IO_CALLBACK, PVOID, PTP_CALLBACK_ENVIRON);
+static VOID (WINAPI *pStartThreadpoolIo)(PTP_IO);
+static VOID (WINAPI *pCancelThreadpoolIo)(PTP_IO);
+static VOID (WINAPI *pWaitForThreadpoolIoCallbacks)(PTP_IO, BOOL);
+static VOID (WINAPI *pCloseThreadpoolIo)(PTP_IO);
+
+static LONG WorkCount;
+static LONG CanceledCount;
+static HANDLE BlockEvent;
+static PVOID IoOverlapped;
+static ULONG IoResult;
+static ULONG_PTR IoBytes;
+
+static
+VOID
+NTAPI
+WorkCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WORK Work)
+{
+    InterlockedIncrement(&WorkCount);
+}
+
+static
+VOID
+NTAPI
+BlockingWorkCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WORK Work)
+{
+    WaitForSingleObject(BlockEvent, INFINITE);
+    InterlockedIncrement(&WorkCount);
+}
+
+static
+VOID
+NTAPI
+SimpleCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context)
+{
+    /* Signaled by the pool once we returned */
+    pSetEventWhenCallbackReturns(Instance, Context);
+}
+
+static
+VOID
+NTAPI
+TimerCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_TIMER Timer)
+{
+    InterlockedIncrement(&WorkCount);
+    SetEvent(Context);
+}
+
+static
+VOID
+NTAPI
+WaitCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PTP_WAIT Wait, TP_WAIT_RESULT WaitResult)
+{
+    *(TP_WAIT_RESULT*)Context = WaitResult;
+    InterlockedIncrement(&WorkCount);
+}
+
+static
+VOID
+NTAPI
+IoCallback(PTP_CALLBACK_INSTANCE Instance, PVOID Context, PVOID Overlapped,
+           ULONG Result, ULONG_PTR NumberOfBytesTransferred, PTP_IO Io)
+{
+    IoOverlapped = Overlapped;
+    IoResult = Result;
+    IoBytes = NumberOfBytesTransferred;
+    InterlockedIncrement(&WorkCount);
+    SetEvent(Context);
+}
+
+static
+VOID
+NTAPI
+CancelCallback(PVOID ObjectContext, PVOID CleanupContext)
+{
+    ok(CleanupContext == (PVOID)0x1234, "CleanupContext = %p\n", CleanupContext);
+    InterlockedIncrement(&CanceledCount);
+}
+
+static
+VOID
+Test_Work(VOID)
+{
+    PTP_WORK Work;
+    HANDLE Event;
+    ULONG i;
+    BOOL ret;
+
+    WorkCount = 0;
+    Work = pCreateThreadpoolWork(WorkCallback, NULL, NULL);
+    ok(Work != NULL, "CreateThreadpoolWork failed with %lu\n", GetLastError());
+    if (!Work)
+        return;
+
+    for (i = 0; i < WORK_COUNT; i++)
+        pSubmitThreadpoolWork(Work);
+    pWaitForThreadpoolWorkCallbacks(Work, FALSE);
+    ok(WorkCount == WORK_COUNT, "WorkCount = %ld\n", WorkCount);
+    pCloseThreadpoolWork(Work);
+
+    Event = CreateEventW(NULL, TRUE, FALSE, NULL);
+    ret = pTrySubmitThreadpoolCallback(SimpleCallback, Event, NULL);
+    ok(ret, "TrySubmitThreadpoolCallback failed with %lu\n", GetLastError());
+    ok(WaitForSingleObject(Event, 5000) == WAIT_OBJECT_0, "Simple callback didn't run\n");
+    CloseHandle(Event);
+}
+
+static
+VOID
+Test_Timer(VOID)
+{
+    PTP_TIMER Timer;
+    FILETIME DueTime;
+    HANDLE Event;
+    LARGE_INTEGER Time;
+
+    Event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    Timer = pCreateThreadpoolTimer(TimerCallback, Event, NULL);
+    ok(Timer != NULL, "CreateThreadpoolTimer failed with %lu\n", GetLastError());
+    if (!Timer)
+    {
+        CloseHandle(Event);
+        return;
+    }
+    ok(!pIsThreadpoolTimerSet(Timer), "Timer is set\n");
+
+    /* One shot, 50ms from now */
+    WorkCount = 0;
+    Time.QuadPart = -50 * 10000LL;
+    DueTime.dwLowDateTime = Time.LowPart;
+    DueTime.dwHighDateTime = Time.HighPart;
+    pSetThreadpoolTimer(Timer, &DueTime, 0, 0);
+    ok(pIsThreadpoolTimerSet(Timer), "Timer isn't set\n");
+    ok(WaitForSingleObject(Event, 5000) == WAIT_OBJECT_0, "Timer didn't fire\n");
+    pWaitForThreadpoolTimerCallbacks(Timer, FALSE);
+    ok(!pIsThreadpoolTimerSet(Timer), "Timer is still set\n");
+    ok(WorkCount == 1, "WorkCount = %ld\n", WorkCount);
+
+    /* Periodic, until stopped */
+    pSetThreadpoolTimer(Timer, &DueTime, 20, 0);
+    ok(WaitForSingleObject(Event, 5000) == WAIT_OBJECT_0, "Timer didn't fire\n");
+    ok(WaitForSingleObject(Event, 5000) == WAIT_OBJECT_0, "Timer didn't fire again\n");
+    ok(pIsThreadpoolTimerSet(Timer), "Timer isn't set\n");
+    pSetThreadpoolTimer(Timer, NULL, 0, 0);
+    pWaitForThreadpoolTimerCallbacks(Timer, TRUE);
+    ok(!pIsThreadpoolTimerSet(Timer), "Timer is still set\n");
+    ok(WorkCount >= 3, "WorkCount = %ld\n", WorkCount);
+
+    pCloseThreadpoolTimer(Timer);
+    CloseHandle(Event);
+}
+
+static
+VOID
+Test_Wait(VOID)
+{
+    TP_WAIT_RESULT WaitResult;
+    PTP_WAIT Wait;
+    FILETIME Timeout;
+    LARGE_INTEGER Time;
+    HANDLE Event;
+
+    Event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    Wait = pCreateThreadpoolWait(WaitCallback, &WaitResult, NULL);
+    ok(Wait != NULL, "CreateThreadpoolWait failed with %lu\n", GetLastError());
+    if (!Wait)
+    {
+        CloseHandle(Event);
+        return;
+    }
+
+    WorkCount = 0;
+    WaitResult = 0xdeadbeef;
+    pSetThreadpoolWait(Wait, Event, NULL);
+    Sleep(50);
+    ok(WorkCount == 0, "WorkCount = %ld\n", WorkCount);
+    SetEvent(Event);
+    Sleep(200);
+    pWaitForThreadpoolWaitCallbacks(Wait, FALSE);
+    ok(WorkCount == 1, "WorkCount = %ld\n", WorkCount);
+    ok(WaitResult == WAIT_OBJECT_0, "WaitResult = %lu\n", WaitResult);
+
+    /* Times out, the event stays unsignaled */
+    WaitResult = 0xdeadbeef;
+    Time.QuadPart = -20 * 10000LL;
+    Timeout.dwLowDateTime = Time.LowPart;
+    Timeout.dwHighDateTime = Time.HighPart;
+    pSetThreadpoolWait(Wait, Event, &Timeout);
+    Sleep(200);
+    pWaitForThreadpoolWaitCallbacks(Wait, FALSE);
+    ok(WorkCount == 2, "WorkCount = %ld\n", WorkCount);
+    ok(WaitResult == WAIT_TIMEOUT, "WaitResult = %lu\n", WaitResult);
+
+    pCloseThreadpoolWait(Wait);
+    CloseHandle(Event);
+}
+
+static
+VOID
+Test_CleanupGroup(VOID)
+{
+    TP_CALLBACK_ENVIRON Environ;
+    PTP_CLEANUP_GROUP Group;
+    PTP_WORK Work;
+    ULONG i;
+
+    Group = pCreateThreadpoolCleanupGroup();
+    ok(Group != NULL, "CreateThreadpoolCleanupGroup failed with %lu\n", GetLastError());
+    if (!Group)
+        return;
+
+    TpInitializeCallbackEnviron(&Environ);
+    TpSetCallbackCleanupGroup(&Environ, Group, CancelCallback);
+
+    /* The first callback blocks, the other ones are still queued when we cancel */
+    WorkCount = 0;
+    CanceledCount = 0;
+    BlockEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    Work = pCreateThreadpoolWork(BlockingWorkCallback, NULL, &Environ);
+    ok(Work != NULL, "CreateThreadpoolWork failed with %lu\n", GetLastError());
+    if (Work)
+    {
+        for (i = 0; i < 3; i++)
+            pSubmitThreadpoolWork(Work);
+
+        /* Only one may run at a time for this to work */
+        Sleep(100);
+        SetEvent(BlockEvent);
+        pCloseThreadpoolCleanupGroupMembers(Group, TRUE, (PVOID)0x1234);
+        ok(WorkCount >= 1 && WorkCount <= 3, "WorkCount = %ld\n", WorkCount);
+
+        /* Called once for the object if anything was canceled */
+        ok(CanceledCount == (WorkCount < 3 ? 1 : 0), "CanceledCount = %ld\n", CanceledCount);
+    }
+
+    pCloseThreadpoolCleanupGroup(Group);
+    TpDestroyCallbackEnviron(&Environ);
+    CloseHandle(BlockEvent);
+}
+
+static
+VOID
+Test_Io(VOID)
+{
+    static const CHAR Data[] = "ReactOS thread pool I/O test";
+    WCHAR TempPath[MAX_PATH], FileName[MAX_PATH];
+    TP_CALLBACK_ENVIRON Environ;
+    OVERLAPPED Overlapped;
+    CHAR Buffer[sizeof(Data)];
+    PTP_POOL Pool;
+    PTP_IO Io;
+    HANDLE File, Event;
+    DWORD Written;
+    ULONG i;
+    BOOL ret;
+
+    if (!pCreateThreadpool || !pCreateThreadpoolIo)
+    {
+        skip("Thread pool I/O is not available\n");
+        return;
+    }
+
+    GetTempPathW(MAX_PATH, TempPath);
+    GetTempFileNameW(TempPath, L"tpi", 0, FileName);
+    File = CreateFileW(FileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return;
+    ret = WriteFile(File, Data, sizeof(Data), &Written, NULL);
+    ok(ret && Written == sizeof(Data), "WriteFile failed with %lu\n", GetLastError());
+    CloseHandle(File);
+
+    File = CreateFileW(FileName, GENERIC_READ, 0, NULL, OPEN_EXISTING,
+                       FILE_FLAG_OVERLAPPED | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+    {
+        DeleteFileW(FileName);
+        return;
+    }
+
+    /* A private pool only used for I/O has no worker until the first operation */
+    Pool = pCreateThreadpool(NULL);
+    ok(Pool != NULL, "CreateThreadpool failed with %lu\n", GetLastError());
+    if (!Pool)
+    {
+        CloseHandle(File);
+        return;
+    }
+    TpInitializeCallbackEnviron(&Environ);
+    TpSetCallbackThreadpool(&Environ, Pool);
+
+    Event = CreateEventW(NULL, FALSE, FALSE, NULL);
+    Io = pCreateThreadpoolIo(File, IoCallback, Event, &Environ);
+    ok(Io != NULL, "CreateThreadpoolIo failed with %lu\n", GetLastError());
+    if (Io)
+    {
+        WorkCount = 0;
+        for (i = 0; i < 2; i++)
+        {
+            RtlZeroMemory(&Overlapped, sizeof(Overlapped));
+            RtlZeroMemory(Buffer, sizeof(Buffer));
+            IoOverlapped = NULL;
+            IoResult = 0xdeadbeef;
+            IoBytes = 0;
+
+            pStartThreadpoolIo(Io);
+            ret = ReadFile(File, Buffer, sizeof(Buffer), NULL, &Overlapped);
+            if (!ret && GetLastError() != ERROR_IO_PENDING)
+            {
+                ok(0, "ReadFile failed with %lu\n", GetLastError());
+                pCancelThreadpoolIo(Io);
+                break;
+            }
+
+            ok(WaitForSingleObject(Event, 5000) == WAIT_OBJECT_0, "I/O callback %lu didn't run\n", i);
+            pWaitForThreadpoolIoCallbacks(Io, FALSE);
+            ok(IoOverlapped == &Overlapped, "IoOverlapped = %p\n", IoOverlapped);
+            ok(IoResult == NO_ERROR, "IoResult = %lu\n", IoResult);
+            ok(IoBytes == sizeof(Data), "IoBytes = %lu\n", (ULONG)IoBytes);
+            ok(!memcmp(Buffer, Data, sizeof(Data)), "Buffer = %s\n", Buffer);
+        }
+        ok(WorkCount == (LONG)i, "WorkCount = %ld\n", WorkCount);
+
+        pCloseThreadpoolIo(Io);
+    }
+
+    CloseHandle(Event);
+    CloseHandle(File);
+    TpDestroyCallbackEnviron(&Environ);
+    pCloseThreadpool(Pool);
+}
+
+static
+VOID
+Benchmark(VOID)
+{
+    LARGE_INTEGER Frequency, Start, End;
+    PTP_WORK Work;
+    double Seconds;
+    ULONG i;
+
+    Work = pCreateThreadpoolWork(WorkCallback, NULL, NULL);
+    if (!Work)
+        return;
+
+    WorkCount = 0;
+    QueryPerformanceFrequency(&Frequency);
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < BENCH_ITEMS; i++)
+        pSubmitThreadpoolWork(Work);
+    pWaitForThreadpoolWorkCallbacks(Work, FALSE);
+    QueryPerformanceCounter(&End);
+    pCloseThreadpoolWork(Work);
+
+    ok(WorkCount == BENCH_ITEMS, "WorkCount = %ld\n", WorkCount);
+    Seconds = (double)(End.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    trace("%8.0f work items/s\n", Seconds > 0 ? BENCH_ITEMS / Seconds : 0.0);
+}
+
+START_TEST(Threadpool)
+{
+    HMODULE hDll;
+
+    /* We have it in kernel32_vista, Windows in kernel32 */
+    hDll = LoadLibraryW(L"kernel32_vista.dll");
+    if (!hDll)
+        hDll = GetModuleHandleW(L"kernel32.dll");
+
+#define LOAD_FUNC(f) *(FARPROC*)&p##f = GetProcAddress(hDll, #f)
+    LOAD_FUNC(CreateThreadpoolWork);
+    LOAD_FUNC(SubmitThreadpoolWork);
+    LOAD_FUNC(WaitForThreadpoolWorkCallbacks);
+    LOAD_FUNC(CloseThreadpoolWork);
+    LOAD_FUNC(TrySubmitThreadpoolCallback);
+    LOAD_FUNC(CreateThreadpoolTimer);
+    LOAD_FUNC(SetThreadpoolTimer);
+    LOAD_FUNC(IsThreadpoolTimerSet);
+    LOAD_FUNC(WaitForThreadpoolTimerCallbacks);
+    LOAD_FUNC(CloseThreadpoolTimer);
+    LOAD_FUNC(CreateThreadpoolWait);
+    LOAD_FUNC(SetThreadpoolWait);
+    LOAD_FUNC(WaitForThreadpoolWaitCallbacks);
+    LOAD_FUNC(CloseThreadpoolWait);
+    LOAD_FUNC(CreateThreadpoolCleanupGroup);
+    LOAD_FUNC(CloseThreadpoolCleanupGroupMembers);
+    LOAD_FUNC(CloseThreadpoolCleanupGroup);
+    LOAD_FUNC(SetEventWhenCallbackReturns);
+    LOAD_FUNC(CreateThreadpool);
+    LOAD_FUNC(CloseThreadpool);
+    LOAD_FUNC(CreateThreadpoolIo);
+    LOAD_FUNC(StartThreadpoolIo);
+    LOAD_FUNC(CancelThreadpoolIo);
+    LOAD_FUNC(WaitForThreadpoolIoCallbacks);
+    LOAD_FUNC(CloseThreadpoolIo);
+#undef LOAD_FUNC
+
+    if (!pCreateThreadpoolWork || !pCloseThreadpoolCleanupGroup || !pSetEventWhenCallbackReturns)
+    {
+        skip("The thread pool API is not available\n");
+        return;
+    }
+
+    Test_Work();
+    Test_Timer();
+    Test_Wait();
+    Test_CleanupGroup();
+    Test_Io();
+    Benchmark();
+}
@@ -0,0 +1,298 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for the loader's handling of old style bound imports
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+/*
+ * The test DLL has no code, only one import descriptor for kernel32 with
+ * the imports below. It is written to a file, bound the way pefixup -bind
+ * does it against the kernel32 of this process, and then loaded.
+ */
+#define TEST_IMAGE_BASE     0x5A000000
+#define TEST_SECTION_RVA    0x1000
+#define TEST_SECTION_SIZE   0x200
+#define TEST_HEADERS_SIZE   0x200
+#define TEST_IMPORT_RVA     (TEST_SECTION_RVA + 0x000)
+#define TEST_LOOKUP_RVA     (TEST_SECTION_RVA + 0x030)
+#define TEST_IAT_RVA        (TEST_SECTION_RVA + 0x050)
+#define TEST_DLLNAME_RVA    (TEST_SECTION_RVA + 0x070)
+#define TEST_NAMES_RVA      (TEST_SECTION_RVA + 0x080)
+
+static PCSTR ImportNames[] =
+{
+    "GetTickCount",
+    "GetCurrentProcessId",
+    "EnterCriticalSection",
+};
+
+typedef struct _TEST_IMAGE
+{
+    UCHAR Buffer[TEST_HEADERS_SIZE + TEST_SECTION_SIZE];
+    PIMAGE_IMPORT_DESCRIPTOR Import;
+    PULONG Lookup;
+    PULONG Iat;
+} TEST_IMAGE, *PTEST_IMAGE;
+
+static
+VOID
+BuildImage(PTEST_IMAGE Image)
+{
+    PIMAGE_DOS_HEADER DosHeader;
+    PIMAGE_NT_HEADERS32 NtHeader;
+    PIMAGE_SECTION_HEADER Section;
+    PUCHAR Data;
+    ULONG i, NameRva;
+
+    RtlZeroMemory(Image, sizeof(*Image));
+
+    DosHeader = (PIMAGE_DOS_HEADER)Image->Buffer;
+    DosHeader->e_magic = IMAGE_DOS_SIGNATURE;
+    DosHeader->e_lfanew = sizeof(IMAGE_DOS_HEADER);
+
+    NtHeader = (PIMAGE_NT_HEADERS32)(Image->Buffer + DosHeader->e_lfanew);
+    NtHeader->Signature = IMAGE_NT_SIGNATURE;
+    NtHeader->FileHeader.Machine = IMAGE_FILE_MACHINE_I386;
+    NtHeader->FileHeader.NumberOfSections = 1;
+    NtHeader->FileHeader.TimeDateStamp = 0x5A5A5A5A;
+    NtHeader->FileHeader.SizeOfOptionalHeader = sizeof(IMAGE_OPTIONAL_HEADER32);
+    NtHeader->FileHeader.Characteristics = IMAGE_FILE_EXECUTABLE_IMAGE |
+                                           IMAGE_FILE_32BIT_MACHINE |
+                                           IMAGE_FILE_DLL;
+    NtHeader->OptionalHeader.Magic = IMAGE_NT_OPTIONAL_HDR32_MAGIC;
+    NtHeader->OptionalHeader.ImageBase = TEST_IMAGE_BASE;
+    NtHeader->OptionalHeader.SectionAlignment = 0x1000;
+    NtHeader->OptionalHeader.FileAlignment = 0x200;
+    NtHeader->OptionalHeader.MajorOperatingSystemVersion = 4;
+    NtHeader->OptionalHeader.MajorSubsystemVersion = 4;
+    NtHeader->OptionalHeader.SizeOfImage = TEST_SECTION_RVA + 0x1000;
+    NtHeader->OptionalHeader.SizeOfHeaders = TEST_HEADERS_SIZE;
+    NtHeader->OptionalHeader.Subsystem = IMAGE_SUBSYSTEM_WINDOWS_CUI;
+    NtHeader->OptionalHeader.SizeOfStackReserve = 0x100000;
+    NtHeader->OptionalHeader.SizeOfStackCommit = 0x1000;
+    NtHeader->OptionalHeader.SizeOfHeapReserve = 0x100000;
+    NtHeader->OptionalHeader.SizeOfHeapCommit = 0x1000;
+    NtHeader->OptionalHeader.NumberOfRvaAndSizes = IMAGE_NUMBEROF_DIRECTORY_ENTRIES;
+    NtHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].VirtualAddress = TEST_IMPORT_RVA;
+    NtHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT].Size = 2 * sizeof(IMAGE_IMPORT_DESCRIPTOR);
+    NtHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IAT].VirtualAddress = TEST_IAT_RVA;
+    NtHeader->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IAT].Size = (ARRAYSIZE(ImportNames) + 1) * sizeof(ULONG);
+
+    Section = (PIMAGE_SECTION_HEADER)(NtHeader + 1);
+    RtlCopyMemory(Section->Name, ".idata", sizeof(".idata"));
+    Section->Misc.VirtualSize = TEST_SECTION_SIZE;
+    Section->VirtualAddress = TEST_SECTION_RVA;
+    Section->SizeOfRawData = TEST_SECTION_SIZE;
+    Section->PointerToRawData = TEST_HEADERS_SIZE;
+    Section->Characteristics = IMAGE_SCN_CNT_INITIALIZED_DATA | IMAGE_SCN_MEM_READ | IMAGE_SCN_MEM_WRITE;
+
+    /* RVAs of the section map to the buffer this way */
+    Data = Image->Buffer + TEST_HEADERS_SIZE - TEST_SECTION_RVA;
+
+    Image->Import = (PIMAGE_IMPORT_DESCRIPTOR)(Data + TEST_IMPORT_RVA);
+    Image->Lookup = (PULONG)(Data + TEST_LOOKUP_RVA);
+    Image->Iat = (PULONG)(Data + TEST_IAT_RVA);
+
+    Image->Import->OriginalFirstThunk = TEST_LOOKUP_RVA;
+    Image->Import->Name = TEST_DLLNAME_RVA;
+    Image->Import->FirstThunk = TEST_IAT_RVA;
+    strcpy((PCHAR)(Data + TEST_DLLNAME_RVA), "kernel32.dll");
+
+    /* Unbound, the IAT is a copy of the lookup table, as the linker leaves it */
+    for (i = 0, NameRva = TEST_NAMES_RVA; i < ARRAYSIZE(ImportNames); i++, NameRva += 0x20)
+    {
+        strcpy((PCHAR)(Data + NameRva + sizeof(WORD)), ImportNames[i]);
+        Image->Lookup[i] = NameRva;
+        Image->Iat[i] = NameRva;
+    }
+}
+
+/* Binds the image like pefixup -bind, returns a mask of the forwarded imports */
+static
+ULONG
+BindImage(PTEST_IMAGE Image, PVOID Kernel32)
+{
+    PIMAGE_EXPORT_DIRECTORY ExportDirectory;
+    PULONG Functions, Names;
+    PUSHORT Ordinals;
+    ULONG ExportSize, i, j, Rva, Forwarders = 0;
+    PULONG LastForwarder;
+
+    ExportDirectory = RtlImageDirectoryEntryToData(Kernel32, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &ExportSize);
+    Functions = (PULONG)((ULONG_PTR)Kernel32 + ExportDirectory->AddressOfFunctions);
+    Names = (PULONG)((ULONG_PTR)Kernel32 + ExportDirectory->AddressOfNames);
+    Ordinals = (PUSHORT)((ULONG_PTR)Kernel32 + ExportDirectory->AddressOfNameOrdinals);
+
+    LastForwarder = &Image->Import->ForwarderChain;
+    for (i = 0; i < ARRAYSIZE(ImportNames); i++)
+    {
+        for (j = 0; j < ExportDirectory->NumberOfNames; j++)
+        {
+            if (!strcmp((PCSTR)((ULONG_PTR)Kernel32 + Names[j]), ImportNames[i]))
+                break;
+        }
+        ok(j < ExportDirectory->NumberOfNames, "%s not found\n", ImportNames[i]);
+        if (j == ExportDirectory->NumberOfNames)
+            return 0;
+
+        Rva = Functions[Ordinals[j]];
+        if (Rva >= (ULONG)((ULONG_PTR)ExportDirectory - (ULONG_PTR)Kernel32) &&
+            Rva < (ULONG)((ULONG_PTR)ExportDirectory - (ULONG_PTR)Kernel32) + ExportSize)
+        {
+            /* Forwarders are snapped by the loader, chain them */
+            *LastForwarder = i;
+            LastForwarder = &Image->Iat[i];
+            Forwarders |= 1 << i;
+        }
+        else
+        {
+            Image->Iat[i] = PtrToUlong(Kernel32) + Rva;
+        }
+    }
+    *LastForwarder = 0xFFFFFFFF;
+
+    Image->Import->TimeDateStamp = RtlImageNtHeader(Kernel32)->FileHeader.TimeDateStamp;
+    return Forwarders;
+}
+
+static
+VOID
+GetImagePath(PCWSTR Name, PWSTR FileName)
+{
+    WCHAR TempPath[MAX_PATH];
+
+    GetTempPathW(ARRAYSIZE(TempPath), TempPath);
+    StringCchPrintfW(FileName, MAX_PATH, L"%s%s", TempPath, Name);
+}
+
+static
+PULONG
+LoadImage(PTEST_IMAGE Image, PCWSTR Name, HMODULE *Module)
+{
+    WCHAR FileName[MAX_PATH];
+    HANDLE File;
+    DWORD Written;
+    BOOL ret;
+
+    *Module = NULL;
+
+    GetImagePath(Name, FileName);
+    File = CreateFileW(FileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL);
+    ok(File != INVALID_HANDLE_VALUE, "CreateFileW failed with %lu\n", GetLastError());
+    if (File == INVALID_HANDLE_VALUE)
+        return NULL;
+    ret = WriteFile(File, Image->Buffer, sizeof(Image->Buffer), &Written, NULL);
+    ok(ret && Written == sizeof(Image->Buffer), "WriteFile failed with %lu\n", GetLastError());
+    CloseHandle(File);
+
+    *Module = LoadLibraryW(FileName);
+    ok(*Module != NULL, "LoadLibraryW(%S) failed with %lu\n", Name, GetLastError());
+    if (!*Module)
+    {
+        DeleteFileW(FileName);
+        return NULL;
+    }
+
+    ok(*Module == (HMODULE)(ULONG_PTR)TEST_IMAGE_BASE, "%S loaded at %p\n", Name, *Module);
+    return (PULONG)((ULONG_PTR)*Module + TEST_IAT_RVA);
+}
+
+static
+VOID
+UnloadImage(PCWSTR Name, HMODULE Module)
+{
+    WCHAR FileName[MAX_PATH];
+
+    FreeLibrary(Module);
+    GetImagePath(Name, FileName);
+    DeleteFileW(FileName);
+}
+
+START_TEST(LdrBoundImports)
+{
+    PIMAGE_NT_HEADERS NtHeader;
+    TEST_IMAGE Image;
+    HMODULE Kernel32, Module;
+    ULONG Expected[ARRAYSIZE(ImportNames)];
+    ULONG Forwarders, Poison, PoisonIndex, i;
+    PULONG Iat;
+
+    if (sizeof(PVOID) != sizeof(ULONG))
+    {
+        skip("Old style binding is only done for 32-bit images\n");
+        return;
+    }
+
+    Kernel32 = GetModuleHandleW(L"kernel32.dll");
+    for (i = 0; i < ARRAYSIZE(ImportNames); i++)
+        Expected[i] = PtrToUlong(GetProcAddress(Kernel32, ImportNames[i]));
+
+    /* An address that no import resolves to, but which is still a function */
+    Poison = PtrToUlong(GetProcAddress(Kernel32, "GetVersion"));
+    ok(Poison != 0, "GetVersion not found\n");
+
+    /* Without a binding, everything is snapped */
+    BuildImage(&Image);
+    Iat = LoadImage(&Image, L"ldrbnd0.dll", &Module);
+    if (Iat)
+    {
+        for (i = 0; i < ARRAYSIZE(ImportNames); i++)
+            ok(Iat[i] == Expected[i], "Unbound %s: 0x%lx, expected 0x%lx\n", ImportNames[i], Iat[i], Expected[i]);
+        UnloadImage(L"ldrbnd0.dll", Module);
+    }
+
+    NtHeader = RtlImageNtHeader(Kernel32);
+    if (NtHeader->OptionalHeader.ImageBase != PtrToUlong(Kernel32) ||
+        NtHeader->FileHeader.TimeDateStamp == 0 ||
+        NtHeader->FileHeader.TimeDateStamp == 0xFFFFFFFF)
+    {
+        skip("kernel32 can't be bound against\n");
+        return;
+    }
+
+    /*
+     * A valid binding is trusted: only the forwarders get snapped. Change
+     * one of the bound entries, the loader has to leave it alone.
+     */
+    BuildImage(&Image);
+    Forwarders = BindImage(&Image, Kernel32);
+    for (PoisonIndex = 0; PoisonIndex < ARRAYSIZE(ImportNames); PoisonIndex++)
+    {
+        if (!(Forwarders & (1 << PoisonIndex)))
+            break;
+    }
+    if (PoisonIndex < ARRAYSIZE(ImportNames))
+        Image.Iat[PoisonIndex] = Poison;
+    Iat = LoadImage(&Image, L"ldrbnd1.dll", &Module);
+    if (Iat)
+    {
+        for (i = 0; i < ARRAYSIZE(ImportNames); i++)
+        {
+            if (i == PoisonIndex)
+                ok(Iat[i] == Poison, "Bound %s was snapped: 0x%lx\n", ImportNames[i], Iat[i]);
+            else
+                ok(Iat[i] == Expected[i], "Bound %s: 0x%lx, expected 0x%lx\n", ImportNames[i], Iat[i], Expected[i]);
+        }
+        UnloadImage(L"ldrbnd1.dll", Module);
+    }
+
+    /* A stale binding falls back to snapping everything */
+    BuildImage(&Image);
+    Forwarders = BindImage(&Image, Kernel32);
+    Image.Import->TimeDateStamp++;
+    for (i = 0; i < ARRAYSIZE(ImportNames); i++)
+    {
+        if (!(Forwarders & (1 << i)))
+            Image.Iat[i] = Poison;
+    }
+    Iat = LoadImage(&Image, L"ldrbnd2.dll", &Module);
+    if (Iat)
+    {
+        for (i = 0; i < ARRAYSIZE(ImportNames); i++)
+            ok(Iat[i] == Expected[i], "Stale %s: 0x%lx, expected 0x%lx\n", ImportNames[i], Iat[i], Expected[i]);
+        UnloadImage(L"ldrbnd2.dll", Module);
+    }
+}
@@ -0,0 +1,216 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for loader module and export lookups, and startup benchmark
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define LOOKUP_ROUNDS 100
+
+/* DLLs with big import graphs, together they pull in most of the system */
+static PCWSTR DllNames[] =
+{
+    L"shell32.dll", L"comctl32.dll", L"ole32.dll", L"oleaut32.dll",
+    L"shlwapi.dll", L"setupapi.dll", L"crypt32.dll", L"wininet.dll",
+    L"urlmon.dll", L"msi.dll", L"winhttp.dll", L"dbghelp.dll",
+    L"netapi32.dll", L"ws2_32.dll", L"mswsock.dll", L"rpcrt4.dll",
+    L"secur32.dll", L"userenv.dll", L"version.dll", L"winmm.dll",
+    L"imm32.dll", L"uxtheme.dll", L"msvcrt.dll", L"comdlg32.dll",
+};
+
+static PVOID DllHandles[ARRAYSIZE(DllNames)];
+
+static
+ULONGLONG
+ElapsedMicroseconds(PLARGE_INTEGER Start)
+{
+    LARGE_INTEGER End, Frequency;
+
+    NtQueryPerformanceCounter(&End, &Frequency);
+    return ((End.QuadPart - Start->QuadPart) * 1000000) / Frequency.QuadPart;
+}
+
+static
+ULONG
+LoadAll(VOID)
+{
+    UNICODE_STRING DllName;
+    NTSTATUS Status;
+    ULONG i, Loaded = 0;
+
+    for (i = 0; i < ARRAYSIZE(DllNames); i++)
+    {
+        RtlInitUnicodeString(&DllName, DllNames[i]);
+        Status = LdrLoadDll(NULL, NULL, &DllName, &DllHandles[i]);
+        if (!NT_SUCCESS(Status))
+        {
+            trace("Failed to load %S: 0x%lx\n", DllNames[i], Status);
+            DllHandles[i] = NULL;
+            continue;
+        }
+        Loaded++;
+    }
+
+    return Loaded;
+}
+
+static
+VOID
+UnloadAll(VOID)
+{
+    ULONG i;
+
+    for (i = 0; i < ARRAYSIZE(DllNames); i++)
+    {
+        if (DllHandles[i])
+        {
+            LdrUnloadDll(DllHandles[i]);
+            DllHandles[i] = NULL;
+        }
+    }
+}
+
+/* Every loaded module must be found by its name, whatever the case */
+static
+ULONG
+CheckModuleNames(VOID)
+{
+    PLIST_ENTRY ListHead, Entry;
+    PLDR_DATA_TABLE_ENTRY LdrEntry;
+    UNICODE_STRING Name;
+    WCHAR Buffer[MAX_PATH];
+    PVOID Handle;
+    NTSTATUS Status;
+    ULONG i, Count = 0;
+
+    ListHead = &NtCurrentPeb()->Ldr->InLoadOrderModuleList;
+    for (Entry = ListHead->Flink; Entry != ListHead; Entry = Entry->Flink)
+    {
+        LdrEntry = CONTAINING_RECORD(Entry, LDR_DATA_TABLE_ENTRY, InLoadOrderLinks);
+        if (LdrEntry->BaseDllName.Length >= sizeof(Buffer))
+            continue;
+
+        Status = LdrGetDllHandle(NULL, NULL, &LdrEntry->BaseDllName, &Handle);
+        ok(Status == STATUS_SUCCESS, "LdrGetDllHandle(%wZ) returned 0x%lx\n", &LdrEntry->BaseDllName, Status);
+        ok(Handle == LdrEntry->DllBase, "Got %p for %wZ, expected %p\n", Handle, &LdrEntry->BaseDllName, LdrEntry->DllBase);
+
+        /* Flip the case of every letter */
+        for (i = 0; i < LdrEntry->BaseDllName.Length / sizeof(WCHAR); i++)
+        {
+            Buffer[i] = LdrEntry->BaseDllName.Buffer[i];
+            if (Buffer[i] >= L'a' && Buffer[i] <= L'z')
+                Buffer[i] -= L'a' - L'A';
+            else if (Buffer[i] >= L'A' && Buffer[i] <= L'Z')
+                Buffer[i] += L'a' - L'A';
+        }
+        Buffer[i] = UNICODE_NULL;
+        RtlInitUnicodeString(&Name, Buffer);
+
+        Status = LdrGetDllHandle(NULL, NULL, &Name, &Handle);
+        ok(Status == STATUS_SUCCESS, "LdrGetDllHandle(%wZ) returned 0x%lx\n", &Name, Status);
+        ok(Handle == LdrEntry->DllBase, "Got %p for %wZ, expected %p\n", Handle, &Name, LdrEntry->DllBase);
+        Count++;
+    }
+
+    RtlInitUnicodeString(&Name, L"notloaded_ldrtest.dll");
+    Status = LdrGetDllHandle(NULL, NULL, &Name, &Handle);
+    ok(Status == STATUS_DLL_NOT_FOUND, "LdrGetDllHandle returned 0x%lx\n", Status);
+
+    return Count;
+}
+
+/* Looking up an export by name must give the same as by its ordinal */
+static
+ULONG
+CheckExports(PVOID DllBase, BOOLEAN Verify)
+{
+    PIMAGE_EXPORT_DIRECTORY ExportDir;
+    PULONG NameTable;
+    PUSHORT OrdinalTable;
+    ANSI_STRING Name;
+    PVOID ByName, ByOrdinal;
+    NTSTATUS Status;
+    ULONG Size, i, Failures = 0;
+
+    ExportDir = RtlImageDirectoryEntryToData(DllBase, TRUE, IMAGE_DIRECTORY_ENTRY_EXPORT, &Size);
+    if (!ExportDir)
+        return 0;
+
+    NameTable = (PULONG)((ULONG_PTR)DllBase + ExportDir->AddressOfNames);
+    OrdinalTable = (PUSHORT)((ULONG_PTR)DllBase + ExportDir->AddressOfNameOrdinals);
+    for (i = 0; i < ExportDir->NumberOfNames; i++)
+    {
+        RtlInitAnsiString(&Name, (PCSTR)((ULONG_PTR)DllBase + NameTable[i]));
+        Status = LdrGetProcedureAddress(DllBase, &Name, 0, &ByName);
+        if (!Verify)
+            continue;
+        if (!NT_SUCCESS(Status))
+        {
+            Failures++;
+            continue;
+        }
+
+        Status = LdrGetProcedureAddress(DllBase, NULL, OrdinalTable[i] + ExportDir->Base, &ByOrdinal);
+        if (!NT_SUCCESS(Status) || ByName != ByOrdinal)
+            Failures++;
+    }
+
+    if (Verify)
+    {
+        RtlInitAnsiString(&Name, "NotAnExportOfThisDll");
+        Status = LdrGetProcedureAddress(DllBase, &Name, 0, &ByName);
+        ok(Status == STATUS_PROCEDURE_NOT_FOUND, "LdrGetProcedureAddress returned 0x%lx\n", Status);
+    }
+
+    return Failures;
+}
+
+START_TEST(LdrLoadDll)
+{
+    LARGE_INTEGER Start, Frequency;
+    ULONGLONG LoadUs, ModuleUs, ExportUs;
+    ULONG Loaded, Modules, Round, i;
+
+    /* Load the whole graph, that's what starting a big application costs */
+    NtQueryPerformanceCounter(&Start, &Frequency);
+    Loaded = LoadAll();
+    LoadUs = ElapsedMicroseconds(&Start);
+    ok(Loaded > 0, "No DLL could be loaded\n");
+
+    Modules = CheckModuleNames();
+    for (i = 0; i < ARRAYSIZE(DllNames); i++)
+    {
+        if (DllHandles[i])
+            ok(CheckExports(DllHandles[i], TRUE) == 0, "Wrong exports from %S\n", DllNames[i]);
+    }
+
+    NtQueryPerformanceCounter(&Start, NULL);
+    for (Round = 0; Round < LOOKUP_ROUNDS; Round++)
+        CheckModuleNames();
+    ModuleUs = ElapsedMicroseconds(&Start);
+
+    NtQueryPerformanceCounter(&Start, NULL);
+    for (i = 0; i < ARRAYSIZE(DllNames); i++)
+    {
+        if (DllHandles[i])
+            CheckExports(DllHandles[i], FALSE);
+    }
+    ExportUs = ElapsedMicroseconds(&Start);
+
+    trace("%lu DLLs loaded with %lu modules in %I64u us\n", Loaded, Modules, LoadUs);
+    trace("%lu rounds of module lookups in %I64u us, one pass over all exports in %I64u us\n",
+          (ULONG)LOOKUP_ROUNDS, ModuleUs, ExportUs);
+
+    /* Export lookups must still be right once a DLL got loaded again */
+    UnloadAll();
+    Loaded = LoadAll();
+    ok(Loaded > 0, "No DLL could be loaded\n");
+    for (i = 0; i < ARRAYSIZE(DllNames); i++)
+    {
+        if (DllHandles[i])
+            ok(CheckExports(DllHandles[i], TRUE) == 0, "Wrong exports from %S\n", DllNames[i]);
+    }
+    UnloadAll();
+}
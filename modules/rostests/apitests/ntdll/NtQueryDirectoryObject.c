@@ -0,0 +1,117 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for NtQueryDirectoryObject and large object directories
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+/* Enough to make the directory grow its hash table a few times */
+#define EVENT_COUNT 3000
+
+static HANDLE Events[EVENT_COUNT];
+
+static
+VOID
+MakeEventName(PUNICODE_STRING Name, PWCHAR Buffer, SIZE_T BufferCount, ULONG Index)
+{
+    StringCchPrintfW(Buffer, BufferCount, L"Event%lu", Index);
+    RtlInitUnicodeString(Name, Buffer);
+}
+
+static
+ULONG
+CountEntries(HANDLE Directory)
+{
+    UCHAR Buffer[0x1000];
+    POBJECT_DIRECTORY_INFORMATION Info;
+    ULONG Context = 0, Count = 0;
+    BOOLEAN Restart = TRUE;
+    NTSTATUS Status;
+
+    for (;;)
+    {
+        Status = NtQueryDirectoryObject(Directory, Buffer, sizeof(Buffer), FALSE,
+                                        Restart, &Context, NULL);
+        if (!NT_SUCCESS(Status) || Status == STATUS_NO_MORE_ENTRIES)
+            break;
+
+        for (Info = (POBJECT_DIRECTORY_INFORMATION)Buffer; Info->Name.Length; Info++)
+            Count++;
+
+        if (Status != STATUS_MORE_ENTRIES)
+            break;
+        Restart = FALSE;
+    }
+
+    return Count;
+}
+
+START_TEST(NtQueryDirectoryObject)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+    UNICODE_STRING Name;
+    WCHAR NameBuffer[32];
+    HANDLE Directory, Event;
+    ULONG i, Failures;
+    NTSTATUS Status;
+
+    /* An unnamed directory is private to us */
+    InitializeObjectAttributes(&ObjectAttributes, NULL, 0, NULL, NULL);
+    Status = NtCreateDirectoryObject(&Directory, DIRECTORY_ALL_ACCESS, &ObjectAttributes);
+    ok(Status == STATUS_SUCCESS, "NtCreateDirectoryObject returned 0x%lx\n", Status);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    ok(CountEntries(Directory) == 0, "Directory isn't empty\n");
+
+    for (i = 0, Failures = 0; i < EVENT_COUNT; i++)
+    {
+        MakeEventName(&Name, NameBuffer, ARRAYSIZE(NameBuffer), i);
+        InitializeObjectAttributes(&ObjectAttributes, &Name, 0, Directory, NULL);
+        Status = NtCreateEvent(&Events[i], EVENT_ALL_ACCESS, &ObjectAttributes, NotificationEvent, FALSE);
+        if (!NT_SUCCESS(Status)) Failures++;
+    }
+    ok(Failures == 0, "%lu events could not be created\n", Failures);
+    ok(CountEntries(Directory) == EVENT_COUNT, "Wrong number of entries\n");
+
+    /* Every name must still be found after the table grew */
+    for (i = 0, Failures = 0; i < EVENT_COUNT; i++)
+    {
+        MakeEventName(&Name, NameBuffer, ARRAYSIZE(NameBuffer), i);
+        InitializeObjectAttributes(&ObjectAttributes, &Name, OBJ_CASE_INSENSITIVE, Directory, NULL);
+        Status = NtOpenEvent(&Event, EVENT_QUERY_STATE, &ObjectAttributes);
+        if (!NT_SUCCESS(Status))
+        {
+            Failures++;
+            continue;
+        }
+        NtClose(Event);
+    }
+    ok(Failures == 0, "%lu events could not be opened\n", Failures);
+
+    /* Names that are there twice are refused */
+    MakeEventName(&Name, NameBuffer, ARRAYSIZE(NameBuffer), EVENT_COUNT / 2);
+    InitializeObjectAttributes(&ObjectAttributes, &Name, 0, Directory, NULL);
+    Status = NtCreateEvent(&Event, EVENT_ALL_ACCESS, &ObjectAttributes, NotificationEvent, FALSE);
+    ok(Status == STATUS_OBJECT_NAME_COLLISION, "NtCreateEvent returned 0x%lx\n", Status);
+    if (NT_SUCCESS(Status)) NtClose(Event);
+
+    /* Closing the last handle takes the names out again */
+    for (i = 0; i < EVENT_COUNT; i += 2)
+        NtClose(Events[i]);
+    ok(CountEntries(Directory) == EVENT_COUNT / 2, "Wrong number of entries\n");
+
+    MakeEventName(&Name, NameBuffer, ARRAYSIZE(NameBuffer), 0);
+    InitializeObjectAttributes(&ObjectAttributes, &Name, 0, Directory, NULL);
+    Status = NtOpenEvent(&Event, EVENT_QUERY_STATE, &ObjectAttributes);
+    ok(Status == STATUS_OBJECT_NAME_NOT_FOUND, "NtOpenEvent returned 0x%lx\n", Status);
+    if (NT_SUCCESS(Status)) NtClose(Event);
+
+    for (i = 1; i < EVENT_COUNT; i += 2)
+        NtClose(Events[i]);
+    ok(CountEntries(Directory) == 0, "Directory isn't empty\n");
+
+    NtClose(Directory);
+}
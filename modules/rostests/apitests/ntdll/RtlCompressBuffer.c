@@ -0,0 +1,215 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test and benchmark for RtlCompressBuffer/RtlDecompressBuffer
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+#define DATA_SIZE (256 * 1024)
+
+static const USHORT Formats[] =
+{
+    COMPRESSION_FORMAT_LZNT1,
+    COMPRESSION_FORMAT_XPRESS,
+    COMPRESSION_FORMAT_XPRESS_HUFF,
+};
+
+static PUCHAR Original;
+static PUCHAR Compressed;
+static PUCHAR Decompressed;
+static ULONG CompressedSize;
+
+/* Text-like data with plenty of repeats at all kinds of distances */
+static
+VOID
+GenerateText(PUCHAR Buffer, ULONG Length)
+{
+    static const char *Words[] = { "NTSTATUS ", "Status", " = ", "Rtl", "Compress", "Buffer",
+                                   "(", ");\n", "    ", "if (!NT_SUCCESS(Status))\n", "return ",
+                                   "STATUS_SUCCESS", "ULONG ", "Length", ", ", "\n" };
+    ULONG Seed = 0x12345678, Pos = 0, WordLength;
+    const char *Word;
+
+    while (Pos < Length)
+    {
+        Word = Words[RtlRandom(&Seed) % ARRAYSIZE(Words)];
+        WordLength = min((ULONG)strlen(Word), Length - Pos);
+        RtlCopyMemory(Buffer + Pos, Word, WordLength);
+        Pos += WordLength;
+    }
+}
+
+static
+VOID
+GenerateRandom(PUCHAR Buffer, ULONG Length)
+{
+    ULONG Seed = 0x87654321, i;
+
+    for (i = 0; i < Length; i++)
+        Buffer[i] = (UCHAR)RtlRandom(&Seed);
+}
+
+static
+NTSTATUS
+Compress(USHORT FormatAndEngine, PUCHAR Data, ULONG Length)
+{
+    ULONG BufferSize, FragmentSize;
+    PVOID WorkSpace;
+    NTSTATUS Status;
+
+    Status = RtlGetCompressionWorkSpaceSize(FormatAndEngine, &BufferSize, &FragmentSize);
+    ok(Status == STATUS_SUCCESS, "0x%04x: RtlGetCompressionWorkSpaceSize returned 0x%lx\n", FormatAndEngine, Status);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    WorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, BufferSize);
+    if (!WorkSpace)
+        return STATUS_NO_MEMORY;
+
+    CompressedSize = 0xdeadbeef;
+    Status = RtlCompressBuffer(FormatAndEngine, Data, Length, Compressed, 2 * DATA_SIZE,
+                               4096, &CompressedSize, WorkSpace);
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, WorkSpace);
+    return Status;
+}
+
+static
+VOID
+TestRoundTrip(USHORT FormatAndEngine, PUCHAR Data, ULONG Length, PCSTR Kind)
+{
+    ULONG FinalSize = 0xdeadbeef;
+    NTSTATUS Status;
+
+    Status = Compress(FormatAndEngine, Data, Length);
+    ok(Status == STATUS_SUCCESS, "0x%04x %s %lu: RtlCompressBuffer returned 0x%lx\n", FormatAndEngine, Kind, Length, Status);
+    if (!NT_SUCCESS(Status))
+        return;
+
+    RtlFillMemory(Decompressed, Length, 0xcc);
+    Status = RtlDecompressBuffer(FormatAndEngine & 0xFF, Decompressed, Length,
+                                 Compressed, CompressedSize, &FinalSize);
+    ok(Status == STATUS_SUCCESS, "0x%04x %s %lu: RtlDecompressBuffer returned 0x%lx\n", FormatAndEngine, Kind, Length, Status);
+    ok(FinalSize == Length, "0x%04x %s %lu: FinalSize = %lu\n", FormatAndEngine, Kind, Length, FinalSize);
+    ok(RtlCompareMemory(Decompressed, Data, Length) == Length, "0x%04x %s %lu: data differs\n", FormatAndEngine, Kind, Length);
+}
+
+static
+VOID
+TestFormat(USHORT FormatAndEngine)
+{
+    static const ULONG Lengths[] = { 1, 2, 3, 4, 17, 4095, 4096, 4097, 8193, 65535, 65536, 65537, 131072, DATA_SIZE };
+    ULONG BufferSize, FragmentSize, i;
+    PVOID WorkSpace;
+    NTSTATUS Status;
+
+    for (i = 0; i < ARRAYSIZE(Lengths); i++)
+    {
+        GenerateText(Original, Lengths[i]);
+        TestRoundTrip(FormatAndEngine, Original, Lengths[i], "text");
+        GenerateRandom(Original, Lengths[i]);
+        TestRoundTrip(FormatAndEngine, Original, Lengths[i], "random");
+        RtlFillMemory(Original, Lengths[i], 'a');
+        TestRoundTrip(FormatAndEngine, Original, Lengths[i], "fill");
+    }
+
+    /* Repetitive data has to actually get smaller */
+    GenerateText(Original, DATA_SIZE);
+    Status = Compress(FormatAndEngine, Original, DATA_SIZE);
+    ok(Status == STATUS_SUCCESS, "0x%04x: RtlCompressBuffer returned 0x%lx\n", FormatAndEngine, Status);
+    ok(CompressedSize < DATA_SIZE / 2, "0x%04x: compressed to %lu bytes\n", FormatAndEngine, CompressedSize);
+
+    /* Doesn't fit */
+    Status = RtlGetCompressionWorkSpaceSize(FormatAndEngine, &BufferSize, &FragmentSize);
+    WorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, BufferSize);
+    if (NT_SUCCESS(Status) && WorkSpace)
+    {
+        Status = RtlCompressBuffer(FormatAndEngine, Original, DATA_SIZE, Compressed, CompressedSize / 2,
+                                   4096, &CompressedSize, WorkSpace);
+        ok(Status == STATUS_BUFFER_TOO_SMALL, "0x%04x: RtlCompressBuffer returned 0x%lx\n", FormatAndEngine, Status);
+    }
+    RtlFreeHeap(RtlGetProcessHeap(), 0, WorkSpace);
+}
+
+static
+VOID
+Benchmark(USHORT FormatAndEngine)
+{
+    LARGE_INTEGER Frequency, Start, Middle, End;
+    ULONG Iterations = 16, FinalSize, i;
+    double CompressSeconds, DecompressSeconds;
+    ULONG BufferSize, FragmentSize;
+    PVOID WorkSpace;
+
+    if (!NT_SUCCESS(RtlGetCompressionWorkSpaceSize(FormatAndEngine, &BufferSize, &FragmentSize)))
+        return;
+    WorkSpace = RtlAllocateHeap(RtlGetProcessHeap(), 0, BufferSize);
+    if (!WorkSpace)
+        return;
+
+    GenerateText(Original, DATA_SIZE);
+    QueryPerformanceFrequency(&Frequency);
+
+    QueryPerformanceCounter(&Start);
+    for (i = 0; i < Iterations; i++)
+    {
+        RtlCompressBuffer(FormatAndEngine, Original, DATA_SIZE, Compressed, 2 * DATA_SIZE,
+                          4096, &CompressedSize, WorkSpace);
+    }
+    QueryPerformanceCounter(&Middle);
+    for (i = 0; i < Iterations; i++)
+    {
+        RtlDecompressBuffer(FormatAndEngine & 0xFF, Decompressed, DATA_SIZE,
+                            Compressed, CompressedSize, &FinalSize);
+    }
+    QueryPerformanceCounter(&End);
+
+    CompressSeconds = (double)(Middle.QuadPart - Start.QuadPart) / Frequency.QuadPart;
+    DecompressSeconds = (double)(End.QuadPart - Middle.QuadPart) / Frequency.QuadPart;
+    trace("0x%04x: %lu -> %lu bytes, compress %8.1f MB/s, decompress %8.1f MB/s\n",
+          FormatAndEngine, (ULONG)DATA_SIZE, CompressedSize,
+          CompressSeconds > 0 ? (double)Iterations * DATA_SIZE / CompressSeconds / (1024 * 1024) : 0.0,
+          DecompressSeconds > 0 ? (double)Iterations * DATA_SIZE / DecompressSeconds / (1024 * 1024) : 0.0);
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, WorkSpace);
+}
+
+START_TEST(RtlCompressBuffer)
+{
+    UCHAR Garbage[300];
+    ULONG FinalSize, i;
+    NTSTATUS Status;
+
+    Original = RtlAllocateHeap(RtlGetProcessHeap(), 0, DATA_SIZE);
+    Compressed = RtlAllocateHeap(RtlGetProcessHeap(), 0, 2 * DATA_SIZE);
+    Decompressed = RtlAllocateHeap(RtlGetProcessHeap(), 0, DATA_SIZE);
+    if (!Original || !Compressed || !Decompressed)
+    {
+        skip("Out of memory\n");
+        return;
+    }
+
+    for (i = 0; i < ARRAYSIZE(Formats); i++)
+    {
+        TestFormat(Formats[i] | COMPRESSION_ENGINE_STANDARD);
+        TestFormat(Formats[i] | COMPRESSION_ENGINE_MAXIMUM);
+    }
+
+    /* An all zero Huffman table can't decode anything */
+    RtlZeroMemory(Garbage, sizeof(Garbage));
+    Status = RtlDecompressBuffer(COMPRESSION_FORMAT_XPRESS_HUFF, Decompressed, 4096,
+                                 Garbage, sizeof(Garbage), &FinalSize);
+    ok(Status == STATUS_BAD_COMPRESSION_BUFFER, "RtlDecompressBuffer returned 0x%lx\n", Status);
+
+    for (i = 0; i < ARRAYSIZE(Formats); i++)
+    {
+        Benchmark(Formats[i] | COMPRESSION_ENGINE_STANDARD);
+        Benchmark(Formats[i] | COMPRESSION_ENGINE_MAXIMUM);
+    }
+
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Decompressed);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Compressed);
+    RtlFreeHeap(RtlGetProcessHeap(), 0, Original);
+}
@@ -0,0 +1,85 @@
+/*
+ * PROJECT:         ReactOS api tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Test for RtlSetHeapInformation/RtlQueryHeapInformation
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include "precomp.h"
+
+static PVOID Buffers[0x100];
+
+START_TEST(RtlHeapInformation)
+{
+    HANDLE hHeap;
+    NTSTATUS Status;
+    ULONG i, Round, HeapType;
+    SIZE_T ReturnLength;
+    RTL_HEAP_FRONT_END_INFORMATION FrontEndInfo;
+
+    hHeap = RtlCreateHeap(HEAP_GROWABLE, NULL, 0, 0, NULL, NULL);
+    ok(hHeap != NULL, "RtlCreateHeap failed\n");
+    if (hHeap == NULL)
+    {
+        return;
+    }
+
+    HeapType = 0xdeadbeef;
+    Status = RtlQueryHeapInformation(hHeap, HeapCompatibilityInformation, &HeapType, sizeof(HeapType), &ReturnLength);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_size_t(ReturnLength, sizeof(ULONG));
+    ok_long(HeapType, 0);
+
+    /* Only the LFH magic value is accepted */
+    HeapType = 1;
+    Status = RtlSetHeapInformation(hHeap, HeapCompatibilityInformation, &HeapType, sizeof(HeapType));
+    ok(!NT_SUCCESS(Status), "Status = 0x%08lx\n", Status);
+
+    HeapType = 2;
+    Status = RtlSetHeapInformation(hHeap, HeapCompatibilityInformation, &HeapType, sizeof(HeapType));
+    ok_ntstatus(Status, STATUS_SUCCESS);
+
+    HeapType = 0xdeadbeef;
+    Status = RtlQueryHeapInformation(hHeap, HeapCompatibilityInformation, &HeapType, sizeof(HeapType), &ReturnLength);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(HeapType, 2);
+
+    /* Churn small blocks so that the front-end gets to recycle them */
+    for (Round = 0; Round < 4; Round++)
+    {
+        for (i = 0; i < 0x100; ++i)
+        {
+            Buffers[i] = RtlAllocateHeap(hHeap, HEAP_ZERO_MEMORY, (i % 64) + 1);
+            ok(Buffers[i] != NULL, "Allocation %lu failed\n", i);
+            if (Buffers[i] != NULL)
+            {
+                ok(((PUCHAR)Buffers[i])[i % 64] == 0, "Block %lu is not zeroed\n", i);
+                ok_size_t(RtlSizeHeap(hHeap, 0, Buffers[i]), (i % 64) + 1);
+                RtlFillMemory(Buffers[i], (i % 64) + 1, 0xA5);
+            }
+        }
+
+        for (i = 0; i < 0x100; ++i)
+        {
+            ok(RtlFreeHeap(hHeap, 0, Buffers[i]) == TRUE, "RtlFreeHeap failed for %lu\n", i);
+        }
+    }
+
+    /* ReactOS reports front-end counters when the buffer is large enough */
+    RtlFillMemory(&FrontEndInfo, sizeof(FrontEndInfo), 0xFF);
+    Status = RtlQueryHeapInformation(hHeap, HeapCompatibilityInformation, &FrontEndInfo, sizeof(FrontEndInfo), &ReturnLength);
+    ok_ntstatus(Status, STATUS_SUCCESS);
+    ok_long(FrontEndInfo.FrontEndHeapType, 2);
+    if (ReturnLength == sizeof(FrontEndInfo))
+    {
+        ok(FrontEndInfo.AllocateHits > 0, "No front-end allocation hits\n");
+        ok(FrontEndInfo.FreeHits > 0, "No front-end free hits\n");
+        ok(FrontEndInfo.AllocateMisses > 0, "No front-end allocation misses\n");
+    }
+    else
+    {
+        skip("Front-end counters are not available\n");
+    }
+
+    RtlDestroyHeap(hHeap);
+}
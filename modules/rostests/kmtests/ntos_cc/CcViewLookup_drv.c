@@ -0,0 +1,376 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         LGPLv2.1+ - See COPYING.LIB in the top level directory
+ * PURPOSE:         Test driver measuring Cc view lookup throughput
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <kmt_test.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define IOCTL_START_TEST  1
+#define IOCTL_FINISH_TEST 2
+
+/* 1024 views of 256KB each */
+#define TEST_FILE_SIZE    (1024LL * VACB_MAPPING_GRANULARITY)
+#define TEST_DURATION_MS  1000
+#define MAX_THREADS       16
+
+typedef struct _TEST_FCB
+{
+    FSRTL_ADVANCED_FCB_HEADER Header;
+    SECTION_OBJECT_POINTERS SectionObjectPointers;
+    FAST_MUTEX HeaderMutex;
+} TEST_FCB, *PTEST_FCB;
+
+typedef struct _TEST_THREAD_DATA
+{
+    PKTHREAD Thread;
+    ULONG Seed;
+    ULONGLONG Lookups;
+    ULONG Failures;
+} TEST_THREAD_DATA, *PTEST_THREAD_DATA;
+
+static ULONG TestThreadCount = -1;
+static PFILE_OBJECT TestFileObject;
+static PDEVICE_OBJECT TestDeviceObject;
+static KEVENT TestStartEvent;
+static volatile LONG TestStop;
+static KMT_IRP_HANDLER TestIrpHandler;
+static KMT_MESSAGE_HANDLER TestMessageHandler;
+
+NTSTATUS
+TestEntry(
+    _In_ PDRIVER_OBJECT DriverObject,
+    _In_ PCUNICODE_STRING RegistryPath,
+    _Out_ PCWSTR *DeviceName,
+    _Inout_ INT *Flags)
+{
+    PAGED_CODE();
+
+    UNREFERENCED_PARAMETER(RegistryPath);
+
+    *DeviceName = L"CcViewLookup";
+    *Flags = TESTENTRY_NO_EXCLUSIVE_DEVICE |
+             TESTENTRY_BUFFERED_IO_DEVICE |
+             TESTENTRY_NO_READONLY_DEVICE;
+
+    KmtRegisterIrpHandler(IRP_MJ_READ, NULL, TestIrpHandler);
+    KmtRegisterMessageHandler(0, NULL, TestMessageHandler);
+
+    return STATUS_SUCCESS;
+}
+
+VOID
+TestUnload(
+    _In_ PDRIVER_OBJECT DriverObject)
+{
+    PAGED_CODE();
+}
+
+BOOLEAN
+NTAPI
+AcquireForLazyWrite(
+    _In_ PVOID Context,
+    _In_ BOOLEAN Wait)
+{
+    return TRUE;
+}
+
+VOID
+NTAPI
+ReleaseFromLazyWrite(
+    _In_ PVOID Context)
+{
+    return;
+}
+
+BOOLEAN
+NTAPI
+AcquireForReadAhead(
+    _In_ PVOID Context,
+    _In_ BOOLEAN Wait)
+{
+    return TRUE;
+}
+
+VOID
+NTAPI
+ReleaseFromReadAhead(
+    _In_ PVOID Context)
+{
+    return;
+}
+
+static CACHE_MANAGER_CALLBACKS Callbacks = {
+    AcquireForLazyWrite,
+    ReleaseFromLazyWrite,
+    AcquireForReadAhead,
+    ReleaseFromReadAhead,
+};
+
+static CC_FILE_SIZES FileSizes = {
+    RTL_CONSTANT_LARGE_INTEGER(TEST_FILE_SIZE), // .AllocationSize
+    RTL_CONSTANT_LARGE_INTEGER(TEST_FILE_SIZE), // .FileSize
+    RTL_CONSTANT_LARGE_INTEGER(TEST_FILE_SIZE)  // .ValidDataLength
+};
+
+static
+VOID
+NTAPI
+LookupThread(
+    _In_ PVOID Context)
+{
+    PTEST_THREAD_DATA ThreadData = Context;
+    LARGE_INTEGER Offset;
+    PVOID Bcb;
+    PVOID Buffer;
+
+    KeWaitForSingleObject(&TestStartEvent, Executive, KernelMode, FALSE, NULL);
+
+    while (!TestStop)
+    {
+        /* Spread the accesses over all views of the file */
+        Offset.QuadPart = (RtlRandomEx(&ThreadData->Seed) % (TEST_FILE_SIZE / PAGE_SIZE)) * PAGE_SIZE;
+
+        if (CcMapData(TestFileObject, &Offset, sizeof(ULONG), MAP_WAIT, &Bcb, &Buffer))
+        {
+            CcUnpinData(Bcb);
+            ThreadData->Lookups++;
+        }
+        else
+        {
+            ThreadData->Failures++;
+        }
+    }
+
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+static
+VOID
+RunBenchmark(
+    _In_ ULONG ThreadCount)
+{
+    TEST_THREAD_DATA ThreadData[MAX_THREADS];
+    LARGE_INTEGER Interval, Start, End, Frequency;
+    ULONGLONG Lookups = 0, ElapsedMs;
+    ULONG Failures = 0;
+    ULONG i;
+
+    ThreadCount = min(ThreadCount, MAX_THREADS);
+
+    KeInitializeEvent(&TestStartEvent, NotificationEvent, FALSE);
+    TestStop = FALSE;
+
+    RtlZeroMemory(ThreadData, sizeof(ThreadData));
+    for (i = 0; i < ThreadCount; i++)
+    {
+        ThreadData[i].Seed = 0x4242 + i;
+        ThreadData[i].Thread = KmtStartThread(LookupThread, &ThreadData[i]);
+    }
+
+    Start = KeQueryPerformanceCounter(&Frequency);
+    KeSetEvent(&TestStartEvent, IO_NO_INCREMENT, FALSE);
+
+    Interval.QuadPart = -10000LL * TEST_DURATION_MS;
+    KeDelayExecutionThread(KernelMode, FALSE, &Interval);
+    InterlockedExchange(&TestStop, TRUE);
+
+    for (i = 0; i < ThreadCount; i++)
+    {
+        KmtFinishThread(ThreadData[i].Thread, NULL);
+        Lookups += ThreadData[i].Lookups;
+        Failures += ThreadData[i].Failures;
+    }
+    End = KeQueryPerformanceCounter(NULL);
+
+    ElapsedMs = ((End.QuadPart - Start.QuadPart) * 1000) / Frequency.QuadPart;
+    if (ElapsedMs == 0) ElapsedMs = 1;
+
+    ok_eq_ulong(Failures, 0UL);
+    ok(Lookups > 0, "No lookup completed with %lu thread(s)\n", ThreadCount);
+    trace("%lu thread(s): %I64u lookups in %I64u ms, %I64u lookups/s\n",
+          ThreadCount, Lookups, ElapsedMs, (Lookups * 1000) / ElapsedMs);
+}
+
+static
+VOID
+PerformTest(
+    ULONG ThreadCount,
+    PDEVICE_OBJECT DeviceObject)
+{
+    PTEST_FCB Fcb;
+    LARGE_INTEGER Offset;
+    PVOID Bcb;
+    PVOID Buffer;
+    BOOLEAN Ret;
+
+    ok_eq_pointer(TestFileObject, NULL);
+    ok_eq_pointer(TestDeviceObject, NULL);
+    ok_eq_ulong(TestThreadCount, -1);
+
+    TestDeviceObject = DeviceObject;
+    TestThreadCount = ThreadCount;
+    TestFileObject = IoCreateStreamFileObject(NULL, DeviceObject);
+    if (skip(TestFileObject != NULL, "Failed to allocate FO\n"))
+        return;
+
+    Fcb = ExAllocatePool(NonPagedPool, sizeof(TEST_FCB));
+    if (skip(Fcb != NULL, "ExAllocatePool failed\n"))
+        return;
+
+    RtlZeroMemory(Fcb, sizeof(TEST_FCB));
+    ExInitializeFastMutex(&Fcb->HeaderMutex);
+    FsRtlSetupAdvancedHeader(&Fcb->Header, &Fcb->HeaderMutex);
+
+    TestFileObject->FsContext = Fcb;
+    TestFileObject->SectionObjectPointer = &Fcb->SectionObjectPointers;
+
+    KmtStartSeh();
+    CcInitializeCacheMap(TestFileObject, &FileSizes, FALSE, &Callbacks, NULL);
+    KmtEndSeh(STATUS_SUCCESS);
+
+    if (skip(CcIsFileCached(TestFileObject) == TRUE, "CcInitializeCacheMap failed\n"))
+        return;
+
+    /* Populate all views first, so that only lookups are measured */
+    for (Offset.QuadPart = 0; Offset.QuadPart < TEST_FILE_SIZE; Offset.QuadPart += VACB_MAPPING_GRANULARITY)
+    {
+        Ret = FALSE;
+        KmtStartSeh();
+        Ret = CcMapData(TestFileObject, &Offset, sizeof(ULONG), MAP_WAIT, &Bcb, &Buffer);
+        KmtEndSeh(STATUS_SUCCESS);
+
+        if (skip(Ret == TRUE, "CcMapData failed at %I64x\n", Offset.QuadPart))
+            return;
+
+        ok_eq_ulong(*(PULONG)Buffer, (ULONG)(Offset.QuadPart / PAGE_SIZE));
+        CcUnpinData(Bcb);
+    }
+
+    RunBenchmark(ThreadCount);
+}
+
+static
+VOID
+CleanupTest(
+    ULONG ThreadCount,
+    PDEVICE_OBJECT DeviceObject)
+{
+    LARGE_INTEGER Zero = RTL_CONSTANT_LARGE_INTEGER(0LL);
+    CACHE_UNINITIALIZE_EVENT CacheUninitEvent;
+
+    ok_eq_pointer(TestDeviceObject, DeviceObject);
+    ok_eq_ulong(TestThreadCount, ThreadCount);
+
+    if (!skip(TestFileObject != NULL, "No test FO\n"))
+    {
+        if (CcIsFileCached(TestFileObject))
+        {
+            KeInitializeEvent(&CacheUninitEvent.Event, NotificationEvent, FALSE);
+            CcUninitializeCacheMap(TestFileObject, &Zero, &CacheUninitEvent);
+            KeWaitForSingleObject(&CacheUninitEvent.Event, Executive, KernelMode, FALSE, NULL);
+        }
+
+        if (TestFileObject->FsContext != NULL)
+        {
+            ExFreePool(TestFileObject->FsContext);
+            TestFileObject->FsContext = NULL;
+            TestFileObject->SectionObjectPointer = NULL;
+        }
+
+        ObDereferenceObject(TestFileObject);
+    }
+
+    TestFileObject = NULL;
+    TestDeviceObject = NULL;
+    TestThreadCount = -1;
+}
+
+static
+NTSTATUS
+TestMessageHandler(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _In_ ULONG ControlCode,
+    _In_opt_ PVOID Buffer,
+    _In_ SIZE_T InLength,
+    _Inout_ PSIZE_T OutLength)
+{
+    NTSTATUS Status = STATUS_SUCCESS;
+
+    switch (ControlCode)
+    {
+        case IOCTL_START_TEST:
+            ok_eq_ulong((ULONG)InLength, sizeof(ULONG));
+            PerformTest(*(PULONG)Buffer, DeviceObject);
+            break;
+
+        case IOCTL_FINISH_TEST:
+            ok_eq_ulong((ULONG)InLength, sizeof(ULONG));
+            CleanupTest(*(PULONG)Buffer, DeviceObject);
+            break;
+
+        default:
+            Status = STATUS_NOT_IMPLEMENTED;
+            break;
+    }
+
+    return Status;
+}
+
+static
+NTSTATUS
+TestIrpHandler(
+    _In_ PDEVICE_OBJECT DeviceObject,
+    _In_ PIRP Irp,
+    _In_ PIO_STACK_LOCATION IoStack)
+{
+    NTSTATUS Status;
+
+    PAGED_CODE();
+
+    DPRINT("IRP %x/%x\n", IoStack->MajorFunction, IoStack->MinorFunction);
+    ASSERT(IoStack->MajorFunction == IRP_MJ_READ);
+
+    Status = STATUS_NOT_SUPPORTED;
+    Irp->IoStatus.Information = 0;
+
+    if (IoStack->MajorFunction == IRP_MJ_READ)
+    {
+        ULONG Length, i;
+        PULONG Buffer;
+        LARGE_INTEGER Offset;
+
+        Offset = IoStack->Parameters.Read.ByteOffset;
+        Length = IoStack->Parameters.Read.Length;
+
+        ok_eq_pointer(DeviceObject, TestDeviceObject);
+        ok_eq_pointer(IoStack->FileObject, TestFileObject);
+        ok(Irp->MdlAddress != NULL, "Null pointer for MDL!\n");
+
+        Buffer = MmGetSystemAddressForMdlSafe(Irp->MdlAddress, NormalPagePriority);
+        if (Buffer != NULL)
+        {
+            /* Stamp each page with its number, so that lookups can be checked */
+            for (i = 0; i < Length / PAGE_SIZE; i++)
+            {
+                Buffer[i * PAGE_SIZE / sizeof(ULONG)] = (ULONG)(Offset.QuadPart / PAGE_SIZE) + i;
+            }
+
+            Irp->IoStatus.Information = Length;
+            Status = STATUS_SUCCESS;
+        }
+        else
+        {
+            Status = STATUS_INSUFFICIENT_RESOURCES;
+        }
+    }
+
+    Irp->IoStatus.Status = Status;
+    IoCompleteRequest(Irp, IO_NO_INCREMENT);
+
+    return Status;
+}
@@ -0,0 +1,35 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Kernel-Mode Test Suite Cc view lookup benchmark user-mode part
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <kmt_test.h>
+
+#define IOCTL_START_TEST  1
+#define IOCTL_FINISH_TEST 2
+
+START_TEST(CcViewLookup)
+{
+    DWORD Ret;
+    ULONG Threads, MaxThreads;
+    SYSTEM_INFO SystemInfo;
+
+    GetSystemInfo(&SystemInfo);
+    MaxThreads = min(SystemInfo.dwNumberOfProcessors * 2, 16);
+
+    KmtLoadDriver(L"CcViewLookup", FALSE);
+    KmtOpenDriver();
+
+    for (Threads = 1; Threads <= MaxThreads; Threads *= 2)
+    {
+        Ret = KmtSendUlongToDriver(IOCTL_START_TEST, Threads);
+        ok(Ret == ERROR_SUCCESS, "KmtSendUlongToDriver failed: %lx\n", Ret);
+        Ret = KmtSendUlongToDriver(IOCTL_FINISH_TEST, Threads);
+        ok(Ret == ERROR_SUCCESS, "KmtSendUlongToDriver failed: %lx\n", Ret);
+    }
+
+    KmtCloseDriver();
+    KmtUnloadDriver();
+}
@@ -0,0 +1,222 @@
+/*
+ * PROJECT:         ReactOS kernel-mode tests
+ * LICENSE:         GPLv2+ - See COPYING in the top level directory
+ * PURPOSE:         Kernel-Mode Test Suite handle table test and create/close benchmark
+ * PROGRAMMER:      ReactOS Team
+ */
+
+#include <kmt_test.h>
+
+#define NDEBUG
+#include <debug.h>
+
+#define TEST_DURATION_MS  1000
+#define MAX_THREADS       16
+#define BATCH_SIZE        8
+
+typedef struct _TEST_THREAD_DATA
+{
+    PKTHREAD Thread;
+    ULONG Processor;
+    ULONGLONG Handles;
+    ULONG Failures;
+} TEST_THREAD_DATA, *PTEST_THREAD_DATA;
+
+static KEVENT TestStartEvent;
+static volatile LONG TestStop;
+
+static
+NTSTATUS
+CreateTestEvent(
+    _Out_ PHANDLE Handle)
+{
+    OBJECT_ATTRIBUTES ObjectAttributes;
+
+    InitializeObjectAttributes(&ObjectAttributes,
+                               NULL,
+                               OBJ_KERNEL_HANDLE,
+                               NULL,
+                               NULL);
+    return ZwCreateEvent(Handle, EVENT_ALL_ACCESS, &ObjectAttributes, NotificationEvent, FALSE);
+}
+
+/* Checks that every handle of the batch leads to its own event */
+static
+BOOLEAN
+CheckBatch(
+    _In_ PHANDLE Handles,
+    _In_ ULONG Count)
+{
+    PKEVENT Event;
+    NTSTATUS Status;
+    BOOLEAN Result = TRUE;
+    ULONG i;
+
+    for (i = 0; i < Count; i++)
+    {
+        Status = ObReferenceObjectByHandle(Handles[i],
+                                           EVENT_QUERY_STATE,
+                                           *ExEventObjectType,
+                                           KernelMode,
+                                           (PVOID*)&Event,
+                                           NULL);
+        if (!NT_SUCCESS(Status))
+        {
+            Result = FALSE;
+            continue;
+        }
+
+        /* Only the even ones were signaled, through their handles */
+        if ((KeReadStateEvent(Event) != 0) != ((i % 2) == 0))
+        {
+            Result = FALSE;
+        }
+        ObDereferenceObject(Event);
+    }
+
+    return Result;
+}
+
+static
+VOID
+NTAPI
+CreateCloseThread(
+    _In_ PVOID Context)
+{
+    PTEST_THREAD_DATA ThreadData = Context;
+    HANDLE Handles[BATCH_SIZE];
+    NTSTATUS Status;
+    ULONG i, Count;
+
+    /* One thread per processor, so that they really run at the same time */
+    KeSetSystemAffinityThread((KAFFINITY)1 << ThreadData->Processor);
+    KeWaitForSingleObject(&TestStartEvent, Executive, KernelMode, FALSE, NULL);
+
+    while (!TestStop)
+    {
+        /* Keep a few handles open at a time, so that they have to be told apart */
+        for (Count = 0; Count < BATCH_SIZE; Count++)
+        {
+            Status = CreateTestEvent(&Handles[Count]);
+            if (!NT_SUCCESS(Status))
+            {
+                ThreadData->Failures++;
+                break;
+            }
+            if ((Count % 2) == 0)
+            {
+                ZwSetEvent(Handles[Count], NULL);
+            }
+        }
+
+        if (!CheckBatch(Handles, Count))
+        {
+            ThreadData->Failures++;
+        }
+
+        for (i = 0; i < Count; i++)
+        {
+            Status = ZwClose(Handles[i]);
+            if (!NT_SUCCESS(Status))
+            {
+                ThreadData->Failures++;
+            }
+        }
+        ThreadData->Handles += Count;
+    }
+
+    KeRevertToUserAffinityThread();
+    PsTerminateSystemThread(STATUS_SUCCESS);
+}
+
+static
+VOID
+RunBenchmark(
+    _In_ ULONG ThreadCount)
+{
+    TEST_THREAD_DATA ThreadData[MAX_THREADS];
+    LARGE_INTEGER Interval, Start, End, Frequency;
+    ULONGLONG Handles = 0, ElapsedMs;
+    ULONG Failures = 0;
+    ULONG i;
+
+    ThreadCount = min(ThreadCount, MAX_THREADS);
+
+    KeInitializeEvent(&TestStartEvent, NotificationEvent, FALSE);
+    TestStop = FALSE;
+
+    RtlZeroMemory(ThreadData, sizeof(ThreadData));
+    for (i = 0; i < ThreadCount; i++)
+    {
+        ThreadData[i].Processor = i % KeNumberProcessors;
+        ThreadData[i].Thread = KmtStartThread(CreateCloseThread, &ThreadData[i]);
+    }
+
+    Start = KeQueryPerformanceCounter(&Frequency);
+    KeSetEvent(&TestStartEvent, IO_NO_INCREMENT, FALSE);
+
+    Interval.QuadPart = -10000LL * TEST_DURATION_MS;
+    KeDelayExecutionThread(KernelMode, FALSE, &Interval);
+    InterlockedExchange(&TestStop, TRUE);
+
+    for (i = 0; i < ThreadCount; i++)
+    {
+        KmtFinishThread(ThreadData[i].Thread, NULL);
+        Handles += ThreadData[i].Handles;
+        Failures += ThreadData[i].Failures;
+    }
+    End = KeQueryPerformanceCounter(NULL);
+
+    ElapsedMs = ((End.QuadPart - Start.QuadPart) * 1000) / Frequency.QuadPart;
+    if (ElapsedMs == 0) ElapsedMs = 1;
+
+    ok_eq_ulong(Failures, 0UL);
+    ok(Handles > 0, "No handle created with %lu thread(s)\n", ThreadCount);
+    trace("%lu thread(s): %I64u create/close pairs in %I64u ms, %I64u pairs/s\n",
+          ThreadCount, Handles, ElapsedMs, (Handles * 1000) / ElapsedMs);
+}
+
+static
+VOID
+TestUnique(VOID)
+{
+    HANDLE Handles[64];
+    NTSTATUS Status;
+    ULONG i, j;
+
+    /* More than a processor can cache, so the free lists get used as well */
+    for (i = 0; i < RTL_NUMBER_OF(Handles); i++)
+    {
+        Status = CreateTestEvent(&Handles[i]);
+        ok_eq_hex(Status, STATUS_SUCCESS);
+        if (!NT_SUCCESS(Status))
+        {
+            Handles[i] = NULL;
+            continue;
+        }
+        for (j = 0; j < i; j++)
+        {
+            ok(Handles[j] != Handles[i], "Handle %p given out twice\n", Handles[i]);
+        }
+    }
+
+    for (i = 0; i < RTL_NUMBER_OF(Handles); i++)
+    {
+        if (Handles[i])
+        {
+            Status = ZwClose(Handles[i]);
+            ok_eq_hex(Status, STATUS_SUCCESS);
+        }
+    }
+}
+
+START_TEST(ExHandle)
+{
+    TestUnique();
+
+    RunBenchmark(1);
+    if (KeNumberProcessors > 1)
+    {
+        RunBenchmark(KeNumberProcessors);
+    }
+}
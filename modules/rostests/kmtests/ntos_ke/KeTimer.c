@@ -1,12 +1,35 @@
 /*
  * PROJECT:         ReactOS kernel-mode tests
  * LICENSE:         GPLv2+ - See COPYING in the top level directory
- * PURPOSE:         Kernel-Mode Test Suite Timer test
+ * PURPOSE:         Kernel-Mode Test Suite Timer test and insert/cancel/expire benchmark
  * PROGRAMMER:      Rafal Harabien <rafalh@reactos.org>
  */
 
 #include <kmt_test.h>
 
+#define BENCH_TIMERS    1000
+#define TIMER_DUE_MS    50
+#define TOLERANCE_MS    100
+
+typedef
+BOOLEAN
+(NTAPI *PKE_SET_COALESCABLE_TIMER)(
+    _Inout_ PKTIMER Timer,
+    _In_ LARGE_INTEGER DueTime,
+    _In_ ULONG Period,
+    _In_ ULONG TolerableDelay,
+    _In_opt_ PKDPC Dpc);
+
+typedef struct _TEST_TIMER
+{
+    KTIMER Timer;
+    KDPC Dpc;
+    ULONGLONG FireTime;
+} TEST_TIMER, *PTEST_TIMER;
+
+static KEVENT AllFiredEvent;
+static volatile LONG TimersLeft;
+
 #define CheckTimer(Timer, ExpectedType, State, ExpectedWaitNext,                \
                             Irql, ThreadList, ThreadCount) do                   \
 {                                                                               \
@@ -47,18 +70,158 @@ TestTimerFunctional(
     CheckTimer(Timer, TimerNotificationObject + Type, 0L, FALSE, OriginalIrql, (PVOID *)NULL, 0);
 }
 
+static
+VOID
+NTAPI
+TimerDpcRoutine(
+    _In_ PKDPC Dpc,
+    _In_opt_ PVOID DeferredContext,
+    _In_opt_ PVOID SystemArgument1,
+    _In_opt_ PVOID SystemArgument2)
+{
+    PTEST_TIMER TestTimer = DeferredContext;
+
+    TestTimer->FireTime = KeQueryInterruptTime();
+    if (InterlockedDecrement(&TimersLeft) == 0)
+        KeSetEvent(&AllFiredEvent, IO_NO_INCREMENT, FALSE);
+}
+
+static
+ULONGLONG
+ElapsedMicroseconds(
+    _In_ LARGE_INTEGER Start,
+    _In_ LARGE_INTEGER Frequency)
+{
+    LARGE_INTEGER End = KeQueryPerformanceCounter(NULL);
+
+    return ((End.QuadPart - Start.QuadPart) * 1000000) / Frequency.QuadPart;
+}
+
+/* Sets all timers, with different due times spread over the timer table */
+static
+VOID
+SetTimers(
+    _In_ PTEST_TIMER Timers,
+    _In_ ULONG Count,
+    _In_opt_ PKE_SET_COALESCABLE_TIMER pKeSetCoalescableTimer)
+{
+    LARGE_INTEGER DueTime;
+    ULONG i;
+
+    KeInitializeEvent(&AllFiredEvent, NotificationEvent, FALSE);
+    TimersLeft = Count;
+    for (i = 0; i < Count; i++)
+    {
+        KeInitializeTimer(&Timers[i].Timer);
+        KeInitializeDpc(&Timers[i].Dpc, TimerDpcRoutine, &Timers[i]);
+        Timers[i].FireTime = 0;
+        DueTime.QuadPart = -10000LL * TIMER_DUE_MS - 1000 * (i % 100);
+        if (pKeSetCoalescableTimer)
+            pKeSetCoalescableTimer(&Timers[i].Timer, DueTime, 0, TOLERANCE_MS, &Timers[i].Dpc);
+        else
+            KeSetTimer(&Timers[i].Timer, DueTime, &Timers[i].Dpc);
+    }
+}
+
+static
+VOID
+TestTimerExpiration(
+    _In_ PTEST_TIMER Timers,
+    _In_opt_ PKE_SET_COALESCABLE_TIMER pKeSetCoalescableTimer)
+{
+    LARGE_INTEGER Timeout;
+    ULONGLONG SetTime, Earliest, Latest;
+    NTSTATUS Status;
+    ULONG i, Early = 0, Late = 0;
+
+    SetTime = KeQueryInterruptTime();
+    SetTimers(Timers, BENCH_TIMERS, pKeSetCoalescableTimer);
+
+    Timeout.QuadPart = -10000LL * 10 * 1000;
+    Status = KeWaitForSingleObject(&AllFiredEvent, Executive, KernelMode, FALSE, &Timeout);
+    ok_eq_hex(Status, STATUS_SUCCESS);
+    if (Status != STATUS_SUCCESS)
+    {
+        for (i = 0; i < BENCH_TIMERS; i++)
+            KeCancelTimer(&Timers[i].Timer);
+        KeFlushQueuedDpcs();
+        return;
+    }
+
+    /* No timer may fire before it's due, nor much later than it tolerates */
+    for (i = 0; i < BENCH_TIMERS; i++)
+    {
+        Earliest = SetTime + 10000ULL * TIMER_DUE_MS + 1000 * (i % 100);
+        Latest = Earliest + 10000ULL * TOLERANCE_MS + 2 * KeQueryTimeIncrement();
+        if (Timers[i].FireTime < Earliest) Early++;
+        if (pKeSetCoalescableTimer && Timers[i].FireTime > Latest) Late++;
+        ok_bool_true(KeReadStateTimer(&Timers[i].Timer), "KeReadStateTimer returned");
+    }
+    ok_eq_ulong(Early, 0UL);
+    ok_eq_ulong(Late, 0UL);
+}
+
+static
+VOID
+BenchmarkTimers(
+    _In_ PTEST_TIMER Timers,
+    _In_opt_ PKE_SET_COALESCABLE_TIMER pKeSetCoalescableTimer,
+    _In_ PCSTR Name)
+{
+    LARGE_INTEGER Start, Frequency;
+    ULONGLONG SetUs, CancelUs, First, Last;
+    ULONG i, j, Cancelled = 0, Ticks = 0;
+
+    /* Insertion and cancellation */
+    Start = KeQueryPerformanceCounter(&Frequency);
+    SetTimers(Timers, BENCH_TIMERS, pKeSetCoalescableTimer);
+    SetUs = ElapsedMicroseconds(Start, Frequency);
+
+    Start = KeQueryPerformanceCounter(NULL);
+    for (i = 0; i < BENCH_TIMERS; i++)
+    {
+        if (KeCancelTimer(&Timers[i].Timer)) Cancelled++;
+    }
+    CancelUs = ElapsedMicroseconds(Start, Frequency);
+    ok_eq_ulong(Cancelled, (ULONG)BENCH_TIMERS);
+    KeFlushQueuedDpcs();
+
+    /* Expiration, count how many clock ticks it took to fire them all */
+    SetTimers(Timers, BENCH_TIMERS, pKeSetCoalescableTimer);
+    KeWaitForSingleObject(&AllFiredEvent, Executive, KernelMode, FALSE, NULL);
+    KeFlushQueuedDpcs();
+    First = Last = Timers[0].FireTime;
+    for (i = 0; i < BENCH_TIMERS; i++)
+    {
+        First = min(First, Timers[i].FireTime);
+        Last = max(Last, Timers[i].FireTime);
+        for (j = 0; j < i; j++)
+        {
+            if (Timers[j].FireTime == Timers[i].FireTime)
+                break;
+        }
+        if (j == i) Ticks++;
+    }
+
+    trace("%s: %lu timers, set %I64u us, cancel %I64u us, expired in %lu tick(s) over %I64u us\n",
+          Name, (ULONG)BENCH_TIMERS, SetUs, CancelUs, Ticks, (Last - First) / 10);
+}
+
 START_TEST(KeTimer)
 {
     KTIMER Timer;
     KIRQL Irql;
     KIRQL Irqls[] = { PASSIVE_LEVEL, APC_LEVEL, DISPATCH_LEVEL, HIGH_LEVEL };
     INT i;
+    PTEST_TIMER Timers;
+    UNICODE_STRING RoutineName;
+    PKE_SET_COALESCABLE_TIMER pKeSetCoalescableTimer;
 
     for (i = 0; i < sizeof Irqls / sizeof Irqls[0]; ++i)
     {
         /* DRIVER_IRQL_NOT_LESS_OR_EQUAL (TODO: on MP only?) */
         if (Irqls[i] > DISPATCH_LEVEL && KmtIsCheckedBuild)
-            return;
+            break;
         KeRaiseIrql(Irqls[i], &Irql);
         TestTimerFunctional(&Timer, NotificationTimer, Irqls[i]);
         TestTimerFunctional(&Timer, SynchronizationTimer, Irqls[i]);
@@ -67,4 +230,21 @@ START_TEST(KeTimer)
 
     ok_irql(PASSIVE_LEVEL);
     KmtSetIrql(PASSIVE_LEVEL);
+
+    RtlInitUnicodeString(&RoutineName, L"KeSetCoalescableTimer");
+    pKeSetCoalescableTimer = (PKE_SET_COALESCABLE_TIMER)MmGetSystemRoutineAddress(&RoutineName);
+
+    Timers = ExAllocatePoolWithTag(NonPagedPool, BENCH_TIMERS * sizeof(*Timers), 'TmeK');
+    if (skip(Timers != NULL, "Out of memory\n"))
+        return;
+
+    TestTimerExpiration(Timers, NULL);
+    BenchmarkTimers(Timers, NULL, "KeSetTimer");
+    if (!skip(pKeSetCoalescableTimer != NULL, "KeSetCoalescableTimer unavailable\n"))
+    {
+        TestTimerExpiration(Timers, pKeSetCoalescableTimer);
+        BenchmarkTimers(Timers, pKeSetCoalescableTimer, "KeSetCoalescableTimer");
+    }
+
+    ExFreePoolWithTag(Timers, 'TmeK');
 }
@@ -151,7 +151,7 @@ CcRemapBcb (
 }
 
 /*
- * @unimplemented
+ * @implemented
  */
 VOID
 NTAPI
@@ -162,9 +162,14 @@ CcScheduleReadAhead (
 	)
 {
     KIRQL OldIrql;
-    LARGE_INTEGER NewOffset;
+    LONGLONG Stride;
+    LONGLONG EndOffset;
+    LONGLONG ScheduledEnd;
+    ULONG Granularity;
+    BOOLEAN Sequential;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
     PPRIVATE_CACHE_MAP PrivateCacheMap;
+    PROS_PRIVATE_CACHE_MAP RosPrivateCacheMap;
 
     SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
     PrivateCacheMap = FileObject->PrivateCacheMap;
@@ -176,47 +181,96 @@ CcScheduleReadAhead (
         return;
     }
 
+    RosPrivateCacheMap = CONTAINING_RECORD(PrivateCacheMap, ROS_PRIVATE_CACHE_MAP, PrivateCacheMap);
+
     /* Round read length with read ahead mask */
-    Length = ROUND_UP(Length, PrivateCacheMap->ReadAheadMask + 1);
+    Granularity = PrivateCacheMap->ReadAheadMask + 1;
+    Length = ROUND_UP(Length, Granularity);
     /* Compute the offset we'll reach */
-    NewOffset.QuadPart = FileOffset->QuadPart + Length;
+    EndOffset = FileOffset->QuadPart + Length;
 
     /* Lock read ahead spin lock */
     KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
-    /* Easy case: the file is sequentially read */
-    if (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY))
+
+    /* Compare with the read history: FileOffset2 is the previous read,
+     * FileOffset1 the one before it
+     */
+    Stride = FileOffset->QuadPart - PrivateCacheMap->FileOffset2.QuadPart;
+
+    /* Sequential: we start where (or close to where) the previous read stopped */
+    Sequential = (BooleanFlagOn(FileObject->Flags, FO_SEQUENTIAL_ONLY) ||
+                  (Stride >= 0 &&
+                   FileOffset->QuadPart <= ROUND_UP(PrivateCacheMap->BeyondLastByte2.QuadPart, Granularity)));
+    if (Sequential)
     {
-        /* If we went backward, this is no go! */
-        if (NewOffset.QuadPart < PrivateCacheMap->ReadAheadOffset[1].QuadPart)
+        Stride = 0;
+    }
+    /* Strided: the distance between reads doesn't change, in either direction */
+    else if (Stride != PrivateCacheMap->FileOffset2.QuadPart - PrivateCacheMap->FileOffset1.QuadPart)
+    {
+        /* No pattern, shrink the window. It takes several misses in a row
+         * to disable read ahead, so that a single seek doesn't kill it
+         */
+        RosPrivateCacheMap->ReadAheadWindow /= 2;
+        if (RosPrivateCacheMap->ReadAheadWindow < Granularity)
         {
-            KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
-            return;
+            RosPrivateCacheMap->ReadAheadWindow = 0;
         }
 
-        /* FIXME: hackish, but will do the job for now */
-        PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-        PrivateCacheMap->ReadAheadLength[1] = Length;
+        KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+        return;
     }
-    /* Other cases: try to find some logic in that mess... */
-    else
+
+    /* Pattern hit. If it's a new one, restart from the request size,
+     * otherwise, the more it's confirmed, the further we read
+     */
+    if (RosPrivateCacheMap->ReadAheadWindow == 0 || RosPrivateCacheMap->ReadAheadStride != Stride)
+    {
+        RosPrivateCacheMap->ReadAheadWindow = min(Length, CC_READ_AHEAD_MAX_WINDOW);
+        RosPrivateCacheMap->ReadAheadStride = Stride;
+    }
+    else if (RosPrivateCacheMap->ReadAheadWindow < CC_READ_AHEAD_MAX_WINDOW)
     {
-        /* Let's check if we always read the same way (like going down in the file)
-         * and pretend it's enough for now
+        RosPrivateCacheMap->ReadAheadWindow = min(RosPrivateCacheMap->ReadAheadWindow * 2, CC_READ_AHEAD_MAX_WINDOW);
+    }
+
+    if (Sequential)
+    {
+        /* What was already scheduled doesn't need to be read again */
+        ScheduledEnd = PrivateCacheMap->ReadAheadOffset[1].QuadPart + PrivateCacheMap->ReadAheadLength[1];
+        if (ScheduledEnd < EndOffset || ScheduledEnd > EndOffset + RosPrivateCacheMap->ReadAheadWindow)
+        {
+            ScheduledEnd = EndOffset;
+        }
+
+        /* If we're still at least half a window ahead, wait for the reader
+         * to catch up, so that we issue a few large reads instead of many
+         * small ones
          */
-        if (PrivateCacheMap->FileOffset2.QuadPart >= PrivateCacheMap->FileOffset1.QuadPart &&
-            FileOffset->QuadPart >= PrivateCacheMap->FileOffset2.QuadPart)
+        if (ScheduledEnd - EndOffset >= RosPrivateCacheMap->ReadAheadWindow / 2)
         {
-            /* FIXME: hackish, but will do the job for now */
-            PrivateCacheMap->ReadAheadOffset[1].QuadPart = NewOffset.QuadPart;
-            PrivateCacheMap->ReadAheadLength[1] = Length;
+            KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
+            return;
         }
-        else
+
+        PrivateCacheMap->ReadAheadOffset[1].QuadPart = ScheduledEnd;
+        PrivateCacheMap->ReadAheadLength[1] = (ULONG)(EndOffset + RosPrivateCacheMap->ReadAheadWindow - ScheduledEnd);
+        RosPrivateCacheMap->ReadAheadCount = 1;
+    }
+    else
+    {
+        /* Don't go before the beginning of the file */
+        if (FileOffset->QuadPart + Stride < 0)
         {
-            /* FIXME: handle the other cases */
             KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
-            UNIMPLEMENTED_ONCE;
             return;
         }
+
+        /* Read the next few strides, as many as the window allows */
+        PrivateCacheMap->ReadAheadOffset[1].QuadPart = FileOffset->QuadPart + Stride;
+        PrivateCacheMap->ReadAheadLength[1] = Length;
+        RosPrivateCacheMap->ReadAheadCount = max(1, min(RosPrivateCacheMap->ReadAheadWindow / Length,
+                                                        CC_READ_AHEAD_MAX_STRIDES));
     }
 
     /* If read ahead isn't active yet */
@@ -228,6 +282,7 @@ CcScheduleReadAhead (
          * Be careful with the mask, you don't want to mess with node code
          */
         InterlockedOr((volatile long *)&PrivateCacheMap->UlongFlags, PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
+        RosPrivateCacheMap->ReadAheadPending = FALSE;
         KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
 
         /* Get a work item */
@@ -251,8 +306,13 @@ CcScheduleReadAhead (
         KeAcquireSpinLock(&PrivateCacheMap->ReadAheadSpinLock, &OldIrql);
         InterlockedAnd((volatile long *)&PrivateCacheMap->UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
     }
+    else
+    {
+        /* The running read ahead will pick the new range up when it's done */
+        RosPrivateCacheMap->ReadAheadPending = TRUE;
+    }
 
-    /* Done (fail) */
+    /* Done */
     KeReleaseSpinLock(&PrivateCacheMap->ReadAheadSpinLock, OldIrql);
 }
 
@@ -258,7 +258,8 @@ CcCopyData (
     ULONG BytesCopied;
     KIRQL OldIrql;
     PROS_SHARED_CACHE_MAP SharedCacheMap;
-    PLIST_ENTRY ListEntry;
+    LONGLONG VacbOffset;
+    PROS_VACB *Slot;
     PROS_VACB Vacb;
     ULONG PartialLength;
     PVOID BaseAddress;
@@ -275,25 +276,18 @@ CcCopyData (
         /* test if the requested data is available */
         KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &OldIrql);
         /* FIXME: this loop doesn't take into account areas that don't have
-         * a VACB in the list yet */
-        ListEntry = SharedCacheMap->CacheMapVacbListHead.Flink;
-        while (ListEntry != &SharedCacheMap->CacheMapVacbListHead)
+         * a VACB in the index yet */
+        for (VacbOffset = ROUND_DOWN(CurrentOffset, VACB_MAPPING_GRANULARITY);
+             VacbOffset < CurrentOffset + Length;
+             VacbOffset += VACB_MAPPING_GRANULARITY)
         {
-            Vacb = CONTAINING_RECORD(ListEntry,
-                                     ROS_VACB,
-                                     CacheMapVacbListEntry);
-            ListEntry = ListEntry->Flink;
-            if (!Vacb->Valid &&
-                DoRangesIntersect(Vacb->FileOffset.QuadPart,
-                                  VACB_MAPPING_GRANULARITY,
-                                  CurrentOffset, Length))
+            Slot = CcRosVacbIndexSlot(SharedCacheMap, VacbOffset);
+            if (Slot != NULL && *Slot != NULL && !(*Slot)->Valid)
             {
                 KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
                 /* data not available */
                 return FALSE;
             }
-            if (Vacb->FileOffset.QuadPart >= CurrentOffset + Length)
-                break;
         }
         KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
     }
@@ -377,11 +371,10 @@ CcCopyData (
     /* If that was a successful sync read operation, let's handle read ahead */
     if (Operation == CcOperationRead && Length == 0 && Wait)
     {
-        /* If file isn't random access and next read may get us cross VACB boundary,
-         * schedule next read
+        /* If file isn't random access, let the read ahead engine look at
+         * that read. It decides whether there's something worth prefetching
          */
-        if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS) &&
-            (CurrentOffset - 1) / VACB_MAPPING_GRANULARITY != (CurrentOffset + BytesCopied - 1) / VACB_MAPPING_GRANULARITY)
+        if (!BooleanFlagOn(FileObject->Flags, FO_RANDOM_ACCESS))
         {
             CcScheduleReadAhead(FileObject, (PLARGE_INTEGER)&FileOffset, BytesCopied);
         }
@@ -472,65 +465,23 @@ CcPostDeferredWrites(VOID)
     }
 }
 
-VOID
-CcPerformReadAhead(
-    IN PFILE_OBJECT FileObject)
+static
+NTSTATUS
+CcReadAheadRange(
+    IN PROS_SHARED_CACHE_MAP SharedCacheMap,
+    IN LONGLONG CurrentOffset,
+    IN ULONG Length)
 {
     NTSTATUS Status;
-    LONGLONG CurrentOffset;
-    KIRQL OldIrql;
-    PROS_SHARED_CACHE_MAP SharedCacheMap;
     PROS_VACB Vacb;
     ULONG PartialLength;
     PVOID BaseAddress;
     BOOLEAN Valid;
-    ULONG Length;
-    PPRIVATE_CACHE_MAP PrivateCacheMap;
-    BOOLEAN Locked;
-
-    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
-
-    /* Critical:
-     * PrivateCacheMap might disappear in-between if the handle
-     * to the file is closed (private is attached to the handle not to
-     * the file), so we need to lock the master lock while we deal with
-     * it. It won't disappear without attempting to lock such lock.
-     */
-    OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
-    PrivateCacheMap = FileObject->PrivateCacheMap;
-    /* If the handle was closed since the read ahead was scheduled, just quit */
-    if (PrivateCacheMap == NULL)
-    {
-        KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
-        ObDereferenceObject(FileObject);
-        return;
-    }
-    /* Otherwise, extract read offset and length and release private map */
-    else
-    {
-        KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
-        CurrentOffset = PrivateCacheMap->ReadAheadOffset[1].QuadPart;
-        Length = PrivateCacheMap->ReadAheadLength[1];
-        KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
-    }
-    KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
-
-    /* Time to go! */
-    DPRINT("Doing ReadAhead for %p\n", FileObject);
-    /* Lock the file, first */
-    if (!SharedCacheMap->Callbacks->AcquireForReadAhead(SharedCacheMap->LazyWriteContext, FALSE))
-    {
-        Locked = FALSE;
-        goto Clear;
-    }
-
-    /* Remember it's locked */
-    Locked = TRUE;
 
     /* Don't read past the end of the file */
     if (CurrentOffset >= SharedCacheMap->FileSize.QuadPart)
     {
-        goto Clear;
+        return STATUS_END_OF_FILE;
     }
     if (CurrentOffset + Length > SharedCacheMap->FileSize.QuadPart)
     {
@@ -539,12 +490,12 @@ CcPerformReadAhead(
 
     /* Next of the algorithm will lock like CcCopyData with the slight
      * difference that we don't copy data back to an user-backed buffer
-     * We just bring data into Cc
+     * We just bring data into Cc, one VACB at a time. VACBs which are
+     * already valid cost a lookup only.
      */
-    PartialLength = CurrentOffset % VACB_MAPPING_GRANULARITY;
-    if (PartialLength != 0)
+    while (Length > 0)
     {
-        PartialLength = min(Length, VACB_MAPPING_GRANULARITY - PartialLength);
+        PartialLength = min(Length, VACB_MAPPING_GRANULARITY - (ULONG)(CurrentOffset % VACB_MAPPING_GRANULARITY));
         Status = CcRosRequestVacb(SharedCacheMap,
                                   ROUND_DOWN(CurrentOffset,
                                              VACB_MAPPING_GRANULARITY),
@@ -554,7 +505,7 @@ CcPerformReadAhead(
         if (!NT_SUCCESS(Status))
         {
             DPRINT1("Failed to request VACB: %lx!\n", Status);
-            goto Clear;
+            return Status;
         }
 
         if (!Valid)
@@ -564,7 +515,7 @@ CcPerformReadAhead(
             {
                 CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE, FALSE);
                 DPRINT1("Failed to read data: %lx!\n", Status);
-                goto Clear;
+                return Status;
             }
         }
 
@@ -574,36 +525,107 @@ CcPerformReadAhead(
         CurrentOffset += PartialLength;
     }
 
-    while (Length > 0)
+    return STATUS_SUCCESS;
+}
+
+VOID
+CcPerformReadAhead(
+    IN PFILE_OBJECT FileObject)
+{
+    NTSTATUS Status;
+    LONGLONG CurrentOffset;
+    LONGLONG Stride;
+    KIRQL OldIrql;
+    PROS_SHARED_CACHE_MAP SharedCacheMap;
+    ULONG Length;
+    ULONG Count;
+    PPRIVATE_CACHE_MAP PrivateCacheMap;
+    PROS_PRIVATE_CACHE_MAP RosPrivateCacheMap;
+    BOOLEAN Locked;
+
+    SharedCacheMap = FileObject->SectionObjectPointer->SharedCacheMap;
+
+    /* Lock the file, first */
+    if (!SharedCacheMap->Callbacks->AcquireForReadAhead(SharedCacheMap->LazyWriteContext, FALSE))
     {
-        ASSERT(CurrentOffset % VACB_MAPPING_GRANULARITY == 0);
-        PartialLength = min(VACB_MAPPING_GRANULARITY, Length);
-        Status = CcRosRequestVacb(SharedCacheMap,
-                                  CurrentOffset,
-                                  &BaseAddress,
-                                  &Valid,
-                                  &Vacb);
-        if (!NT_SUCCESS(Status))
+        Locked = FALSE;
+        goto Clear;
+    }
+
+    /* Remember it's locked */
+    Locked = TRUE;
+
+    /* Time to go! */
+    DPRINT("Doing ReadAhead for %p\n", FileObject);
+    while (TRUE)
+    {
+        /* Critical:
+         * PrivateCacheMap might disappear in-between if the handle
+         * to the file is closed (private is attached to the handle not to
+         * the file), so we need to lock the master lock while we deal with
+         * it. It won't disappear without attempting to lock such lock.
+         */
+        OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+        PrivateCacheMap = FileObject->PrivateCacheMap;
+        /* If the handle was closed since the read ahead was scheduled, just quit */
+        if (PrivateCacheMap == NULL)
         {
-            DPRINT1("Failed to request VACB: %lx!\n", Status);
-            goto Clear;
+            KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+            break;
         }
 
-        if (!Valid)
+        /* Otherwise, extract what to read and release private map */
+        RosPrivateCacheMap = CONTAINING_RECORD(PrivateCacheMap, ROS_PRIVATE_CACHE_MAP, PrivateCacheMap);
+        KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+        CurrentOffset = PrivateCacheMap->ReadAheadOffset[1].QuadPart;
+        Length = PrivateCacheMap->ReadAheadLength[1];
+        Stride = RosPrivateCacheMap->ReadAheadStride;
+        Count = RosPrivateCacheMap->ReadAheadCount;
+        RosPrivateCacheMap->ReadAheadPending = FALSE;
+        KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+
+        /* Sequential reads come as a single range, strided ones as
+         * Count ranges of Length bytes, Stride bytes apart
+         */
+        do
         {
-            Status = CcReadVirtualAddress(Vacb);
-            if (!NT_SUCCESS(Status))
-            {
-                CcRosReleaseVacb(SharedCacheMap, Vacb, FALSE, FALSE, FALSE);
-                DPRINT1("Failed to read data: %lx!\n", Status);
-                goto Clear;
-            }
+            Status = CcReadAheadRange(SharedCacheMap, CurrentOffset, Length);
+            CurrentOffset += Stride;
         }
+        while (NT_SUCCESS(Status) && --Count > 0 && CurrentOffset >= 0);
 
-        CcRosReleaseVacb(SharedCacheMap, Vacb, TRUE, FALSE, FALSE);
+        /* If something failed, don't insist */
+        if (!NT_SUCCESS(Status))
+        {
+            break;
+        }
 
-        Length -= PartialLength;
-        CurrentOffset += PartialLength;
+        /* Check whether the reader moved on while we were working,
+         * in which case we keep going, we're still active
+         */
+        OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
+        PrivateCacheMap = FileObject->PrivateCacheMap;
+        if (PrivateCacheMap == NULL)
+        {
+            KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+            break;
+        }
+
+        RosPrivateCacheMap = CONTAINING_RECORD(PrivateCacheMap, ROS_PRIVATE_CACHE_MAP, PrivateCacheMap);
+        KeAcquireSpinLockAtDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+        if (!RosPrivateCacheMap->ReadAheadPending)
+        {
+            /* Nothing new, mark read ahead as unactive while we hold the lock,
+             * so that the next request queues a new work item
+             */
+            InterlockedAnd((volatile long *)&PrivateCacheMap->UlongFlags, ~PRIVATE_CACHE_MAP_READ_AHEAD_ACTIVE);
+            KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+            KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
+            goto Done;
+        }
+        KeReleaseSpinLockFromDpcLevel(&PrivateCacheMap->ReadAheadSpinLock);
+        KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
     }
 
 Clear:
@@ -619,6 +641,7 @@ Clear:
     }
     KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
 
+Done:
     /* If file was locked, release it */
     if (Locked)
     {
@@ -221,7 +221,8 @@ CcPurgeCacheSection (
                       SharedCacheMap->SectionSize.QuadPart);
         if (ViewEnd >= EndOffset)
         {
-            break;
+            /* The list isn't sorted by offset */
+            continue;
         }
 
         /* Still in use, it cannot be purged, fail
@@ -242,6 +243,7 @@ CcPurgeCacheSection (
         {
             CcRosUnmarkDirtyVacb(Vacb, FALSE);
         }
+        CcRosRemoveVacbFromIndex(Vacb);
         RemoveEntryList(&Vacb->CacheMapVacbListEntry);
         InsertHeadList(&FreeList, &Vacb->CacheMapVacbListEntry);
     }
@@ -299,6 +301,10 @@ CcSetFileSizes (
                             FALSE);
     }
 
+    /* Make sure the VACB index covers the new section size. If this fails,
+     * the index gets another chance when a VACB is created */
+    CcRosGrowVacbIndex(SharedCacheMap, FileSizes->AllocationSize.QuadPart);
+
     KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldirql);
     SharedCacheMap->SectionSize = FileSizes->AllocationSize;
     SharedCacheMap->FileSize = FileSizes->FileSize;
@@ -373,6 +373,7 @@ retry:
             ASSERT(!current->MappedCount);
             ASSERT(Refs == 1);
 
+            CcRosRemoveVacbFromIndex(current);
             RemoveEntryList(&current->CacheMapVacbListEntry);
             RemoveEntryList(&current->VacbLruListEntry);
             InsertHeadList(&FreeList, &current->CacheMapVacbListEntry);
@@ -461,6 +462,160 @@ CcRosReleaseVacb (
     return STATUS_SUCCESS;
 }
 
+static
+ULONG
+CcRosGetVacbIndexLeaves (
+    LONGLONG SectionSize)
+{
+    /* Always have at least one leaf slot, even for empty files */
+    if (SectionSize <= 0)
+        return 1;
+
+    return (ULONG)((SectionSize + VACB_INDEX_LEAF_SIZE - 1) / VACB_INDEX_LEAF_SIZE);
+}
+
+NTSTATUS
+NTAPI
+CcRosGrowVacbIndex (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG SectionSize)
+/*
+ * FUNCTION: Makes sure the VACB index directory covers the section
+ */
+{
+    PROS_VACB **NewIndex, **OldIndex;
+    ULONG Leaves;
+    KIRQL OldIrql;
+
+    Leaves = CcRosGetVacbIndexLeaves(SectionSize);
+    if (Leaves <= SharedCacheMap->VacbIndexLeaves)
+        return STATUS_SUCCESS;
+
+    NewIndex = ExAllocatePoolWithTag(NonPagedPool,
+                                     Leaves * sizeof(PROS_VACB *),
+                                     TAG_VACB_INDEX);
+    if (NewIndex == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    RtlZeroMemory(NewIndex, Leaves * sizeof(PROS_VACB *));
+
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &OldIrql);
+
+    /* Someone else may have grown it meanwhile */
+    if (Leaves <= SharedCacheMap->VacbIndexLeaves)
+    {
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
+        ExFreePoolWithTag(NewIndex, TAG_VACB_INDEX);
+        return STATUS_SUCCESS;
+    }
+
+    /* Leaves are kept, only the directory is replaced */
+    OldIndex = SharedCacheMap->VacbIndex;
+    if (OldIndex != NULL)
+    {
+        RtlCopyMemory(NewIndex,
+                      OldIndex,
+                      SharedCacheMap->VacbIndexLeaves * sizeof(PROS_VACB *));
+    }
+
+    SharedCacheMap->VacbIndex = NewIndex;
+    SharedCacheMap->VacbIndexLeaves = Leaves;
+
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
+
+    if (OldIndex != NULL)
+        ExFreePoolWithTag(OldIndex, TAG_VACB_INDEX);
+
+    return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+CcRosAllocateVacbIndexLeaf (
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG FileOffset)
+/*
+ * FUNCTION: Makes sure there's a slot for FileOffset in the VACB index
+ */
+{
+    PROS_VACB *Leaf;
+    ULONG_PTR LeafIndex;
+    KIRQL OldIrql;
+    NTSTATUS Status;
+
+    /* The section may have grown without us being told */
+    Status = CcRosGrowVacbIndex(SharedCacheMap, FileOffset + 1);
+    if (!NT_SUCCESS(Status))
+        return Status;
+
+    LeafIndex = (ULONG_PTR)(FileOffset / VACB_INDEX_LEAF_SIZE);
+
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &OldIrql);
+    Leaf = SharedCacheMap->VacbIndex[LeafIndex];
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
+
+    if (Leaf != NULL)
+        return STATUS_SUCCESS;
+
+    Leaf = ExAllocatePoolWithTag(NonPagedPool,
+                                 VACB_INDEX_LEAF_ENTRIES * sizeof(PROS_VACB),
+                                 TAG_VACB_INDEX);
+    if (Leaf == NULL)
+        return STATUS_INSUFFICIENT_RESOURCES;
+
+    RtlZeroMemory(Leaf, VACB_INDEX_LEAF_ENTRIES * sizeof(PROS_VACB));
+
+    KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &OldIrql);
+    if (SharedCacheMap->VacbIndex[LeafIndex] == NULL)
+    {
+        SharedCacheMap->VacbIndex[LeafIndex] = Leaf;
+        Leaf = NULL;
+    }
+    KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
+
+    /* Lost the race, somebody else installed it */
+    if (Leaf != NULL)
+        ExFreePoolWithTag(Leaf, TAG_VACB_INDEX);
+
+    return STATUS_SUCCESS;
+}
+
+static
+VOID
+CcRosFreeVacbIndex (
+    PROS_SHARED_CACHE_MAP SharedCacheMap)
+{
+    ULONG i;
+
+    if (SharedCacheMap->VacbIndex == NULL)
+        return;
+
+    for (i = 0; i < SharedCacheMap->VacbIndexLeaves; i++)
+    {
+        if (SharedCacheMap->VacbIndex[i] != NULL)
+            ExFreePoolWithTag(SharedCacheMap->VacbIndex[i], TAG_VACB_INDEX);
+    }
+
+    ExFreePoolWithTag(SharedCacheMap->VacbIndex, TAG_VACB_INDEX);
+    SharedCacheMap->VacbIndex = NULL;
+    SharedCacheMap->VacbIndexLeaves = 0;
+}
+
+/* Must be called with the CacheMapLock held */
+VOID
+NTAPI
+CcRosRemoveVacbFromIndex (
+    PROS_VACB Vacb)
+{
+    PROS_VACB *Slot;
+
+    Slot = CcRosVacbIndexSlot(Vacb->SharedCacheMap, Vacb->FileOffset.QuadPart);
+    if (Slot != NULL && *Slot == Vacb)
+    {
+        *Slot = NULL;
+    }
+}
+
 /* Returns with VACB Lock Held! */
 PROS_VACB
 NTAPI
@@ -468,8 +623,8 @@ CcRosLookupVacb (
     PROS_SHARED_CACHE_MAP SharedCacheMap,
     LONGLONG FileOffset)
 {
-    PLIST_ENTRY current_entry;
-    PROS_VACB current;
+    PROS_VACB *Slot;
+    PROS_VACB current = NULL;
     KIRQL oldIrql;
 
     ASSERT(SharedCacheMap);
@@ -477,34 +632,28 @@ CcRosLookupVacb (
     DPRINT("CcRosLookupVacb(SharedCacheMap 0x%p, FileOffset %I64u)\n",
            SharedCacheMap, FileOffset);
 
-    KeAcquireGuardedMutex(&ViewLock);
+    /* The index is protected by the cache map lock alone, so lookups
+     * on different files don't serialize on the ViewLock */
     KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
 
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    Slot = CcRosVacbIndexSlot(SharedCacheMap, FileOffset);
+    if (Slot != NULL && *Slot != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
-            KeReleaseGuardedMutex(&ViewLock);
-            CcRosAcquireVacbLock(current, NULL);
-            return current;
-        }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+        current = *Slot;
+        ASSERT(IsPointInRange(current->FileOffset.QuadPart,
+                              VACB_MAPPING_GRANULARITY,
+                              FileOffset));
+        CcRosVacbIncRefCount(current);
     }
 
     KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
-    KeReleaseGuardedMutex(&ViewLock);
 
-    return NULL;
+    if (current != NULL)
+    {
+        CcRosAcquireVacbLock(current, NULL);
+    }
+
+    return current;
 }
 
 VOID
@@ -714,8 +863,7 @@ CcRosCreateVacb (
     PROS_VACB *Vacb)
 {
     PROS_VACB current;
-    PROS_VACB previous;
-    PLIST_ENTRY current_entry;
+    PROS_VACB *Slot;
     NTSTATUS Status;
     KIRQL oldIrql;
 
@@ -729,6 +877,14 @@ CcRosCreateVacb (
         return STATUS_INVALID_PARAMETER;
     }
 
+    /* Make room in the index before taking any lock */
+    Status = CcRosAllocateVacbIndexLeaf(SharedCacheMap, FileOffset);
+    if (!NT_SUCCESS(Status))
+    {
+        *Vacb = NULL;
+        return Status;
+    }
+
     current = ExAllocateFromNPagedLookasideList(&VacbLookasideList);
     current->BaseAddress = NULL;
     current->Valid = FALSE;
@@ -758,55 +914,33 @@ CcRosCreateVacb (
      * our newly created VACB and return the existing one.
      */
     KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
-    current_entry = SharedCacheMap->CacheMapVacbListHead.Flink;
-    previous = NULL;
-    while (current_entry != &SharedCacheMap->CacheMapVacbListHead)
+    Slot = CcRosVacbIndexSlot(SharedCacheMap, FileOffset);
+    ASSERT(Slot != NULL);
+    if (*Slot != NULL)
     {
-        current = CONTAINING_RECORD(current_entry,
-                                    ROS_VACB,
-                                    CacheMapVacbListEntry);
-        if (IsPointInRange(current->FileOffset.QuadPart,
-                           VACB_MAPPING_GRANULARITY,
-                           FileOffset))
-        {
-            CcRosVacbIncRefCount(current);
-            KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+        current = *Slot;
+        CcRosVacbIncRefCount(current);
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 #if DBG
-            if (SharedCacheMap->Trace)
-            {
-                DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
-                        SharedCacheMap,
-                        (*Vacb),
-                        current);
-            }
-#endif
-            CcRosReleaseVacbLock(*Vacb);
-            KeReleaseGuardedMutex(&ViewLock);
-            ExFreeToNPagedLookasideList(&VacbLookasideList, *Vacb);
-            *Vacb = current;
-            CcRosAcquireVacbLock(current, NULL);
-            return STATUS_SUCCESS;
-        }
-        if (current->FileOffset.QuadPart < FileOffset)
+        if (SharedCacheMap->Trace)
         {
-            ASSERT(previous == NULL ||
-                   previous->FileOffset.QuadPart < current->FileOffset.QuadPart);
-            previous = current;
+            DPRINT1("CacheMap 0x%p: deleting newly created VACB 0x%p ( found existing one 0x%p )\n",
+                    SharedCacheMap,
+                    (*Vacb),
+                    current);
         }
-        if (current->FileOffset.QuadPart > FileOffset)
-            break;
-        current_entry = current_entry->Flink;
+#endif
+        CcRosReleaseVacbLock(*Vacb);
+        KeReleaseGuardedMutex(&ViewLock);
+        ExFreeToNPagedLookasideList(&VacbLookasideList, *Vacb);
+        *Vacb = current;
+        CcRosAcquireVacbLock(current, NULL);
+        return STATUS_SUCCESS;
     }
-    /* There was no existing VACB. */
+    /* There was no existing VACB. The list is not sorted, lookups go through the index */
     current = *Vacb;
-    if (previous)
-    {
-        InsertHeadList(&previous->CacheMapVacbListEntry, &current->CacheMapVacbListEntry);
-    }
-    else
-    {
-        InsertHeadList(&SharedCacheMap->CacheMapVacbListHead, &current->CacheMapVacbListEntry);
-    }
+    *Slot = current;
+    InsertTailList(&SharedCacheMap->CacheMapVacbListHead, &current->CacheMapVacbListEntry);
     KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
     InsertTailList(&VacbLruListHead, &current->VacbLruListEntry);
     CcRosVacbIncRefCount(current);
@@ -837,8 +971,13 @@ CcRosCreateVacb (
     Status = CcRosMapVacbInKernelSpace(current);
     if (!NT_SUCCESS(Status))
     {
+        KeAcquireGuardedMutex(&ViewLock);
+        KeAcquireSpinLock(&SharedCacheMap->CacheMapLock, &oldIrql);
+        CcRosRemoveVacbFromIndex(current);
         RemoveEntryList(&current->CacheMapVacbListEntry);
         RemoveEntryList(&current->VacbLruListEntry);
+        KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
+        KeReleaseGuardedMutex(&ViewLock);
         CcRosReleaseVacb(SharedCacheMap, current, FALSE,
                          FALSE, FALSE);
         CcRosVacbDecRefCount(current);
@@ -884,13 +1023,15 @@ CcRosGetVacb (
 
     Refs = CcRosVacbGetRefCount(current);
 
-    KeAcquireGuardedMutex(&ViewLock);
-
-    /* Move to the tail of the LRU list */
-    RemoveEntryList(&current->VacbLruListEntry);
-    InsertTailList(&VacbLruListHead, &current->VacbLruListEntry);
+    /* Move to the tail of the LRU list. The LRU order is only a hint for
+     * the trimmer, so don't wait for the ViewLock if someone else holds it */
+    if (KeTryToAcquireGuardedMutex(&ViewLock))
+    {
+        RemoveEntryList(&current->VacbLruListEntry);
+        InsertTailList(&VacbLruListHead, &current->VacbLruListEntry);
 
-    KeReleaseGuardedMutex(&ViewLock);
+        KeReleaseGuardedMutex(&ViewLock);
+    }
 
     /*
      * Return information about the VACB to the caller.
@@ -1104,9 +1245,10 @@ CcRosDeleteFileCache (
         while (!IsListEmpty(&SharedCacheMap->CacheMapVacbListHead))
         {
             current_entry = RemoveTailList(&SharedCacheMap->CacheMapVacbListHead);
+            current = CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry);
+            CcRosRemoveVacbFromIndex(current);
             KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, oldIrql);
 
-            current = CONTAINING_RECORD(current_entry, ROS_VACB, CacheMapVacbListEntry);
             CcRosAcquireVacbLock(current, NULL);
             RemoveEntryList(&current->VacbLruListEntry);
             if (current->Dirty)
@@ -1141,6 +1283,7 @@ CcRosDeleteFileCache (
         RemoveEntryList(&SharedCacheMap->SharedCacheMapLinks);
         KeReleaseQueuedSpinLock(LockQueueMasterLock, OldIrql);
 
+        CcRosFreeVacbIndex(SharedCacheMap);
         ExFreeToNPagedLookasideList(&SharedCacheMapLookasideList, SharedCacheMap);
         KeAcquireGuardedMutex(&ViewLock);
     }
@@ -1236,7 +1379,7 @@ CcRosReleaseFileCache (
             KeReleaseSpinLock(&SharedCacheMap->CacheMapLock, OldIrql);
 
             /* And free it. */
-            if (PrivateMap != &SharedCacheMap->PrivateCacheMap)
+            if (PrivateMap != &SharedCacheMap->PrivateCacheMap.PrivateCacheMap)
             {
                 ExFreePoolWithTag(PrivateMap, TAG_PRIVATE_CACHE_MAP);
             }
@@ -1309,6 +1452,13 @@ CcRosInitializeFileCache (
         InitializeListHead(&SharedCacheMap->PrivateList);
         KeInitializeSpinLock(&SharedCacheMap->CacheMapLock);
         InitializeListHead(&SharedCacheMap->CacheMapVacbListHead);
+        if (!NT_SUCCESS(CcRosGrowVacbIndex(SharedCacheMap, SharedCacheMap->SectionSize.QuadPart)))
+        {
+            ObDereferenceObject(FileObject);
+            ExFreeToNPagedLookasideList(&SharedCacheMapLookasideList, SharedCacheMap);
+            KeReleaseGuardedMutex(&ViewLock);
+            return STATUS_INSUFFICIENT_RESOURCES;
+        }
         FileObject->SectionObjectPointer->SharedCacheMap = SharedCacheMap;
 
         OldIrql = KeAcquireQueuedSpinLock(LockQueueMasterLock);
@@ -1320,13 +1470,13 @@ CcRosInitializeFileCache (
         PPRIVATE_CACHE_MAP PrivateMap;
 
         /* Allocate the private cache map for this handle */
-        if (SharedCacheMap->PrivateCacheMap.NodeTypeCode != 0)
+        if (SharedCacheMap->PrivateCacheMap.PrivateCacheMap.NodeTypeCode != 0)
         {
-            PrivateMap = ExAllocatePoolWithTag(NonPagedPool, sizeof(PRIVATE_CACHE_MAP), TAG_PRIVATE_CACHE_MAP);
+            PrivateMap = ExAllocatePoolWithTag(NonPagedPool, sizeof(ROS_PRIVATE_CACHE_MAP), TAG_PRIVATE_CACHE_MAP);
         }
         else
         {
-            PrivateMap = &SharedCacheMap->PrivateCacheMap;
+            PrivateMap = &SharedCacheMap->PrivateCacheMap.PrivateCacheMap;
         }
 
         if (PrivateMap == NULL)
@@ -1340,6 +1490,7 @@ CcRosInitializeFileCache (
 
                 FileObject->SectionObjectPointer->SharedCacheMap = NULL;
                 ObDereferenceObject(FileObject);
+                CcRosFreeVacbIndex(SharedCacheMap);
                 ExFreeToNPagedLookasideList(&SharedCacheMapLookasideList, SharedCacheMap);
             }
 
@@ -1348,7 +1499,7 @@ CcRosInitializeFileCache (
         }
 
         /* Initialize it */
-        RtlZeroMemory(PrivateMap, sizeof(PRIVATE_CACHE_MAP));
+        RtlZeroMemory(PrivateMap, sizeof(ROS_PRIVATE_CACHE_MAP));
         PrivateMap->NodeTypeCode = NODE_TYPE_PRIVATE_MAP;
         PrivateMap->ReadAheadMask = PAGE_SIZE - 1;
         PrivateMap->FileObject = FileObject;
@@ -252,6 +252,103 @@ ExpFreeHandleTable(IN PHANDLE_TABLE HandleTable)
     }
 }
 
+FORCEINLINE
+PEXP_HANDLE_CACHE
+ExpGetHandleCache(IN PHANDLE_TABLE HandleTable)
+{
+    PEXP_HANDLE_TABLE ExHandleTable;
+
+    /* We can be rescheduled at any time, so the processor is only a hint */
+    ExHandleTable = CONTAINING_RECORD(HandleTable, EXP_HANDLE_TABLE, Table);
+    return &ExHandleTable->Caches[KeGetCurrentProcessorNumber() %
+                                  ExHandleTable->CacheCount];
+}
+
+BOOLEAN
+NTAPI
+ExpCacheFreeHandle(IN PEXP_HANDLE_CACHE Cache,
+                   IN ULONG Handle)
+{
+    ULONG i;
+
+    /* Fill the cache from the bottom, allocations take from the top */
+    for (i = 0; i < EXP_HANDLE_CACHE_ENTRIES; i++)
+    {
+        /* Claim the slot if it's still empty */
+        if (!(Cache->Handles[i]) &&
+            !(InterlockedCompareExchange((PLONG)&Cache->Handles[i], Handle, 0)))
+        {
+            return TRUE;
+        }
+    }
+
+    /* The cache is full */
+    return FALSE;
+}
+
+ULONG
+NTAPI
+ExpRefillHandleCache(IN PHANDLE_TABLE HandleTable,
+                     IN PEXP_HANDLE_CACHE Cache)
+{
+    EXHANDLE Handle;
+    PHANDLE_TABLE_ENTRY Entry;
+    ULONG First, Next, OldValue, i;
+
+    /*
+     * Take everything that was freed to the last free list at once. Nobody
+     * pops single entries off that list, it only gets pushed to and emptied,
+     * so we own the whole chain now and it can't change under us.
+     */
+    First = InterlockedExchange((PLONG)&HandleTable->LastFree, 0);
+    if (!First) return 0;
+
+    /* The first handle is for our caller */
+    Handle.Value = First;
+    Entry = ExpLookupHandleTableEntry(HandleTable, Handle);
+    Next = Entry->NextFreeTableEntry;
+
+    /* Move a cache full of the others to the cache */
+    for (i = 0; (Next) && (i < EXP_HANDLE_CACHE_ENTRIES); i++)
+    {
+        /* Get the link before the handle can be allocated from the cache */
+        Handle.Value = Next;
+        Entry = ExpLookupHandleTableEntry(HandleTable, Handle);
+        OldValue = Entry->NextFreeTableEntry;
+        if (!ExpCacheFreeHandle(Cache, Next)) break;
+        Next = OldValue;
+    }
+
+    /* Put back the rest of the chain */
+    if ((Next) &&
+        (InterlockedCompareExchange((PLONG)&HandleTable->LastFree, Next, 0)))
+    {
+        /* Somebody freed handles meanwhile, find the end of our chain */
+        Handle.Value = Next;
+        Entry = ExpLookupHandleTableEntry(HandleTable, Handle);
+        while (Entry->NextFreeTableEntry)
+        {
+            Handle.Value = Entry->NextFreeTableEntry;
+            Entry = ExpLookupHandleTableEntry(HandleTable, Handle);
+        }
+
+        /* And link theirs to it */
+        for (;;)
+        {
+            OldValue = HandleTable->LastFree;
+            Entry->NextFreeTableEntry = OldValue;
+            if (InterlockedCompareExchange((PLONG)&HandleTable->LastFree,
+                                           Next,
+                                           OldValue) == OldValue)
+            {
+                break;
+            }
+        }
+    }
+
+    return First;
+}
+
 VOID
 NTAPI
 ExpFreeHandleTableEntry(IN PHANDLE_TABLE HandleTable,
@@ -272,6 +369,13 @@ ExpFreeHandleTableEntry(IN PHANDLE_TABLE HandleTable,
     /* Mark the handle as free */
     Handle.TagBits = 0;
 
+    /* Keep it for the next allocation on this processor if there's room */
+    if (!HandleTable->StrictFIFO)
+    {
+        HandleTableEntry->NextFreeTableEntry = 0;
+        if (ExpCacheFreeHandle(ExpGetHandleCache(HandleTable), Handle.AsULONG)) return;
+    }
+
     /* Check if we're FIFO */
     if (!HandleTable->StrictFIFO)
     {
@@ -309,16 +413,27 @@ NTAPI
 ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
                        IN BOOLEAN NewTable)
 {
+    PEXP_HANDLE_TABLE ExHandleTable;
     PHANDLE_TABLE HandleTable;
     PHANDLE_TABLE_ENTRY HandleTableTable, HandleEntry;
-    ULONG i;
+    ULONG i, CacheCount;
+    SIZE_T Size;
     PAGED_CODE();
 
+    /*
+     * One free handle cache per processor, plus room to align them. The kernel
+     * and CID tables get created before the other processors are started, so
+     * tables without a process get a cache for every processor there can be.
+     */
+    CacheCount = Process ? KeNumberProcessors : MAXIMUM_PROCESSORS;
+    Size = sizeof(EXP_HANDLE_TABLE) + (CacheCount + 1) * sizeof(EXP_HANDLE_CACHE);
+
     /* Allocate the table */
-    HandleTable = ExAllocatePoolWithTag(PagedPool,
-                                        sizeof(HANDLE_TABLE),
-                                        TAG_OBJECT_TABLE);
-    if (!HandleTable) return NULL;
+    ExHandleTable = ExAllocatePoolWithTag(PagedPool,
+                                          Size,
+                                          TAG_OBJECT_TABLE);
+    if (!ExHandleTable) return NULL;
+    HandleTable = &ExHandleTable->Table;
 
     /* Check if we have a process */
     if (Process)
@@ -326,8 +441,13 @@ ExpAllocateHandleTable(IN PEPROCESS Process OPTIONAL,
         /* FIXME: Charge quota */
     }
 
-    /* Clear the table */
-    RtlZeroMemory(HandleTable, sizeof(HANDLE_TABLE));
+    /* Clear the table and the caches */
+    RtlZeroMemory(ExHandleTable, Size);
+
+    /* Give every cache a cache line of its own */
+    ExHandleTable->CacheCount = CacheCount;
+    ExHandleTable->Caches = ALIGN_UP_POINTER_BY(ExHandleTable + 1,
+                                                sizeof(EXP_HANDLE_CACHE));
 
     /* Now allocate the first level structures */
     HandleTableTable = ExpAllocateTablePagedPoolNoZero(Process, PAGE_SIZE);
@@ -642,6 +762,29 @@ ExpMoveFreeHandles(IN PHANDLE_TABLE HandleTable)
     return LastFree;
 }
 
+ULONG
+NTAPI
+ExpAllocateCachedHandle(IN PHANDLE_TABLE HandleTable)
+{
+    PEXP_HANDLE_CACHE Cache;
+    ULONG Handle, i;
+
+    /* Take the most recently cached handle */
+    Cache = ExpGetHandleCache(HandleTable);
+    for (i = EXP_HANDLE_CACHE_ENTRIES; i > 0; i--)
+    {
+        /* Somebody else might grab it first */
+        if (Cache->Handles[i - 1])
+        {
+            Handle = InterlockedExchange((PLONG)&Cache->Handles[i - 1], 0);
+            if (Handle) return Handle;
+        }
+    }
+
+    /* The cache is empty, refill it */
+    return ExpRefillHandleCache(HandleTable, Cache);
+}
+
 PHANDLE_TABLE_ENTRY
 NTAPI
 ExpAllocateHandleTableEntry(IN PHANDLE_TABLE HandleTable,
@@ -653,6 +796,21 @@ ExpAllocateHandleTableEntry(IN PHANDLE_TABLE HandleTable,
     BOOLEAN Result;
     ULONG i;
 
+    /* Check if we're FIFO */
+    if (!HandleTable->StrictFIFO)
+    {
+        /* We're not, so try the cache of this processor first */
+        Handle.Value = ExpAllocateCachedHandle(HandleTable);
+        if (Handle.Value)
+        {
+            /* Got one without touching the free lists */
+            Entry = ExpLookupHandleTableEntry(HandleTable, Handle);
+            InterlockedIncrement(&HandleTable->HandleCount);
+            *NewHandle = Handle;
+            return Entry;
+        }
+    }
+
     /* Start allocation loop */
     for (;;)
     {
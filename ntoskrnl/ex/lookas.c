@@ -24,14 +24,22 @@ LIST_ENTRY ExpPagedLookasideListHead;
 KSPIN_LOCK ExpPagedLookasideListLock;
 LIST_ENTRY ExSystemLookasideListHead;
 LIST_ENTRY ExPoolLookasideListHead;
-GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[MAXIMUM_PROCESSORS];
-GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[MAXIMUM_PROCESSORS];
+KSPIN_LOCK ExpPoolLookasideListLock;
+GENERAL_LOOKASIDE ExpSmallNPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+GENERAL_LOOKASIDE ExpSmallPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+
+/* Per-processor lists of the boot processor, which comes up before pool */
+GENERAL_LOOKASIDE ExpBootSmallNPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+GENERAL_LOOKASIDE ExpBootSmallPagedPoolLookasideLists[NUMBER_POOL_LOOKASIDE_LISTS];
+
+/* Lookaside depth tuning, see ExAdjustLookasideDepth */
+#define MINIMUM_LOOKASIDE_DEPTH 4
+#define MINIMUM_ALLOCATION_THRESHOLD 25
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
 VOID
 NTAPI
-INIT_FUNCTION
 ExInitializeSystemLookasideList(IN PGENERAL_LOOKASIDE List,
                                 IN POOL_TYPE Type,
                                 IN ULONG Size,
@@ -45,7 +53,7 @@ ExInitializeSystemLookasideList(IN PGENERAL_LOOKASIDE List,
     List->Size = Size;
     InsertHeadList(ListHead, &List->ListEntry);
     List->MaximumDepth = MaximumDepth;
-    List->Depth = 2;
+    List->Depth = MINIMUM_LOOKASIDE_DEPTH;
     List->Allocate = ExAllocatePoolWithTag;
     List->Free = ExFreePool;
     InitializeSListHead(&List->ListHead);
@@ -64,26 +72,92 @@ ExInitPoolLookasidePointers(VOID)
 {
     ULONG i;
     PKPRCB Prcb = KeGetCurrentPrcb();
-    PGENERAL_LOOKASIDE Entry;
 
-    /* Loop for all pool lists */
-    for (i = 0; i < MAXIMUM_PROCESSORS; i++)
+    /* Bind both levels to the system-wide lists first. Application processors
+     * run this at HIGH_LEVEL, so they can't allocate their own lists, and keep
+     * sharing these until ExpAllocateProcessorLookasideLists gives them theirs */
+    for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
     {
-        /* Initialize the non-paged list */
-        Entry = &ExpSmallNPagedPoolLookasideLists[i];
-        InitializeSListHead(&Entry->ListHead);
+        Prcb->PPNPagedLookasideList[i].P = &ExpSmallNPagedPoolLookasideLists[i];
+        Prcb->PPNPagedLookasideList[i].L = &ExpSmallNPagedPoolLookasideLists[i];
+        Prcb->PPPagedLookasideList[i].P = &ExpSmallPagedPoolLookasideLists[i];
+        Prcb->PPPagedLookasideList[i].L = &ExpSmallPagedPoolLookasideLists[i];
+    }
 
-        /* Bind to PRCB */
-        Prcb->PPNPagedLookasideList[i].P = Entry;
-        Prcb->PPNPagedLookasideList[i].L = Entry;
+    if (Prcb->Number == 0)
+    {
+        /* The boot processor runs before pool is up, and even before the
+         * system-wide lists are initialized, see ExpInitLookasideLists.
+         * Make them all empty with no depth, so that they're never used
+         * until then */
+        for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+        {
+            InitializeSListHead(&ExpSmallNPagedPoolLookasideLists[i].ListHead);
+            InitializeSListHead(&ExpSmallPagedPoolLookasideLists[i].ListHead);
+            InitializeSListHead(&ExpBootSmallNPagedPoolLookasideLists[i].ListHead);
+            InitializeSListHead(&ExpBootSmallPagedPoolLookasideLists[i].ListHead);
+
+            Prcb->PPNPagedLookasideList[i].P = &ExpBootSmallNPagedPoolLookasideLists[i];
+            Prcb->PPPagedLookasideList[i].P = &ExpBootSmallPagedPoolLookasideLists[i];
+        }
+    }
+}
 
-        /* Initialize the paged list */
-        Entry = &ExpSmallPagedPoolLookasideLists[i];
-        InitializeSListHead(&Entry->ListHead);
+/* Called at PASSIVE_LEVEL, gives its own lists to every processor lacking them */
+static
+VOID
+ExpAllocateProcessorLookasideLists(VOID)
+{
+    ULONG i, Number;
+    KIRQL OldIrql;
+    PKPRCB Prcb;
+    PGENERAL_LOOKASIDE Entry, NPagedLists, PagedLists;
 
-        /* Bind to PRCB */
-        Prcb->PPPagedLookasideList[i].P = Entry;
-        Prcb->PPPagedLookasideList[i].L = Entry;
+    for (Number = 1; Number < (ULONG)KeNumberProcessors; Number++)
+    {
+        /* Skip processors that already have their lists */
+        Prcb = KiProcessorBlock[Number];
+        if (!Prcb || (Prcb->PPNPagedLookasideList[0].P != Prcb->PPNPagedLookasideList[0].L))
+            continue;
+
+        NPagedLists = ExAllocatePoolWithTag(NonPagedPool,
+                                            2 * NUMBER_POOL_LOOKASIDE_LISTS * sizeof(GENERAL_LOOKASIDE),
+                                            'looP');
+        if (!NPagedLists)
+        {
+            /* Keep sharing the system-wide lists, and try again next time */
+            DPRINT("Failed to allocate pool lookaside lists for CPU %lu\n", Number);
+            continue;
+        }
+        PagedLists = NPagedLists + NUMBER_POOL_LOOKASIDE_LISTS;
+
+        /* The lists must be fully set up before the processor can see them */
+        KeAcquireSpinLock(&ExpPoolLookasideListLock, &OldIrql);
+        for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+        {
+            ExInitializeSystemLookasideList(&NPagedLists[i],
+                                            NonPagedPool,
+                                            (i + 1) * 8,
+                                            'looP',
+                                            256,
+                                            &ExPoolLookasideListHead);
+            ExInitializeSystemLookasideList(&PagedLists[i],
+                                            PagedPool,
+                                            (i + 1) * 8,
+                                            'looP',
+                                            256,
+                                            &ExPoolLookasideListHead);
+        }
+        KeReleaseSpinLock(&ExpPoolLookasideListLock, OldIrql);
+
+        /* Now bind them to the PRCB */
+        for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
+        {
+            Entry = &NPagedLists[i];
+            InterlockedExchangePointer((PVOID*)&Prcb->PPNPagedLookasideList[i].P, Entry);
+            Entry = &PagedLists[i];
+            InterlockedExchangePointer((PVOID*)&Prcb->PPPagedLookasideList[i].P, Entry);
+        }
     }
 }
 
@@ -101,9 +175,10 @@ ExpInitLookasideLists(VOID)
     InitializeListHead(&ExPoolLookasideListHead);
     KeInitializeSpinLock(&ExpNonPagedLookasideListLock);
     KeInitializeSpinLock(&ExpPagedLookasideListLock);
+    KeInitializeSpinLock(&ExpPoolLookasideListLock);
 
     /* Initialize the system lookaside lists */
-    for (i = 0; i < MAXIMUM_PROCESSORS; i++)
+    for (i = 0; i < NUMBER_POOL_LOOKASIDE_LISTS; i++)
     {
         /* Initialize the non-paged list */
         ExInitializeSystemLookasideList(&ExpSmallNPagedPoolLookasideLists[i],
@@ -120,9 +195,121 @@ ExpInitLookasideLists(VOID)
                                         'looP',
                                         256,
                                         &ExPoolLookasideListHead);
+
+        /* And the boot processor ones */
+        ExInitializeSystemLookasideList(&ExpBootSmallNPagedPoolLookasideLists[i],
+                                        NonPagedPool,
+                                        (i + 1) * 8,
+                                        'looP',
+                                        256,
+                                        &ExPoolLookasideListHead);
+        ExInitializeSystemLookasideList(&ExpBootSmallPagedPoolLookasideLists[i],
+                                        PagedPool,
+                                        (i + 1) * 8,
+                                        'looP',
+                                        256,
+                                        &ExPoolLookasideListHead);
     }
 }
 
+static
+VOID
+ExpComputeLookasideDepth(IN PGENERAL_LOOKASIDE Lookaside,
+                         IN ULONG Misses)
+{
+    ULONG Allocates, MissRatio, Depth;
+
+    /* Compute what happened since last scan */
+    Allocates = Lookaside->TotalAllocates - Lookaside->LastTotalAllocates;
+    Lookaside->LastTotalAllocates = Lookaside->TotalAllocates;
+    Depth = Lookaside->Depth;
+
+    if (Allocates < MINIMUM_ALLOCATION_THRESHOLD)
+    {
+        /* Barely used, give memory back quickly */
+        Depth = (Depth > MINIMUM_LOOKASIDE_DEPTH + 10) ? Depth - 10 : MINIMUM_LOOKASIDE_DEPTH;
+    }
+    else
+    {
+        /* Misses per thousand allocations */
+        MissRatio = (ULONG)(((ULONGLONG)Misses * 1000) / Allocates);
+        if (MissRatio < 5)
+        {
+            /* Almost always hit, slowly shrink to find the sweet spot */
+            if (Depth > MINIMUM_LOOKASIDE_DEPTH) Depth--;
+        }
+        else
+        {
+            /* Grow proportionally to the miss ratio */
+            Depth += ((Lookaside->MaximumDepth - Depth) * MissRatio) / 2000 + 5;
+            if (Depth > Lookaside->MaximumDepth) Depth = Lookaside->MaximumDepth;
+        }
+    }
+
+    Lookaside->Depth = (USHORT)Depth;
+}
+
+static
+VOID
+ExpScanGeneralLookasideList(IN PLIST_ENTRY ListHead,
+                            IN BOOLEAN ListUsesMisses)
+{
+    PLIST_ENTRY ListEntry;
+    PGENERAL_LOOKASIDE Lookaside;
+    ULONG Misses;
+
+    for (ListEntry = ListHead->Flink;
+         ListEntry != ListHead;
+         ListEntry = ListEntry->Flink)
+    {
+        Lookaside = CONTAINING_RECORD(ListEntry, GENERAL_LOOKASIDE, ListEntry);
+
+        /* Pool lists count hits, the other ones count misses */
+        if (ListUsesMisses)
+        {
+            Misses = Lookaside->AllocateMisses - Lookaside->LastAllocateMisses;
+            Lookaside->LastAllocateMisses = Lookaside->AllocateMisses;
+        }
+        else
+        {
+            Misses = (Lookaside->TotalAllocates - Lookaside->LastTotalAllocates) -
+                     (Lookaside->AllocateHits - Lookaside->LastAllocateHits);
+            Lookaside->LastAllocateHits = Lookaside->AllocateHits;
+        }
+
+        ExpComputeLookasideDepth(Lookaside, Misses);
+    }
+}
+
+/*
+ * Called once per second by the balance set manager
+ */
+VOID
+ExAdjustLookasideDepth(VOID)
+{
+    KIRQL OldIrql;
+
+    /* Give the processors that came up meanwhile their own pool lists */
+    ExpAllocateProcessorLookasideLists();
+
+    /* Pool lists never go away, but can still be added */
+    KeAcquireSpinLock(&ExpPoolLookasideListLock, &OldIrql);
+    ExpScanGeneralLookasideList(&ExPoolLookasideListHead, FALSE);
+    KeReleaseSpinLock(&ExpPoolLookasideListLock, OldIrql);
+
+    /* System lists never go away */
+    ExpScanGeneralLookasideList(&ExSystemLookasideListHead, TRUE);
+
+    /* Driver lists can, so hold their lock */
+    KeAcquireSpinLock(&ExpNonPagedLookasideListLock, &OldIrql);
+    ExpScanGeneralLookasideList(&ExpNonPagedLookasideListHead, TRUE);
+    KeReleaseSpinLock(&ExpNonPagedLookasideListLock, OldIrql);
+
+    KeAcquireSpinLock(&ExpPagedLookasideListLock, &OldIrql);
+    ExpScanGeneralLookasideList(&ExpPagedLookasideListHead, TRUE);
+    KeReleaseSpinLock(&ExpPagedLookasideListLock, OldIrql);
+}
+
 /* PUBLIC FUNCTIONS **********************************************************/
 
 /*
@@ -166,6 +166,26 @@ typedef struct _PFSN_PREFETCHER_GLOBALS
     LONG ActivePrefetches;
 } PFSN_PREFETCHER_GLOBALS, *PPFSN_PREFETCHER_GLOBALS;
 
+/* Read ahead windows grow from the request size up to that */
+#define CC_READ_AHEAD_MAX_WINDOW  (4 * VACB_MAPPING_GRANULARITY)
+/* Maximum amount of strided reads prefetched at once */
+#define CC_READ_AHEAD_MAX_STRIDES 8
+
+typedef struct _ROS_PRIVATE_CACHE_MAP
+{
+    PRIVATE_CACHE_MAP PrivateCacheMap;
+
+    /* ROS specific. Protected by ReadAheadSpinLock */
+    /* Distance between two reads, 0 for sequential access */
+    LONGLONG ReadAheadStride;
+    /* Current size of the read ahead window, 0 when no pattern was found */
+    ULONG ReadAheadWindow;
+    /* Amount of ranges to read ahead, each one being ReadAheadStride apart */
+    ULONG ReadAheadCount;
+    /* A read ahead was requested while one was already running */
+    BOOLEAN ReadAheadPending;
+} ROS_PRIVATE_CACHE_MAP, *PROS_PRIVATE_CACHE_MAP;
+
 typedef struct _ROS_SHARED_CACHE_MAP
 {
     CSHORT NodeTypeCode;
@@ -181,10 +201,13 @@ typedef struct _ROS_SHARED_CACHE_MAP
     PVOID LazyWriteContext;
     LIST_ENTRY PrivateList;
     ULONG DirtyPageThreshold;
-    PRIVATE_CACHE_MAP PrivateCacheMap;
+    ROS_PRIVATE_CACHE_MAP PrivateCacheMap;
 
     /* ROS specific */
     LIST_ENTRY CacheMapVacbListHead;
+    /* VACBs by file offset, see CcRosVacbIndexSlot. Protected by CacheMapLock */
+    struct _ROS_VACB ***VacbIndex;
+    ULONG VacbIndexLeaves;
     ULONG TimeStamp;
     BOOLEAN PinAccess;
     KSPIN_LOCK CacheMapLock;
@@ -193,6 +216,11 @@ typedef struct _ROS_SHARED_CACHE_MAP
 #endif
 } ROS_SHARED_CACHE_MAP, *PROS_SHARED_CACHE_MAP;
 
+/* The VACB index is a two-level table: a directory of leaves, each leaf being
+ * a page of VACB pointers. Leaves are only allocated where VACBs exist */
+#define VACB_INDEX_LEAF_ENTRIES (PAGE_SIZE / sizeof(PVOID))
+#define VACB_INDEX_LEAF_SIZE    ((LONGLONG)VACB_INDEX_LEAF_ENTRIES * VACB_MAPPING_GRANULARITY)
+
 #define READAHEAD_DISABLED 0x1
 #define WRITEBEHIND_DISABLED 0x2
 
@@ -439,6 +467,19 @@ CcRosReleaseFileCache(
     PFILE_OBJECT FileObject
 );
 
+NTSTATUS
+NTAPI
+CcRosGrowVacbIndex(
+    PROS_SHARED_CACHE_MAP SharedCacheMap,
+    LONGLONG SectionSize
+);
+
+VOID
+NTAPI
+CcRosRemoveVacbFromIndex(
+    PROS_VACB Vacb
+);
+
 VOID
 NTAPI
 CcShutdownSystem(VOID);
@@ -493,6 +534,30 @@ CcRosReleaseVacbLock(
     KeReleaseMutex(&Vacb->Mutex, FALSE);
 }
 
+/* Must be called with the CacheMapLock held.
+ * Returns NULL if there's no room in the index for this offset yet */
+FORCEINLINE
+PROS_VACB *
+CcRosVacbIndexSlot(
+    _In_ PROS_SHARED_CACHE_MAP SharedCacheMap,
+    _In_ LONGLONG FileOffset)
+{
+    ULONG_PTR Leaf, Entry;
+
+    if (FileOffset < 0)
+        return NULL;
+
+    Leaf = (ULONG_PTR)(FileOffset / VACB_INDEX_LEAF_SIZE);
+    if (Leaf >= SharedCacheMap->VacbIndexLeaves ||
+        SharedCacheMap->VacbIndex[Leaf] == NULL)
+    {
+        return NULL;
+    }
+
+    Entry = (ULONG_PTR)((FileOffset % VACB_INDEX_LEAF_SIZE) / VACB_MAPPING_GRANULARITY);
+    return &SharedCacheMap->VacbIndex[Leaf][Entry];
+}
+
 FORCEINLINE
 BOOLEAN
 DoRangesIntersect(
@@ -155,6 +155,27 @@ typedef struct _HARDERROR_USER_PARAMETERS
 #define MAX_MID_INDEX       (MID_LEVEL_ENTRIES * LOW_LEVEL_ENTRIES)
 #define MAX_HIGH_INDEX      (MID_LEVEL_ENTRIES * MID_LEVEL_ENTRIES * LOW_LEVEL_ENTRIES)
 
+//
+// Free handles cached per processor in front of the free lists of a table.
+// Each cache is one cache line of handle values, 0 marks an empty slot.
+//
+#define EXP_HANDLE_CACHE_ENTRIES    (64 / sizeof(ULONG))
+
+typedef struct _EXP_HANDLE_CACHE
+{
+    ULONG Handles[EXP_HANDLE_CACHE_ENTRIES];
+} EXP_HANDLE_CACHE, *PEXP_HANDLE_CACHE;
+
+//
+// What ExpAllocateHandleTable really allocates, the caches follow it
+//
+typedef struct _EXP_HANDLE_TABLE
+{
+    HANDLE_TABLE Table;
+    ULONG CacheCount;
+    PEXP_HANDLE_CACHE Caches;
+} EXP_HANDLE_TABLE, *PEXP_HANDLE_TABLE;
+
 #define ExpChangeRundown(x, y, z) (ULONG_PTR)InterlockedCompareExchangePointer(&x->Ptr, (PVOID)y, (PVOID)z)
 #define ExpChangePushlock(x, y, z) InterlockedCompareExchangePointer((PVOID*)x, (PVOID)y, (PVOID)z)
 #define ExpSetRundown(x, y) InterlockedExchangePointer(&x->Ptr, (PVOID)y)
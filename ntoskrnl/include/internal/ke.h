@@ -63,6 +63,30 @@ typedef struct _DPC_QUEUE_ENTRY
     PVOID Context;
 } DPC_QUEUE_ENTRY, *PDPC_QUEUE_ENTRY;
 
+//
+// Timers are spread over several tables, each with its own locks, so that
+// processors setting timers don't all contend on the same ones. Hand is a
+// UCHAR, so a table has 256 entries, covering 256 clock ticks.
+//
+#define KI_TIMER_TABLE_SIZE                 256
+#ifdef CONFIG_SMP
+#define KI_TIMER_TABLES                     4
+#else
+#define KI_TIMER_TABLES                     1
+#endif
+
+typedef struct _KI_TIMER_TABLE
+{
+    KSPIN_LOCK Lock[LOCK_QUEUE_TIMER_TABLE_LOCKS];
+    KTIMER_TABLE_ENTRY Entry[KI_TIMER_TABLE_SIZE];
+} KI_TIMER_TABLE, *PKI_TIMER_TABLE;
+
+//
+// Coalescable timers keep the log2 of their due time granularity, in
+// clock ticks, in EncodedTolerableDelay
+//
+#define KI_MAXIMUM_COALESCING_SHIFT         6
+
 typedef struct _KNMI_HANDLER_CALLBACK
 {
     struct _KNMI_HANDLER_CALLBACK* Next;
@@ -116,7 +140,7 @@ extern ULONG KiServiceLimit;
 extern LIST_ENTRY KeBugcheckCallbackListHead, KeBugcheckReasonCallbackListHead;
 extern KSPIN_LOCK BugCheckCallbackLock;
 extern KDPC KiTimerExpireDpc;
-extern KTIMER_TABLE_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
+extern KI_TIMER_TABLE KiTimerTable[KI_TIMER_TABLES];
 extern FAST_MUTEX KiGenericCallDpcMutex;
 extern LIST_ENTRY KiProfileListHead, KiProfileSourceListHead;
 extern KSPIN_LOCK KiProfileLock;
@@ -290,9 +314,27 @@ VOID
 FASTCALL
 KiCompleteTimer(
     IN PKTIMER Timer,
-    IN PKSPIN_LOCK_QUEUE LockQueue
+    IN PKSPIN_LOCK TimerLock
 );
 
+VOID
+NTAPI
+KiInitializeTimerTables(
+    VOID
+);
+
+#if (NTDDI_VERSION < NTDDI_WIN7)
+BOOLEAN
+NTAPI
+KeSetCoalescableTimer(
+    IN OUT PKTIMER Timer,
+    IN LARGE_INTEGER DueTime,
+    IN ULONG Period,
+    IN ULONG TolerableDelay,
+    IN PKDPC Dpc OPTIONAL
+);
+#endif
+
 /* gmutex.c ********************************************************************/
 
 VOID
@@ -705,6 +747,19 @@ VOID
 FASTCALL
 KiActivateWaiterQueue(IN PKQUEUE Queue);
 
+#if (NTDDI_VERSION < NTDDI_VISTA)
+ULONG
+NTAPI
+KeRemoveQueueEx(
+    IN PKQUEUE Queue,
+    IN KPROCESSOR_MODE WaitMode,
+    IN BOOLEAN Alertable,
+    IN PLARGE_INTEGER Timeout OPTIONAL,
+    OUT PLIST_ENTRY *EntryArray,
+    IN ULONG Count
+);
+#endif
+
 ULONG
 NTAPI
 KeQueryRuntimeProcess(IN PKPROCESS Process,
@@ -276,24 +276,26 @@ KiRequestApcInterrupt(IN BOOLEAN NeedApc,
 }
 
 FORCEINLINE
-PKSPIN_LOCK_QUEUE
-KiAcquireTimerLock(IN ULONG Hand)
+PKSPIN_LOCK
+KiAcquireTimerLock(IN PKI_TIMER_TABLE Table,
+                   IN ULONG Hand)
 {
     ASSERT(KeGetCurrentIrql() >= DISPATCH_LEVEL);
 
     /* Nothing to do on UP */
+    UNREFERENCED_PARAMETER(Table);
     UNREFERENCED_PARAMETER(Hand);
     return NULL;
 }
 
 FORCEINLINE
 VOID
-KiReleaseTimerLock(IN PKSPIN_LOCK_QUEUE LockQueue)
+KiReleaseTimerLock(IN PKSPIN_LOCK TimerLock)
 {
     ASSERT(KeGetCurrentIrql() >= DISPATCH_LEVEL);
 
     /* Nothing to do on UP */
-    UNREFERENCED_PARAMETER(LockQueue);
+    UNREFERENCED_PARAMETER(TimerLock);
 }
 
 #else
@@ -564,10 +566,11 @@ KiRequestApcInterrupt(IN BOOLEAN NeedApc,
 }
 
 FORCEINLINE
-PKSPIN_LOCK_QUEUE
-KiAcquireTimerLock(IN ULONG Hand)
+PKSPIN_LOCK
+KiAcquireTimerLock(IN PKI_TIMER_TABLE Table,
+                   IN ULONG Hand)
 {
-    PKSPIN_LOCK_QUEUE LockQueue;
+    PKSPIN_LOCK TimerLock;
     ULONG LockIndex;
     ASSERT(KeGetCurrentIrql() >= DISPATCH_LEVEL);
 
@@ -575,22 +578,22 @@ KiAcquireTimerLock(IN ULONG Hand)
     LockIndex = Hand >> LOCK_QUEUE_TIMER_LOCK_SHIFT;
     LockIndex &= (LOCK_QUEUE_TIMER_TABLE_LOCKS - 1);
 
-    /* Now get the lock */
-    LockQueue = &KeGetCurrentPrcb()->LockQueue[LockQueueTimerTableLock + LockIndex];
+    /* Now get the lock of the table */
+    TimerLock = &Table->Lock[LockIndex];
 
     /* Acquire it and return */
-    KeAcquireQueuedSpinLockAtDpcLevel(LockQueue);
-    return LockQueue;
+    KeAcquireSpinLockAtDpcLevel(TimerLock);
+    return TimerLock;
 }
 
 FORCEINLINE
 VOID
-KiReleaseTimerLock(IN PKSPIN_LOCK_QUEUE LockQueue)
+KiReleaseTimerLock(IN PKSPIN_LOCK TimerLock)
 {
     ASSERT(KeGetCurrentIrql() >= DISPATCH_LEVEL);
 
     /* Release the lock */
-    KeReleaseQueuedSpinLockFromDpcLevel(LockQueue);
+    KeReleaseSpinLockFromDpcLevel(TimerLock);
 }
 
 #endif
@@ -872,7 +875,37 @@ FORCEINLINE
 ULONG
 KiComputeTimerTableIndex(IN ULONGLONG DueTime)
 {
-    return (DueTime / KeMaximumIncrement) & (TIMER_TABLE_SIZE - 1);
+    return (DueTime / KeMaximumIncrement) & (KI_TIMER_TABLE_SIZE - 1);
+}
+
+//
+// The header of a timer has no spare byte before Windows 7, so the table is
+// picked from the address of the timer. It never changes while it's alive.
+//
+FORCEINLINE
+PKI_TIMER_TABLE
+KiGetTimerTable(IN PKTIMER Timer)
+{
+    return &KiTimerTable[((ULONG_PTR)Timer >> 6) & (KI_TIMER_TABLES - 1)];
+}
+
+//
+// Moves the due time of a coalescable timer up to the next multiple of its
+// granularity, so that timers with a similar tolerance expire together
+//
+FORCEINLINE
+ULONGLONG
+KiCoalesceDueTime(IN PKTIMER Timer,
+                  IN ULONGLONG DueTime)
+{
+    ULONGLONG Granularity;
+
+    /* Check if the timer can be delayed at all */
+    if (!Timer->Header.Coalescable) return DueTime;
+
+    /* Round it up */
+    Granularity = (ULONGLONG)KeMaximumIncrement << Timer->Header.EncodedTolerableDelay;
+    return ((DueTime + Granularity - 1) / Granularity) * Granularity;
 }
 
 //
@@ -891,7 +924,7 @@ KiRemoveEntryTimer(IN PKTIMER Timer)
     if (RemoveEntryList(&Timer->TimerListEntry))
     {
         /* Get the respective timer table entry */
-        TableEntry = &KiTimerTableListHead[Hand];
+        TableEntry = &KiGetTimerTable(Timer)->Entry[Hand];
         if (&TableEntry->Entry == TableEntry->Entry.Flink)
         {
             /* Set the entry to an infinite absolute time */
@@ -915,22 +948,22 @@ VOID
 KxInsertTimer(IN PKTIMER Timer,
               IN ULONG Hand)
 {
-    PKSPIN_LOCK_QUEUE LockQueue;
+    PKSPIN_LOCK TimerLock;
 
     /* Acquire the lock and release the dispatcher lock */
-    LockQueue = KiAcquireTimerLock(Hand);
+    TimerLock = KiAcquireTimerLock(KiGetTimerTable(Timer), Hand);
     KiReleaseDispatcherLockFromDpcLevel();
 
     /* Try to insert the timer */
     if (KiInsertTimerTable(Timer, Hand))
     {
         /* Complete it */
-        KiCompleteTimer(Timer, LockQueue);
+        KiCompleteTimer(Timer, TimerLock);
     }
     else
     {
         /* Do nothing, just release the lock */
-        KiReleaseTimerLock(LockQueue);
+        KiReleaseTimerLock(TimerLock);
     }
 }
 
@@ -976,7 +1009,8 @@ KiComputeDueTime(IN PKTIMER Timer,
     InterruptTime.QuadPart = KeQueryInterruptTime();
 
     /* Recalculate due time */
-    Timer->DueTime.QuadPart = InterruptTime.QuadPart - DueTime.QuadPart;
+    Timer->DueTime.QuadPart = KiCoalesceDueTime(Timer,
+                                                InterruptTime.QuadPart - DueTime.QuadPart);
 
     /* Get the handle */
     *Hand = KiComputeTimerTableIndex(Timer->DueTime.QuadPart);
@@ -995,11 +1029,12 @@ VOID
 KxRemoveTreeTimer(IN PKTIMER Timer)
 {
     ULONG Hand = Timer->Header.Hand;
-    PKSPIN_LOCK_QUEUE LockQueue;
+    PKI_TIMER_TABLE Table = KiGetTimerTable(Timer);
+    PKSPIN_LOCK TimerLock;
     PKTIMER_TABLE_ENTRY TimerEntry;
 
     /* Acquire timer lock */
-    LockQueue = KiAcquireTimerLock(Hand);
+    TimerLock = KiAcquireTimerLock(Table, Hand);
 
     /* Set the timer as non-inserted */
     Timer->Header.Inserted = FALSE;
@@ -1008,7 +1043,7 @@ KxRemoveTreeTimer(IN PKTIMER Timer)
     if (RemoveEntryList(&Timer->TimerListEntry))
     {
         /* Get the entry and check if it's empty */
-        TimerEntry = &KiTimerTableListHead[Hand];
+        TimerEntry = &Table->Entry[Hand];
         if (IsListEmpty(&TimerEntry->Entry))
         {
             /* Clear the time then */
@@ -1017,7 +1052,7 @@ KxRemoveTreeTimer(IN PKTIMER Timer)
     }
 
     /* Release the timer lock */
-    KiReleaseTimerLock(LockQueue);
+    KiReleaseTimerLock(TimerLock);
 }
 
 FORCEINLINE
@@ -1029,8 +1064,9 @@ KxSetTimerForThreadWait(IN PKTIMER Timer,
     ULONGLONG DueTime;
     LARGE_INTEGER InterruptTime, SystemTime, TimeDifference;
 
-    /* Check the timer's interval to see if it's absolute */
+    /* Check the timer's interval to see if it's absolute, waits are never delayed */
     Timer->Header.Absolute = FALSE;
+    Timer->Header.Coalescable = FALSE;
     if (Interval.HighPart >= 0)
     {
         /* Get the system time and calculate the relative time */
@@ -144,6 +144,31 @@ typedef union
     ULARGE_INTEGER Alignment;
 } ALIGNEDNAME;
 
+//
+// Large directories outgrow the fixed buckets of OBJECT_DIRECTORY and move
+// their entries to a private table, which doubles in size whenever chains
+// get longer than OBP_DIRECTORY_MAX_CHAIN entries on average
+//
+#define OBP_DIRECTORY_MAX_CHAIN                         4
+#define OBP_DIRECTORY_MIN_HASH_BITS                     8
+#define OBP_DIRECTORY_MAX_HASH_BITS                     16
+
+typedef struct _OBP_DIRECTORY_HASH_TABLE
+{
+    ULONG HashBits;
+    POBJECT_DIRECTORY_ENTRY HashBuckets[ANYSIZE_ARRAY];
+} OBP_DIRECTORY_HASH_TABLE, *POBP_DIRECTORY_HASH_TABLE;
+
+//
+// Body of directory objects, the public part comes first
+//
+typedef struct _OBP_DIRECTORY
+{
+    OBJECT_DIRECTORY Directory;
+    POBP_DIRECTORY_HASH_TABLE HashTable;
+    ULONG EntryCount;
+} OBP_DIRECTORY, *POBP_DIRECTORY;
+
 //
 // Private Temporary Buffer for Lookup Routines
 //
@@ -174,6 +199,12 @@ ObShutdownSystem(
 //
 // Directory Namespace Functions
 //
+VOID
+NTAPI
+ObpDeleteDirectory(
+    IN PVOID ObjectBody
+);
+
 BOOLEAN
 NTAPI
 ObpDeleteEntryDirectory(
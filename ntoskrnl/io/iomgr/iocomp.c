@@ -31,6 +31,9 @@ static const INFORMATION_CLASS_INFO IoCompletionInfoClass[] =
     ICI_SQ_SAME(sizeof(IO_COMPLETION_BASIC_INFORMATION), sizeof(ULONG), ICIF_QUERY),
 };
 
+/* Completions removed at once, NtRemoveIoCompletionEx takes more in several rounds */
+#define IOP_MAX_STACK_COMPLETIONS 16
+
 /* PRIVATE FUNCTIONS *********************************************************/
 
 NTSTATUS
@@ -95,6 +98,48 @@ IopFreeMiniPacket(PIOP_MINI_COMPLETION_PACKET Packet)
     InterlockedPushEntrySList(&List->L.ListHead, (PSLIST_ENTRY)Packet);
 }
 
+VOID
+NTAPI
+IopRetrieveCompletionPacket(IN PLIST_ENTRY ListEntry,
+                            OUT PFILE_IO_COMPLETION_INFORMATION Information)
+{
+    PIOP_MINI_COMPLETION_PACKET Packet;
+    PIRP Irp;
+
+    /* Get the Packet Data */
+    Packet = CONTAINING_RECORD(ListEntry,
+                               IOP_MINI_COMPLETION_PACKET,
+                               ListEntry);
+
+    /* Check if this is piggybacked on an IRP */
+    if (Packet->PacketType == IopCompletionPacketIrp)
+    {
+        /* Get the IRP */
+        Irp = CONTAINING_RECORD(ListEntry,
+                                IRP,
+                                Tail.Overlay.ListEntry);
+
+        /* Save values */
+        Information->KeyContext = Irp->Tail.CompletionKey;
+        Information->ApcContext = Irp->Overlay.AsynchronousParameters.UserApcContext;
+        Information->IoStatusBlock = Irp->IoStatus;
+
+        /* Free the IRP */
+        IoFreeIrp(Irp);
+    }
+    else
+    {
+        /* Save values */
+        Information->KeyContext = Packet->KeyContext;
+        Information->ApcContext = Packet->ApcContext;
+        Information->IoStatusBlock.Status = Packet->IoStatus;
+        Information->IoStatusBlock.Information = Packet->IoStatusInformation;
+
+        /* Free the packet */
+        IopFreeMiniPacket(Packet);
+    }
+}
+
 VOID
 NTAPI
 IopDeleteIoCompletion(PVOID ObjectBody)
@@ -449,13 +494,10 @@ NtRemoveIoCompletion(IN HANDLE IoCompletionHandle,
 {
     LARGE_INTEGER SafeTimeout;
     PKQUEUE Queue;
-    PIOP_MINI_COMPLETION_PACKET Packet;
     PLIST_ENTRY ListEntry;
     KPROCESSOR_MODE PreviousMode = ExGetPreviousMode();
     NTSTATUS Status;
-    PIRP Irp;
-    PVOID Apc, Key;
-    IO_STATUS_BLOCK IoStatus;
+    FILE_IO_COMPLETION_INFORMATION Completion;
     PAGED_CODE();
 
     /* Check if the call was from user mode */
@@ -506,46 +548,161 @@ NtRemoveIoCompletion(IN HANDLE IoCompletionHandle,
         }
         else
         {
-            /* Get the Packet Data */
-            Packet = CONTAINING_RECORD(ListEntry,
-                                       IOP_MINI_COMPLETION_PACKET,
-                                       ListEntry);
+            /* Get the values and free the packet */
+            IopRetrieveCompletionPacket(ListEntry, &Completion);
 
-            /* Check if this is piggybacked on an IRP */
-            if (Packet->PacketType == IopCompletionPacketIrp)
+            /* Enter SEH to write back the values */
+            _SEH2_TRY
+            {
+                /* Write the values to caller */
+                *ApcContext = Completion.ApcContext;
+                *KeyContext = Completion.KeyContext;
+                *IoStatusBlock = Completion.IoStatusBlock;
+            }
+            _SEH2_EXCEPT(ExSystemExceptionFilter())
             {
-                /* Get the IRP */
-                Irp = CONTAINING_RECORD(ListEntry,
-                                        IRP,
-                                        Tail.Overlay.ListEntry);
+                /* Get the exception code */
+                Status = _SEH2_GetExceptionCode();
+            }
+            _SEH2_END;
+        }
 
-                /* Save values */
-                Key = Irp->Tail.CompletionKey;
-                Apc = Irp->Overlay.AsynchronousParameters.UserApcContext;
-                IoStatus = Irp->IoStatus;
+        /* Dereference the Object */
+        ObDereferenceObject(Queue);
+    }
 
-                /* Free the IRP */
-                IoFreeIrp(Irp);
-            }
-            else
+    /* Return status */
+    return Status;
+}
+
+NTSTATUS
+NTAPI
+NtRemoveIoCompletionEx(IN HANDLE IoCompletionHandle,
+                       OUT PFILE_IO_COMPLETION_INFORMATION IoCompletionInformation,
+                       IN ULONG Count,
+                       OUT PULONG NumEntriesRemoved,
+                       IN PLARGE_INTEGER Timeout OPTIONAL,
+                       IN BOOLEAN Alertable)
+{
+    LARGE_INTEGER SafeTimeout, NoWait;
+    PKQUEUE Queue;
+    PLIST_ENTRY Entries[IOP_MAX_STACK_COMPLETIONS];
+    KPROCESSOR_MODE PreviousMode = ExGetPreviousMode();
+    NTSTATUS Status;
+    FILE_IO_COMPLETION_INFORMATION Completion;
+    ULONG Removed, Total, i;
+    PAGED_CODE();
+
+    /* We need room for at least one packet, and the size must not overflow */
+    if (!Count || (Count > MAXULONG / sizeof(FILE_IO_COMPLETION_INFORMATION)))
+    {
+        return STATUS_INVALID_PARAMETER;
+    }
+
+    /* Check if the call was from user mode */
+    if (PreviousMode != KernelMode)
+    {
+        /* Protect probes in SEH */
+        _SEH2_TRY
+        {
+            /* Probe the output array and the count */
+            ProbeForWrite(IoCompletionInformation,
+                          Count * sizeof(FILE_IO_COMPLETION_INFORMATION),
+                          sizeof(PVOID));
+            ProbeForWriteUlong(NumEntriesRemoved);
+            if (Timeout)
             {
-                /* Save values */
-                Key = Packet->KeyContext;
-                Apc = Packet->ApcContext;
-                IoStatus.Status = Packet->IoStatus;
-                IoStatus.Information = Packet->IoStatusInformation;
+                /* Probe and capture the timeout */
+                SafeTimeout = ProbeForReadLargeInteger(Timeout);
+                Timeout = &SafeTimeout;
+            }
+        }
+        _SEH2_EXCEPT(EXCEPTION_EXECUTE_HANDLER)
+        {
+            /* Return the exception code */
+            _SEH2_YIELD(return _SEH2_GetExceptionCode());
+        }
+        _SEH2_END;
+    }
 
-                /* Free the packet */
-                IopFreeMiniPacket(Packet);
+    /* Open the Object */
+    Status = ObReferenceObjectByHandle(IoCompletionHandle,
+                                       IO_COMPLETION_MODIFY_STATE,
+                                       IoCompletionType,
+                                       PreviousMode,
+                                       (PVOID*)&Queue,
+                                       NULL);
+    if (NT_SUCCESS(Status))
+    {
+        /* Wait for the first packet and take the ones queued behind it */
+        Removed = KeRemoveQueueEx(Queue,
+                                  PreviousMode,
+                                  Alertable,
+                                  Timeout,
+                                  Entries,
+                                  min(Count, IOP_MAX_STACK_COMPLETIONS));
+
+        /* If we got a timeout or user_apc back, return the status */
+        if (((NTSTATUS)(ULONG_PTR)Entries[0] == STATUS_TIMEOUT) ||
+            ((NTSTATUS)(ULONG_PTR)Entries[0] == STATUS_USER_APC))
+        {
+            /* Set this as the status */
+            Status = (NTSTATUS)(ULONG_PTR)Entries[0];
+        }
+        else
+        {
+            Total = 0;
+            NoWait.QuadPart = 0;
+            for (;;)
+            {
+                /* Every packet has to be freed, even if the caller's buffer went away */
+                for (i = 0; i < Removed; i++, Total++)
+                {
+                    /* Get the values and free the packet */
+                    IopRetrieveCompletionPacket(Entries[i], &Completion);
+
+                    /* Enter SEH to write back the values */
+                    _SEH2_TRY
+                    {
+                        IoCompletionInformation[Total] = Completion;
+                    }
+                    _SEH2_EXCEPT(ExSystemExceptionFilter())
+                    {
+                        /* Get the exception code */
+                        Status = _SEH2_GetExceptionCode();
+                    }
+                    _SEH2_END;
+                }
+
+                /* Don't take packets that can't be written back anymore */
+                if (!NT_SUCCESS(Status)) break;
+
+                /* Stop once the caller has enough or the queue ran dry */
+                if ((Total == Count) ||
+                    (Removed < IOP_MAX_STACK_COMPLETIONS) ||
+                    !(KeReadStateQueue(Queue)))
+                {
+                    break;
+                }
+
+                /* Take the next batch, without waiting for it */
+                Removed = KeRemoveQueueEx(Queue,
+                                          PreviousMode,
+                                          FALSE,
+                                          &NoWait,
+                                          Entries,
+                                          min(Count - Total, IOP_MAX_STACK_COMPLETIONS));
+                if (((NTSTATUS)(ULONG_PTR)Entries[0] == STATUS_TIMEOUT) ||
+                    ((NTSTATUS)(ULONG_PTR)Entries[0] == STATUS_USER_APC))
+                {
+                    break;
+                }
             }
 
-            /* Enter SEH to write back the values */
+            /* Enter SEH to write back the count */
             _SEH2_TRY
             {
-                /* Write the values to caller */
-                *ApcContext = Apc;
-                *KeyContext = Key;
-                *IoStatusBlock = IoStatus;
+                *NumEntriesRemoved = Total;
             }
             _SEH2_EXCEPT(ExSystemExceptionFilter())
             {
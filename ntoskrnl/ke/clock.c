@@ -35,7 +35,8 @@ KeSetSystemTime(IN PLARGE_INTEGER NewTime,
     LARGE_INTEGER DeltaTime;
     PLIST_ENTRY ListHead, NextEntry;
     PKTIMER Timer;
-    PKSPIN_LOCK_QUEUE LockQueue;
+    PKI_TIMER_TABLE Table;
+    PKSPIN_LOCK TimerLock;
     LIST_ENTRY TempList, TempList2;
     ULONG Hand, i;
 
@@ -78,32 +79,36 @@ KeSetSystemTime(IN PLARGE_INTEGER NewTime,
     /* Setup a temporary list of absolute timers */
     InitializeListHead(&TempList);
 
-    /* Loop current timers */
-    for (i = 0; i < TIMER_TABLE_SIZE; i++)
+    /* Loop every timer table */
+    for (Table = KiTimerTable; Table < &KiTimerTable[KI_TIMER_TABLES]; Table++)
     {
-        /* Loop the entries in this table and lock the timers */
-        ListHead = &KiTimerTableListHead[i].Entry;
-        LockQueue = KiAcquireTimerLock(i);
-        NextEntry = ListHead->Flink;
-        while (NextEntry != ListHead)
+        /* Loop current timers */
+        for (i = 0; i < KI_TIMER_TABLE_SIZE; i++)
         {
-            /* Get the timer */
-            Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
-            NextEntry = NextEntry->Flink;
-
-            /* Is it absolute? */
-            if (Timer->Header.Absolute)
+            /* Loop the entries in this table and lock the timers */
+            ListHead = &Table->Entry[i].Entry;
+            TimerLock = KiAcquireTimerLock(Table, i);
+            NextEntry = ListHead->Flink;
+            while (NextEntry != ListHead)
             {
-                /* Remove it from the timer list */
-                KiRemoveEntryTimer(Timer);
-
-                /* Insert it into our temporary list */
-                InsertTailList(&TempList, &Timer->TimerListEntry);
+                /* Get the timer */
+                Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
+                NextEntry = NextEntry->Flink;
+
+                /* Is it absolute? */
+                if (Timer->Header.Absolute)
+                {
+                    /* Remove it from the timer list */
+                    KiRemoveEntryTimer(Timer);
+
+                    /* Insert it into our temporary list */
+                    InsertTailList(&TempList, &Timer->TimerListEntry);
+                }
             }
-        }
 
-        /* Release the lock */
-        KiReleaseTimerLock(LockQueue);
+            /* Release the lock */
+            KiReleaseTimerLock(TimerLock);
+        }
     }
 
     /* Setup a temporary list of expired timers */
@@ -122,7 +127,7 @@ KeSetSystemTime(IN PLARGE_INTEGER NewTime,
         Timer->Header.Hand = (UCHAR)Hand;
 
         /* Lock the timer and re-insert it */
-        LockQueue = KiAcquireTimerLock(Hand);
+        TimerLock = KiAcquireTimerLock(KiGetTimerTable(Timer), Hand);
         if (KiInsertTimerTable(Timer, Hand))
         {
             /* Remove it from the timer list */
@@ -133,7 +138,7 @@ KeSetSystemTime(IN PLARGE_INTEGER NewTime,
         }
 
         /* Release the lock */
-        KiReleaseTimerLock(LockQueue);
+        KiReleaseTimerLock(TimerLock);
     }
 
     /* Process expired timers. This releases the dispatcher lock. */
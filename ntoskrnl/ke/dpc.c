@@ -35,15 +35,17 @@ KiCheckTimerTable(IN ULARGE_INTEGER CurrentTime)
 #if DBG
     ULONG i = 0;
     PLIST_ENTRY ListHead, NextEntry;
+    PKI_TIMER_TABLE Table;
     KIRQL OldIrql;
     PKTIMER Timer;
 
-    /* Raise IRQL to high and loop timers */
+    /* Raise IRQL to high and loop the timers of every table */
     KeRaiseIrql(HIGH_LEVEL, &OldIrql);
+    Table = KiTimerTable;
     do
     {
         /* Loop the current list */
-        ListHead = &KiTimerTableListHead[i].Entry;
+        ListHead = &Table->Entry[i].Entry;
         NextEntry = ListHead->Flink;
         while (NextEntry != ListHead)
         {
@@ -65,9 +67,14 @@ KiCheckTimerTable(IN ULARGE_INTEGER CurrentTime)
             }
         }
 
-        /* Move to the next timer */
+        /* Move to the next timer, and to the next table once done */
         i++;
-    } while(i < TIMER_TABLE_SIZE);
+        if (i == KI_TIMER_TABLE_SIZE)
+        {
+            i = 0;
+            Table++;
+        }
+    } while(Table < &KiTimerTable[KI_TIMER_TABLES]);
 
     /* Lower IRQL and return */
     KeLowerIrql(OldIrql);
@@ -83,7 +90,7 @@ KiTimerExpiration(IN PKDPC Dpc,
 {
     ULARGE_INTEGER SystemTime, InterruptTime;
     LARGE_INTEGER Interval;
-    LONG Limit, Index, i;
+    LONG Limit, Index, StartIndex, i;
     ULONG Timers, ActiveTimers, DpcCalls;
     PLIST_ENTRY ListHead, NextEntry;
     KIRQL OldIrql;
@@ -91,8 +98,9 @@ KiTimerExpiration(IN PKDPC Dpc,
     PKDPC TimerDpc;
     ULONG Period;
     DPC_QUEUE_ENTRY DpcEntry[MAX_TIMER_DPCS];
-    PKSPIN_LOCK_QUEUE LockQueue;
+    PKSPIN_LOCK TimerLock;
     PKPRCB Prcb = KeGetCurrentPrcb();
+    PKI_TIMER_TABLE Table;
 
     /* Disable interrupts */
     _disable();
@@ -107,15 +115,15 @@ KiTimerExpiration(IN PKDPC Dpc,
 
     /* Get the index of the timer and normalize it */
     Index = PtrToLong(SystemArgument1);
-    if ((Limit - Index) >= TIMER_TABLE_SIZE)
+    if ((Limit - Index) >= KI_TIMER_TABLE_SIZE)
     {
         /* Normalize it */
-        Limit = Index + TIMER_TABLE_SIZE - 1;
+        Limit = Index + KI_TIMER_TABLE_SIZE - 1;
     }
 
     /* Setup index and actual limit */
-    Index--;
-    Limit &= (TIMER_TABLE_SIZE - 1);
+    StartIndex = Index - 1;
+    Limit &= (KI_TIMER_TABLE_SIZE - 1);
 
     /* Setup accounting data */
     DpcCalls = 0;
@@ -125,179 +133,183 @@ KiTimerExpiration(IN PKDPC Dpc,
     /* Lock the Database and Raise IRQL */
     OldIrql = KiAcquireDispatcherLock();
 
-    /* Start expiration loop */
-    do
+    /* Expiration loop, over the same entries of every table */
+    for (Table = KiTimerTable; Table < &KiTimerTable[KI_TIMER_TABLES]; Table++)
     {
-        /* Get the current index */
-        Index = (Index + 1) & (TIMER_TABLE_SIZE - 1);
-
-        /* Get list pointers and loop the list */
-        ListHead = &KiTimerTableListHead[Index].Entry;
-        while (ListHead != ListHead->Flink)
+        Index = StartIndex;
+        do
         {
-            /* Lock the timer and go to the next entry */
-            LockQueue = KiAcquireTimerLock(Index);
-            NextEntry = ListHead->Flink;
+            /* Get the current index */
+            Index = (Index + 1) & (KI_TIMER_TABLE_SIZE - 1);
 
-            /* Get the current timer and check its due time */
-            Timers--;
-            Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
-            if ((NextEntry != ListHead) &&
-                (Timer->DueTime.QuadPart <= InterruptTime.QuadPart))
+            /* Get list pointers and loop the list */
+            ListHead = &Table->Entry[Index].Entry;
+            while (ListHead != ListHead->Flink)
             {
-                /* It's expired, remove it */
-                ActiveTimers--;
-                KiRemoveEntryTimer(Timer);
+                /* Lock the timer and go to the next entry */
+                TimerLock = KiAcquireTimerLock(Table, Index);
+                NextEntry = ListHead->Flink;
+
+                /* Get the current timer and check its due time */
+                Timers--;
+                Timer = CONTAINING_RECORD(NextEntry, KTIMER, TimerListEntry);
+                if ((NextEntry != ListHead) &&
+                    (Timer->DueTime.QuadPart <= InterruptTime.QuadPart))
+                {
+                    /* It's expired, remove it */
+                    ActiveTimers--;
+                    KiRemoveEntryTimer(Timer);
 
-                /* Make it non-inserted, unlock it, and signal it */
-                Timer->Header.Inserted = FALSE;
-                KiReleaseTimerLock(LockQueue);
-                Timer->Header.SignalState = 1;
+                    /* Make it non-inserted, unlock it, and signal it */
+                    Timer->Header.Inserted = FALSE;
+                    KiReleaseTimerLock(TimerLock);
+                    Timer->Header.SignalState = 1;
 
-                /* Get the DPC and period */
-                TimerDpc = Timer->Dpc;
-                Period = Timer->Period;
+                    /* Get the DPC and period */
+                    TimerDpc = Timer->Dpc;
+                    Period = Timer->Period;
 
-                /* Check if there's any waiters */
-                if (!IsListEmpty(&Timer->Header.WaitListHead))
-                {
-                    /* Check the type of event */
-                    if (Timer->Header.Type == TimerNotificationObject)
+                    /* Check if there's any waiters */
+                    if (!IsListEmpty(&Timer->Header.WaitListHead))
                     {
-                        /* Unwait the thread */
-                        KxUnwaitThread(&Timer->Header, IO_NO_INCREMENT);
+                        /* Check the type of event */
+                        if (Timer->Header.Type == TimerNotificationObject)
+                        {
+                            /* Unwait the thread */
+                            KxUnwaitThread(&Timer->Header, IO_NO_INCREMENT);
+                        }
+                        else
+                        {
+                            /* Otherwise unwait the thread and signal the timer */
+                            KxUnwaitThreadForEvent((PKEVENT)Timer, IO_NO_INCREMENT);
+                        }
                     }
-                    else
+
+                    /* Check if we have a period */
+                    if (Period)
                     {
-                        /* Otherwise unwait the thread and signal the timer */
-                        KxUnwaitThreadForEvent((PKEVENT)Timer, IO_NO_INCREMENT);
+                        /* Calculate the interval and insert the timer */
+                        Interval.QuadPart = Int32x32To64(Period, -10000);
+                        while (!KiInsertTreeTimer(Timer, Interval));
                     }
-                }
 
-                /* Check if we have a period */
-                if (Period)
-                {
-                    /* Calculate the interval and insert the timer */
-                    Interval.QuadPart = Int32x32To64(Period, -10000);
-                    while (!KiInsertTreeTimer(Timer, Interval));
-                }
-
-                /* Check if we have a DPC */
-                if (TimerDpc)
-                {
-#ifdef CONFIG_SMP
-                    /* 
-                     * If the DPC is targeted to another processor,
-                     * then insert it into that processor's DPC queue
-                     * instead of delivering it now.
-                     * If the DPC is a threaded DPC, and the current CPU
-                     * has threaded DPCs enabled (KiExecuteDpc is actively parsing DPCs),
-                     * then also insert it into the DPC queue for threaded delivery,
-                     * instead of doing it here.
-                     */
-                    if (((TimerDpc->Number >= MAXIMUM_PROCESSORS) &&
-                        ((TimerDpc->Number - MAXIMUM_PROCESSORS) != Prcb->Number)) ||
-                        ((TimerDpc->Type == ThreadedDpcObject) && (Prcb->ThreadDpcEnable)))
+                    /* Check if we have a DPC */
+                    if (TimerDpc)
                     {
-                        /* Queue it */
-                        KeInsertQueueDpc(TimerDpc,
-                                         UlongToPtr(SystemTime.LowPart),
-                                         UlongToPtr(SystemTime.HighPart));
-                    }
-                    else
+#ifdef CONFIG_SMP
+                        /* 
+                         * If the DPC is targeted to another processor,
+                         * then insert it into that processor's DPC queue
+                         * instead of delivering it now.
+                         * If the DPC is a threaded DPC, and the current CPU
+                         * has threaded DPCs enabled (KiExecuteDpc is actively parsing DPCs),
+                         * then also insert it into the DPC queue for threaded delivery,
+                         * instead of doing it here.
+                         */
+                        if (((TimerDpc->Number >= MAXIMUM_PROCESSORS) &&
+                            ((TimerDpc->Number - MAXIMUM_PROCESSORS) != Prcb->Number)) ||
+                            ((TimerDpc->Type == ThreadedDpcObject) && (Prcb->ThreadDpcEnable)))
+                        {
+                            /* Queue it */
+                            KeInsertQueueDpc(TimerDpc,
+                                             UlongToPtr(SystemTime.LowPart),
+                                             UlongToPtr(SystemTime.HighPart));
+                        }
+                        else
 #endif
-                    {
-                        /* Setup the DPC Entry */
-                        DpcEntry[DpcCalls].Dpc = TimerDpc;
-                        DpcEntry[DpcCalls].Routine = TimerDpc->DeferredRoutine;
-                        DpcEntry[DpcCalls].Context = TimerDpc->DeferredContext;
-                        DpcCalls++;
-                        ASSERT(DpcCalls < MAX_TIMER_DPCS);
+                        {
+                            /* Setup the DPC Entry */
+                            DpcEntry[DpcCalls].Dpc = TimerDpc;
+                            DpcEntry[DpcCalls].Routine = TimerDpc->DeferredRoutine;
+                            DpcEntry[DpcCalls].Context = TimerDpc->DeferredContext;
+                            DpcCalls++;
+                            ASSERT(DpcCalls < MAX_TIMER_DPCS);
+                        }
                     }
-                }
-
-                /* Check if we're done processing */
-                if (!(ActiveTimers) || !(Timers))
-                {
-                    /* Release the dispatcher while doing DPCs */
-                    KiReleaseDispatcherLock(DISPATCH_LEVEL);
 
-                    /* Start looping all DPC Entries */
-                    for (i = 0; DpcCalls; DpcCalls--, i++)
+                    /* Check if we're done processing */
+                    if (!(ActiveTimers) || !(Timers))
                     {
+                        /* Release the dispatcher while doing DPCs */
+                        KiReleaseDispatcherLock(DISPATCH_LEVEL);
+
+                        /* Start looping all DPC Entries */
+                        for (i = 0; DpcCalls; DpcCalls--, i++)
+                        {
 #if DBG
-                        /* Clear DPC Time */
-                        Prcb->DebugDpcTime = 0;
+                            /* Clear DPC Time */
+                            Prcb->DebugDpcTime = 0;
 #endif
 
-                        /* Call the DPC */
-                        DpcEntry[i].Routine(DpcEntry[i].Dpc,
-                                            DpcEntry[i].Context,
-                                            UlongToPtr(SystemTime.LowPart),
-                                            UlongToPtr(SystemTime.HighPart));
-                    }
+                            /* Call the DPC */
+                            DpcEntry[i].Routine(DpcEntry[i].Dpc,
+                                                DpcEntry[i].Context,
+                                                UlongToPtr(SystemTime.LowPart),
+                                                UlongToPtr(SystemTime.HighPart));
+                        }
 
-                    /* Reset accounting */
-                    Timers = 24;
-                    ActiveTimers = 4;
+                        /* Reset accounting */
+                        Timers = 24;
+                        ActiveTimers = 4;
 
-                    /* Lock the dispatcher database */
-                    KiAcquireDispatcherLock();
+                        /* Lock the dispatcher database */
+                        KiAcquireDispatcherLock();
+                    }
                 }
-            }
-            else
-            {
-                /* Check if the timer list is empty */
-                if (NextEntry != ListHead)
+                else
                 {
-                    /* Sanity check */
-                    ASSERT(KiTimerTableListHead[Index].Time.QuadPart <=
-                           Timer->DueTime.QuadPart);
-
-                    /* Update the time */
-                    _disable();
-                    KiTimerTableListHead[Index].Time.QuadPart =
-                        Timer->DueTime.QuadPart;
-                    _enable();
-                }
-
-                /* Release the lock */
-                KiReleaseTimerLock(LockQueue);
+                    /* Check if the timer list is empty */
+                    if (NextEntry != ListHead)
+                    {
+                        /* Sanity check */
+                        ASSERT(Table->Entry[Index].Time.QuadPart <=
+                               Timer->DueTime.QuadPart);
+
+                        /* Update the time */
+                        _disable();
+                        Table->Entry[Index].Time.QuadPart =
+                            Timer->DueTime.QuadPart;
+                        _enable();
+                    }
 
-                /* Check if we've scanned all the timers we could */
-                if (!Timers)
-                {
-                    /* Release the dispatcher while doing DPCs */
-                    KiReleaseDispatcherLock(DISPATCH_LEVEL);
+                    /* Release the lock */
+                    KiReleaseTimerLock(TimerLock);
 
-                    /* Start looping all DPC Entries */
-                    for (i = 0; DpcCalls; DpcCalls--, i++)
+                    /* Check if we've scanned all the timers we could */
+                    if (!Timers)
                     {
+                        /* Release the dispatcher while doing DPCs */
+                        KiReleaseDispatcherLock(DISPATCH_LEVEL);
+
+                        /* Start looping all DPC Entries */
+                        for (i = 0; DpcCalls; DpcCalls--, i++)
+                        {
 #if DBG
-                        /* Clear DPC Time */
-                        Prcb->DebugDpcTime = 0;
+                            /* Clear DPC Time */
+                            Prcb->DebugDpcTime = 0;
 #endif
 
-                        /* Call the DPC */
-                        DpcEntry[i].Routine(DpcEntry[i].Dpc,
-                                            DpcEntry[i].Context,
-                                            UlongToPtr(SystemTime.LowPart),
-                                            UlongToPtr(SystemTime.HighPart));
-                    }
+                            /* Call the DPC */
+                            DpcEntry[i].Routine(DpcEntry[i].Dpc,
+                                                DpcEntry[i].Context,
+                                                UlongToPtr(SystemTime.LowPart),
+                                                UlongToPtr(SystemTime.HighPart));
+                        }
 
-                    /* Reset accounting */
-                    Timers = 24;
-                    ActiveTimers = 4;
+                        /* Reset accounting */
+                        Timers = 24;
+                        ActiveTimers = 4;
 
-                    /* Lock the dispatcher database */
-                    KiAcquireDispatcherLock();
-                }
+                        /* Lock the dispatcher database */
+                        KiAcquireDispatcherLock();
+                    }
 
-                /* Done looping */
-                break;
+                    /* Done looping */
+                    break;
+                }
             }
-        }
-    } while (Index != Limit);
+        } while (Index != Limit);
+    }
 
     /* Verify the timer table, on debug builds */
     if (KeNumberProcessors == 1) KiCheckTimerTable(InterruptTime);
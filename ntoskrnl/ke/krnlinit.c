@@ -70,8 +70,6 @@ NTAPI
 INIT_FUNCTION
 KiInitSystem(VOID)
 {
-    ULONG i;
-
     /* Initialize Bugcheck Callback data */
     InitializeListHead(&KeBugcheckCallbackListHead);
     InitializeListHead(&KeBugcheckReasonCallbackListHead);
@@ -86,15 +84,6 @@ KiInitSystem(VOID)
     InitializeListHead(&KiProfileListHead);
     InitializeListHead(&KiProfileSourceListHead);
 
-    /* Loop the timer table */
-    for (i = 0; i < TIMER_TABLE_SIZE; i++)
-    {
-        /* Initialize the list and entries */
-        InitializeListHead(&KiTimerTableListHead[i].Entry);
-        KiTimerTableListHead[i].Time.HighPart = 0xFFFFFFFF;
-        KiTimerTableListHead[i].Time.LowPart = 0;
-    }
-
     /* Initialize the Swap event and all swap lists */
     KeInitializeEvent(&KiSwapEvent, SynchronizationEvent, FALSE);
     InitializeListHead(&KiProcessInSwapListHead);
@@ -284,6 +273,9 @@ KiInitSpinLocks(IN PKPRCB Prcb,
         KeInitializeSpinLock(&MmNonPagedPoolLock);
         KeInitializeSpinLock(&NtfsStructLock);
         KeInitializeSpinLock(&AfdWorkQueueSpinLock);
+
+        /* Initialize the timer tables */
+        KiInitializeTimerTables();
     }
 }
 
@@ -430,6 +430,72 @@ KeRemoveQueue(IN PKQUEUE Queue,
     return QueueEntry;
 }
 
+/*
+ * @implemented
+ *
+ * Waits like KeRemoveQueue for the first entry, then takes whatever else is
+ * already queued, up to Count entries, without waiting again. Returns the
+ * number of entries stored in EntryArray. If the wait ended without an
+ * entry, the status is stored in EntryArray[0] as KeRemoveQueue returns it.
+ */
+ULONG
+NTAPI
+KeRemoveQueueEx(IN PKQUEUE Queue,
+                IN KPROCESSOR_MODE WaitMode,
+                IN BOOLEAN Alertable,
+                IN PLARGE_INTEGER Timeout OPTIONAL,
+                OUT PLIST_ENTRY *EntryArray,
+                IN ULONG Count)
+{
+    PLIST_ENTRY QueueEntry;
+    ULONG Removed = 1;
+    KIRQL OldIrql;
+    ASSERT_QUEUE(Queue);
+    ASSERT(Count > 0);
+
+    /* Queue waits aren't alertable, user mode ones end on pending user APCs anyway */
+    UNREFERENCED_PARAMETER(Alertable);
+
+    /* Wait for the first entry */
+    QueueEntry = KeRemoveQueue(Queue, WaitMode, Timeout);
+    EntryArray[0] = QueueEntry;
+    if ((Count == 1) ||
+        ((NTSTATUS)(ULONG_PTR)QueueEntry == STATUS_TIMEOUT) ||
+        ((NTSTATUS)(ULONG_PTR)QueueEntry == STATUS_USER_APC))
+    {
+        return 1;
+    }
+
+    /* The thread is still counted as running, take the rest on its behalf */
+    OldIrql = KiAcquireDispatcherLock();
+    while (Removed < Count)
+    {
+        QueueEntry = Queue->EntryListHead.Flink;
+        if (QueueEntry == &Queue->EntryListHead) break;
+
+        /* Check if the entry is valid. If not, bugcheck */
+        if (!(QueueEntry->Flink) || !(QueueEntry->Blink))
+        {
+            /* Invalid item */
+            KeBugCheckEx(INVALID_WORK_QUEUE_ITEM,
+                         (ULONG_PTR)QueueEntry,
+                         (ULONG_PTR)Queue,
+                         (ULONG_PTR)NULL,
+                         (ULONG_PTR)((PWORK_QUEUE_ITEM)QueueEntry)->
+                                     WorkerRoutine);
+        }
+
+        /* Remove the Entry */
+        RemoveEntryList(QueueEntry);
+        QueueEntry->Flink = NULL;
+        Queue->Header.SignalState--;
+        EntryArray[Removed++] = QueueEntry;
+    }
+    KiReleaseDispatcherLock(OldIrql);
+
+    return Removed;
+}
+
 /*
  * @implemented
  */
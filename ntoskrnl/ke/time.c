@@ -42,11 +42,15 @@ KiCheckForTimerExpiration(
     PKTRAP_FRAME TrapFrame,
     ULARGE_INTEGER InterruptTime)
 {
-    ULONG Hand;
+    ULONG Hand, i;
 
-    /* Check for timer expiration */
-    Hand = KeTickCount.LowPart & (TIMER_TABLE_SIZE - 1);
-    if (KiTimerTableListHead[Hand].Time.QuadPart <= InterruptTime.QuadPart)
+    /* Check for timer expiration in any of the timer tables */
+    Hand = KeTickCount.LowPart & (KI_TIMER_TABLE_SIZE - 1);
+    for (i = 0; i < KI_TIMER_TABLES; i++)
+    {
+        if (KiTimerTable[i].Entry[Hand].Time.QuadPart <= InterruptTime.QuadPart) break;
+    }
+    if (i < KI_TIMER_TABLES)
     {
         /* Check if we are already doing expiration */
         if (!Prcb->TimerRequest)
@@ -14,13 +14,41 @@
 
 /* GLOBALS *******************************************************************/
 
-KTIMER_TABLE_ENTRY KiTimerTableListHead[TIMER_TABLE_SIZE];
+KI_TIMER_TABLE KiTimerTable[KI_TIMER_TABLES];
 LARGE_INTEGER KiTimeIncrementReciprocal;
 UCHAR KiTimeIncrementShiftCount;
 BOOLEAN KiEnableTimerWatchdog = FALSE;
 
 /* PRIVATE FUNCTIONS *********************************************************/
 
+VOID
+NTAPI
+INIT_FUNCTION
+KiInitializeTimerTables(VOID)
+{
+    PKI_TIMER_TABLE Table;
+    ULONG i;
+
+    /* Loop the timer tables */
+    for (Table = KiTimerTable; Table < &KiTimerTable[KI_TIMER_TABLES]; Table++)
+    {
+        /* Initialize the locks */
+        for (i = 0; i < LOCK_QUEUE_TIMER_TABLE_LOCKS; i++)
+        {
+            KeInitializeSpinLock(&Table->Lock[i]);
+        }
+
+        /* Loop the entries of the table */
+        for (i = 0; i < KI_TIMER_TABLE_SIZE; i++)
+        {
+            /* Initialize the list and entries */
+            InitializeListHead(&Table->Entry[i].Entry);
+            Table->Entry[i].Time.HighPart = 0xFFFFFFFF;
+            Table->Entry[i].Time.LowPart = 0;
+        }
+    }
+}
+
 BOOLEAN
 FASTCALL
 KiInsertTreeTimer(IN PKTIMER Timer,
@@ -28,14 +56,14 @@ KiInsertTreeTimer(IN PKTIMER Timer,
 {
     BOOLEAN Inserted = FALSE;
     ULONG Hand = 0;
-    PKSPIN_LOCK_QUEUE LockQueue;
+    PKSPIN_LOCK TimerLock;
     DPRINT("KiInsertTreeTimer(): Timer %p, Interval: %I64d\n", Timer, Interval.QuadPart);
 
     /* Setup the timer's due time */
     if (KiComputeDueTime(Timer, Interval, &Hand))
     {
         /* Acquire the lock */
-        LockQueue = KiAcquireTimerLock(Hand);
+        TimerLock = KiAcquireTimerLock(KiGetTimerTable(Timer), Hand);
 
         /* Insert the timer */
         if (KiInsertTimerTable(Timer, Hand))
@@ -51,7 +79,7 @@ KiInsertTreeTimer(IN PKTIMER Timer,
         }
         
         /* Release the lock */
-        KiReleaseTimerLock(LockQueue);
+        KiReleaseTimerLock(TimerLock);
     }
 
     /* Release the lock and return insert status */
@@ -66,6 +94,7 @@ KiInsertTimerTable(IN PKTIMER Timer,
     LARGE_INTEGER InterruptTime;
     LONGLONG DueTime = Timer->DueTime.QuadPart;
     BOOLEAN Expired = FALSE;
+    PKTIMER_TABLE_ENTRY TableEntry;
     PLIST_ENTRY ListHead, NextEntry;
     PKTIMER CurrentTimer;
     DPRINT("KiInsertTimerTable(): Timer %p, Hand: %lu\n", Timer, Hand);
@@ -77,7 +106,8 @@ KiInsertTimerTable(IN PKTIMER Timer,
     ASSERT(Hand == KiComputeTimerTableIndex(DueTime));
 
     /* Loop the timer list backwards */
-    ListHead = &KiTimerTableListHead[Hand].Entry;
+    TableEntry = &KiGetTimerTable(Timer)->Entry[Hand];
+    ListHead = &TableEntry->Entry;
     NextEntry = ListHead->Blink;
     while (NextEntry != ListHead)
     {
@@ -98,7 +128,7 @@ KiInsertTimerTable(IN PKTIMER Timer,
     if (NextEntry == ListHead)
     {
         /* Set the time */
-        KiTimerTableListHead[Hand].Time.QuadPart = DueTime;
+        TableEntry->Time.QuadPart = DueTime;
 
         /* Make sure it hasn't expired already */
         InterruptTime.QuadPart = KeQueryInterruptTime();
@@ -165,11 +195,11 @@ KiSignalTimer(IN PKTIMER Timer)
 VOID
 FASTCALL
 KiCompleteTimer(IN PKTIMER Timer,
-                IN PKSPIN_LOCK_QUEUE LockQueue)
+                IN PKSPIN_LOCK TimerLock)
 {
     LIST_ENTRY ListHead;
     BOOLEAN RequestInterrupt = FALSE;
-    DPRINT("KiCompleteTimer(): Timer %p, LockQueue: %p\n", Timer, LockQueue);
+    DPRINT("KiCompleteTimer(): Timer %p, TimerLock: %p\n", Timer, TimerLock);
 
     /* Remove it from the timer list */
     KiRemoveEntryTimer(Timer);
@@ -181,7 +211,7 @@ KiCompleteTimer(IN PKTIMER Timer,
     Timer->TimerListEntry.Blink = &ListHead;
 
     /* Release the timer lock */
-    KiReleaseTimerLock(LockQueue);
+    KiReleaseTimerLock(TimerLock);
 
     /* Acquire dispatcher lock */
     KiAcquireDispatcherLockAtDpcLevel();
@@ -286,24 +316,18 @@ KeSetTimer(IN OUT PKTIMER Timer,
     return KeSetTimerEx(Timer, DueTime, 0, Dpc);
 }
 
-/*
- * @implemented
- */
+static
 BOOLEAN
-NTAPI
-KeSetTimerEx(IN OUT PKTIMER Timer,
-             IN LARGE_INTEGER DueTime,
-             IN LONG Period,
-             IN PKDPC Dpc OPTIONAL)
+KiSetTimer(IN OUT PKTIMER Timer,
+           IN LARGE_INTEGER DueTime,
+           IN LONG Period,
+           IN ULONG CoalescingShift,
+           IN PKDPC Dpc OPTIONAL)
 {
     KIRQL OldIrql;
     BOOLEAN Inserted;
     ULONG Hand = 0;
     BOOLEAN RequestInterrupt = FALSE;
-    ASSERT_TIMER(Timer);
-    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
-    DPRINT("KeSetTimerEx(): Timer %p, DueTime %I64d, Period %d, Dpc %p\n",
-           Timer, DueTime.QuadPart, Period, Dpc);
 
     /* Lock the Database and Raise IRQL */
     OldIrql = KiAcquireDispatcherLock();
@@ -315,6 +339,8 @@ KeSetTimerEx(IN OUT PKTIMER Timer,
     /* Set Default Timer Data */
     Timer->Dpc = Dpc;
     Timer->Period = Period;
+    Timer->Header.Coalescable = (CoalescingShift != 0);
+    Timer->Header.EncodedTolerableDelay = CoalescingShift;
     if (!KiComputeDueTime(Timer, DueTime, &Hand))
     {
         /* Signal the timer */
@@ -340,3 +366,61 @@ KeSetTimerEx(IN OUT PKTIMER Timer,
     return Inserted;
 }
 
+/*
+ * @implemented
+ */
+BOOLEAN
+NTAPI
+KeSetTimerEx(IN OUT PKTIMER Timer,
+             IN LARGE_INTEGER DueTime,
+             IN LONG Period,
+             IN PKDPC Dpc OPTIONAL)
+{
+    ASSERT_TIMER(Timer);
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+    DPRINT("KeSetTimerEx(): Timer %p, DueTime %I64d, Period %d, Dpc %p\n",
+           Timer, DueTime.QuadPart, Period, Dpc);
+
+    /* The timer expires on time */
+    return KiSetTimer(Timer, DueTime, Period, 0, Dpc);
+}
+
+/*
+ * @implemented
+ */
+BOOLEAN
+NTAPI
+KeSetCoalescableTimer(IN OUT PKTIMER Timer,
+                      IN LARGE_INTEGER DueTime,
+                      IN ULONG Period,
+                      IN ULONG TolerableDelay,
+                      IN PKDPC Dpc OPTIONAL)
+{
+    ULONGLONG Tolerance;
+    ULONG Shift = 0;
+    ASSERT_TIMER(Timer);
+    ASSERT(KeGetCurrentIrql() <= DISPATCH_LEVEL);
+    ASSERT(Period <= MAXLONG);
+    DPRINT("KeSetCoalescableTimer(): Timer %p, DueTime %I64d, Period %lu, TolerableDelay %lu, Dpc %p\n",
+           Timer, DueTime.QuadPart, Period, TolerableDelay, Dpc);
+
+    /* A periodic timer can't be delayed by more than its period */
+    if (Period) TolerableDelay = min(TolerableDelay, Period);
+    Tolerance = (ULONGLONG)TolerableDelay * 10000;
+
+    /*
+     * Find the coarsest granularity the delay allows. Timers with the same
+     * granularity get the same due times, so they expire in one pass over the
+     * timer table instead of spreading over many clock ticks. Less than two
+     * ticks of tolerance leaves nothing to gain, so the timer stays exact.
+     */
+    while ((Shift < KI_MAXIMUM_COALESCING_SHIFT) &&
+           (((ULONGLONG)KeMaximumIncrement << (Shift + 1)) <= Tolerance))
+    {
+        Shift++;
+    }
+
+    /* Set the timer */
+    return KiSetTimer(Timer, DueTime, Period, Shift, Dpc);
+}
+
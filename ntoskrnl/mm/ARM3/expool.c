@@ -1622,8 +1622,10 @@ ExQueryPoolUsage(OUT PULONG PagedPoolPages,
                  OUT PULONG NonPagedPoolFrees,
                  OUT PULONG NonPagedPoolLookasideHits)
 {
-    ULONG i;
+    ULONG i, j;
     PPOOL_DESCRIPTOR PoolDesc;
+    PKPRCB Prcb;
+    PGENERAL_LOOKASIDE LookasideList;
 
     //
     // Assume all failures
@@ -1669,10 +1671,43 @@ ExQueryPoolUsage(OUT PULONG PagedPoolPages,
 #endif
 
     //
-    // FIXME: Not yet supported
+    // Add up the hits of the per-CPU lookaside lists of all processors
     //
-    *NonPagedPoolLookasideHits += 0;
-    *PagedPoolLookasideHits += 0;
+    for (i = 0; i < (ULONG)KeNumberProcessors; i++)
+    {
+        Prcb = KiProcessorBlock[i];
+        if (!Prcb) continue;
+
+        for (j = 0; j < NUMBER_POOL_LOOKASIDE_LISTS; j++)
+        {
+            //
+            // A processor which couldn't get its own lists uses the
+            // system-wide ones, counted below
+            //
+            LookasideList = Prcb->PPNPagedLookasideList[j].P;
+            if (LookasideList != Prcb->PPNPagedLookasideList[j].L)
+            {
+                *NonPagedPoolLookasideHits += LookasideList->AllocateHits;
+            }
+
+            LookasideList = Prcb->PPPagedLookasideList[j].P;
+            if (LookasideList != Prcb->PPPagedLookasideList[j].L)
+            {
+                *PagedPoolLookasideHits += LookasideList->AllocateHits;
+            }
+        }
+    }
+
+    //
+    // And the ones of the system-wide lookaside lists, which all
+    // processors share
+    //
+    Prcb = KeGetCurrentPrcb();
+    for (j = 0; j < NUMBER_POOL_LOOKASIDE_LISTS; j++)
+    {
+        *NonPagedPoolLookasideHits += Prcb->PPNPagedLookasideList[j].L->AllocateHits;
+        *PagedPoolLookasideHits += Prcb->PPPagedLookasideList[j].L->AllocateHits;
+    }
 }
 
 VOID
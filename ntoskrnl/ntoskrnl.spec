@@ -673,6 +673,7 @@
 @ stdcall KeRemoveDeviceQueue(ptr)
 @ stdcall KeRemoveEntryDeviceQueue(ptr ptr)
 @ stdcall KeRemoveQueue(ptr long ptr)
+@ stdcall KeRemoveQueueEx(ptr long long ptr ptr long)
 @ stdcall KeRemoveQueueDpc(ptr)
 @ stdcall KeRemoveSystemServiceTable(long)
 @ stdcall KeResetEvent(ptr)
@@ -686,6 +687,7 @@
 @ extern KeServiceDescriptorTable
 @ stdcall KeSetAffinityThread(ptr long)
 @ stdcall KeSetBasePriorityThread(ptr long)
+@ stdcall KeSetCoalescableTimer(ptr long long long long ptr)
 @ stdcall KeSetDmaIoCoherency(long)
 @ stdcall KeSetEvent(ptr long long)
 @ stdcall KeSetEventBoostPriority(ptr ptr)
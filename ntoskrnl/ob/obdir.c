@@ -22,6 +22,130 @@ POBJECT_TYPE ObDirectoryType = NULL;
 
 /* PRIVATE FUNCTIONS ******************************************************/
 
+FORCEINLINE
+POBJECT_DIRECTORY_ENTRY*
+ObpGetDirectoryBuckets(IN POBJECT_DIRECTORY Directory,
+                       OUT PULONG BucketCount)
+{
+    POBP_DIRECTORY_HASH_TABLE HashTable;
+
+    /* Small directories use the buckets built into the directory */
+    HashTable = CONTAINING_RECORD(Directory, OBP_DIRECTORY, Directory)->HashTable;
+    if (!HashTable)
+    {
+        *BucketCount = NUMBER_HASH_BUCKETS;
+        return Directory->HashBuckets;
+    }
+
+    *BucketCount = 1 << HashTable->HashBits;
+    return HashTable->HashBuckets;
+}
+
+FORCEINLINE
+ULONG
+ObpGetDirectoryHashIndex(IN POBJECT_DIRECTORY Directory,
+                         IN ULONG HashValue)
+{
+    POBP_DIRECTORY_HASH_TABLE HashTable;
+
+    HashTable = CONTAINING_RECORD(Directory, OBP_DIRECTORY, Directory)->HashTable;
+    if (!HashTable) return HashValue % NUMBER_HASH_BUCKETS;
+
+    /* The name hash has poor low bits, so mix them before masking */
+    return (HashValue * 0x9E3779B1) >> (32 - HashTable->HashBits);
+}
+
+/*++
+* @name ObpGrowDirectory
+*
+*     The ObpGrowDirectory routine moves the entries of a directory to a
+*     hash table with twice as many buckets.
+*
+* @param Directory
+*        Directory to grow. Its lock must be held exclusively.
+*
+* @return None.
+*
+* @remarks If the new table can't be allocated, the directory keeps working
+*          with longer chains.
+*
+*--*/
+static
+VOID
+ObpGrowDirectory(IN POBP_DIRECTORY Directory)
+{
+    POBP_DIRECTORY_HASH_TABLE OldTable = Directory->HashTable;
+    POBP_DIRECTORY_HASH_TABLE NewTable;
+    POBJECT_DIRECTORY_ENTRY *OldBuckets;
+    POBJECT_DIRECTORY_ENTRY Entry, NextEntry;
+    ULONG OldCount, HashBits, Index, i;
+
+    /* Get the next size */
+    if (OldTable)
+    {
+        if (OldTable->HashBits >= OBP_DIRECTORY_MAX_HASH_BITS) return;
+        HashBits = OldTable->HashBits + 1;
+    }
+    else
+    {
+        HashBits = OBP_DIRECTORY_MIN_HASH_BITS;
+    }
+
+    /* Allocate the new table */
+    NewTable = ExAllocatePoolWithTag(PagedPool,
+                                     FIELD_OFFSET(OBP_DIRECTORY_HASH_TABLE, HashBuckets) +
+                                     (sizeof(POBJECT_DIRECTORY_ENTRY) << HashBits),
+                                     OB_DIR_TAG);
+    if (!NewTable) return;
+    NewTable->HashBits = HashBits;
+    RtlZeroMemory(NewTable->HashBuckets, sizeof(POBJECT_DIRECTORY_ENTRY) << HashBits);
+
+    /* Move all the entries, their hash is saved so the names aren't needed */
+    OldBuckets = ObpGetDirectoryBuckets(&Directory->Directory, &OldCount);
+    for (i = 0; i < OldCount; i++)
+    {
+        for (Entry = OldBuckets[i]; Entry; Entry = NextEntry)
+        {
+            NextEntry = Entry->ChainLink;
+            Index = (Entry->HashValue * 0x9E3779B1) >> (32 - HashBits);
+            Entry->ChainLink = NewTable->HashBuckets[Index];
+            NewTable->HashBuckets[Index] = Entry;
+        }
+
+        OldBuckets[i] = NULL;
+    }
+
+    /* Switch to the new table */
+    Directory->HashTable = NewTable;
+    if (OldTable) ExFreePoolWithTag(OldTable, OB_DIR_TAG);
+}
+
+/*++
+* @name ObpDeleteDirectory
+*
+*     The ObpDeleteDirectory routine is the delete procedure of directory
+*     objects.
+*
+* @param ObjectBody
+*        Directory being deleted.
+*
+* @return None.
+*
+* @remarks Named objects reference their directory, so it's empty by now.
+*
+*--*/
+VOID
+NTAPI
+ObpDeleteDirectory(IN PVOID ObjectBody)
+{
+    POBP_DIRECTORY Directory = ObjectBody;
+
+    ASSERT(Directory->EntryCount == 0);
+
+    /* Free the hash table if the directory ever grew one */
+    if (Directory->HashTable) ExFreePoolWithTag(Directory->HashTable, OB_DIR_TAG);
+}
+
 /*++
 * @name ObpInsertEntryDirectory
 *
@@ -50,6 +174,8 @@ ObpInsertEntryDirectory(IN POBJECT_DIRECTORY Parent,
     POBJECT_DIRECTORY_ENTRY *AllocatedEntry;
     POBJECT_DIRECTORY_ENTRY NewEntry;
     POBJECT_HEADER_NAME_INFO HeaderNameInfo;
+    POBP_DIRECTORY Directory;
+    ULONG BucketCount;
 
     /* Make sure we have a name */
     ASSERT(ObjectHeader->NameInfoOffset != 0);
@@ -79,7 +205,8 @@ ObpInsertEntryDirectory(IN POBJECT_DIRECTORY Parent,
     HeaderNameInfo = OBJECT_HEADER_TO_NAME_INFO(ObjectHeader);
 
     /* Get the Allocated entry */
-    AllocatedEntry = &Parent->HashBuckets[Context->HashIndex];
+    AllocatedEntry = ObpGetDirectoryBuckets(Parent, &BucketCount);
+    AllocatedEntry += ObpGetDirectoryHashIndex(Parent, Context->HashValue);
 
     /* Set it */
     NewEntry->ChainLink = *AllocatedEntry;
@@ -90,6 +217,14 @@ ObpInsertEntryDirectory(IN POBJECT_DIRECTORY Parent,
 
     /* Associate the Directory */
     HeaderNameInfo->Directory = Parent;
+
+    /* Grow the hash table once the chains get too long */
+    Directory = CONTAINING_RECORD(Parent, OBP_DIRECTORY, Directory);
+    if (++Directory->EntryCount > BucketCount * OBP_DIRECTORY_MAX_CHAIN)
+    {
+        ObpGrowDirectory(Directory);
+    }
+
     return TRUE;
 }
 
@@ -137,6 +272,7 @@ ObpLookupEntryDirectory(IN POBJECT_DIRECTORY Directory,
     POBJECT_DIRECTORY_ENTRY *LookupBucket;
     POBJECT_DIRECTORY_ENTRY CurrentEntry;
     PVOID FoundObject = NULL;
+    ULONG BucketCount;
     PWSTR Buffer;
     PAGED_CODE();
 
@@ -171,24 +307,25 @@ ObpLookupEntryDirectory(IN POBJECT_DIRECTORY Directory,
         else HashValue += (CurrentChar - ('a'-'A'));
     }
 
-    /* Merge it with our number of hash buckets */
-    HashIndex = HashValue % 37;
+    /* Check if the directory is already locked */
+    if (!Context->DirectoryLocked)
+    {
+        /* Lock it */
+        ObpAcquireDirectoryLockShared(Directory, Context);
+    }
+
+    /* Merge it with our number of hash buckets, which can change until
+       the directory is locked */
+    HashIndex = ObpGetDirectoryHashIndex(Directory, HashValue);
 
     /* Save the result */
     Context->HashValue = HashValue;
     Context->HashIndex = (USHORT)HashIndex;
 
     /* Get the root entry and set it as our lookup bucket */
-    AllocatedEntry = &Directory->HashBuckets[HashIndex];
+    AllocatedEntry = ObpGetDirectoryBuckets(Directory, &BucketCount) + HashIndex;
     LookupBucket = AllocatedEntry;
 
-    /* Check if the directory is already locked */
-    if (!Context->DirectoryLocked)
-    {
-        /* Lock it */
-        ObpAcquireDirectoryLockShared(Directory, Context);
-    }
-
     /* Start looping */
     while ((CurrentEntry = *AllocatedEntry))
     {
@@ -217,12 +354,14 @@ ObpLookupEntryDirectory(IN POBJECT_DIRECTORY Directory,
     /* Check if we still have an entry */
     if (CurrentEntry)
     {
-        /* Set this entry as the first, to speed up incoming insertion */
+        /* Set this entry as the first, to speed up incoming deletion. Shared
+           lookups leave the chain alone, since chains are kept short and
+           writing to it would make concurrent lookups of hot names fight
+           over the lock and the bucket's cache line */
         if (AllocatedEntry != LookupBucket)
         {
-            /* Check if the directory was locked or convert the lock */
-            if ((Context->DirectoryLocked) ||
-                (ExConvertPushLockSharedToExclusive(&Directory->Lock)))
+            /* Check if the directory was locked */
+            if (Context->DirectoryLocked)
             {
                 /* Set the Current Entry */
                 *AllocatedEntry = CurrentEntry->ChainLink;
@@ -312,18 +451,21 @@ ObpDeleteEntryDirectory(POBP_LOOKUP_CONTEXT Context)
     POBJECT_DIRECTORY Directory;
     POBJECT_DIRECTORY_ENTRY *AllocatedEntry;
     POBJECT_DIRECTORY_ENTRY CurrentEntry;
+    ULONG BucketCount;
 
     /* Get the Directory */
     Directory = Context->Directory;
     if (!Directory) return FALSE;
 
-    /* Get the Entry */
-    AllocatedEntry = &Directory->HashBuckets[Context->HashIndex];
+    /* Get the Entry, the lookup put it first in its chain */
+    AllocatedEntry = ObpGetDirectoryBuckets(Directory, &BucketCount) + Context->HashIndex;
     CurrentEntry = *AllocatedEntry;
+    ASSERT(CurrentEntry->Object == Context->Object);
 
     /* Unlink the Entry */
     *AllocatedEntry = CurrentEntry->ChainLink;
     CurrentEntry->ChainLink = NULL;
+    CONTAINING_RECORD(Directory, OBP_DIRECTORY, Directory)->EntryCount--;
 
     /* Free it */
     ExFreePoolWithTag(CurrentEntry, OB_DIR_TAG);
@@ -469,7 +611,8 @@ NtQueryDirectoryObject(IN HANDLE DirectoryHandle,
     POBJECT_DIRECTORY_INFORMATION DirectoryInfo;
     ULONG Length, TotalLength;
     ULONG Count, CurrentEntry;
-    ULONG Hash;
+    ULONG Hash, BucketCount;
+    POBJECT_DIRECTORY_ENTRY *HashBuckets;
     POBJECT_DIRECTORY_ENTRY Entry;
     POBJECT_HEADER ObjectHeader;
     POBJECT_HEADER_NAME_INFO ObjectNameInfo;
@@ -544,10 +687,11 @@ NtQueryDirectoryObject(IN HANDLE DirectoryHandle,
 
     /* Set default status and start looping */
     Status = STATUS_NO_MORE_ENTRIES;
-    for (Hash = 0; Hash < 37; Hash++)
+    HashBuckets = ObpGetDirectoryBuckets(Directory, &BucketCount);
+    for (Hash = 0; Hash < BucketCount; Hash++)
     {
         /* Get this entry and loop all of them */
-        Entry = Directory->HashBuckets[Hash];
+        Entry = HashBuckets[Hash];
         while (Entry)
         {
             /* Check if we should process this entry */
@@ -760,14 +904,14 @@ NtCreateDirectoryObject(OUT PHANDLE DirectoryHandle,
                             ObjectAttributes,
                             PreviousMode,
                             NULL,
-                            sizeof(OBJECT_DIRECTORY),
+                            sizeof(OBP_DIRECTORY),
                             0,
                             0,
                             (PVOID*)&Directory);
     if (!NT_SUCCESS(Status)) return Status;
 
     /* Setup the object */
-    RtlZeroMemory(Directory, sizeof(OBJECT_DIRECTORY));
+    RtlZeroMemory(Directory, sizeof(OBP_DIRECTORY));
     ExInitializePushLock(&Directory->Lock);
     Directory->SessionId = -1;
 
@@ -97,6 +97,14 @@ RtlpGetMode(VOID)
    return KernelMode;
 }
 
+ULONG
+NTAPI
+RtlpGetAffinityHint(VOID)
+{
+    /* Threads migrate, but the current processor is the best hint we have */
+    return KeGetCurrentProcessorNumber();
+}
+
 PVOID
 NTAPI
 RtlpAllocateMemory(ULONG Bytes,
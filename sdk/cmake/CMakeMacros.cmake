@@ -580,6 +580,25 @@ function(add_importlibs _module)
     endforeach()
 endfunction()
 
+# Binds the imports of a module from the given DLLs after linking it, so that
+# the loader doesn't have to snap them as long as the DLLs don't change.
+# Only done on i386 when BIND_IMPORTS is enabled, and only for modules that
+# aren't imported by these DLLs.
+function(bind_imports _module)
+    if(NOT BIND_IMPORTS OR NOT ARCH STREQUAL "i386")
+        return()
+    endif()
+
+    set(_dll_files)
+    foreach(_dll ${ARGN})
+        list(APPEND _dll_files $<TARGET_FILE:${_dll}>)
+    endforeach()
+
+    add_custom_command(TARGET ${_module} POST_BUILD
+        COMMAND native-pefixup $<TARGET_FILE:${_module}> -bind ${_dll_files})
+    add_dependencies(${_module} ${ARGN})
+endfunction()
+
 function(set_module_type MODULE TYPE)
     cmake_parse_arguments(__module "UNICODE" "IMAGEBASE" "ENTRYPOINT" ${ARGN})
 
@@ -64,6 +64,9 @@ set(BUILD_MP TRUE CACHE BOOL
 set(GENERATE_DEPENDENCY_GRAPH FALSE CACHE BOOL
 "Whether to create a GraphML dependency graph of DLLs.")
 
+set(BIND_IMPORTS FALSE CACHE BOOL
+"Whether to pre-bind the imports of some system executables (i386 only).")
+
 if(MSVC)
 set(_PREFAST_ FALSE CACHE BOOL
 "Whether to enable PREFAST while compiling.")
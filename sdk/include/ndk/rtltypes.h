@@ -584,6 +584,20 @@ typedef NTSTATUS
     _In_ NTSTATUS ExitStatus
 );
 
+#ifdef NTOS_MODE_USER
+//
+// Thread Pool I/O Completion Callback
+//
+typedef VOID
+(NTAPI *PTP_IO_CALLBACK)(
+    _Inout_ PTP_CALLBACK_INSTANCE Instance,
+    _Inout_opt_ PVOID Context,
+    _In_ PVOID ApcContext,
+    _In_ struct _IO_STATUS_BLOCK *IoStatusBlock,
+    _In_ PTP_IO Io
+);
+#endif
+
 //
 // Declare empty structure definitions so that they may be referenced by
 // routines before they are defined
@@ -730,6 +744,19 @@ typedef struct _RTL_HEAP_PARAMETERS
     SIZE_T Reserved[2];
 } RTL_HEAP_PARAMETERS, *PRTL_HEAP_PARAMETERS;
 
+//
+// Extended HeapCompatibilityInformation returned by RtlQueryHeapInformation
+// when the caller's buffer is large enough (ReactOS specific)
+//
+typedef struct _RTL_HEAP_FRONT_END_INFORMATION
+{
+    ULONG FrontEndHeapType;
+    ULONG AllocateHits;
+    ULONG AllocateMisses;
+    ULONG FreeHits;
+    ULONG FreeMisses;
+} RTL_HEAP_FRONT_END_INFORMATION, *PRTL_HEAP_FRONT_END_INFORMATION;
+
 //
 // RTL Bitmap structures
 //
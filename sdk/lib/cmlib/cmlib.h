@@ -110,6 +110,12 @@
         IN ULONG NumberToFind,
         IN ULONG HintIndex);
 
+    ULONG NTAPI
+    RtlFindNextForwardRunSet(
+        IN PRTL_BITMAP BitMapHeader,
+        IN ULONG FromIndex,
+        IN PULONG StartingRunIndex);
+
     VOID NTAPI
     RtlSetBits(
         IN PRTL_BITMAP BitMapHeader,
@@ -9,6 +9,102 @@
 #define NDEBUG
 #include <debug.h>
 
+/* Bins are allocated one by one, so blocks that follow each other in the
+   file rarely do in memory. Runs of dirty blocks are copied into a buffer
+   of this many blocks, so that each run takes a few large writes rather
+   than one write per block. */
+#define HV_WRITE_GATHER_BLOCKS 32
+
+static ULONG
+HvpGetContiguousBlocks(
+    PHHIVE RegistryHive,
+    ULONG BlockIndex,
+    ULONG BlockCount)
+{
+    PHMAP_ENTRY BlockList = RegistryHive->Storage[Stable].BlockList;
+    ULONG_PTR BlockAddress = BlockList[BlockIndex].BlockAddress;
+    ULONG Count;
+
+    for (Count = 1; Count < BlockCount; Count++)
+    {
+        if (BlockList[BlockIndex + Count].BlockAddress != BlockAddress + Count * HBLOCK_SIZE)
+            break;
+    }
+
+    return Count;
+}
+
+static BOOLEAN CMAPI
+HvpWriteBlockRun(
+    PHHIVE RegistryHive,
+    ULONG FileType,
+    ULONG FileOffset,
+    ULONG BlockIndex,
+    ULONG BlockCount,
+    PUCHAR GatherBuffer)
+{
+    PHMAP_ENTRY BlockList = RegistryHive->Storage[Stable].BlockList;
+    ULONG Count, Gathered;
+    PVOID BlockPtr;
+    BOOLEAN Success;
+
+    while (BlockCount != 0)
+    {
+        Count = HvpGetContiguousBlocks(RegistryHive, BlockIndex, BlockCount);
+
+        if (GatherBuffer == NULL || Count == BlockCount || Count >= HV_WRITE_GATHER_BLOCKS)
+        {
+            /* Already in one piece, write it as it is */
+            BlockPtr = (PVOID)BlockList[BlockIndex].BlockAddress;
+        }
+        else
+        {
+            /* Collect the pieces until the buffer is full */
+            Gathered = 0;
+            for (;;)
+            {
+                Count = min(Count, HV_WRITE_GATHER_BLOCKS - Gathered);
+                RtlCopyMemory(GatherBuffer + Gathered * HBLOCK_SIZE,
+                              (PVOID)BlockList[BlockIndex + Gathered].BlockAddress,
+                              Count * HBLOCK_SIZE);
+                Gathered += Count;
+
+                if (Gathered == HV_WRITE_GATHER_BLOCKS || Gathered == BlockCount)
+                    break;
+
+                Count = HvpGetContiguousBlocks(RegistryHive,
+                                               BlockIndex + Gathered,
+                                               BlockCount - Gathered);
+            }
+
+            BlockPtr = GatherBuffer;
+            Count = Gathered;
+        }
+
+        Success = RegistryHive->FileWrite(RegistryHive, FileType,
+                                          &FileOffset, BlockPtr,
+                                          Count * HBLOCK_SIZE);
+        if (!Success)
+        {
+            return FALSE;
+        }
+
+        FileOffset += Count * HBLOCK_SIZE;
+        BlockIndex += Count;
+        BlockCount -= Count;
+    }
+
+    return TRUE;
+}
+
+static PUCHAR CMAPI
+HvpAllocateGatherBuffer(
+    PHHIVE RegistryHive)
+{
+    /* Not getting it only means more writes */
+    return RegistryHive->Allocate(HV_WRITE_GATHER_BLOCKS * HBLOCK_SIZE, TRUE, TAG_CM);
+}
+
 static BOOLEAN CMAPI
 HvpWriteLog(
     PHHIVE RegistryHive)
@@ -19,8 +115,8 @@ HvpWriteLog(
     PUCHAR Buffer;
     PUCHAR Ptr;
     ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
+    ULONG BlockCount;
+    PUCHAR GatherBuffer;
     BOOLEAN Success;
     static ULONG PrintCount = 0;
 
@@ -78,32 +174,35 @@ HvpWriteLog(
         return FALSE;
     }
 
-    /* Write dirty blocks */
+    /* Write dirty blocks, one run at a time */
+    GatherBuffer = HvpAllocateGatherBuffer(RegistryHive);
     FileOffset = BufferSize;
     BlockIndex = 0;
     while (BlockIndex < RegistryHive->Storage[Stable].Length)
     {
-        LastIndex = BlockIndex;
-        BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-        if (BlockIndex == ~0U || BlockIndex < LastIndex)
+        BlockCount = RtlFindNextForwardRunSet(&RegistryHive->DirtyVector,
+                                              BlockIndex, &BlockIndex);
+        if (BlockCount == 0 || BlockIndex >= RegistryHive->Storage[Stable].Length)
         {
             break;
         }
+        BlockCount = min(BlockCount, RegistryHive->Storage[Stable].Length - BlockIndex);
 
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
-
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_LOG,
-                                         &FileOffset, BlockPtr, HBLOCK_SIZE);
+        /* Write hive blocks */
+        Success = HvpWriteBlockRun(RegistryHive, HFILE_TYPE_LOG, FileOffset,
+                                   BlockIndex, BlockCount, GatherBuffer);
         if (!Success)
         {
+            if (GatherBuffer) RegistryHive->Free(GatherBuffer, 0);
             return FALSE;
         }
 
-        BlockIndex++;
-        FileOffset += HBLOCK_SIZE;
+        BlockIndex += BlockCount;
+        FileOffset += BlockCount * HBLOCK_SIZE;
     }
 
+    if (GatherBuffer) RegistryHive->Free(GatherBuffer, 0);
+
     Success = RegistryHive->FileSetSize(RegistryHive, HFILE_TYPE_LOG, FileOffset, FileOffset);
     if (!Success)
     {
@@ -150,8 +249,8 @@ HvpWriteHive(
 {
     ULONG FileOffset;
     ULONG BlockIndex;
-    ULONG LastIndex;
-    PVOID BlockPtr;
+    ULONG BlockCount;
+    PUCHAR GatherBuffer;
     BOOLEAN Success;
 
     ASSERT(RegistryHive->ReadOnly == FALSE);
@@ -182,33 +281,42 @@ HvpWriteHive(
         return FALSE;
     }
 
+    GatherBuffer = HvpAllocateGatherBuffer(RegistryHive);
     BlockIndex = 0;
     while (BlockIndex < RegistryHive->Storage[Stable].Length)
     {
         if (OnlyDirty)
         {
-            LastIndex = BlockIndex;
-            BlockIndex = RtlFindSetBits(&RegistryHive->DirtyVector, 1, BlockIndex);
-            if (BlockIndex == ~0U || BlockIndex < LastIndex)
+            /* Find the next run of dirty blocks */
+            BlockCount = RtlFindNextForwardRunSet(&RegistryHive->DirtyVector,
+                                                  BlockIndex, &BlockIndex);
+            if (BlockCount == 0 || BlockIndex >= RegistryHive->Storage[Stable].Length)
             {
                 break;
             }
+            BlockCount = min(BlockCount, RegistryHive->Storage[Stable].Length - BlockIndex);
+        }
+        else
+        {
+            BlockCount = RegistryHive->Storage[Stable].Length;
         }
 
-        BlockPtr = (PVOID)RegistryHive->Storage[Stable].BlockList[BlockIndex].BlockAddress;
         FileOffset = (BlockIndex + 1) * HBLOCK_SIZE;
 
-        /* Write hive block */
-        Success = RegistryHive->FileWrite(RegistryHive, HFILE_TYPE_PRIMARY,
-                                          &FileOffset, BlockPtr, HBLOCK_SIZE);
+        /* Write hive blocks */
+        Success = HvpWriteBlockRun(RegistryHive, HFILE_TYPE_PRIMARY, FileOffset,
+                                   BlockIndex, BlockCount, GatherBuffer);
         if (!Success)
         {
+            if (GatherBuffer) RegistryHive->Free(GatherBuffer, 0);
             return FALSE;
         }
 
-        BlockIndex++;
+        BlockIndex += BlockCount;
     }
 
+    if (GatherBuffer) RegistryHive->Free(GatherBuffer, 0);
+
     Success = RegistryHive->FileFlush(RegistryHive, HFILE_TYPE_PRIMARY, NULL, 0);
     if (!Success)
     {
@@ -467,6 +467,8 @@ elseif(ARCH STREQUAL "amd64")
         math/amd64/sqrt.S
         # math/amd64/sqrtf.S
         math/amd64/tan.S
+        mem/amd64/memmove_asm.s
+        mem/amd64/memset_asm.s
         setjmp/amd64/setjmp.s)
 
     list(APPEND CRT_SOURCE
@@ -486,6 +488,9 @@ elseif(ARCH STREQUAL "arm")
         math/arm/__rt_sdiv64_worker.c
         math/arm/__rt_udiv.c
         math/arm/__rt_udiv64_worker.c
+        mem/memcpy.c
+        mem/memmove.c
+        mem/memset.c
     )
     list(APPEND CRT_ASM_SOURCE
         except/arm/_abnormal_termination.s
@@ -555,9 +560,6 @@ if(NOT ARCH STREQUAL "i386")
         math/tanhf.c
         math/stubs.c
         mem/memchr.c
-        mem/memcpy.c
-        mem/memmove.c
-        mem/memset.c
         string/strcat.c
         string/strchr.c
         string/strcmp.c
@@ -127,7 +127,9 @@ elseif(ARCH STREQUAL "amd64")
         math/amd64/log10.S
         math/amd64/pow.S
         math/amd64/sqrt.S
-        math/amd64/tan.S)
+        math/amd64/tan.S
+        mem/amd64/memmove_asm.s
+        mem/amd64/memset_asm.s)
     list(APPEND LIBCNTPR_SOURCE
         except/amd64/ehandler.c
         math/cos.c
@@ -140,6 +142,9 @@ elseif(ARCH STREQUAL "arm")
         math/arm/__rt_sdiv64_worker.c
         math/arm/__rt_udiv.c
         math/arm/__rt_udiv64_worker.c
+        mem/memcpy.c
+        mem/memmove.c
+        mem/memset.c
     )
     list(APPEND LIBCNTPR_ASM_SOURCE
         except/arm/_abnormal_termination.s
@@ -211,9 +216,6 @@ else()
         math/sin.c
         math/sqrt.c
         mem/memchr.c
-        mem/memcpy.c
-        mem/memmove.c
-        mem/memset.c
         string/strcat.c
         string/strchr.c
         string/strcmp.c
@@ -0,0 +1,232 @@
+/*
+ * COPYRIGHT:         See COPYING in the top level directory
+ * PROJECT:           ReactOS system libraries
+ * PURPOSE:           Implementation of memcpy/memmove
+ * FILE:              lib/sdk/crt/mem/amd64/memmove_asm.s
+ * PROGRAMMER:        ReactOS Team
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <asm.inc>
+
+/* Copies at least this big that don't overlap bypass the cache */
+#define NON_TEMPORAL_THRESHOLD HEX(200000)
+
+/* CODE **********************************************************************/
+.code64
+
+/*
+ * void *memmove(void *dest <rcx>, const void *src <rdx>, size_t count <r8>);
+ *
+ * memcpy is the same function, so that overlapping copies stay safe.
+ * Only volatile registers are used, so no unwind information is needed.
+ * Small copies load everything before storing anything, which makes
+ * them correct in both directions. Larger ones keep the first and last
+ * 16 bytes in xmm4/xmm5, copy the middle with aligned stores and write
+ * the saved ends last.
+ */
+PUBLIC memcpy
+PUBLIC memmove
+
+memcpy:
+FUNC memmove
+    .ENDPROLOG
+
+    mov rax, rcx
+
+    cmp r8, 16
+    ja memmove_Above16
+
+    cmp r8, 8
+    jb memmove_Below8
+
+    /* 8 to 16 bytes, two possibly overlapping qwords */
+    mov r9, [rdx]
+    mov r10, [rdx + r8 - 8]
+    mov [rcx], r9
+    mov [rcx + r8 - 8], r10
+    ret
+
+memmove_Below8:
+    cmp r8, 4
+    jb memmove_Below4
+
+    /* 4 to 7 bytes, two possibly overlapping dwords */
+    mov r9d, [rdx]
+    mov r10d, [rdx + r8 - 4]
+    mov [rcx], r9d
+    mov [rcx + r8 - 4], r10d
+    ret
+
+memmove_Below4:
+    test r8, r8
+    jz memmove_Done
+
+    /* 1 to 3 bytes, first, middle and last byte */
+    mov r11, r8
+    shr r11, 1
+    movzx r9d, byte ptr [rdx]
+    movzx r10d, byte ptr [rdx + r8 - 1]
+    movzx edx, byte ptr [rdx + r11]
+    mov [rcx], r9b
+    mov [rcx + r8 - 1], r10b
+    mov [rcx + r11], dl
+
+memmove_Done:
+    ret
+
+memmove_Above16:
+    cmp r8, 32
+    ja memmove_Above32
+
+    /* 17 to 32 bytes */
+    movdqu xmm0, [rdx]
+    movdqu xmm1, [rdx + r8 - 16]
+    movdqu [rcx], xmm0
+    movdqu [rcx + r8 - 16], xmm1
+    ret
+
+memmove_Above32:
+    cmp r8, 64
+    ja memmove_Large
+
+    /* 33 to 64 bytes */
+    movdqu xmm0, [rdx]
+    movdqu xmm1, [rdx + 16]
+    movdqu xmm2, [rdx + r8 - 32]
+    movdqu xmm3, [rdx + r8 - 16]
+    movdqu [rcx], xmm0
+    movdqu [rcx + 16], xmm1
+    movdqu [rcx + r8 - 32], xmm2
+    movdqu [rcx + r8 - 16], xmm3
+    ret
+
+memmove_Large:
+    /* Save both ends, they are stored last */
+    movdqu xmm4, [rdx]
+    movdqu xmm5, [rdx + r8 - 16]
+    lea r10, [rcx + r8 - 16]
+
+    /* Copy backwards if the destination starts inside the source */
+    mov r9, rcx
+    sub r9, rdx
+    cmp r9, r8
+    jb memmove_Backward
+
+    /* Only use non-temporal stores when the buffers don't overlap at all */
+    mov r9, rdx
+    sub r9, rcx
+    cmp r9, r8
+    setae r9b
+    cmp r8, NON_TEMPORAL_THRESHOLD
+    setae r11b
+    and r9b, r11b
+
+    /* Align the destination to 16 bytes, the head covers the skipped part */
+    mov r11, rcx
+    neg r11
+    and r11, 15
+    add rcx, r11
+    add rdx, r11
+    sub r8, r11
+
+    test r9b, r9b
+    jnz memmove_ForwardNonTemporal
+
+    cmp r8, 64
+    jbe memmove_Forward16
+
+memmove_Forward64:
+    movdqu xmm0, [rdx]
+    movdqu xmm1, [rdx + 16]
+    movdqu xmm2, [rdx + 32]
+    movdqu xmm3, [rdx + 48]
+    movdqa [rcx], xmm0
+    movdqa [rcx + 16], xmm1
+    movdqa [rcx + 32], xmm2
+    movdqa [rcx + 48], xmm3
+    add rdx, 64
+    add rcx, 64
+    sub r8, 64
+    cmp r8, 64
+    ja memmove_Forward64
+
+memmove_Forward16:
+    /* Up to 64 bytes left, the last 16 of them come from the tail */
+    cmp r8, 16
+    jbe memmove_StoreEnds
+    movdqu xmm0, [rdx]
+    movdqa [rcx], xmm0
+    add rdx, 16
+    add rcx, 16
+    sub r8, 16
+    jmp memmove_Forward16
+
+memmove_ForwardNonTemporal:
+    prefetchnta [rdx + 512]
+    movdqu xmm0, [rdx]
+    movdqu xmm1, [rdx + 16]
+    movdqu xmm2, [rdx + 32]
+    movdqu xmm3, [rdx + 48]
+    movntdq [rcx], xmm0
+    movntdq [rcx + 16], xmm1
+    movntdq [rcx + 32], xmm2
+    movntdq [rcx + 48], xmm3
+    add rdx, 64
+    add rcx, 64
+    sub r8, 64
+    cmp r8, 64
+    ja memmove_ForwardNonTemporal
+
+    /* Make the streaming stores visible before the regular ones */
+    sfence
+    jmp memmove_Forward16
+
+memmove_Backward:
+    /* Align the end of the destination, the tail covers the skipped part */
+    lea r9, [rcx + r8]
+    and r9, 15
+    add rcx, r8
+    add rdx, r8
+    sub rcx, r9
+    sub rdx, r9
+    sub r8, r9
+
+    cmp r8, 64
+    jbe memmove_Backward16
+
+memmove_Backward64:
+    movdqu xmm0, [rdx - 16]
+    movdqu xmm1, [rdx - 32]
+    movdqu xmm2, [rdx - 48]
+    movdqu xmm3, [rdx - 64]
+    movdqa [rcx - 16], xmm0
+    movdqa [rcx - 32], xmm1
+    movdqa [rcx - 48], xmm2
+    movdqa [rcx - 64], xmm3
+    sub rdx, 64
+    sub rcx, 64
+    sub r8, 64
+    cmp r8, 64
+    ja memmove_Backward64
+
+memmove_Backward16:
+    /* Up to 64 bytes left, the first 16 of them come from the head */
+    cmp r8, 16
+    jbe memmove_StoreEnds
+    movdqu xmm0, [rdx - 16]
+    movdqa [rcx - 16], xmm0
+    sub rdx, 16
+    sub rcx, 16
+    sub r8, 16
+    jmp memmove_Backward16
+
+memmove_StoreEnds:
+    movdqu [rax], xmm4
+    movdqu [r10], xmm5
+    ret
+
+ENDFUNC
+
+END
@@ -0,0 +1,129 @@
+/*
+ * COPYRIGHT:         See COPYING in the top level directory
+ * PROJECT:           ReactOS system libraries
+ * PURPOSE:           Implementation of memset
+ * FILE:              lib/sdk/crt/mem/amd64/memset_asm.s
+ * PROGRAMMER:        ReactOS Team
+ */
+
+/* INCLUDES ******************************************************************/
+
+#include <asm.inc>
+
+/* Fills at least this big bypass the cache */
+#define NON_TEMPORAL_THRESHOLD HEX(200000)
+
+/* CODE **********************************************************************/
+.code64
+
+/*
+ * void *memset(void *dest <rcx>, int c <edx>, size_t count <r8>);
+ *
+ * Only volatile registers are used, so no unwind information is needed.
+ * The fill byte is spread over a qword and an xmm register, small fills
+ * use two possibly overlapping stores and larger ones store the first and
+ * last 16 bytes unaligned, then fill the middle with aligned stores.
+ */
+PUBLIC memset
+FUNC memset
+    .ENDPROLOG
+
+    mov rax, rcx
+
+    /* Spread the byte over all of rdx */
+    movzx edx, dl
+    mov r9, HEX(0101010101010101)
+    imul rdx, r9
+
+    cmp r8, 16
+    ja memset_Above16
+
+    cmp r8, 8
+    jb memset_Below8
+
+    /* 8 to 16 bytes */
+    mov [rcx], rdx
+    mov [rcx + r8 - 8], rdx
+    ret
+
+memset_Below8:
+    cmp r8, 4
+    jb memset_Below4
+
+    /* 4 to 7 bytes */
+    mov [rcx], edx
+    mov [rcx + r8 - 4], edx
+    ret
+
+memset_Below4:
+    test r8, r8
+    jz memset_Done
+
+    /* 1 to 3 bytes */
+    mov [rcx], dl
+    cmp r8, 1
+    je memset_Done
+    mov [rcx + r8 - 2], dx
+
+memset_Done:
+    ret
+
+memset_Above16:
+    movq xmm0, rdx
+    punpcklqdq xmm0, xmm0
+
+    /* Both ends first, whatever their alignment */
+    movdqu [rcx], xmm0
+    movdqu [rcx + r8 - 16], xmm0
+
+    cmp r8, 32
+    jbe memset_Done
+
+    /* Align the destination, the head already covers the skipped part */
+    lea r9, [rcx + r8]
+    add rcx, 16
+    and rcx, -16
+    sub r9, rcx
+
+    cmp r9, NON_TEMPORAL_THRESHOLD
+    jae memset_NonTemporal
+
+    cmp r9, 64
+    jbe memset_Fill16
+
+memset_Fill64:
+    movdqa [rcx], xmm0
+    movdqa [rcx + 16], xmm0
+    movdqa [rcx + 32], xmm0
+    movdqa [rcx + 48], xmm0
+    add rcx, 64
+    sub r9, 64
+    cmp r9, 64
+    ja memset_Fill64
+
+memset_Fill16:
+    /* Up to 64 bytes left, the last 16 of them are already done */
+    cmp r9, 16
+    jbe memset_Done
+    movdqa [rcx], xmm0
+    add rcx, 16
+    sub r9, 16
+    jmp memset_Fill16
+
+memset_NonTemporal:
+    movntdq [rcx], xmm0
+    movntdq [rcx + 16], xmm0
+    movntdq [rcx + 32], xmm0
+    movntdq [rcx + 48], xmm0
+    add rcx, 64
+    sub r9, 64
+    cmp r9, 64
+    ja memset_NonTemporal
+
+    /* Make the streaming stores visible before returning */
+    sfence
+    jmp memset_Fill16
+
+ENDFUNC
+
+END
@@ -9,6 +9,25 @@ void * __cdecl memmove(void *dest,const void *src,size_t count)
     if ((char_dest <= char_src) || (char_dest >= (char_src+count)))
     {
         /*  non-overlapping buffers */
+        if (count >= 4 * sizeof(size_t) &&
+            (((size_t)char_dest ^ (size_t)char_src) & (sizeof(size_t) - 1)) == 0)
+        {
+            /* Both are equally misaligned, so go word by word once aligned */
+            while((size_t)char_dest & (sizeof(size_t) - 1))
+            {
+                *char_dest++ = *char_src++;
+                count--;
+            }
+
+            while(count >= sizeof(size_t))
+            {
+                *(size_t *)char_dest = *(size_t *)char_src;
+                char_dest += sizeof(size_t);
+                char_src += sizeof(size_t);
+                count -= sizeof(size_t);
+            }
+        }
+
         while(count > 0)
 	{
             *char_dest = *char_src;
@@ -20,14 +39,32 @@ void * __cdecl memmove(void *dest,const void *src,size_t count)
     else
     {
         /* overlaping buffers */
-        char_dest = (char *)dest + count - 1;
-        char_src = (char *)src + count - 1;
+        char_dest = (char *)dest + count;
+        char_src = (char *)src + count;
+
+        if (count >= 4 * sizeof(size_t) &&
+            (((size_t)char_dest ^ (size_t)char_src) & (sizeof(size_t) - 1)) == 0)
+        {
+            while((size_t)char_dest & (sizeof(size_t) - 1))
+            {
+                *--char_dest = *--char_src;
+                count--;
+            }
+
+            while(count >= sizeof(size_t))
+            {
+                char_dest -= sizeof(size_t);
+                char_src -= sizeof(size_t);
+                *(size_t *)char_dest = *(size_t *)char_src;
+                count -= sizeof(size_t);
+            }
+        }
 
         while(count > 0)
 	{
-           *char_dest = *char_src;
            char_dest--;
            char_src--;
+           *char_dest = *char_src;
            count--;
 	}
     }
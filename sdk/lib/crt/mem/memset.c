@@ -8,6 +8,29 @@
 void* __cdecl memset(void* src, int val, size_t count)
 {
     char *char_src = (char *)src;
+    size_t word;
+
+    if (count >= 4 * sizeof(size_t))
+    {
+        while((size_t)char_src & (sizeof(size_t) - 1))
+        {
+            *char_src++ = val;
+            count--;
+        }
+
+        /* Spread the byte over a whole word */
+        word = (unsigned char)val;
+        word |= word << 8;
+        word |= word << 16;
+        if (sizeof(size_t) > 4)
+            word |= (word << 16) << 16;
+
+        while(count >= sizeof(size_t)) {
+            *(size_t *)char_src = word;
+            char_src += sizeof(size_t);
+            count -= sizeof(size_t);
+        }
+    }
 
     while(count>0) {
         *char_src = val;
@@ -216,29 +216,283 @@ out:
 }
 
 
+/* Hash chain match finder shared by all the compressors. Positions are
+   absolute offsets in the input, stored plus one so that 0 ends a chain.
+   The chain links live in a ring the size of the window, so following a
+   link whose slot has been reused gives a newer position, which ends the
+   walk. Every candidate is compared byte by byte anyway. */
+
+#define LZ_MIN_MATCH 3
+
+typedef struct _LZ_MATCH_FINDER
+{
+    PUCHAR Buffer;
+    PULONG Head;
+    PULONG Prev;
+    ULONG HashShift;
+    ULONG WindowMask;
+    ULONG MaxDepth;
+    ULONG NiceLength;
+    BOOLEAN Lazy;
+} LZ_MATCH_FINDER, *PLZ_MATCH_FINDER;
+
+static VOID
+RtlpInitializeMatchFinder(PLZ_MATCH_FINDER Finder,
+                          PUCHAR Buffer,
+                          PULONG Head,
+                          ULONG HashBits,
+                          PULONG Prev,
+                          ULONG WindowSize,
+                          USHORT Engine)
+{
+    Finder->Buffer = Buffer;
+    Finder->Head = Head;
+    Finder->Prev = Prev;
+    Finder->HashShift = 32 - HashBits;
+    Finder->WindowMask = WindowSize - 1;
+
+    /* The maximum engine looks much further down the chains and defers a
+       match by one byte when the next one is longer */
+    if (Engine == COMPRESSION_ENGINE_MAXIMUM)
+    {
+        Finder->MaxDepth = 256;
+        Finder->NiceLength = MAXULONG;
+        Finder->Lazy = TRUE;
+    }
+    else
+    {
+        Finder->MaxDepth = 8;
+        Finder->NiceLength = 32;
+        Finder->Lazy = FALSE;
+    }
+
+    RtlZeroMemory(Head, sizeof(ULONG) << HashBits);
+}
+
+FORCEINLINE
+ULONG
+RtlpHashMatchFinder(PLZ_MATCH_FINDER Finder, ULONG Pos)
+{
+    PUCHAR Data = Finder->Buffer + Pos;
+
+    return ((Data[0] | (Data[1] << 8) | (Data[2] << 16)) * 0x9E3779B1) >> Finder->HashShift;
+}
+
+/* Pos must have at least LZ_MIN_MATCH bytes after it */
+FORCEINLINE
+VOID
+RtlpInsertMatchFinder(PLZ_MATCH_FINDER Finder, ULONG Pos)
+{
+    ULONG Hash = RtlpHashMatchFinder(Finder, Pos);
+
+    Finder->Prev[Pos & Finder->WindowMask] = Finder->Head[Hash];
+    Finder->Head[Hash] = Pos + 1;
+}
+
+/* Returns the longest match for Pos of up to MaxLength bytes, starting no
+   further back than MaxOffset, or 0 if there is none of LZ_MIN_MATCH bytes */
+static ULONG
+RtlpFindMatch(PLZ_MATCH_FINDER Finder,
+              ULONG Pos,
+              ULONG MaxLength,
+              ULONG MaxOffset,
+              PULONG MatchOffset)
+{
+    PUCHAR Current = Finder->Buffer + Pos;
+    PUCHAR Candidate;
+    ULONG Next, Entry, Length, BestLength = LZ_MIN_MATCH - 1;
+    ULONG Depth = Finder->MaxDepth;
+
+    if (MaxLength < LZ_MIN_MATCH)
+        return 0;
+
+    Entry = Finder->Head[RtlpHashMatchFinder(Finder, Pos)];
+
+    while (Entry != 0 && Pos - (Entry - 1) <= MaxOffset && Depth-- != 0)
+    {
+        Candidate = Finder->Buffer + Entry - 1;
+
+        /* Only bother comparing when it could beat what we have */
+        if (Candidate[BestLength] == Current[BestLength] &&
+            Candidate[0] == Current[0] &&
+            Candidate[1] == Current[1])
+        {
+            for (Length = 2; Length < MaxLength && Candidate[Length] == Current[Length]; Length++);
+
+            if (Length > BestLength)
+            {
+                BestLength = Length;
+                *MatchOffset = Pos - (Entry - 1);
+                if (Length >= MaxLength || Length >= Finder->NiceLength)
+                    break;
+            }
+        }
+
+        Next = Finder->Prev[(Entry - 1) & Finder->WindowMask];
+        if (Next >= Entry)
+            break;
+        Entry = Next;
+    }
+
+    return (BestLength >= LZ_MIN_MATCH) ? BestLength : 0;
+}
+
+/* LZNT1 ********************************************************************/
+
+#define LZNT1_CHUNK_SIZE 0x1000
+#define LZNT1_HASH_BITS  12
+
+typedef struct _LZNT1_WORKSPACE
+{
+    ULONG Head[1 << LZNT1_HASH_BITS];
+    ULONG Prev[LZNT1_CHUNK_SIZE];
+} LZNT1_WORKSPACE, *PLZNT1_WORKSPACE;
+
+/* Matches in a chunk can't reach back before its start, and the split
+   between displacement and length bits depends on how far into the chunk
+   we are, just like in lznt1_decompress_chunk */
+FORCEINLINE
+ULONG
+RtlpLZNT1DisplacementBits(ULONG Pos)
+{
+    ULONG DisplacementBits;
+
+    for (DisplacementBits = 12; DisplacementBits > 4; DisplacementBits--)
+        if ((1UL << (DisplacementBits - 1)) < Pos) break;
+
+    return DisplacementBits;
+}
+
+FORCEINLINE
+ULONG
+RtlpLZNT1MaxLength(ULONG Pos, ULONG Remaining)
+{
+    ULONG MaxLength = (1 << (16 - RtlpLZNT1DisplacementBits(Pos))) - 1 + LZ_MIN_MATCH;
+
+    return min(MaxLength, Remaining);
+}
+
+/* Compresses one chunk into at most DstSize bytes, returns 0 if it doesn't fit */
+static ULONG
+RtlpCompressChunkLZNT1(PLZ_MATCH_FINDER Finder,
+                       ULONG ChunkStart,
+                       ULONG ChunkSize,
+                       PUCHAR Dst,
+                       ULONG DstSize)
+{
+    PUCHAR Src = Finder->Buffer + ChunkStart;
+    PUCHAR DstCur = Dst, DstEnd = Dst + DstSize;
+    PUCHAR FlagByte = NULL;
+    ULONG FlagCount = 8;
+    ULONG Pos = 0, Length, Offset, NextLength, NextOffset, i;
+
+    while (Pos < ChunkSize)
+    {
+        /* Every group of eight tokens starts with a flag byte */
+        if (FlagCount == 8)
+        {
+            if (DstCur >= DstEnd)
+                return 0;
+            FlagByte = DstCur++;
+            *FlagByte = 0;
+            FlagCount = 0;
+        }
+
+        Length = 0;
+        if (ChunkSize - Pos >= LZ_MIN_MATCH)
+        {
+            Length = RtlpFindMatch(Finder, ChunkStart + Pos,
+                                   RtlpLZNT1MaxLength(Pos, ChunkSize - Pos),
+                                   Pos, &Offset);
+            RtlpInsertMatchFinder(Finder, ChunkStart + Pos);
+
+            if (Length && Finder->Lazy && ChunkSize - Pos - 1 >= LZ_MIN_MATCH)
+            {
+                NextLength = RtlpFindMatch(Finder, ChunkStart + Pos + 1,
+                                           RtlpLZNT1MaxLength(Pos + 1, ChunkSize - Pos - 1),
+                                           Pos + 1, &NextOffset);
+                if (NextLength > Length)
+                {
+                    /* Better to start one byte later */
+                    Length = 0;
+                }
+            }
+        }
+
+        if (Length)
+        {
+            if (DstCur + sizeof(WORD) > DstEnd)
+                return 0;
+            *(WORD UNALIGNED *)DstCur = (WORD)(((Offset - 1) << (16 - RtlpLZNT1DisplacementBits(Pos))) |
+                                               (Length - LZ_MIN_MATCH));
+            DstCur += sizeof(WORD);
+            *FlagByte |= 1 << FlagCount;
+
+            for (i = 1; i < Length; i++)
+            {
+                if (ChunkSize - Pos - i >= LZ_MIN_MATCH)
+                    RtlpInsertMatchFinder(Finder, ChunkStart + Pos + i);
+            }
+            Pos += Length;
+        }
+        else
+        {
+            if (DstCur >= DstEnd)
+                return 0;
+            *DstCur++ = Src[Pos++];
+        }
+
+        FlagCount++;
+    }
+
+    return (ULONG)(DstCur - Dst);
+}
+
 static NTSTATUS
 RtlpCompressBufferLZNT1(UCHAR *src, ULONG src_size, UCHAR *dst, ULONG dst_size,
-                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace)
+                        ULONG chunk_size, ULONG *final_size, UCHAR *workspace,
+                        USHORT engine)
 {
-        UCHAR *src_cur = src, *src_end = src + src_size;
+        PLZNT1_WORKSPACE WorkSpace = (PLZNT1_WORKSPACE)workspace;
         UCHAR *dst_cur = dst, *dst_end = dst + dst_size;
-        ULONG block_size;
+        ULONG src_pos = 0, block_size, compressed_size;
+        LZ_MATCH_FINDER Finder;
+
+        RtlpInitializeMatchFinder(&Finder, src, WorkSpace->Head, LZNT1_HASH_BITS,
+                                  WorkSpace->Prev, LZNT1_CHUNK_SIZE, engine);
 
-        while (src_cur < src_end)
+        while (src_pos < src_size)
         {
             /* determine size of current chunk */
-            block_size = min(0x1000, src_end - src_cur);
-            if (dst_cur + sizeof(WORD) + block_size > dst_end)
+            block_size = min(LZNT1_CHUNK_SIZE, src_size - src_pos);
+            if (dst_cur + sizeof(WORD) >= dst_end)
                 return STATUS_BUFFER_TOO_SMALL;
 
-            /* write (uncompressed) chunk header */
-            *(WORD *)dst_cur = 0x3000 | (block_size - 1);
-            dst_cur += sizeof(WORD);
+            /* only keep the compressed chunk if it's actually smaller */
+            compressed_size = RtlpCompressChunkLZNT1(&Finder, src_pos, block_size,
+                                                     dst_cur + sizeof(WORD),
+                                                     min(block_size - 1, (ULONG)(dst_end - dst_cur - sizeof(WORD))));
+            if (compressed_size)
+            {
+                /* write compressed chunk header */
+                *(WORD *)dst_cur = 0xB000 | (compressed_size - 1);
+                dst_cur += sizeof(WORD) + compressed_size;
+            }
+            else
+            {
+                if (dst_cur + sizeof(WORD) + block_size > dst_end)
+                    return STATUS_BUFFER_TOO_SMALL;
 
-            /* write chunk content */
-            memcpy(dst_cur, src_cur, block_size);
-            dst_cur += block_size;
-            src_cur += block_size;
+                /* write (uncompressed) chunk header */
+                *(WORD *)dst_cur = 0x3000 | (block_size - 1);
+                dst_cur += sizeof(WORD);
+
+                /* write chunk content */
+                memcpy(dst_cur, src + src_pos, block_size);
+                dst_cur += block_size;
+            }
+
+            src_pos += block_size;
         }
 
         if (final_size)
@@ -253,22 +507,927 @@ RtlpWorkSpaceSizeLZNT1(USHORT Engine,
                        PULONG BufferAndWorkSpaceSize,
                        PULONG FragmentWorkSpaceSize)
 {
-   if (Engine == COMPRESSION_ENGINE_STANDARD)
+   C_ASSERT(sizeof(LZNT1_WORKSPACE) <= 0x8010);
+
+   if (Engine == COMPRESSION_ENGINE_STANDARD ||
+       Engine == COMPRESSION_ENGINE_MAXIMUM)
    {
       *BufferAndWorkSpaceSize = 0x8010;
       *FragmentWorkSpaceSize = 0x1000;
       return(STATUS_SUCCESS);
    }
-   else if (Engine == COMPRESSION_ENGINE_MAXIMUM)
-   {
-      *BufferAndWorkSpaceSize = 0x10;
-      *FragmentWorkSpaceSize = 0x1000;
-      return(STATUS_SUCCESS);
-   }
 
    return(STATUS_NOT_SUPPORTED);
 }
 
+/* Xpress ([MS-XCA] 2.3 and 2.4) *******************************************/
+
+#define XPRESS_WINDOW_SIZE 0x2000
+#define XPRESS_HASH_BITS   13
+
+typedef struct _XPRESS_WORKSPACE
+{
+    ULONG Head[1 << XPRESS_HASH_BITS];
+    ULONG Prev[XPRESS_WINDOW_SIZE];
+} XPRESS_WORKSPACE, *PXPRESS_WORKSPACE;
+
+static NTSTATUS
+RtlpCompressBufferXpress(PUCHAR Src,
+                         ULONG SrcSize,
+                         PUCHAR Dst,
+                         ULONG DstSize,
+                         PULONG FinalSize,
+                         PVOID WorkSpace,
+                         USHORT Engine)
+{
+    PXPRESS_WORKSPACE Xpress = WorkSpace;
+    PUCHAR DstCur = Dst, DstEnd = Dst + DstSize;
+    PUCHAR FlagPos, NibblePos = NULL;
+    ULONG Flags = 0, FlagCount = 0;
+    ULONG Pos = 0, Length, Offset, NextLength, NextOffset, Code, i;
+    LZ_MATCH_FINDER Finder;
+
+    RtlpInitializeMatchFinder(&Finder, Src, Xpress->Head, XPRESS_HASH_BITS,
+                              Xpress->Prev, XPRESS_WINDOW_SIZE, Engine);
+
+    /* Each token takes one bit in a 32-bit flag word placed in front of it */
+    if (DstSize < sizeof(ULONG))
+        return STATUS_BUFFER_TOO_SMALL;
+    FlagPos = DstCur;
+    DstCur += sizeof(ULONG);
+
+    while (Pos < SrcSize)
+    {
+        Length = 0;
+        if (SrcSize - Pos >= LZ_MIN_MATCH)
+        {
+            Length = RtlpFindMatch(&Finder, Pos, SrcSize - Pos, XPRESS_WINDOW_SIZE, &Offset);
+            RtlpInsertMatchFinder(&Finder, Pos);
+
+            if (Length && Finder.Lazy && SrcSize - Pos - 1 >= LZ_MIN_MATCH)
+            {
+                NextLength = RtlpFindMatch(&Finder, Pos + 1, SrcSize - Pos - 1,
+                                           XPRESS_WINDOW_SIZE, &NextOffset);
+                if (NextLength > Length)
+                    Length = 0;
+            }
+        }
+
+        if (Length)
+        {
+            /* Low 3 bits hold the length, longer ones spill into a shared
+               nibble, then a byte, then a word or a dword */
+            Code = Length - LZ_MIN_MATCH;
+            if (DstCur + sizeof(USHORT) > DstEnd)
+                return STATUS_BUFFER_TOO_SMALL;
+            *(USHORT UNALIGNED *)DstCur = (USHORT)(((Offset - 1) << 3) | min(Code, 7));
+            DstCur += sizeof(USHORT);
+
+            if (Code >= 7)
+            {
+                Code -= 7;
+                if (NibblePos == NULL)
+                {
+                    if (DstCur >= DstEnd)
+                        return STATUS_BUFFER_TOO_SMALL;
+                    NibblePos = DstCur++;
+                    *NibblePos = (UCHAR)min(Code, 15);
+                }
+                else
+                {
+                    *NibblePos |= (UCHAR)(min(Code, 15) << 4);
+                    NibblePos = NULL;
+                }
+
+                if (Code >= 15)
+                {
+                    Code -= 15;
+                    if (DstCur >= DstEnd)
+                        return STATUS_BUFFER_TOO_SMALL;
+                    if (Code < 255)
+                    {
+                        *DstCur++ = (UCHAR)Code;
+                    }
+                    else
+                    {
+                        *DstCur++ = 255;
+                        Code += 7 + 15;
+                        if (Code < 0x10000)
+                        {
+                            if (DstCur + sizeof(USHORT) > DstEnd)
+                                return STATUS_BUFFER_TOO_SMALL;
+                            *(USHORT UNALIGNED *)DstCur = (USHORT)Code;
+                            DstCur += sizeof(USHORT);
+                        }
+                        else
+                        {
+                            if (DstCur + sizeof(USHORT) + sizeof(ULONG) > DstEnd)
+                                return STATUS_BUFFER_TOO_SMALL;
+                            *(USHORT UNALIGNED *)DstCur = 0;
+                            *(ULONG UNALIGNED *)(DstCur + sizeof(USHORT)) = Code;
+                            DstCur += sizeof(USHORT) + sizeof(ULONG);
+                        }
+                    }
+                }
+            }
+
+            for (i = 1; i < Length; i++)
+            {
+                if (SrcSize - Pos - i >= LZ_MIN_MATCH)
+                    RtlpInsertMatchFinder(&Finder, Pos + i);
+            }
+
+            Flags = (Flags << 1) | 1;
+            Pos += Length;
+        }
+        else
+        {
+            if (DstCur >= DstEnd)
+                return STATUS_BUFFER_TOO_SMALL;
+            *DstCur++ = Src[Pos++];
+            Flags <<= 1;
+        }
+
+        if (++FlagCount == 32)
+        {
+            *(ULONG UNALIGNED *)FlagPos = Flags;
+            FlagCount = 0;
+            if (DstCur + sizeof(ULONG) > DstEnd)
+                return STATUS_BUFFER_TOO_SMALL;
+            FlagPos = DstCur;
+            DstCur += sizeof(ULONG);
+        }
+    }
+
+    /* Pad the last flag word with match flags, a match with no input left
+       is how the decoder knows it's done */
+    if (FlagCount == 0)
+        Flags = MAXULONG;
+    else
+        Flags = (Flags << (32 - FlagCount)) | ((1UL << (32 - FlagCount)) - 1);
+    *(ULONG UNALIGNED *)FlagPos = Flags;
+
+    *FinalSize = (ULONG)(DstCur - Dst);
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+RtlpDecompressBufferXpress(PUCHAR Dst,
+                           ULONG DstSize,
+                           PUCHAR Src,
+                           ULONG SrcSize,
+                           PULONG FinalSize)
+{
+    PUCHAR SrcCur = Src, SrcEnd = Src + SrcSize;
+    PUCHAR DstCur = Dst, DstEnd = Dst + DstSize;
+    PUCHAR NibblePos = NULL;
+    ULONG Flags = 0, FlagCount = 0;
+    ULONG Length, Offset;
+
+    for (;;)
+    {
+        if (FlagCount == 0)
+        {
+            if (SrcCur + sizeof(ULONG) > SrcEnd)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            Flags = *(ULONG UNALIGNED *)SrcCur;
+            SrcCur += sizeof(ULONG);
+            FlagCount = 32;
+        }
+
+        FlagCount--;
+        if (!(Flags & (1UL << FlagCount)))
+        {
+            if (SrcCur >= SrcEnd || DstCur >= DstEnd)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+            *DstCur++ = *SrcCur++;
+            continue;
+        }
+
+        if (SrcCur == SrcEnd)
+            break;
+
+        if (SrcCur + sizeof(USHORT) > SrcEnd)
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        Length = *(USHORT UNALIGNED *)SrcCur;
+        SrcCur += sizeof(USHORT);
+        Offset = (Length >> 3) + 1;
+        Length &= 7;
+
+        if (Length == 7)
+        {
+            if (NibblePos == NULL)
+            {
+                if (SrcCur >= SrcEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                NibblePos = SrcCur++;
+                Length = *NibblePos & 0x0F;
+            }
+            else
+            {
+                Length = *NibblePos >> 4;
+                NibblePos = NULL;
+            }
+
+            if (Length == 15)
+            {
+                if (SrcCur >= SrcEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                Length = *SrcCur++;
+                if (Length == 255)
+                {
+                    if (SrcCur + sizeof(USHORT) > SrcEnd)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length = *(USHORT UNALIGNED *)SrcCur;
+                    SrcCur += sizeof(USHORT);
+                    if (Length == 0)
+                    {
+                        if (SrcCur + sizeof(ULONG) > SrcEnd)
+                            return STATUS_BAD_COMPRESSION_BUFFER;
+                        Length = *(ULONG UNALIGNED *)SrcCur;
+                        SrcCur += sizeof(ULONG);
+                    }
+                    if (Length < 15 + 7)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length -= 15 + 7;
+                }
+                Length += 15;
+            }
+            Length += 7;
+        }
+        Length += LZ_MIN_MATCH;
+
+        if (Offset > (ULONG)(DstCur - Dst) || Length > (ULONG)(DstEnd - DstCur))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+
+        /* source and destination can overlap */
+        while (Length--)
+        {
+            *DstCur = *(DstCur - Offset);
+            DstCur++;
+        }
+    }
+
+    *FinalSize = (ULONG)(DstCur - Dst);
+    return STATUS_SUCCESS;
+}
+
+/* Xpress Huffman ([MS-XCA] 2.1 and 2.2) ************************************/
+
+#define XPRESS_HUFF_BLOCK_SIZE      0x10000
+#define XPRESS_HUFF_WINDOW_SIZE     0x10000
+#define XPRESS_HUFF_MAX_OFFSET      0xFFFF
+#define XPRESS_HUFF_HASH_BITS       14
+#define XPRESS_HUFF_SYMBOLS         512
+#define XPRESS_HUFF_EOF             256
+#define XPRESS_HUFF_TABLE_SIZE      (XPRESS_HUFF_SYMBOLS / 2)
+#define XPRESS_HUFF_MAX_CODE_LENGTH 15
+#define XPRESS_HUFF_FAST_BITS       9
+
+/* Tokens of a block: literals are below 256, matches have the offset in
+   the high word and the length minus 3 in the low one */
+#define XPRESS_HUFF_TOKEN_EOF       XPRESS_HUFF_EOF
+#define XPRESS_HUFF_TOKEN_MATCH(Offset, Length) (((Offset) << 16) | ((Length) - LZ_MIN_MATCH))
+
+typedef struct _XPRESS_HUFF_WORKSPACE
+{
+    ULONG Head[1 << XPRESS_HUFF_HASH_BITS];
+    ULONG Prev[XPRESS_HUFF_WINDOW_SIZE];
+    ULONG Tokens[XPRESS_HUFF_BLOCK_SIZE + 1];
+    ULONG Frequencies[XPRESS_HUFF_SYMBOLS];
+    USHORT Codes[XPRESS_HUFF_SYMBOLS];
+    UCHAR Lengths[XPRESS_HUFF_SYMBOLS];
+
+    /* Huffman tree, leaves first, then the internal nodes */
+    ULONG NodeFrequency[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT NodeParent[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT NodeDepth[2 * XPRESS_HUFF_SYMBOLS];
+    USHORT Heap[XPRESS_HUFF_SYMBOLS + 1];
+} XPRESS_HUFF_WORKSPACE, *PXPRESS_HUFF_WORKSPACE;
+
+/* The bit stream is made of 16-bit words read MSB first, with the extra
+   length bytes of matches stored in between. The decoder always has the
+   next two words loaded, so the slot of a word gets reserved as soon as
+   the one before it is started, anything written in the meantime goes
+   after it. */
+typedef struct _XPRESS_BIT_WRITER
+{
+    PUCHAR Current;
+    PUCHAR End;
+    PUCHAR Slots[2];
+    ULONG Bits;
+    ULONG BitCount;
+    BOOLEAN Overflow;
+} XPRESS_BIT_WRITER, *PXPRESS_BIT_WRITER;
+
+FORCEINLINE
+PUCHAR
+RtlpXpressReserve(PXPRESS_BIT_WRITER Writer, ULONG Size)
+{
+    PUCHAR Pos = Writer->Current;
+
+    if ((ULONG)(Writer->End - Writer->Current) < Size)
+    {
+        Writer->Overflow = TRUE;
+        return NULL;
+    }
+
+    Writer->Current += Size;
+    return Pos;
+}
+
+static VOID
+RtlpXpressStartBits(PXPRESS_BIT_WRITER Writer)
+{
+    Writer->Slots[0] = RtlpXpressReserve(Writer, sizeof(USHORT));
+    Writer->Slots[1] = RtlpXpressReserve(Writer, sizeof(USHORT));
+    Writer->Bits = 0;
+    Writer->BitCount = 0;
+}
+
+FORCEINLINE
+VOID
+RtlpXpressWriteBits(PXPRESS_BIT_WRITER Writer, ULONG Count, ULONG Value)
+{
+    if (Count == 0 || Writer->Overflow)
+        return;
+
+    if (Writer->Slots[1] == NULL)
+        Writer->Slots[1] = RtlpXpressReserve(Writer, sizeof(USHORT));
+
+    Writer->Bits = (Writer->Bits << Count) | Value;
+    Writer->BitCount += Count;
+
+    if (Writer->BitCount >= 16)
+    {
+        Writer->BitCount -= 16;
+        *(USHORT UNALIGNED *)Writer->Slots[0] = (USHORT)(Writer->Bits >> Writer->BitCount);
+        Writer->Slots[0] = Writer->Slots[1];
+        Writer->Slots[1] = NULL;
+
+        if (Writer->BitCount != 0)
+            Writer->Slots[1] = RtlpXpressReserve(Writer, sizeof(USHORT));
+    }
+}
+
+FORCEINLINE
+VOID
+RtlpXpressWriteByte(PXPRESS_BIT_WRITER Writer, UCHAR Value)
+{
+    PUCHAR Pos = RtlpXpressReserve(Writer, sizeof(UCHAR));
+
+    if (Pos)
+        *Pos = Value;
+}
+
+static VOID
+RtlpXpressFlushBits(PXPRESS_BIT_WRITER Writer)
+{
+    if (Writer->Overflow)
+        return;
+
+    *(USHORT UNALIGNED *)Writer->Slots[0] = (USHORT)(Writer->Bits << (16 - Writer->BitCount));
+    if (Writer->Slots[1])
+        *(USHORT UNALIGNED *)Writer->Slots[1] = 0;
+}
+
+static VOID
+RtlpXpressHeapPush(PXPRESS_HUFF_WORKSPACE Huff, PULONG HeapSize, USHORT Node)
+{
+    ULONG i = ++*HeapSize;
+
+    while (i > 1 && Huff->NodeFrequency[Huff->Heap[i / 2]] > Huff->NodeFrequency[Node])
+    {
+        Huff->Heap[i] = Huff->Heap[i / 2];
+        i /= 2;
+    }
+    Huff->Heap[i] = Node;
+}
+
+static USHORT
+RtlpXpressHeapPop(PXPRESS_HUFF_WORKSPACE Huff, PULONG HeapSize)
+{
+    USHORT Top = Huff->Heap[1], Last = Huff->Heap[(*HeapSize)--];
+    ULONG i = 1, Child;
+
+    while ((Child = 2 * i) <= *HeapSize)
+    {
+        if (Child < *HeapSize &&
+            Huff->NodeFrequency[Huff->Heap[Child + 1]] < Huff->NodeFrequency[Huff->Heap[Child]])
+            Child++;
+        if (Huff->NodeFrequency[Last] <= Huff->NodeFrequency[Huff->Heap[Child]])
+            break;
+        Huff->Heap[i] = Huff->Heap[Child];
+        i = Child;
+    }
+    Huff->Heap[i] = Last;
+
+    return Top;
+}
+
+/* Builds canonical codes of at most 15 bits from the block's frequencies.
+   Frequencies get flattened until the tree is shallow enough. */
+static VOID
+RtlpXpressBuildCodes(PXPRESS_HUFF_WORKSPACE Huff)
+{
+    ULONG LengthCount[XPRESS_HUFF_MAX_CODE_LENGTH + 1];
+    USHORT NextCode[XPRESS_HUFF_MAX_CODE_LENGTH + 1];
+    ULONG HeapSize, Nodes, MaxLength, Used, i;
+    PUSHORT Depth = Huff->NodeDepth;
+    USHORT A, B;
+
+    /* The decoder needs a complete code, so use at least two symbols */
+    for (i = 0, Used = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        Used += (Huff->Frequencies[i] != 0);
+    for (i = 0; Used < 2; i++)
+    {
+        if (Huff->Frequencies[i] == 0)
+        {
+            Huff->Frequencies[i] = 1;
+            Used++;
+        }
+    }
+
+    for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        Huff->NodeFrequency[i] = Huff->Frequencies[i];
+
+    for (;;)
+    {
+        HeapSize = 0;
+        for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        {
+            if (Huff->NodeFrequency[i])
+                RtlpXpressHeapPush(Huff, &HeapSize, (USHORT)i);
+        }
+
+        Nodes = XPRESS_HUFF_SYMBOLS;
+        while (HeapSize > 1)
+        {
+            A = RtlpXpressHeapPop(Huff, &HeapSize);
+            B = RtlpXpressHeapPop(Huff, &HeapSize);
+            Huff->NodeFrequency[Nodes] = Huff->NodeFrequency[A] + Huff->NodeFrequency[B];
+            Huff->NodeParent[A] = Huff->NodeParent[B] = (USHORT)Nodes;
+            RtlpXpressHeapPush(Huff, &HeapSize, (USHORT)Nodes);
+            Nodes++;
+        }
+
+        /* Parents always come after their children */
+        Depth[Nodes - 1] = 0;
+        for (i = Nodes - 1; i-- > XPRESS_HUFF_SYMBOLS;)
+            Depth[i] = Depth[Huff->NodeParent[i]] + 1;
+
+        MaxLength = 0;
+        for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        {
+            if (Huff->NodeFrequency[i])
+            {
+                Depth[i] = Depth[Huff->NodeParent[i]] + 1;
+                MaxLength = max(MaxLength, Depth[i]);
+            }
+            else
+            {
+                Depth[i] = 0;
+            }
+        }
+
+        if (MaxLength <= XPRESS_HUFF_MAX_CODE_LENGTH)
+            break;
+
+        for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        {
+            if (Huff->NodeFrequency[i])
+                Huff->NodeFrequency[i] = (Huff->NodeFrequency[i] >> 1) | 1;
+        }
+    }
+
+    RtlZeroMemory(LengthCount, sizeof(LengthCount));
+    for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+    {
+        Huff->Lengths[i] = (UCHAR)Depth[i];
+        LengthCount[Depth[i]]++;
+    }
+
+    /* Shorter codes first, then by symbol, which is what the decoder expects */
+    LengthCount[0] = 0;
+    NextCode[0] = 0;
+    for (i = 1; i <= XPRESS_HUFF_MAX_CODE_LENGTH; i++)
+        NextCode[i] = (USHORT)((NextCode[i - 1] + LengthCount[i - 1]) << 1);
+
+    for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+    {
+        if (Huff->Lengths[i])
+            Huff->Codes[i] = NextCode[Huff->Lengths[i]]++;
+    }
+}
+
+FORCEINLINE
+ULONG
+RtlpXpressHighBit(ULONG Value)
+{
+    ULONG Bit = 0;
+
+    while (Value >>= 1)
+        Bit++;
+
+    return Bit;
+}
+
+/* Finds the matches of one block, counting the symbols as it goes */
+static ULONG
+RtlpXpressHuffTokenize(PXPRESS_HUFF_WORKSPACE Huff,
+                       PLZ_MATCH_FINDER Finder,
+                       ULONG BlockStart,
+                       ULONG BlockEnd,
+                       BOOLEAN Last)
+{
+    ULONG Pos = BlockStart, TokenCount = 0;
+    ULONG Length, Offset, NextLength, NextOffset, Symbol, i;
+
+    RtlZeroMemory(Huff->Frequencies, sizeof(Huff->Frequencies));
+
+    while (Pos < BlockEnd)
+    {
+        Length = 0;
+        if (BlockEnd - Pos >= LZ_MIN_MATCH)
+        {
+            Length = RtlpFindMatch(Finder, Pos, BlockEnd - Pos, XPRESS_HUFF_MAX_OFFSET, &Offset);
+            RtlpInsertMatchFinder(Finder, Pos);
+
+            if (Length && Finder->Lazy && BlockEnd - Pos - 1 >= LZ_MIN_MATCH)
+            {
+                NextLength = RtlpFindMatch(Finder, Pos + 1, BlockEnd - Pos - 1,
+                                           XPRESS_HUFF_MAX_OFFSET, &NextOffset);
+                if (NextLength > Length)
+                    Length = 0;
+            }
+
+            /* Symbol 256 is kept for the end of the stream */
+            if (Length == LZ_MIN_MATCH && Offset == 1)
+                Length = 0;
+        }
+
+        if (Length)
+        {
+            Symbol = 256 + (RtlpXpressHighBit(Offset) << 4) + min(Length - LZ_MIN_MATCH, 15);
+            Huff->Tokens[TokenCount++] = XPRESS_HUFF_TOKEN_MATCH(Offset, Length);
+
+            for (i = 1; i < Length; i++)
+            {
+                if (BlockEnd - Pos - i >= LZ_MIN_MATCH)
+                    RtlpInsertMatchFinder(Finder, Pos + i);
+            }
+            Pos += Length;
+        }
+        else
+        {
+            Symbol = Finder->Buffer[Pos++];
+            Huff->Tokens[TokenCount++] = Symbol;
+        }
+
+        Huff->Frequencies[Symbol]++;
+    }
+
+    if (Last)
+    {
+        Huff->Tokens[TokenCount++] = XPRESS_HUFF_TOKEN_EOF;
+        Huff->Frequencies[XPRESS_HUFF_EOF]++;
+    }
+
+    return TokenCount;
+}
+
+static NTSTATUS
+RtlpCompressBufferXpressHuff(PUCHAR Src,
+                             ULONG SrcSize,
+                             PUCHAR Dst,
+                             ULONG DstSize,
+                             PULONG FinalSize,
+                             PVOID WorkSpace,
+                             USHORT Engine)
+{
+    PXPRESS_HUFF_WORKSPACE Huff = WorkSpace;
+    XPRESS_BIT_WRITER Writer;
+    LZ_MATCH_FINDER Finder;
+    ULONG BlockStart = 0, BlockEnd, TokenCount;
+    ULONG Token, Offset, Length, OffsetBits, Symbol, i;
+    BOOLEAN Last;
+    PUCHAR Table;
+
+    RtlpInitializeMatchFinder(&Finder, Src, Huff->Head, XPRESS_HUFF_HASH_BITS,
+                              Huff->Prev, XPRESS_HUFF_WINDOW_SIZE, Engine);
+
+    Writer.Current = Dst;
+    Writer.End = Dst + DstSize;
+    Writer.Overflow = FALSE;
+
+    /* The end of stream symbol goes into the first block that isn't full,
+       so an input of a multiple of 64K ends with a block of its own */
+    do
+    {
+        BlockEnd = min(BlockStart + XPRESS_HUFF_BLOCK_SIZE, SrcSize);
+        Last = (BlockEnd - BlockStart < XPRESS_HUFF_BLOCK_SIZE);
+
+        TokenCount = RtlpXpressHuffTokenize(Huff, &Finder, BlockStart, BlockEnd, Last);
+        RtlpXpressBuildCodes(Huff);
+
+        Table = RtlpXpressReserve(&Writer, XPRESS_HUFF_TABLE_SIZE);
+        if (Table == NULL)
+            return STATUS_BUFFER_TOO_SMALL;
+        for (i = 0; i < XPRESS_HUFF_TABLE_SIZE; i++)
+            Table[i] = Huff->Lengths[2 * i] | (Huff->Lengths[2 * i + 1] << 4);
+
+        RtlpXpressStartBits(&Writer);
+
+        for (i = 0; i < TokenCount && !Writer.Overflow; i++)
+        {
+            Token = Huff->Tokens[i];
+            if (Token <= XPRESS_HUFF_TOKEN_EOF)
+            {
+                RtlpXpressWriteBits(&Writer, Huff->Lengths[Token], Huff->Codes[Token]);
+                continue;
+            }
+
+            Offset = Token >> 16;
+            Length = Token & 0xFFFF;
+            OffsetBits = RtlpXpressHighBit(Offset);
+            Symbol = 256 + (OffsetBits << 4) + min(Length, 15);
+
+            RtlpXpressWriteBits(&Writer, Huff->Lengths[Symbol], Huff->Codes[Symbol]);
+
+            if (Length >= 15)
+            {
+                if (Length - 15 < 255)
+                {
+                    RtlpXpressWriteByte(&Writer, (UCHAR)(Length - 15));
+                }
+                else
+                {
+                    RtlpXpressWriteByte(&Writer, 255);
+                    RtlpXpressWriteByte(&Writer, (UCHAR)Length);
+                    RtlpXpressWriteByte(&Writer, (UCHAR)(Length >> 8));
+                }
+            }
+
+            RtlpXpressWriteBits(&Writer, OffsetBits, Offset & ((1 << OffsetBits) - 1));
+        }
+
+        RtlpXpressFlushBits(&Writer);
+        if (Writer.Overflow)
+            return STATUS_BUFFER_TOO_SMALL;
+
+        BlockStart = BlockEnd;
+    } while (!Last);
+
+    *FinalSize = (ULONG)(Writer.Current - Dst);
+    return STATUS_SUCCESS;
+}
+
+typedef struct _XPRESS_BIT_READER
+{
+    PUCHAR Current;
+    PUCHAR End;
+    ULONG Bits;
+    LONG ExtraBits;
+} XPRESS_BIT_READER, *PXPRESS_BIT_READER;
+
+/* Reading past the end gives zeros, callers check the position */
+FORCEINLINE
+ULONG
+RtlpXpressReadWord(PXPRESS_BIT_READER Reader)
+{
+    ULONG Word = 0;
+
+    if (Reader->Current + sizeof(USHORT) <= Reader->End)
+        Word = *(USHORT UNALIGNED *)Reader->Current;
+    Reader->Current += sizeof(USHORT);
+
+    return Word;
+}
+
+FORCEINLINE
+VOID
+RtlpXpressSkipBits(PXPRESS_BIT_READER Reader, ULONG Count)
+{
+    Reader->Bits <<= Count;
+    Reader->ExtraBits -= Count;
+    if (Reader->ExtraBits < 0)
+    {
+        Reader->Bits |= RtlpXpressReadWord(Reader) << -Reader->ExtraBits;
+        Reader->ExtraBits += 16;
+    }
+}
+
+/* The decoding tables live on the stack, so rather than a table indexed
+   by 15 bits, the short codes are looked up directly and the long ones
+   are walked canonically */
+typedef struct _XPRESS_HUFF_DECODER
+{
+    USHORT Fast[1 << XPRESS_HUFF_FAST_BITS];
+    USHORT Sorted[XPRESS_HUFF_SYMBOLS];
+    USHORT LengthCount[XPRESS_HUFF_MAX_CODE_LENGTH + 1];
+} XPRESS_HUFF_DECODER, *PXPRESS_HUFF_DECODER;
+
+#define XPRESS_HUFF_CODE_LENGTH(Table, Symbol) \
+    (((Symbol) & 1) ? ((Table)[(Symbol) / 2] >> 4) : ((Table)[(Symbol) / 2] & 0x0F))
+
+static BOOLEAN
+RtlpXpressBuildDecoder(PXPRESS_HUFF_DECODER Decoder, PUCHAR Table)
+{
+    ULONG Code, Length, Symbol, Index, Space, i;
+
+    RtlZeroMemory(Decoder->LengthCount, sizeof(Decoder->LengthCount));
+    for (i = 0; i < XPRESS_HUFF_SYMBOLS; i++)
+        Decoder->LengthCount[XPRESS_HUFF_CODE_LENGTH(Table, i)]++;
+
+    /* Refuse oversubscribed codes */
+    Space = 1 << XPRESS_HUFF_MAX_CODE_LENGTH;
+    for (Length = 1; Length <= XPRESS_HUFF_MAX_CODE_LENGTH; Length++)
+    {
+        if (Decoder->LengthCount[Length] << (XPRESS_HUFF_MAX_CODE_LENGTH - Length) > Space)
+            return FALSE;
+        Space -= Decoder->LengthCount[Length] << (XPRESS_HUFF_MAX_CODE_LENGTH - Length);
+    }
+
+    /* Zero means the code is longer than the fast bits, or unused */
+    RtlZeroMemory(Decoder->Fast, sizeof(Decoder->Fast));
+
+    Code = 0;
+    Index = 0;
+    for (Length = 1; Length <= XPRESS_HUFF_MAX_CODE_LENGTH; Length++)
+    {
+        for (Symbol = 0; Symbol < XPRESS_HUFF_SYMBOLS; Symbol++)
+        {
+            if (XPRESS_HUFF_CODE_LENGTH(Table, Symbol) != Length)
+                continue;
+
+            Decoder->Sorted[Index++] = (USHORT)Symbol;
+            if (Length <= XPRESS_HUFF_FAST_BITS)
+            {
+                for (i = 0; i < (1UL << (XPRESS_HUFF_FAST_BITS - Length)); i++)
+                {
+                    Decoder->Fast[(Code << (XPRESS_HUFF_FAST_BITS - Length)) + i] =
+                        (USHORT)((Length << 9) | Symbol);
+                }
+            }
+            Code++;
+        }
+        Code <<= 1;
+    }
+
+    return TRUE;
+}
+
+/* Returns the next symbol, or MAXULONG for a code that isn't assigned */
+FORCEINLINE
+ULONG
+RtlpXpressDecodeSymbol(PXPRESS_HUFF_DECODER Decoder, PXPRESS_BIT_READER Reader)
+{
+    ULONG Entry, Code, First, Index, Length, Count;
+
+    Entry = Decoder->Fast[Reader->Bits >> (32 - XPRESS_HUFF_FAST_BITS)];
+    if (Entry != 0)
+    {
+        RtlpXpressSkipBits(Reader, Entry >> 9);
+        return Entry & 0x1FF;
+    }
+
+    Code = 0;
+    First = 0;
+    Index = 0;
+    for (Length = 1; Length <= XPRESS_HUFF_MAX_CODE_LENGTH; Length++)
+    {
+        Code |= (Reader->Bits >> (32 - Length)) & 1;
+        Count = Decoder->LengthCount[Length];
+        if (Code - First < Count)
+        {
+            RtlpXpressSkipBits(Reader, Length);
+            return Decoder->Sorted[Index + Code - First];
+        }
+        Index += Count;
+        First = (First + Count) << 1;
+        Code <<= 1;
+    }
+
+    return MAXULONG;
+}
+
+static NTSTATUS
+RtlpDecompressBufferXpressHuff(PUCHAR Dst,
+                               ULONG DstSize,
+                               PUCHAR Src,
+                               ULONG SrcSize,
+                               PULONG FinalSize)
+{
+    XPRESS_HUFF_DECODER Decoder;
+    XPRESS_BIT_READER Reader;
+    PUCHAR SrcCur = Src, SrcEnd = Src + SrcSize;
+    PUCHAR DstCur = Dst, DstEnd = Dst + DstSize, BlockEnd;
+    ULONG Symbol, Length, OffsetBits, Offset;
+
+    /* A stream may also just stop at the end of a full block */
+    while (SrcCur < SrcEnd)
+    {
+        if ((ULONG)(SrcEnd - SrcCur) < XPRESS_HUFF_TABLE_SIZE + 2 * sizeof(USHORT))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+
+        if (!RtlpXpressBuildDecoder(&Decoder, SrcCur))
+            return STATUS_BAD_COMPRESSION_BUFFER;
+
+        Reader.Current = SrcCur + XPRESS_HUFF_TABLE_SIZE;
+        Reader.End = SrcEnd;
+        Reader.Bits = RtlpXpressReadWord(&Reader) << 16;
+        Reader.Bits |= RtlpXpressReadWord(&Reader);
+        Reader.ExtraBits = 16;
+
+        BlockEnd = DstCur + min(XPRESS_HUFF_BLOCK_SIZE, (ULONG_PTR)(DstEnd - DstCur) + 1);
+
+        while (DstCur < BlockEnd)
+        {
+            Symbol = RtlpXpressDecodeSymbol(&Decoder, &Reader);
+            if (Symbol == MAXULONG)
+                return STATUS_BAD_COMPRESSION_BUFFER;
+
+            if (Symbol < 256)
+            {
+                if (DstCur >= DstEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                *DstCur++ = (UCHAR)Symbol;
+                continue;
+            }
+
+            if (Symbol == XPRESS_HUFF_EOF && Reader.Current >= SrcEnd)
+            {
+                *FinalSize = (ULONG)(DstCur - Dst);
+                return STATUS_SUCCESS;
+            }
+
+            Symbol -= 256;
+            Length = Symbol & 0x0F;
+            OffsetBits = Symbol >> 4;
+
+            if (Length == 15)
+            {
+                if (Reader.Current >= SrcEnd)
+                    return STATUS_BAD_COMPRESSION_BUFFER;
+                Length = *Reader.Current++;
+                if (Length == 255)
+                {
+                    if (Reader.Current + sizeof(USHORT) > SrcEnd)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length = *(USHORT UNALIGNED *)Reader.Current;
+                    Reader.Current += sizeof(USHORT);
+                    if (Length < 15)
+                        return STATUS_BAD_COMPRESSION_BUFFER;
+                    Length -= 15;
+                }
+                Length += 15;
+            }
+            Length += LZ_MIN_MATCH;
+
+            Offset = (OffsetBits ? (Reader.Bits >> (32 - OffsetBits)) : 0) + (1 << OffsetBits);
+            RtlpXpressSkipBits(&Reader, OffsetBits);
+
+            if (Offset > (ULONG)(DstCur - Dst) || Length > (ULONG)(DstEnd - DstCur))
+                return STATUS_BAD_COMPRESSION_BUFFER;
+
+            /* source and destination can overlap */
+            while (Length--)
+            {
+                *DstCur = *(DstCur - Offset);
+                DstCur++;
+            }
+        }
+
+        if (Reader.Current > SrcEnd)
+            return STATUS_BAD_COMPRESSION_BUFFER;
+        SrcCur = Reader.Current;
+    }
+
+    *FinalSize = (ULONG)(DstCur - Dst);
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+RtlpWorkSpaceSizeXpress(USHORT Format,
+                        USHORT Engine,
+                        PULONG BufferAndWorkSpaceSize,
+                        PULONG FragmentWorkSpaceSize)
+{
+    if (Engine != COMPRESSION_ENGINE_STANDARD &&
+        Engine != COMPRESSION_ENGINE_MAXIMUM)
+        return STATUS_NOT_SUPPORTED;
+
+    if (Format == COMPRESSION_FORMAT_XPRESS)
+        *BufferAndWorkSpaceSize = sizeof(XPRESS_WORKSPACE);
+    else
+        *BufferAndWorkSpaceSize = sizeof(XPRESS_HUFF_WORKSPACE);
+
+    /* Both are decompressed in place */
+    *FragmentWorkSpaceSize = 0;
+    return STATUS_SUCCESS;
+}
+
+
 
 /*
  * @implemented
@@ -284,12 +1443,20 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                   IN PVOID WorkSpace)
 {
    USHORT Format = CompressionFormatAndEngine & COMPRESSION_FORMAT_MASK;
-   /* USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK; */
+   USHORT Engine = CompressionFormatAndEngine & COMPRESSION_ENGINE_MASK;
 
    if ((Format == COMPRESSION_FORMAT_NONE) ||
          (Format == COMPRESSION_FORMAT_DEFAULT))
       return(STATUS_INVALID_PARAMETER);
 
+   if (Engine != COMPRESSION_ENGINE_STANDARD &&
+       Engine != COMPRESSION_ENGINE_MAXIMUM)
+      return(STATUS_NOT_SUPPORTED);
+
+   /* The match finders keep their tables in the workspace */
+   if (WorkSpace == NULL)
+      return(STATUS_INVALID_PARAMETER);
+
    if (Format == COMPRESSION_FORMAT_LZNT1)
       return(RtlpCompressBufferLZNT1(UncompressedBuffer,
                                      UncompressedBufferSize,
@@ -297,7 +1464,26 @@ RtlCompressBuffer(IN USHORT CompressionFormatAndEngine,
                                      CompressedBufferSize,
                                      UncompressedChunkSize,
                                      FinalCompressedSize,
-                                     WorkSpace));
+                                     WorkSpace,
+                                     Engine));
+
+   if (Format == COMPRESSION_FORMAT_XPRESS)
+      return(RtlpCompressBufferXpress(UncompressedBuffer,
+                                      UncompressedBufferSize,
+                                      CompressedBuffer,
+                                      CompressedBufferSize,
+                                      FinalCompressedSize,
+                                      WorkSpace,
+                                      Engine));
+
+   if (Format == COMPRESSION_FORMAT_XPRESS_HUFF)
+      return(RtlpCompressBufferXpressHuff(UncompressedBuffer,
+                                          UncompressedBufferSize,
+                                          CompressedBuffer,
+                                          CompressedBufferSize,
+                                          FinalCompressedSize,
+                                          WorkSpace,
+                                          Engine));
 
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
@@ -378,8 +1564,32 @@ RtlDecompressBuffer(IN USHORT CompressionFormat,
                     IN ULONG CompressedBufferSize,
                     OUT PULONG FinalUncompressedSize)
 {
-    return RtlDecompressFragment(CompressionFormat, UncompressedBuffer, UncompressedBufferSize,
-                                 CompressedBuffer, CompressedBufferSize, 0, FinalUncompressedSize, NULL);
+    ULONG FinalSize;
+    NTSTATUS Status;
+
+    /* Xpress streams can't be entered in the middle, so they don't go
+       through RtlDecompressFragment */
+    switch (CompressionFormat & COMPRESSION_FORMAT_MASK)
+    {
+        case COMPRESSION_FORMAT_XPRESS:
+            Status = RtlpDecompressBufferXpress(UncompressedBuffer, UncompressedBufferSize,
+                                                CompressedBuffer, CompressedBufferSize, &FinalSize);
+            break;
+
+        case COMPRESSION_FORMAT_XPRESS_HUFF:
+            Status = RtlpDecompressBufferXpressHuff(UncompressedBuffer, UncompressedBufferSize,
+                                                    CompressedBuffer, CompressedBufferSize, &FinalSize);
+            break;
+
+        default:
+            return RtlDecompressFragment(CompressionFormat, UncompressedBuffer, UncompressedBufferSize,
+                                         CompressedBuffer, CompressedBufferSize, 0, FinalUncompressedSize, NULL);
+    }
+
+    if (NT_SUCCESS(Status) && FinalUncompressedSize)
+        *FinalUncompressedSize = FinalSize;
+
+    return Status;
 }
 
 /*
@@ -417,6 +1627,13 @@ RtlGetCompressionWorkSpaceSize(IN USHORT CompressionFormatAndEngine,
                                     CompressBufferAndWorkSpaceSize,
                                     CompressFragmentWorkSpaceSize));
 
+   if (Format == COMPRESSION_FORMAT_XPRESS ||
+       Format == COMPRESSION_FORMAT_XPRESS_HUFF)
+      return(RtlpWorkSpaceSizeXpress(Format,
+                                     Engine,
+                                     CompressBufferAndWorkSpaceSize,
+                                     CompressFragmentWorkSpaceSize));
+
    return(STATUS_UNSUPPORTED_COMPRESSION);
 }
 
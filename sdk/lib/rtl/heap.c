@@ -1577,6 +1577,9 @@ RtlDestroyHeap(HANDLE HeapPtr) /* [in] Handle of heap */
                             MEM_RELEASE);
     }
 
+    /* Release the front-end heap */
+    RtlpDestroyLowFragHeap(Heap);
+
     /* Delete tags and remove heap from the process heaps list in user mode */
     if (RtlpGetMode() == UserMode)
     {
@@ -1977,6 +1980,29 @@ RtlAllocateHeap(IN PVOID HeapPtr,
 
     Index = AllocationSize >> HEAP_ENTRY_SHIFT;
 
+    /* Small blocks without extra stuff may come from the front-end heap,
+       which doesn't need the heap lock */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_END_LFH &&
+        Index < HEAP_LFH_BUCKETS &&
+        !(EntryFlags & HEAP_ENTRY_EXTRA_PRESENT))
+    {
+        InUseEntry = RtlpLowFragHeapAllocate(Heap, Index);
+        if (InUseEntry)
+        {
+            /* Initialize this block, it's still busy from the back-end's view */
+            InUseEntry->Flags = EntryFlags | (InUseEntry->Flags & HEAP_ENTRY_LAST_ENTRY);
+            InUseEntry->UnusedBytes = (UCHAR)(AllocationSize - Size);
+            InUseEntry->SmallTagIndex = 0;
+
+            /* Zero memory if that was requested */
+            if (Flags & HEAP_ZERO_MEMORY)
+                RtlZeroMemory(InUseEntry + 1, Size);
+
+            /* User data starts right after the entry's header */
+            return InUseEntry + 1;
+        }
+    }
+
     /* Acquire the lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2180,6 +2206,17 @@ BOOLEAN NTAPI RtlFreeHeap(
     if (RtlpHeapIsSpecial(Flags))
         return RtlDebugFreeHeap(Heap, Flags, Ptr);
 
+    /* Get pointer to the heap entry */
+    HeapEntry = (PHEAP_ENTRY)Ptr - 1;
+
+    /* Give small blocks to the front-end heap if it's active */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_END_LFH &&
+        (((ULONG_PTR)Ptr & 0x7) == 0) &&
+        RtlpLowFragHeapFree(Heap, HeapEntry))
+    {
+        return TRUE;
+    }
+
     /* Lock if necessary */
     if (!(Flags & HEAP_NO_SERIALIZE))
     {
@@ -2187,13 +2224,13 @@ BOOLEAN NTAPI RtlFreeHeap(
         Locked = TRUE;
     }
 
-    /* Get pointer to the heap entry */
-    HeapEntry = (PHEAP_ENTRY)Ptr - 1;
-
-    /* Check this entry, fail if it's invalid */
+    /* Check this entry, fail if it's invalid or already cached by the front-end */
     if (!(HeapEntry->Flags & HEAP_ENTRY_BUSY) ||
         (((ULONG_PTR)Ptr & 0x7) != 0) ||
-        (HeapEntry->SegmentOffset >= HEAP_SEGMENTS))
+        (HeapEntry->SegmentOffset >= HEAP_SEGMENTS) ||
+        (Heap->FrontEndHeapType == HEAP_FRONT_END_LFH &&
+         !(HeapEntry->Flags & HEAP_ENTRY_VIRTUAL_ALLOC) &&
+         HeapEntry->UnusedBytes == 0))
     {
         /* This is an invalid block */
         DPRINT1("HEAP: Trying to free an invalid address %p!\n", Ptr);
@@ -3918,13 +3955,18 @@ RtlSetHeapInformation(IN HANDLE HeapHandle OPTIONAL,
         }
 
         /* Check for a special magic value for enabling LFH */
-        if (*(PULONG)HeapInformation != 2)
+        if (*(PULONG)HeapInformation != HEAP_FRONT_END_LFH || !HeapHandle)
         {
             return STATUS_UNSUCCESSFUL;
         }
 
-        DPRINT1("RtlSetHeapInformation() needs to enable LFH\n");
-        return STATUS_SUCCESS;
+        /* Page heaps have their own allocator */
+        if (((PHEAP)HeapHandle)->ForceFlags & HEAP_FLAG_PAGE_ALLOCS)
+        {
+            return STATUS_UNSUCCESSFUL;
+        }
+
+        return RtlpActivateLowFragHeap((PHEAP)HeapHandle);
     }
 
     return STATUS_SUCCESS;
@@ -3954,6 +3996,17 @@ RtlQueryHeapInformation(HANDLE HeapHandle,
             return STATUS_BUFFER_TOO_SMALL;
         }
 
+        /* Return front end heap counters if there is room for them */
+        if (HeapInformationLength >= sizeof(RTL_HEAP_FRONT_END_INFORMATION))
+        {
+            RtlpQueryLowFragHeapCounters(Heap, HeapInformation);
+
+            if (ReturnLength)
+                *ReturnLength = sizeof(RTL_HEAP_FRONT_END_INFORMATION);
+
+            return STATUS_SUCCESS;
+        }
+
         /* Return front end heap type */
         *(PULONG)HeapInformation = Heap->FrontEndHeapType;
 
@@ -55,6 +55,17 @@
 /* Segment flags */
 #define HEAP_USER_ALLOCATED    0x1
 
+/* Front-end heap types (HEAP::FrontEndHeapType) */
+#define HEAP_FRONT_END_NONE    0
+#define HEAP_FRONT_END_LFH     2
+
+/* Low fragmentation front-end heap parameters */
+#define HEAP_LFH_BUCKETS          HEAP_FREELISTS
+#define HEAP_LFH_AFFINITY_SLOTS   4
+#define HEAP_LFH_SLOT_CACHE_SIZE  0x2000
+#define HEAP_LFH_MIN_DEPTH        4
+#define HEAP_LFH_MAX_DEPTH        64
+
 /* A handy inline to distinguis normal heap, special "debug heap" and special "page heap" */
 FORCEINLINE BOOLEAN
 RtlpHeapIsSpecial(ULONG Flags)
@@ -203,6 +214,21 @@ typedef struct _HEAP_LIST_LOOKUP
     PLIST_ENTRY *ListHints;
 } HEAP_LIST_LOOKUP, *PHEAP_LIST_LOOKUP;
 
+typedef struct _HEAP_LFH_SLOT
+{
+    SLIST_HEADER ListHead;
+    LONG AllocateHits;
+    LONG AllocateMisses;
+    LONG FreeHits;
+    LONG FreeMisses;
+} HEAP_LFH_SLOT, *PHEAP_LFH_SLOT;
+
+typedef struct _HEAP_LFH
+{
+    /* One cache per block size (in HEAP_ENTRY units) and affinity slot */
+    HEAP_LFH_SLOT Slots[HEAP_LFH_BUCKETS][HEAP_LFH_AFFINITY_SLOTS];
+} HEAP_LFH, *PHEAP_LFH;
+
 typedef struct _HEAP
 {
     HEAP_ENTRY Entry;
@@ -352,6 +378,25 @@ RtlpValidateHeapEntry(PHEAP Heap, PHEAP_ENTRY HeapEntry);
 BOOLEAN NTAPI
 RtlpValidateHeapHeaders(PHEAP Heap, BOOLEAN Recalculate);
 
+/* heaplfh.c */
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap);
+
+VOID NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap);
+
+PHEAP_ENTRY NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        SIZE_T Index);
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry);
+
+VOID NTAPI
+RtlpQueryLowFragHeapCounters(PHEAP Heap,
+                             PRTL_HEAP_FRONT_END_INFORMATION Information);
+
 /* heapdbg.c */
 HANDLE NTAPI
 RtlDebugCreateHeap(ULONG Flags,
@@ -0,0 +1,239 @@
+/*
+ * COPYRIGHT:       See COPYING in the top level directory
+ * PROJECT:         ReactOS system libraries
+ * FILE:            lib/rtl/heaplfh.c
+ * PURPOSE:         RTL Low Fragmentation front-end heap
+ * PROGRAMMERS:     Copyright 2026 ReactOS Team
+ */
+
+/* Useful references:
+   http://illmatics.com/Understanding_the_LFH.pdf
+*/
+
+/* The front-end heap sits in front of the back-end allocator in heap.c and
+   keeps recently freed small blocks in lock-free per-size caches. Blocks in
+   the cache remain busy from the back-end's point of view, so neither the
+   heap lock nor coalescing is needed to hand them out again. Each block size
+   has several caches, and threads pick one by their affinity hint so that
+   concurrent threads mostly contend on different list heads. The caches are
+   packed next to each other, so neighbouring ones can share a cache line. */
+
+/* INCLUDES *****************************************************************/
+
+#include <rtl.h>
+#include <heap.h>
+
+#define NDEBUG
+#include <debug.h>
+
+/* FUNCTIONS *****************************************************************/
+
+FORCEINLINE
+PHEAP_LFH_SLOT
+RtlpGetLowFragHeapSlot(PHEAP_LFH LowFragHeap,
+                       SIZE_T Index)
+{
+    return &LowFragHeap->Slots[Index][RtlpGetAffinityHint() % HEAP_LFH_AFFINITY_SLOTS];
+}
+
+FORCEINLINE
+USHORT
+RtlpGetLowFragHeapDepth(SIZE_T Index)
+{
+    SIZE_T Depth;
+
+    /* Bound the cache by bytes rather than by blocks */
+    Depth = HEAP_LFH_SLOT_CACHE_SIZE / (Index << HEAP_ENTRY_SHIFT);
+
+    if (Depth < HEAP_LFH_MIN_DEPTH) return HEAP_LFH_MIN_DEPTH;
+    if (Depth > HEAP_LFH_MAX_DEPTH) return HEAP_LFH_MAX_DEPTH;
+    return (USHORT)Depth;
+}
+
+NTSTATUS NTAPI
+RtlpActivateLowFragHeap(PHEAP Heap)
+{
+    PHEAP_LFH LowFragHeap = NULL;
+    SIZE_T Size = sizeof(HEAP_LFH);
+    ULONG Bucket, Slot;
+    NTSTATUS Status;
+
+    /* The front-end relies on the heap lock being there and on blocks
+       not carrying fill patterns or extra information */
+    if ((Heap->Flags & (HEAP_NO_SERIALIZE |
+                        HEAP_TAIL_CHECKING_ENABLED |
+                        HEAP_FREE_CHECKING_ENABLED)) ||
+        RtlpHeapIsSpecial(Heap->Flags))
+    {
+        DPRINT1("HEAP: Can't enable LFH on heap %p with flags 0x%08x\n", Heap, Heap->Flags);
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    /* Nothing to do if it's already active */
+    if (Heap->FrontEndHeapType == HEAP_FRONT_END_LFH)
+        return STATUS_SUCCESS;
+
+    /* The front-end can't be replaced once something else is there */
+    if (Heap->FrontEndHeap)
+        return STATUS_UNSUCCESSFUL;
+
+    /* Allocate the front-end directly from the memory manager, so that it
+       stays independent from the heap it serves */
+    Status = ZwAllocateVirtualMemory(NtCurrentProcess(),
+                                     (PVOID *)&LowFragHeap,
+                                     0,
+                                     &Size,
+                                     MEM_RESERVE | MEM_COMMIT,
+                                     PAGE_READWRITE);
+    if (!NT_SUCCESS(Status))
+    {
+        DPRINT1("HEAP: Failed to allocate LFH for heap %p, Status 0x%08x\n", Heap, Status);
+        return Status;
+    }
+
+    /* Initialize all caches */
+    for (Bucket = 0; Bucket < HEAP_LFH_BUCKETS; Bucket++)
+    {
+        for (Slot = 0; Slot < HEAP_LFH_AFFINITY_SLOTS; Slot++)
+        {
+            RtlInitializeSListHead(&LowFragHeap->Slots[Bucket][Slot].ListHead);
+        }
+    }
+
+    /* Publish it under the heap lock. The type is set last, since it's what
+       RtlAllocateHeap and RtlFreeHeap look at without the lock */
+    RtlEnterHeapLock(Heap->LockVariable, TRUE);
+
+    if (Heap->FrontEndHeap)
+    {
+        /* Somebody else was faster */
+        RtlLeaveHeapLock(Heap->LockVariable);
+
+        Size = 0;
+        ZwFreeVirtualMemory(NtCurrentProcess(),
+                            (PVOID *)&LowFragHeap,
+                            &Size,
+                            MEM_RELEASE);
+
+        return (Heap->FrontEndHeapType == HEAP_FRONT_END_LFH) ? STATUS_SUCCESS : STATUS_UNSUCCESSFUL;
+    }
+
+    Heap->FrontEndHeap = LowFragHeap;
+    Heap->FrontEndHeapType = HEAP_FRONT_END_LFH;
+
+    RtlLeaveHeapLock(Heap->LockVariable);
+
+    DPRINT("HEAP: LFH enabled for heap %p\n", Heap);
+    return STATUS_SUCCESS;
+}
+
+VOID NTAPI
+RtlpDestroyLowFragHeap(PHEAP Heap)
+{
+    PVOID BaseAddress = Heap->FrontEndHeap;
+    SIZE_T Size = 0;
+
+    if (Heap->FrontEndHeapType != HEAP_FRONT_END_LFH) return;
+
+    /* Cached blocks live in the heap segments, which go away with the heap.
+       Only the front-end bookkeeping needs to be released */
+    Heap->FrontEndHeapType = HEAP_FRONT_END_NONE;
+    Heap->FrontEndHeap = NULL;
+
+    ZwFreeVirtualMemory(NtCurrentProcess(),
+                        &BaseAddress,
+                        &Size,
+                        MEM_RELEASE);
+}
+
+PHEAP_ENTRY NTAPI
+RtlpLowFragHeapAllocate(PHEAP Heap,
+                        SIZE_T Index)
+{
+    PHEAP_LFH_SLOT Slot;
+    PSLIST_ENTRY ListEntry;
+
+    ASSERT(Index < HEAP_LFH_BUCKETS);
+
+    Slot = RtlpGetLowFragHeapSlot(Heap->FrontEndHeap, Index);
+
+    ListEntry = RtlInterlockedPopEntrySList(&Slot->ListHead);
+    if (!ListEntry)
+    {
+        /* Let the back-end satisfy it, the block will come back on free */
+        InterlockedIncrement(&Slot->AllocateMisses);
+        return NULL;
+    }
+
+    InterlockedIncrement(&Slot->AllocateHits);
+
+    /* User data starts right after the entry's header */
+    return (PHEAP_ENTRY)ListEntry - 1;
+}
+
+BOOLEAN NTAPI
+RtlpLowFragHeapFree(PHEAP Heap,
+                    PHEAP_ENTRY HeapEntry)
+{
+    PHEAP_LFH_SLOT Slot;
+    SIZE_T Index = HeapEntry->Size;
+
+    /* Only plain busy blocks of a cacheable size go to the front-end */
+    if ((HeapEntry->Flags & (HEAP_ENTRY_BUSY |
+                             HEAP_ENTRY_EXTRA_PRESENT |
+                             HEAP_ENTRY_VIRTUAL_ALLOC |
+                             HEAP_ENTRY_FILL_PATTERN)) != HEAP_ENTRY_BUSY ||
+        (HeapEntry->SegmentOffset >= HEAP_SEGMENTS) ||
+        (Index >= HEAP_LFH_BUCKETS) ||
+        (HeapEntry->UnusedBytes == 0))
+    {
+        return FALSE;
+    }
+
+    Slot = RtlpGetLowFragHeapSlot(Heap->FrontEndHeap, Index);
+
+    /* Don't let the cache hoard memory, the back-end can coalesce it */
+    if (RtlQueryDepthSList(&Slot->ListHead) >= RtlpGetLowFragHeapDepth(Index))
+    {
+        InterlockedIncrement(&Slot->FreeMisses);
+        return FALSE;
+    }
+
+    /* Mark the block as cached, so that a double free is caught */
+    HeapEntry->UnusedBytes = 0;
+
+    RtlInterlockedPushEntrySList(&Slot->ListHead, (PSLIST_ENTRY)(HeapEntry + 1));
+    InterlockedIncrement(&Slot->FreeHits);
+
+    return TRUE;
+}
+
+VOID NTAPI
+RtlpQueryLowFragHeapCounters(PHEAP Heap,
+                             PRTL_HEAP_FRONT_END_INFORMATION Information)
+{
+    PHEAP_LFH LowFragHeap = Heap->FrontEndHeap;
+    PHEAP_LFH_SLOT Slot;
+    ULONG Bucket, i;
+
+    RtlZeroMemory(Information, sizeof(*Information));
+    Information->FrontEndHeapType = Heap->FrontEndHeapType;
+
+    if (Heap->FrontEndHeapType != HEAP_FRONT_END_LFH) return;
+
+    /* Other threads keep counting while we sum, so this is a snapshot */
+    for (Bucket = 0; Bucket < HEAP_LFH_BUCKETS; Bucket++)
+    {
+        for (i = 0; i < HEAP_LFH_AFFINITY_SLOTS; i++)
+        {
+            Slot = &LowFragHeap->Slots[Bucket][i];
+
+            Information->AllocateHits += Slot->AllocateHits;
+            Information->AllocateMisses += Slot->AllocateMisses;
+            Information->FreeHits += Slot->FreeHits;
+            Information->FreeMisses += Slot->FreeMisses;
+        }
+    }
+}
+
+/* EOF */
@@ -98,6 +98,10 @@ KPROCESSOR_MODE
 NTAPI
 RtlpGetMode(VOID);
 
+ULONG
+NTAPI
+RtlpGetAffinityHint(VOID);
+
 BOOLEAN
 NTAPI
 RtlpCaptureStackLimits(
@@ -5,7 +5,7 @@
  * The purpose of this utility is fix PE binaries generated by binutils and
  * to manipulate flags that can't be set by binutils.
  *
- * Currently two features are implemented:
+ * Currently three features are implemented:
  *
  * - Setting flags on PE sections for use by drivers. The sections
  *   .text, .data, .idata, .bss are marked as non-pageable and
@@ -18,17 +18,19 @@
  *   incorrectly put at the beginning of export table. This option
  *   allow to correct sort the table, so binary search can be used
  *   to process them.
+ *
+ * - Binding of imports to the DLLs given on the command line. The IAT
+ *   gets the addresses the imports have when the DLLs are loaded at their
+ *   preferred base, and every import descriptor gets the time stamp of
+ *   its DLL. The loader skips snapping as long as these still match.
+ *   Only old style binding of 32-bit images is done, so no bound import
+ *   directory has to be squeezed into the headers.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <fcntl.h>
-#include <unistd.h>
-
-#ifndef O_BINARY
-#define O_BINARY 0
-#endif
+#include <ctype.h>
 
 /* The following definitions are ripped from MinGW W32API headers. We don't
    use these headers directly in order to allow compilation on Linux hosts. */
@@ -46,8 +48,11 @@ typedef long LONG_PTR;
 #define IMAGE_SCN_MEM_DISCARDABLE 0x2000000
 #define IMAGE_SCN_MEM_NOT_PAGED 0x8000000
 #define FIELD_OFFSET(t,f) ((LONG)(LONG_PTR)&(((t*)0)->f))
-#define IMAGE_FIRST_SECTION(h) ((PIMAGE_SECTION_HEADER) ((unsigned long)h+FIELD_OFFSET(IMAGE_NT_HEADERS,OptionalHeader)+((PIMAGE_NT_HEADERS)(h))->FileHeader.SizeOfOptionalHeader))
+#define IMAGE_FIRST_SECTION(h) ((PIMAGE_SECTION_HEADER) ((PBYTE)(h)+FIELD_OFFSET(IMAGE_NT_HEADERS,OptionalHeader)+dtohs(((PIMAGE_NT_HEADERS)(h))->FileHeader.SizeOfOptionalHeader)))
 #define IMAGE_DIRECTORY_ENTRY_EXPORT 0
+#define IMAGE_DIRECTORY_ENTRY_IMPORT 1
+#define IMAGE_NT_OPTIONAL_HDR32_MAGIC 0x10b
+#define IMAGE_ORDINAL_FLAG32 0x80000000
 
 #pragma pack(2)
 typedef struct _IMAGE_DOS_HEADER {
@@ -152,6 +157,13 @@ typedef struct _IMAGE_SECTION_HEADER {
 	WORD NumberOfLinenumbers;
 	DWORD Characteristics;
 } IMAGE_SECTION_HEADER,*PIMAGE_SECTION_HEADER;
+typedef struct _IMAGE_IMPORT_DESCRIPTOR {
+	DWORD OriginalFirstThunk;
+	DWORD TimeDateStamp;
+	DWORD ForwarderChain;
+	DWORD Name;
+	DWORD FirstThunk;
+} IMAGE_IMPORT_DESCRIPTOR,*PIMAGE_IMPORT_DESCRIPTOR;
 #pragma pack(4)
 
 /* End of ripped definitions */
@@ -161,9 +173,14 @@ typedef struct _export_t {
    WORD ordinal;
 } export_t;
 
-unsigned char *buffer;
-PIMAGE_DOS_HEADER dos_header;
-PIMAGE_NT_HEADERS nt_header;
+typedef struct _image_t {
+   const char *name;
+   unsigned char *buffer;
+   long len;
+   PIMAGE_NT_HEADERS nt_header;
+} image_t;
+
+image_t image;
 
 static inline WORD dtohs(WORD in)
 {
@@ -194,27 +211,37 @@ static inline DWORD htodl(DWORD in)
     return out;
 }
 
-void *rva_to_ptr(DWORD rva)
+void *image_rva_to_ptr(image_t *img, DWORD rva)
 {
    PIMAGE_SECTION_HEADER section_header;
+   DWORD offset;
    unsigned int i;
 
-   for (i = 0, section_header = IMAGE_FIRST_SECTION(nt_header);
-        i < dtohl(nt_header->FileHeader.NumberOfSections);
+   for (i = 0, section_header = IMAGE_FIRST_SECTION(img->nt_header);
+        i < dtohs(img->nt_header->FileHeader.NumberOfSections);
         i++, section_header++)
    {
       if (rva >= dtohl(section_header->VirtualAddress) &&
           rva < dtohl(section_header->VirtualAddress) +
                 dtohl(section_header->Misc.VirtualSize))
       {
-         return buffer + rva - dtohl(section_header->VirtualAddress) +
-                dtohl(section_header->PointerToRawData);
+         /* Uninitialized data isn't in the file */
+         offset = rva - dtohl(section_header->VirtualAddress);
+         if (offset >= dtohl(section_header->SizeOfRawData) ||
+             dtohl(section_header->PointerToRawData) + offset >= (DWORD)img->len)
+            return NULL;
+         return img->buffer + dtohl(section_header->PointerToRawData) + offset;
       }
    }
 
    return NULL;
 }
 
+void *rva_to_ptr(DWORD rva)
+{
+   return image_rva_to_ptr(&image, rva);
+}
+
 int export_compare_func(const void *a, const void *b)
 {
    const export_t *ap = a;
@@ -224,17 +251,277 @@ int export_compare_func(const void *a, const void *b)
    return strcmp(an, bn);
 }
 
+/* Reads a whole PE image into memory, returns 0 if it isn't one */
+int load_image(image_t *img, const char *name)
+{
+   FILE *file;
+   PIMAGE_DOS_HEADER dos_header;
+
+   img->name = name;
+   img->buffer = NULL;
+
+   file = fopen(name, "rb");
+   if (file == NULL)
+   {
+      fprintf(stderr, "Can't open '%s'.\n", name);
+      return 0;
+   }
+
+   fseek(file, 0, SEEK_END);
+   img->len = ftell(file);
+   if (img->len < (long)sizeof(IMAGE_DOS_HEADER))
+   {
+      fclose(file);
+      fprintf(stderr, "'%s' isn't a PE image (too short)\n", name);
+      return 0;
+   }
+
+   /* The checksum is computed on words, so have one more byte to spare */
+   img->buffer = calloc(1, (img->len + 2) & ~1);
+   if (img->buffer == NULL)
+   {
+      fclose(file);
+      fprintf(stderr, "Not enough memory available.\n");
+      return 0;
+   }
+
+   fseek(file, 0, SEEK_SET);
+   if (fread(img->buffer, 1, img->len, file) != (size_t)img->len)
+   {
+      fclose(file);
+      fprintf(stderr, "Can't read '%s'.\n", name);
+      free(img->buffer);
+      img->buffer = NULL;
+      return 0;
+   }
+   fclose(file);
+
+   dos_header = (PIMAGE_DOS_HEADER)img->buffer;
+   if (dtohs(dos_header->e_magic) != IMAGE_DOS_SIGNATURE ||
+       (LONG)dtohl(dos_header->e_lfanew) < 0 ||
+       (long)dtohl(dos_header->e_lfanew) + (long)sizeof(IMAGE_NT_HEADERS) > img->len)
+   {
+      fprintf(stderr, "'%s' isn't a PE image (bad headers)\n", name);
+      free(img->buffer);
+      img->buffer = NULL;
+      return 0;
+   }
+
+   img->nt_header = (PIMAGE_NT_HEADERS)(img->buffer + dtohl(dos_header->e_lfanew));
+   if (dtohl(img->nt_header->Signature) != IMAGE_NT_SIGNATURE)
+   {
+      fprintf(stderr, "'%s' isn't a PE image (bad headers)\n", name);
+      free(img->buffer);
+      img->buffer = NULL;
+      return 0;
+   }
+
+   return 1;
+}
+
+const char *base_name(const char *path)
+{
+   const char *p, *name = path;
+
+   for (p = path; *p; p++)
+   {
+      if (*p == '/' || *p == '\\')
+         name = p + 1;
+   }
+
+   return name;
+}
+
+int name_compare_nocase(const char *a, const char *b)
+{
+   while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b))
+   {
+      a++;
+      b++;
+   }
+
+   return tolower((unsigned char)*a) - tolower((unsigned char)*b);
+}
+
+/* Returns the RVA of an export, 0 if it doesn't exist */
+DWORD find_export(image_t *dll, PIMAGE_EXPORT_DIRECTORY export_directory,
+                  const char *name, DWORD ordinal)
+{
+   DWORD *function_ptr, *name_ptr;
+   WORD *ordinal_ptr;
+   DWORD index, i;
+   char *export_name;
+
+   function_ptr = image_rva_to_ptr(dll, dtohl(export_directory->AddressOfFunctions));
+   if (function_ptr == NULL)
+      return 0;
+
+   if (name == NULL)
+   {
+      index = ordinal - dtohl(export_directory->Base);
+   }
+   else
+   {
+      name_ptr = image_rva_to_ptr(dll, dtohl(export_directory->AddressOfNames));
+      ordinal_ptr = image_rva_to_ptr(dll, dtohl(export_directory->AddressOfNameOrdinals));
+      if (name_ptr == NULL || ordinal_ptr == NULL)
+         return 0;
+
+      for (i = 0; i < dtohl(export_directory->NumberOfNames); i++)
+      {
+         export_name = image_rva_to_ptr(dll, dtohl(name_ptr[i]));
+         if (export_name != NULL && !strcmp(export_name, name))
+            break;
+      }
+      if (i == dtohl(export_directory->NumberOfNames))
+         return 0;
+
+      index = dtohs(ordinal_ptr[i]);
+   }
+
+   if (index >= dtohl(export_directory->NumberOfFunctions))
+      return 0;
+
+   return dtohl(function_ptr[index]);
+}
+
+/* Binds one import descriptor, returns 0 if it has to stay unbound */
+int bind_descriptor(PIMAGE_IMPORT_DESCRIPTOR import, image_t *dll)
+{
+   PIMAGE_DATA_DIRECTORY data_dir;
+   PIMAGE_EXPORT_DIRECTORY export_directory;
+   DWORD *original_thunk, *thunk, *bound;
+   DWORD count, i, rva, export_start, export_end;
+   DWORD forwarder_chain = 0xFFFFFFFF, *last_forwarder = &forwarder_chain;
+   char *name;
+
+   /* A binding can't be validated without a time stamp */
+   if (dtohl(dll->nt_header->FileHeader.TimeDateStamp) == 0 ||
+       dtohl(dll->nt_header->FileHeader.TimeDateStamp) == 0xFFFFFFFF)
+      return 0;
+
+   /* Without the lookup table, the loader couldn't snap a stale binding */
+   original_thunk = rva_to_ptr(dtohl(import->OriginalFirstThunk));
+   thunk = rva_to_ptr(dtohl(import->FirstThunk));
+   if (import->OriginalFirstThunk == 0 || original_thunk == NULL || thunk == NULL ||
+       original_thunk == thunk)
+      return 0;
+
+   data_dir = &dll->nt_header->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT];
+   export_start = dtohl(data_dir->VirtualAddress);
+   export_end = export_start + dtohl(data_dir->Size);
+   export_directory = image_rva_to_ptr(dll, export_start);
+   if (dtohl(data_dir->Size) == 0 || export_directory == NULL)
+      return 0;
+
+   for (count = 0; original_thunk[count] != 0; count++)
+      ;
+
+   bound = malloc((count + 1) * sizeof(DWORD));
+   if (bound == NULL)
+      return 0;
+
+   /* Resolve everything first, so that nothing is written if one import is missing */
+   for (i = 0; i < count; i++)
+   {
+      if (dtohl(original_thunk[i]) & IMAGE_ORDINAL_FLAG32)
+      {
+         rva = find_export(dll, export_directory, NULL,
+                           dtohl(original_thunk[i]) & 0xFFFF);
+      }
+      else
+      {
+         /* Skip the hint */
+         name = rva_to_ptr(dtohl(original_thunk[i]) + sizeof(WORD));
+         rva = name ? find_export(dll, export_directory, name, 0) : 0;
+      }
+
+      if (rva == 0)
+      {
+         free(bound);
+         return 0;
+      }
+
+      if (rva >= export_start && rva < export_end)
+      {
+         /* Forwarders are snapped by the loader, chain them */
+         *last_forwarder = i;
+         last_forwarder = &bound[i];
+      }
+      else
+      {
+         bound[i] = dtohl(dll->nt_header->OptionalHeader.ImageBase) + rva;
+      }
+   }
+   *last_forwarder = 0xFFFFFFFF;
+
+   for (i = 0; i < count; i++)
+      thunk[i] = htodl(bound[i]);
+   import->TimeDateStamp = dll->nt_header->FileHeader.TimeDateStamp;
+   import->ForwarderChain = htodl(forwarder_chain);
+
+   free(bound);
+   return 1;
+}
+
+void bind_imports(image_t *dlls, int dll_count)
+{
+   PIMAGE_DATA_DIRECTORY data_dir;
+   PIMAGE_IMPORT_DESCRIPTOR import;
+   char *name;
+   int i;
+
+   if (dtohs(image.nt_header->OptionalHeader.Magic) != IMAGE_NT_OPTIONAL_HDR32_MAGIC)
+   {
+      fprintf(stderr, "'%s' isn't a 32-bit image, not binding it\n", image.name);
+      return;
+   }
+
+   data_dir = &image.nt_header->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+   if (dtohl(data_dir->Size) == 0)
+      return;
+
+   import = rva_to_ptr(dtohl(data_dir->VirtualAddress));
+   if (import == NULL)
+      return;
+
+   for (; import->Name != 0; import++)
+   {
+      /* Leave alone what the linker bound already */
+      if (import->TimeDateStamp != 0)
+         continue;
+
+      name = rva_to_ptr(dtohl(import->Name));
+      if (name == NULL)
+         continue;
+
+      for (i = 0; i < dll_count; i++)
+      {
+         if (!name_compare_nocase(name, base_name(dlls[i].name)))
+         {
+            bind_descriptor(import, &dlls[i]);
+            break;
+         }
+      }
+   }
+}
+
 int main(int argc, char **argv)
 {
-   int fd_in, fd_out;
+   FILE *file;
    long len;
-   char hdrbuf[4] = { }, elfhdr[4] = { '\177', 'E', 'L', 'F' };
+   char hdrbuf[4] = { 0 }, elfhdr[4] = { '\177', 'E', 'L', 'F' };
    PIMAGE_SECTION_HEADER section_header;
    PIMAGE_DATA_DIRECTORY data_dir;
+   PIMAGE_NT_HEADERS nt_header;
+   unsigned char *buffer;
+   image_t *dlls = NULL;
+   int dll_count = 0;
    unsigned int i;
    unsigned long checksum;
    int fixup_exports = 0;
    int fixup_sections = 0;
+   int bind = 0;
 
    /*
     * Process parameters.
@@ -245,17 +532,25 @@ int main(int argc, char **argv)
       printf("Usage: %s <filename> <options>\n"
              "Options:\n"
              " -sections Sets section flags for PE image.\n"
-             " -exports Sort the names in export table.\n",
+             " -exports Sort the names in export table.\n"
+             " -bind <dll> [<dll> ...] Bind the imports from these DLLs.\n",
              argv[0]);
       return 1;
    }
 
-   for (i = 2; i < argc; i++)
+   for (i = 2; i < (unsigned int)argc; i++)
    {
       if (!strcmp(argv[i], "-sections"))
          fixup_sections = 1;
       else if (!strcmp(argv[i], "-exports"))
          fixup_exports = 1;
+      else if (!strcmp(argv[i], "-bind"))
+      {
+         /* Everything after it is a DLL to bind to */
+         bind = 1;
+         dll_count = argc - i - 1;
+         break;
+      }
       else
          { fprintf(stderr, "Invalid option: %s\n", argv[i]); return 1; }
    }
@@ -263,70 +558,56 @@ int main(int argc, char **argv)
    /*
     * Nothing to do.
     */
-   if (fixup_sections == 0 && fixup_exports == 0)
+   if (fixup_sections == 0 && fixup_exports == 0 && (bind == 0 || dll_count == 0))
       return 0;
 
    /*
-    * Read the whole file to memory.
+    * PowerPC ReactOS uses elf, so doesn't need pefixup
     */
-
-   fd_in = open(argv[1], O_RDONLY | O_BINARY);
-   if (fd_in == 0)
+   file = fopen(argv[1], "rb");
+   if (file == NULL)
    {
       fprintf(stderr, "Can't open input file.\n");
       return 1;
    }
+   len = (long)fread(hdrbuf, 1, sizeof(hdrbuf), file);
+   fclose(file);
+   if (len == sizeof(elfhdr) && !memcmp(hdrbuf, elfhdr, sizeof(elfhdr)))
+      return 0;
 
    /*
-    * PowerPC ReactOS uses elf, so doesn't need pefixup
+    * Read the whole file to memory and check the headers.
     */
-   len = read(fd_in, hdrbuf, sizeof(elfhdr));
-   if (!memcmp(hdrbuf, elfhdr, sizeof(elfhdr)))
-   {
-      close(fd_in);
-      return 0;
-   }
-
-   len = lseek(fd_in, 0, SEEK_END);
-   if (len < sizeof(IMAGE_DOS_HEADER))
-   {
-      close(fd_in);
-      fprintf(stderr, "'%s' isn't a PE image (too short)\n", argv[1]);
+   if (!load_image(&image, argv[1]))
       return 1;
-   }
+   buffer = image.buffer;
+   len = image.len;
+   nt_header = image.nt_header;
 
-   /* Lower down we overwrite the byte at len, so here, we need at least
-    * one more byte than len.  We'll be guaranteed one or two now. */
-   buffer = malloc((len + 2) & ~1);
-   if (buffer == NULL)
+   if (bind && dll_count != 0)
    {
-      close(fd_in);
-      fprintf(stderr, "Not enough memory available.\n");
-      return 1;
-   }
-
-   /* Read the whole input file into a buffer */
-   lseek(fd_in, 0, SEEK_SET);
-   read(fd_in, buffer, len);
-   /* Here is where the block end overwrite was */
-   if (len & 1)
-      buffer[len] = 0;
-
-   close(fd_in);
+      dlls = calloc(dll_count, sizeof(image_t));
+      if (dlls == NULL)
+      {
+         fprintf(stderr, "Not enough memory.\n");
+         free(buffer);
+         return 1;
+      }
 
-   /*
-    * Check the headers and save pointers to them.
-    */
+      for (i = 0; i < (unsigned int)dll_count; i++)
+      {
+         if (!load_image(&dlls[i], argv[argc - dll_count + i]))
+         {
+            free(buffer);
+            return 1;
+         }
+      }
 
-   dos_header = (PIMAGE_DOS_HEADER)buffer;
-   nt_header = (PIMAGE_NT_HEADERS)(buffer + dtohl(dos_header->e_lfanew));
+      bind_imports(dlls, dll_count);
 
-   if (dtohs(dos_header->e_magic) != IMAGE_DOS_SIGNATURE ||
-       dtohl(nt_header->Signature) != IMAGE_NT_SIGNATURE)
-   {
-      fprintf(stderr, "'%s' isn't a PE image (bad headers)\n", argv[1]);
-      free(buffer);
-      return 1;
+      for (i = 0; i < (unsigned int)dll_count; i++)
+         free(dlls[i].buffer);
+      free(dlls);
    }
 
    if (fixup_exports)
@@ -410,12 +691,25 @@ int main(int argc, char **argv)
       checksum = (checksum + (checksum >> 16)) & 0xffff;
    }
    checksum += len;
-   nt_header->OptionalHeader.CheckSum = htods(checksum);
+   nt_header->OptionalHeader.CheckSum = htodl(checksum);
 
    /* Write the output file */
-   fd_out = open(argv[1], O_WRONLY | O_BINARY);
-   write(fd_out, buffer, len);
-   close(fd_out);
+   file = fopen(argv[1], "r+b");
+   if (file == NULL)
+   {
+      fprintf(stderr, "Can't open output file.\n");
+      free(buffer);
+      return 1;
+   }
+   if (fwrite(buffer, 1, len, file) != (size_t)len)
+   {
+      fprintf(stderr, "Can't write output file.\n");
+      fclose(file);
+      free(buffer);
+      return 1;
+   }
+   fclose(file);
+   free(buffer);
 
    return 0;
 }
@@ -13,6 +13,70 @@
 #define NDEBUG
 #include <debug.h>
 
+/*
+ * 32bpp to 32bpp without color translation, mask or pattern. Picks the same
+ * source pixels as the generic code below, but without a division, a function
+ * call and a translation for each one of them.
+ */
+static BOOLEAN
+StretchBlt32To32(SURFOBJ *DestSurf, SURFOBJ *SourceSurf,
+                 RECTL *DestRect, RECTL *SourceRect, ROP4 ROP)
+{
+  LONG DstWidth = DestRect->right - DestRect->left;
+  LONG DstHeight = DestRect->bottom - DestRect->top;
+  LONG SrcWidth = SourceRect->right - SourceRect->left;
+  LONG SrcHeight = SourceRect->bottom - SourceRect->top;
+  LONG DesX, DesY, sx, sy = 0, RemainderX, RemainderY = 0;
+  PBYTE DestLine, SourceLine;
+  PULONG Dest, Source;
+
+  DestLine = (PBYTE)DestSurf->pvScan0 + DestRect->top * DestSurf->lDelta + (DestRect->left << 2);
+  SourceLine = (PBYTE)SourceSurf->pvScan0 + SourceRect->top * SourceSurf->lDelta + (SourceRect->left << 2);
+
+  for (DesY = 0; DesY < DstHeight; DesY++)
+  {
+    Dest = (PULONG)DestLine;
+    Source = (PULONG)(SourceLine + sy * SourceSurf->lDelta);
+
+    if (SrcWidth == DstWidth && ROP4_FGND(ROP) == R3_OPINDEX_SRCCOPY)
+    {
+      RtlMoveMemory(Dest, Source, DstWidth << 2);
+    }
+    else
+    {
+      sx = 0;
+      RemainderX = 0;
+      for (DesX = 0; DesX < DstWidth; DesX++)
+      {
+        switch (ROP4_FGND(ROP))
+        {
+          case R3_OPINDEX_SRCCOPY:  Dest[DesX] = Source[sx]; break;
+          case R3_OPINDEX_SRCAND:   Dest[DesX] &= Source[sx]; break;
+          case R3_OPINDEX_SRCPAINT: Dest[DesX] |= Source[sx]; break;
+        }
+
+        /* sx = ((DesX + 1) * SrcWidth) / DstWidth */
+        RemainderX += SrcWidth;
+        while (RemainderX >= DstWidth)
+        {
+          RemainderX -= DstWidth;
+          sx++;
+        }
+      }
+    }
+
+    DestLine += DestSurf->lDelta;
+    RemainderY += SrcHeight;
+    while (RemainderY >= DstHeight)
+    {
+      RemainderY -= DstHeight;
+      sy++;
+    }
+  }
+
+  return TRUE;
+}
+
 BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *MaskSurf,
                             SURFOBJ *PatternSurface,
                             RECTL *DestRect, RECTL *SourceRect,
@@ -50,6 +114,23 @@ BOOLEAN DIB_XXBPP_StretchBlt(SURFOBJ *DestSurf, SURFOBJ *SourceSurf, SURFOBJ *Ma
 
   ASSERT(IS_VALID_ROP4(ROP));
 
+  if (DestSurf->iBitmapFormat == BMF_32BPP &&
+      UsesSource && !UsesPattern && MaskSurf == NULL &&
+      SourceSurf->iBitmapFormat == BMF_32BPP &&
+      SourceSurf->pvScan0 != DestSurf->pvScan0 &&
+      (ColorTranslation == NULL || (ColorTranslation->flXlate & XO_TRIVIAL)) &&
+      (ROP4_FGND(ROP) == R3_OPINDEX_SRCCOPY ||
+       ROP4_FGND(ROP) == R3_OPINDEX_SRCAND ||
+       ROP4_FGND(ROP) == R3_OPINDEX_SRCPAINT) &&
+      DestRect->right > DestRect->left && DestRect->bottom > DestRect->top &&
+      SourceRect->left >= 0 && SourceRect->top >= 0 &&
+      SourceRect->right > SourceRect->left && SourceRect->bottom > SourceRect->top &&
+      SourceRect->right <= SourceSurf->sizlBitmap.cx &&
+      SourceRect->bottom <= abs(SourceSurf->sizlBitmap.cy))
+  {
+    return StretchBlt32To32(DestSurf, SourceSurf, DestRect, SourceRect, ROP);
+  }
+
   fnDest_GetPixel = DibFunctionsForBitmapFormat[DestSurf->iBitmapFormat].DIB_GetPixel;
   fnDest_PutPixel = DibFunctionsForBitmapFormat[DestSurf->iBitmapFormat].DIB_PutPixel;
 
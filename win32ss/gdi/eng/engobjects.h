@@ -131,6 +131,8 @@ typedef struct _SHARED_FACE {
   PSHARED_MEM   Memory;
   SHARED_FACE_CACHE EnglishUS;
   SHARED_FACE_CACHE UserLanguage;
+  LIST_ENTRY    GlyphCacheListHead;
+  SIZE_T        GlyphCacheSize;
 } SHARED_FACE, *PSHARED_FACE;
 
 typedef struct _FONTGDI {
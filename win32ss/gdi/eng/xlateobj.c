@@ -25,6 +25,48 @@ EXLATEOBJ gexloTrivial = {{0, XO_TRIVIAL, 0, 0, 0, 0}, EXLATEOBJ_iXlateTrivial};
 
 static ULONG giUniqueXlate = 0;
 
+/*
+ * Translations from or to an indexed palette need a nearest color search for
+ * every palette entry or every pixel. The cache keeps the result around for
+ * the last few pairs of palettes. Entries are keyed by the contents of the
+ * palettes rather than their addresses, so a palette that was changed, or
+ * freed and reallocated at the same place, can't hit a stale entry.
+ */
+#define XLATE_CACHE_SIZE        8
+#define XLATE_COLOR_CACHE_SIZE  1024
+
+#define XLATE_PAL_FLAGS (PAL_INDEXED | PAL_BITFIELDS | PAL_RGB | PAL_BGR | \
+                         PAL_RGB16_555 | PAL_RGB16_565 | PAL_MONOCHROME)
+
+typedef struct _XLATECACHE
+{
+    LIST_ENTRY leLink;
+    LONG cRefs;
+    ULONG ulHash;
+    FLONG flSrc;
+    FLONG flDst;
+    ULONG cSrcColors;
+    ULONG cDstColors;
+    ULONG aulSrcMasks[3];
+    ULONG aulDstMasks[3];
+    PALETTEENTRY *papeSrc;
+    PALETTEENTRY *papeDst;
+
+    /* Indexed source: the translation table, and whether it changes anything */
+    PULONG pulXlate;
+    BOOL bTrivial;
+
+    /* 555 or 565 source to indexed destination, 0xFFFF until first used */
+    PUSHORT pusXlate16;
+
+    /* Other sources to indexed destination: (index + 1) << 24 | RGB, or 0 */
+    PULONG pulColorCache;
+} XLATECACHE, *PXLATECACHE;
+
+static LIST_ENTRY gleXlateCache = {&gleXlateCache, &gleXlateCache};
+static ULONG gcXlateCache = 0;
+static EX_PUSH_LOCK gpushlockXlateCache;
+
 static const BYTE gajXlate5to8[32] =
 {  0,  8, 16, 25, 33, 41, 49, 58, 66, 74, 82, 90, 99,107,115,123,
  132,140,148,156,165,173,181,189,197,206,214,222,231,239,247,255};
@@ -350,6 +392,316 @@ EXLATEOBJ_iXlateBitfieldsToPal(PEXLATEOBJ pexlo, ULONG iColor)
     return PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
 }
 
+_Function_class_(FN_XLATE)
+ULONG
+FASTCALL
+EXLATEOBJ_iXlate555toPalCached(PEXLATEOBJ pexlo, ULONG iColor)
+{
+    PUSHORT pusXlate = pexlo->pxlc->pusXlate16;
+
+    /* The top bit doesn't take part */
+    iColor &= 0x7FFF;
+    if (pusXlate[iColor] == 0xFFFF)
+        pusXlate[iColor] = (USHORT)EXLATEOBJ_iXlate555toPal(pexlo, iColor);
+
+    return pusXlate[iColor];
+}
+
+_Function_class_(FN_XLATE)
+ULONG
+FASTCALL
+EXLATEOBJ_iXlate565toPalCached(PEXLATEOBJ pexlo, ULONG iColor)
+{
+    PUSHORT pusXlate = pexlo->pxlc->pusXlate16;
+
+    iColor &= 0xFFFF;
+    if (pusXlate[iColor] == 0xFFFF)
+        pusXlate[iColor] = (USHORT)EXLATEOBJ_iXlate565toPal(pexlo, iColor);
+
+    return pusXlate[iColor];
+}
+
+static
+ULONG
+EXLATEOBJ_iNearestIndexCached(PEXLATEOBJ pexlo, ULONG iColor)
+{
+    PULONG pulEntry;
+    ULONG ulEntry, iIndex;
+
+    /* Only red, green and blue are looked at */
+    iColor &= 0xFFFFFF;
+    pulEntry = &pexlo->pxlc->pulColorCache[((iColor * 0x9E3779B1) >> 22) % XLATE_COLOR_CACHE_SIZE];
+
+    /* Entries are written in one go, so there is no torn read to worry about */
+    ulEntry = *pulEntry;
+    if (ulEntry != 0 && (ulEntry & 0xFFFFFF) == iColor)
+        return (ulEntry >> 24) - 1;
+
+    iIndex = PALETTE_ulGetNearestPaletteIndex(pexlo->ppalDst, iColor);
+    *pulEntry = ((iIndex + 1) << 24) | iColor;
+
+    return iIndex;
+}
+
+_Function_class_(FN_XLATE)
+ULONG
+FASTCALL
+EXLATEOBJ_iXlateRGBtoPalCached(PEXLATEOBJ pexlo, ULONG iColor)
+{
+    return EXLATEOBJ_iNearestIndexCached(pexlo, iColor);
+}
+
+_Function_class_(FN_XLATE)
+ULONG
+FASTCALL
+EXLATEOBJ_iXlateBitfieldsToPalCached(PEXLATEOBJ pexlo, ULONG iColor)
+{
+    /* Convert bitfields to RGB */
+    iColor = EXLATEOBJ_iXlateShiftAndMask(pexlo, iColor);
+
+    return EXLATEOBJ_iNearestIndexCached(pexlo, iColor);
+}
+
+
+/** Translation cache *********************************************************/
+
+/* Fills the table for an indexed source palette, returns TRUE if it maps every index to itself */
+static
+BOOL
+EXLATEOBJ_bBuildTable(
+    _In_ PPALETTE ppalSrc,
+    _In_ PPALETTE ppalDst,
+    _Out_writes_(ppalSrc->NumColors) PULONG pulXlate)
+{
+    ULONG i, ulColor, cDiff = 0;
+
+    for (i = 0; i < ppalSrc->NumColors; i++)
+    {
+        ulColor = RGB(ppalSrc->IndexedColors[i].peRed,
+                      ppalSrc->IndexedColors[i].peGreen,
+                      ppalSrc->IndexedColors[i].peBlue);
+
+        if (ppalDst->flFlags & PAL_INDEXED)
+        {
+            pulXlate[i] = PALETTE_ulGetNearestPaletteIndex(ppalDst, ulColor);
+            if (pulXlate[i] != i) cDiff++;
+        }
+        else
+        {
+            pulXlate[i] = PALETTE_ulGetNearestBitFieldsIndex(ppalDst, ulColor);
+            cDiff++;
+        }
+    }
+
+    return (cDiff == 0);
+}
+
+static
+ULONG
+XLATECACHE_ulHashPalette(
+    _In_ PPALETTE ppal,
+    _In_ ULONG ulHash)
+{
+    PULONG pulColors = (PULONG)ppal->IndexedColors;
+    ULONG i;
+
+    ulHash = (ulHash ^ (ppal->flFlags & XLATE_PAL_FLAGS)) * 16777619;
+    if (ppal->flFlags & PAL_INDEXED)
+    {
+        for (i = 0; i < ppal->NumColors; i++)
+            ulHash = (ulHash ^ pulColors[i]) * 16777619;
+    }
+    else if (ppal->flFlags & PAL_BITFIELDS)
+    {
+        ulHash = (ulHash ^ ppal->RedMask) * 16777619;
+        ulHash = (ulHash ^ ppal->GreenMask) * 16777619;
+        ulHash = (ulHash ^ ppal->BlueMask) * 16777619;
+    }
+
+    return ulHash;
+}
+
+static
+BOOL
+XLATECACHE_bMatchPalette(
+    _In_ PPALETTE ppal,
+    _In_ FLONG fl,
+    _In_ ULONG cColors,
+    _In_ PALETTEENTRY *pape,
+    _In_ PULONG aulMasks)
+{
+    if ((ppal->flFlags & XLATE_PAL_FLAGS) != fl)
+        return FALSE;
+
+    if (fl & PAL_INDEXED)
+    {
+        return (ppal->NumColors == cColors) &&
+               (RtlCompareMemory(ppal->IndexedColors, pape,
+                                 cColors * sizeof(PALETTEENTRY)) == cColors * sizeof(PALETTEENTRY));
+    }
+
+    if (fl & PAL_BITFIELDS)
+    {
+        return (ppal->RedMask == aulMasks[0]) &&
+               (ppal->GreenMask == aulMasks[1]) &&
+               (ppal->BlueMask == aulMasks[2]);
+    }
+
+    return TRUE;
+}
+
+static
+VOID
+XLATECACHE_vFree(
+    _In_ PXLATECACHE pxlc)
+{
+    if (pxlc->pusXlate16) EngFreeMem(pxlc->pusXlate16);
+    if (pxlc->pulColorCache) EngFreeMem(pxlc->pulColorCache);
+    EngFreeMem(pxlc);
+}
+
+static
+PXLATECACHE
+XLATECACHE_pxlcCreate(
+    _In_ PPALETTE ppalSrc,
+    _In_ PPALETTE ppalDst,
+    _In_ ULONG ulHash)
+{
+    PXLATECACHE pxlc;
+    ULONG cSrcColors, cDstColors, cjSize;
+
+    cSrcColors = (ppalSrc->flFlags & PAL_INDEXED) ? ppalSrc->NumColors : 0;
+    cDstColors = (ppalDst->flFlags & PAL_INDEXED) ? ppalDst->NumColors : 0;
+
+    /* Room for copies of both palettes and for the table */
+    cjSize = sizeof(XLATECACHE) +
+             (cSrcColors + cDstColors) * sizeof(PALETTEENTRY) +
+             cSrcColors * sizeof(ULONG);
+
+    pxlc = EngAllocMem(FL_ZERO_MEMORY, cjSize, GDITAG_PXLATE);
+    if (!pxlc)
+        return NULL;
+
+    pxlc->cRefs = 1;
+    pxlc->ulHash = ulHash;
+    pxlc->flSrc = ppalSrc->flFlags & XLATE_PAL_FLAGS;
+    pxlc->flDst = ppalDst->flFlags & XLATE_PAL_FLAGS;
+    pxlc->cSrcColors = cSrcColors;
+    pxlc->cDstColors = cDstColors;
+    pxlc->papeSrc = (PALETTEENTRY*)(pxlc + 1);
+    pxlc->papeDst = pxlc->papeSrc + cSrcColors;
+    RtlCopyMemory(pxlc->papeSrc, ppalSrc->IndexedColors, cSrcColors * sizeof(PALETTEENTRY));
+    RtlCopyMemory(pxlc->papeDst, ppalDst->IndexedColors, cDstColors * sizeof(PALETTEENTRY));
+    if (ppalSrc->flFlags & PAL_BITFIELDS)
+        PALETTE_vGetBitMasks(ppalSrc, pxlc->aulSrcMasks);
+    if (ppalDst->flFlags & PAL_BITFIELDS)
+        PALETTE_vGetBitMasks(ppalDst, pxlc->aulDstMasks);
+
+    if (cSrcColors)
+    {
+        pxlc->pulXlate = (PULONG)(pxlc->papeDst + cDstColors);
+        pxlc->bTrivial = EXLATEOBJ_bBuildTable(ppalSrc, ppalDst, pxlc->pulXlate);
+        return pxlc;
+    }
+
+    ASSERT(cDstColors);
+    if (ppalSrc->flFlags & (PAL_RGB16_555 | PAL_RGB16_565))
+    {
+        pxlc->pusXlate16 = EngAllocMem(0, 0x10000 * sizeof(USHORT), GDITAG_PXLATE);
+        if (pxlc->pusXlate16)
+        {
+            RtlFillMemory(pxlc->pusXlate16, 0x10000 * sizeof(USHORT), 0xFF);
+            return pxlc;
+        }
+    }
+    else if (cDstColors <= 255)
+    {
+        pxlc->pulColorCache = EngAllocMem(FL_ZERO_MEMORY,
+                                          XLATE_COLOR_CACHE_SIZE * sizeof(ULONG),
+                                          GDITAG_PXLATE);
+        if (pxlc->pulColorCache)
+            return pxlc;
+    }
+
+    /* Nothing worth caching */
+    XLATECACHE_vFree(pxlc);
+    return NULL;
+}
+
+static
+VOID
+XLATECACHE_vRelease(
+    _In_ PXLATECACHE pxlc)
+{
+    /* Entries are only freed by eviction, with the lock held and no references left */
+    ASSERT(pxlc->cRefs > 0);
+    InterlockedDecrement(&pxlc->cRefs);
+}
+
+/* Returns a referenced cache entry for the two palettes, or NULL */
+static
+PXLATECACHE
+XLATECACHE_pxlcReference(
+    _In_ PPALETTE ppalSrc,
+    _In_ PPALETTE ppalDst)
+{
+    PXLATECACHE pxlc, pxlcNew;
+    PLIST_ENTRY ple;
+    ULONG ulHash;
+
+    ulHash = XLATECACHE_ulHashPalette(ppalDst, XLATECACHE_ulHashPalette(ppalSrc, 2166136261));
+
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&gpushlockXlateCache);
+    for (ple = gleXlateCache.Flink; ple != &gleXlateCache; ple = ple->Flink)
+    {
+        pxlc = CONTAINING_RECORD(ple, XLATECACHE, leLink);
+        if (pxlc->ulHash == ulHash &&
+            XLATECACHE_bMatchPalette(ppalSrc, pxlc->flSrc, pxlc->cSrcColors,
+                                     pxlc->papeSrc, pxlc->aulSrcMasks) &&
+            XLATECACHE_bMatchPalette(ppalDst, pxlc->flDst, pxlc->cDstColors,
+                                     pxlc->papeDst, pxlc->aulDstMasks))
+        {
+            InterlockedIncrement(&pxlc->cRefs);
+            RemoveEntryList(&pxlc->leLink);
+            InsertHeadList(&gleXlateCache, &pxlc->leLink);
+            ExReleasePushLockExclusive(&gpushlockXlateCache);
+            KeLeaveCriticalRegion();
+            return pxlc;
+        }
+    }
+    ExReleasePushLockExclusive(&gpushlockXlateCache);
+    KeLeaveCriticalRegion();
+
+    /* Do the expensive part without holding up everyone else */
+    pxlcNew = XLATECACHE_pxlcCreate(ppalSrc, ppalDst, ulHash);
+    if (!pxlcNew)
+        return NULL;
+
+    KeEnterCriticalRegion();
+    ExAcquirePushLockExclusive(&gpushlockXlateCache);
+    InsertHeadList(&gleXlateCache, &pxlcNew->leLink);
+    gcXlateCache++;
+
+    /* Evict the least recently used entries nobody is using right now */
+    ple = gleXlateCache.Blink;
+    while (gcXlateCache > XLATE_CACHE_SIZE && ple != &gleXlateCache)
+    {
+        pxlc = CONTAINING_RECORD(ple, XLATECACHE, leLink);
+        ple = ple->Blink;
+        if (pxlc->cRefs == 0)
+        {
+            RemoveEntryList(&pxlc->leLink);
+            gcXlateCache--;
+            XLATECACHE_vFree(pxlc);
+        }
+    }
+    ExReleasePushLockExclusive(&gpushlockXlateCache);
+    KeLeaveCriticalRegion();
+
+    return pxlcNew;
+}
+
 
 /** Private Functions *********************************************************/
 
@@ -364,7 +716,7 @@ EXLATEOBJ_vInitialize(
     _In_ COLORREF crDstForeColor)
 {
     ULONG cEntries;
-    ULONG i, ulColor;
+    BOOL bTrivial;
 
     if (!ppalSrc) ppalSrc = &gpalRGB;
     if (!ppalDst) ppalDst = &gpalRGB;
@@ -375,6 +727,7 @@ EXLATEOBJ_vInitialize(
     pexlo->xlo.pulXlate = pexlo->aulXlate;
     pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
     pexlo->hColorTransform = NULL;
+    pexlo->pxlc = NULL;
     pexlo->ppalSrc = ppalSrc;
     pexlo->ppalDst = ppalDst;
     pexlo->xlo.iSrcType = (USHORT)ppalSrc->flFlags;
@@ -455,65 +808,47 @@ EXLATEOBJ_vInitialize(
     {
         cEntries = ppalSrc->NumColors;
 
-        /* Allocate buffer if needed */
-        if (cEntries > 6)
+        /* The table is shared with the cache, if it has one for these palettes */
+        pexlo->pxlc = XLATECACHE_pxlcReference(ppalSrc, ppalDst);
+        if (pexlo->pxlc)
         {
-            pexlo->xlo.pulXlate = EngAllocMem(0,
-                                              cEntries * sizeof(ULONG),
-                                              GDITAG_PXLATE);
-            if (!pexlo->xlo.pulXlate)
-            {
-                DPRINT1("Could not allocate pulXlate buffer.\n");
-                pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
-                pexlo->xlo.flXlate = XO_TRIVIAL;
-                return;
-            }
+            pexlo->xlo.pulXlate = pexlo->pxlc->pulXlate;
+            bTrivial = pexlo->pxlc->bTrivial;
         }
-
-        pexlo->pfnXlate = EXLATEOBJ_iXlateTable;
-        pexlo->xlo.cEntries = cEntries;
-        pexlo->xlo.flXlate |= XO_TABLE;
-
-        if (ppalDst->flFlags & PAL_INDEXED)
+        else
         {
-            ULONG cDiff = 0;
-
-            for (i = 0; i < cEntries; i++)
-            {
-                ulColor = RGB(ppalSrc->IndexedColors[i].peRed,
-                              ppalSrc->IndexedColors[i].peGreen,
-                              ppalSrc->IndexedColors[i].peBlue);
-
-                pexlo->xlo.pulXlate[i] =
-                    PALETTE_ulGetNearestPaletteIndex(ppalDst, ulColor);
-
-                if (pexlo->xlo.pulXlate[i] != i) cDiff++;
-            }
-
-            /* Check if we have only trivial mappings */
-            if (cDiff == 0)
+            /* Allocate buffer if needed */
+            if (cEntries > 6)
             {
-                if (pexlo->xlo.pulXlate != pexlo->aulXlate)
+                pexlo->xlo.pulXlate = EngAllocMem(0,
+                                                  cEntries * sizeof(ULONG),
+                                                  GDITAG_PXLATE);
+                if (!pexlo->xlo.pulXlate)
                 {
-                    EngFreeMem(pexlo->xlo.pulXlate);
+                    DPRINT1("Could not allocate pulXlate buffer.\n");
                     pexlo->xlo.pulXlate = pexlo->aulXlate;
+                    pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
+                    pexlo->xlo.flXlate = XO_TRIVIAL;
+                    return;
                 }
-                pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
-                pexlo->xlo.flXlate = XO_TRIVIAL;
-                pexlo->xlo.cEntries = 0;
-                return;
             }
+
+            bTrivial = EXLATEOBJ_bBuildTable(ppalSrc, ppalDst, pexlo->xlo.pulXlate);
         }
-        else
+
+        /* Check if we have only trivial mappings */
+        if (bTrivial)
         {
-            for (i = 0; i < pexlo->xlo.cEntries; i++)
-            {
-                ulColor = RGB(ppalSrc->IndexedColors[i].peRed,
-                              ppalSrc->IndexedColors[i].peGreen,
-                              ppalSrc->IndexedColors[i].peBlue);
-                pexlo->xlo.pulXlate[i] = PALETTE_ulGetNearestBitFieldsIndex(ppalDst, ulColor);
-            }
+            EXLATEOBJ_vCleanup(pexlo);
+            pexlo->pfnXlate = EXLATEOBJ_iXlateTrivial;
+            pexlo->xlo.flXlate = XO_TRIVIAL;
+            pexlo->xlo.cEntries = 0;
+            return;
         }
+
+        pexlo->pfnXlate = EXLATEOBJ_iXlateTable;
+        pexlo->xlo.cEntries = cEntries;
+        pexlo->xlo.flXlate |= XO_TABLE;
     }
     else if (ppalSrc->flFlags & PAL_RGB)
     {
@@ -592,6 +927,25 @@ EXLATEOBJ_vInitialize(
             pexlo->pfnXlate = EXLATEOBJ_iXlateShiftAndMask;
     }
 
+    /* Nearest color searches per pixel, see if the cache can take them over */
+    if (pexlo->pfnXlate == EXLATEOBJ_iXlateRGBtoPal ||
+        pexlo->pfnXlate == EXLATEOBJ_iXlateBitfieldsToPal ||
+        pexlo->pfnXlate == EXLATEOBJ_iXlate555toPal ||
+        pexlo->pfnXlate == EXLATEOBJ_iXlate565toPal)
+    {
+        pexlo->pxlc = XLATECACHE_pxlcReference(ppalSrc, ppalDst);
+        if (pexlo->pxlc && pexlo->pxlc->pusXlate16)
+        {
+            pexlo->pfnXlate = (pexlo->pfnXlate == EXLATEOBJ_iXlate555toPal) ?
+                EXLATEOBJ_iXlate555toPalCached : EXLATEOBJ_iXlate565toPalCached;
+        }
+        else if (pexlo->pxlc && pexlo->pxlc->pulColorCache)
+        {
+            pexlo->pfnXlate = (pexlo->pfnXlate == EXLATEOBJ_iXlateRGBtoPal) ?
+                EXLATEOBJ_iXlateRGBtoPalCached : EXLATEOBJ_iXlateBitfieldsToPalCached;
+        }
+    }
+
     /* Check for a trivial shift and mask operation */
     if (pexlo->pfnXlate == EXLATEOBJ_iXlateShiftAndMask &&
         !pexlo->ulRedShift && !pexlo->ulGreenShift && !pexlo->ulBlueShift)
@@ -649,13 +1003,116 @@ NTAPI
 EXLATEOBJ_vCleanup(
     _Inout_ PEXLATEOBJ pexlo)
 {
-    if (pexlo->xlo.pulXlate != pexlo->aulXlate)
+    if (pexlo->pxlc)
+    {
+        /* The table belongs to the cache */
+        XLATECACHE_vRelease(pexlo->pxlc);
+        pexlo->pxlc = NULL;
+    }
+    else if (pexlo->xlo.pulXlate != pexlo->aulXlate)
     {
         EngFreeMem(pexlo->xlo.pulXlate);
     }
     pexlo->xlo.pulXlate = pexlo->aulXlate;
 }
 
+/*
+ * Translates a whole span of pixels, so that the DIB code doesn't have to go
+ * through a function pointer for every single one of them. The source pixels
+ * are 8, 16 or 32 bits wide, the results are stored as ULONGs. For 32 bits
+ * per pixel, pulDst may be the same as pvSrc.
+ */
+VOID
+NTAPI
+EXLATEOBJ_vXlateSpan(
+    _In_opt_ PEXLATEOBJ pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_ const VOID *pvSrc,
+    _In_ ULONG cBitsPerPixel,
+    _In_ ULONG cPixels)
+{
+    PFN_XLATE pfnXlate = pexlo ? pexlo->pfnXlate : EXLATEOBJ_iXlateTrivial;
+    const BYTE *pjSrc = pvSrc;
+    const USHORT *pusSrc = pvSrc;
+    const ULONG *pulSrc = pvSrc;
+    ULONG i, iColor, iNewColor;
+
+    if (cBitsPerPixel == 8)
+    {
+        if (pfnXlate == EXLATEOBJ_iXlateTable)
+        {
+            for (i = 0; i < cPixels; i++)
+            {
+                iColor = pjSrc[i];
+                pulDst[i] = (iColor < pexlo->xlo.cEntries) ? pexlo->xlo.pulXlate[iColor] : 0;
+            }
+        }
+        else
+        {
+            for (i = 0; i < cPixels; i++)
+                pulDst[i] = pfnXlate(pexlo, pjSrc[i]);
+        }
+    }
+    else if (cBitsPerPixel == 16)
+    {
+        if (pfnXlate == EXLATEOBJ_iXlate555toPalCached ||
+            pfnXlate == EXLATEOBJ_iXlate565toPalCached)
+        {
+            PUSHORT pusXlate = pexlo->pxlc->pusXlate16;
+            ULONG ulMask = (pfnXlate == EXLATEOBJ_iXlate555toPalCached) ? 0x7FFF : 0xFFFF;
+
+            for (i = 0; i < cPixels; i++)
+            {
+                iColor = pusSrc[i] & ulMask;
+                if (pusXlate[iColor] == 0xFFFF)
+                    pfnXlate(pexlo, iColor);
+                pulDst[i] = pusXlate[iColor];
+            }
+        }
+        else
+        {
+            for (i = 0; i < cPixels; i++)
+                pulDst[i] = pfnXlate(pexlo, pusSrc[i]);
+        }
+    }
+    else
+    {
+        ASSERT(cBitsPerPixel == 32);
+
+        if (pfnXlate == EXLATEOBJ_iXlateTrivial)
+        {
+            if (pulDst != pulSrc)
+                RtlMoveMemory(pulDst, pulSrc, cPixels * sizeof(ULONG));
+        }
+        else if (pfnXlate == EXLATEOBJ_iXlateRGBtoBGR)
+        {
+            for (i = 0; i < cPixels; i++)
+            {
+                iColor = pulSrc[i];
+                iNewColor = iColor & 0xff00ff00;
+                iColor &= 0x00ff00ff;
+                pulDst[i] = iNewColor | (iColor >> 16) | (iColor << 16);
+            }
+        }
+        else if (pfnXlate == EXLATEOBJ_iXlateShiftAndMask)
+        {
+            for (i = 0; i < cPixels; i++)
+            {
+                iColor = pulSrc[i];
+                iNewColor = _rotl(iColor, pexlo->ulRedShift) & pexlo->ulRedMask;
+                iNewColor |= _rotl(iColor, pexlo->ulGreenShift) & pexlo->ulGreenMask;
+                iNewColor |= _rotl(iColor, pexlo->ulBlueShift) & pexlo->ulBlueMask;
+                pulDst[i] = iNewColor;
+            }
+        }
+        else
+        {
+            for (i = 0; i < cPixels; i++)
+                pulDst[i] = pfnXlate(pexlo, pulSrc[i]);
+        }
+    }
+}
+
 /** Public DDI Functions ******************************************************/
 
 #undef XLATEOBJ_iXlate
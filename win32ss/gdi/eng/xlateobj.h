@@ -8,6 +8,7 @@
  */
 
 struct _EXLATEOBJ;
+struct _XLATECACHE;
 
 _Function_class_(FN_XLATE)
 typedef
@@ -28,6 +29,9 @@ typedef struct _EXLATEOBJ
 
     HANDLE hColorTransform;
 
+    /* Cached tables for translations involving an indexed palette */
+    struct _XLATECACHE *pxlc;
+
     union
     {
         ULONG aulXlate[6];
@@ -84,3 +88,12 @@ NTAPI
 EXLATEOBJ_vCleanup(
     _Inout_ PEXLATEOBJ pexlo);
 
+VOID
+NTAPI
+EXLATEOBJ_vXlateSpan(
+    _In_opt_ PEXLATEOBJ pexlo,
+    _Out_writes_(cPixels) PULONG pulDst,
+    _In_ const VOID *pvSrc,
+    _In_ ULONG cBitsPerPixel,
+    _In_ ULONG cPixels);
+
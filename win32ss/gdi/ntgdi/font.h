@@ -24,7 +24,10 @@ typedef struct _FONT_ENTRY_COLL_MEM
 
 typedef struct _FONT_CACHE_ENTRY
 {
-    LIST_ENTRY ListEntry;
+    LIST_ENTRY ListEntry;   /* in the global LRU list */
+    LIST_ENTRY HashEntry;   /* in the hash bucket */
+    LIST_ENTRY FaceEntry;   /* in the LRU list of the face */
+    SIZE_T Size;
     int GlyphIndex;
     FT_Face Face;
     FT_BitmapGlyph BitmapGlyph;
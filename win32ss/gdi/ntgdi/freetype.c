@@ -86,10 +86,28 @@ static BOOL RenderingEnabled = TRUE;
 #define ASSERT_FREETYPE_LOCK_NOT_HELD() \
   ASSERT(FreeTypeLock->Owner != KeGetCurrentThread())
 
-#define MAX_FONT_CACHE 256
+/*
+ * The glyph cache is bounded by the memory the rendered bitmaps take, not by
+ * their number: a page of CJK text or a large font size would otherwise evict
+ * everything else. A single face may only take a part of it, so that one big
+ * font doesn't push the glyphs of all the others out.
+ */
+#define MAX_FONT_CACHE_SIZE         (4 * 1024 * 1024)
+#define MAX_FONT_CACHE_FACE_SIZE    (MAX_FONT_CACHE_SIZE / 2)
+#define FONT_CACHE_HASH_BUCKETS     1024
 
 static LIST_ENTRY FontCacheListHead;
-static UINT FontCacheNumEntries;
+static LIST_ENTRY FontCacheHashBuckets[FONT_CACHE_HASH_BUCKETS];
+static SIZE_T FontCacheSize;
+
+/* Not used for anything, but handy to look at from the debugger */
+static struct
+{
+    ULONG Hits;
+    ULONG Misses;
+    ULONG Evictions;
+    ULONG Entries;
+} FontCacheStats;
 
 static PWCHAR ElfScripts[32] =   /* These are in the order of the fsCsb[0] bits */
 {
@@ -191,6 +209,12 @@ SharedFace_Create(FT_Face Face, PSHARED_MEM Memory)
         Ptr->Memory = Memory;
         SharedFaceCache_Init(&Ptr->EnglishUS);
         SharedFaceCache_Init(&Ptr->UserLanguage);
+        InitializeListHead(&Ptr->GlyphCacheListHead);
+        Ptr->GlyphCacheSize = 0;
+
+        /* Lets the glyph cache find the shared face from the FreeType face */
+        Face->generic.data = Ptr;
+        Face->generic.finalizer = NULL;
 
         SharedMem_AddRef(Memory);
         DPRINT("Creating SharedFace for %s\n", Face->family_name);
@@ -225,34 +249,38 @@ SharedFace_AddRef(PSHARED_FACE Ptr)
 static void
 RemoveCachedEntry(PFONT_CACHE_ENTRY Entry)
 {
+    PSHARED_FACE SharedFace = Entry->Face->generic.data;
+
     ASSERT_FREETYPE_LOCK_HELD();
 
     FT_Done_Glyph((FT_Glyph)Entry->BitmapGlyph);
     RemoveEntryList(&Entry->ListEntry);
+    RemoveEntryList(&Entry->HashEntry);
+    RemoveEntryList(&Entry->FaceEntry);
+
+    ASSERT(FontCacheSize >= Entry->Size);
+    ASSERT(SharedFace->GlyphCacheSize >= Entry->Size);
+    FontCacheSize -= Entry->Size;
+    SharedFace->GlyphCacheSize -= Entry->Size;
+    FontCacheStats.Entries--;
+
     ExFreePoolWithTag(Entry, TAG_FONT);
-    FontCacheNumEntries--;
-    ASSERT(FontCacheNumEntries <= MAX_FONT_CACHE);
 }
 
 static void
-RemoveCacheEntries(FT_Face Face)
+RemoveCacheEntries(PSHARED_FACE SharedFace)
 {
-    PLIST_ENTRY CurrentEntry;
     PFONT_CACHE_ENTRY FontEntry;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    CurrentEntry = FontCacheListHead.Flink;
-    while (CurrentEntry != &FontCacheListHead)
+    while (!IsListEmpty(&SharedFace->GlyphCacheListHead))
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
-        CurrentEntry = CurrentEntry->Flink;
-
-        if (FontEntry->Face == Face)
-        {
-            RemoveCachedEntry(FontEntry);
-        }
+        FontEntry = CONTAINING_RECORD(SharedFace->GlyphCacheListHead.Flink,
+                                      FONT_CACHE_ENTRY, FaceEntry);
+        RemoveCachedEntry(FontEntry);
     }
+    ASSERT(SharedFace->GlyphCacheSize == 0);
 }
 
 static void SharedMem_Release(PSHARED_MEM Ptr)
@@ -295,7 +323,7 @@ SharedFace_Release(PSHARED_FACE Ptr)
     if (Ptr->RefCount == 0)
     {
         DPRINT("Releasing SharedFace for %s\n", Ptr->Face->family_name);
-        RemoveCacheEntries(Ptr->Face);
+        RemoveCacheEntries(Ptr);
         FT_Done_Face(Ptr->Face);
         SharedMem_Release(Ptr->Memory);
         SharedFaceCache_Release(&Ptr->EnglishUS);
@@ -454,10 +482,16 @@ BOOL FASTCALL
 InitFontSupport(VOID)
 {
     ULONG ulError;
+    ULONG i;
 
     InitializeListHead(&FontListHead);
     InitializeListHead(&FontCacheListHead);
-    FontCacheNumEntries = 0;
+    for (i = 0; i < FONT_CACHE_HASH_BUCKETS; i++)
+    {
+        InitializeListHead(&FontCacheHashBuckets[i]);
+    }
+    FontCacheSize = 0;
+    RtlZeroMemory(&FontCacheStats, sizeof(FontCacheStats));
     /* Fast Mutexes must be allocated from non paged pool */
     FontListLock = ExAllocatePoolWithTag(NonPagedPool, sizeof(FAST_MUTEX), TAG_INTERNAL_SYNC);
     if (FontListLock == NULL)
@@ -2614,6 +2648,25 @@ SameScaleMatrix(
             FLOATOBJ_Equal(&pmx1->efM22, &pmx2->efM22));
 }
 
+/* The matrix isn't hashed, glyphs of one size seldom come in several transforms */
+static
+PLIST_ENTRY
+GlyphCacheBucket(
+    FT_Face Face,
+    INT GlyphIndex,
+    INT Height,
+    FT_Render_Mode RenderMode)
+{
+    ULONG Hash;
+
+    Hash = (ULONG)((ULONG_PTR)Face >> 4) * 0x9E3779B1;
+    Hash ^= (ULONG)GlyphIndex * 0x85EBCA6B;
+    Hash ^= ((ULONG)Height << 8) ^ (ULONG)RenderMode;
+    Hash ^= Hash >> 16;
+
+    return &FontCacheHashBuckets[Hash % FONT_CACHE_HASH_BUCKETS];
+}
+
 FT_BitmapGlyph APIENTRY
 ftGdiGlyphCacheGet(
     FT_Face Face,
@@ -2622,31 +2675,38 @@ ftGdiGlyphCacheGet(
     FT_Render_Mode RenderMode,
     PMATRIX pmx)
 {
-    PLIST_ENTRY CurrentEntry;
+    PLIST_ENTRY Bucket, CurrentEntry;
     PFONT_CACHE_ENTRY FontEntry;
+    PSHARED_FACE SharedFace;
 
     ASSERT_FREETYPE_LOCK_HELD();
 
-    CurrentEntry = FontCacheListHead.Flink;
-    while (CurrentEntry != &FontCacheListHead)
+    Bucket = GlyphCacheBucket(Face, GlyphIndex, Height, RenderMode);
+    for (CurrentEntry = Bucket->Flink; CurrentEntry != Bucket; CurrentEntry = CurrentEntry->Flink)
     {
-        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, ListEntry);
+        FontEntry = CONTAINING_RECORD(CurrentEntry, FONT_CACHE_ENTRY, HashEntry);
         if ((FontEntry->Face == Face) &&
             (FontEntry->GlyphIndex == GlyphIndex) &&
             (FontEntry->Height == Height) &&
             (FontEntry->RenderMode == RenderMode) &&
             (SameScaleMatrix(&FontEntry->mxWorldToDevice, pmx)))
             break;
-        CurrentEntry = CurrentEntry->Flink;
     }
 
-    if (CurrentEntry == &FontCacheListHead)
+    if (CurrentEntry == Bucket)
     {
+        FontCacheStats.Misses++;
         return NULL;
     }
 
-    RemoveEntryList(CurrentEntry);
-    InsertHeadList(&FontCacheListHead, CurrentEntry);
+    /* Most recently used, both globally and within its face */
+    SharedFace = Face->generic.data;
+    RemoveEntryList(&FontEntry->ListEntry);
+    InsertHeadList(&FontCacheListHead, &FontEntry->ListEntry);
+    RemoveEntryList(&FontEntry->FaceEntry);
+    InsertHeadList(&SharedFace->GlyphCacheListHead, &FontEntry->FaceEntry);
+
+    FontCacheStats.Hits++;
     return FontEntry->BitmapGlyph;
 }
 
@@ -2703,11 +2763,13 @@ ftGdiGlyphCacheSet(
 {
     FT_Glyph GlyphCopy;
     INT error;
-    PFONT_CACHE_ENTRY NewEntry;
+    PFONT_CACHE_ENTRY NewEntry, OldEntry;
     FT_Bitmap AlignedBitmap;
     FT_BitmapGlyph BitmapGlyph;
+    PSHARED_FACE SharedFace = Face->generic.data;
 
     ASSERT_FREETYPE_LOCK_HELD();
+    ASSERT(SharedFace && SharedFace->Face == Face);
 
     error = FT_Get_Glyph(GlyphSlot, &GlyphCopy);
     if (error)
@@ -2752,12 +2814,31 @@ ftGdiGlyphCacheSet(
     NewEntry->Height = Height;
     NewEntry->RenderMode = RenderMode;
     NewEntry->mxWorldToDevice = *pmx;
+    NewEntry->Size = sizeof(FONT_CACHE_ENTRY) + sizeof(FT_BitmapGlyphRec) +
+                     (SIZE_T)abs(AlignedBitmap.pitch) * AlignedBitmap.rows;
 
     InsertHeadList(&FontCacheListHead, &NewEntry->ListEntry);
-    if (++FontCacheNumEntries > MAX_FONT_CACHE)
-    {
-        NewEntry = CONTAINING_RECORD(FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
-        RemoveCachedEntry(NewEntry);
+    InsertHeadList(GlyphCacheBucket(Face, GlyphIndex, Height, RenderMode), &NewEntry->HashEntry);
+    InsertHeadList(&SharedFace->GlyphCacheListHead, &NewEntry->FaceEntry);
+    FontCacheSize += NewEntry->Size;
+    SharedFace->GlyphCacheSize += NewEntry->Size;
+    FontCacheStats.Entries++;
+
+    /* Make room, first within the face, then globally. The new glyph always stays,
+     * the caller is about to use it */
+    while (SharedFace->GlyphCacheSize > MAX_FONT_CACHE_FACE_SIZE &&
+           SharedFace->GlyphCacheListHead.Blink != &NewEntry->FaceEntry)
+    {
+        OldEntry = CONTAINING_RECORD(SharedFace->GlyphCacheListHead.Blink, FONT_CACHE_ENTRY, FaceEntry);
+        RemoveCachedEntry(OldEntry);
+        FontCacheStats.Evictions++;
+    }
+    while (FontCacheSize > MAX_FONT_CACHE_SIZE &&
+           FontCacheListHead.Blink != &NewEntry->ListEntry)
+    {
+        OldEntry = CONTAINING_RECORD(FontCacheListHead.Blink, FONT_CACHE_ENTRY, ListEntry);
+        RemoveCachedEntry(OldEntry);
+        FontCacheStats.Evictions++;
     }
 
     return BitmapGlyph;